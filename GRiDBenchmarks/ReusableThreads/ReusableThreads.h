@@ -1,10 +1,18 @@
 /**************************************************************************
  *  Reusable Threads
  *
- *  This library is a mashup of threadpools and standard threads. Here we
- *  construct persistent threads that can each be sent specific jobs.
- *  This library is adapted from and inspired by threadpool and llvm. 
+ *  Persistent threads that split a range of work items (e.g., timesteps)
+ *  between themselves. Each thread owns a lock-free deque holding a
+ *  contiguous range of items: the owner pops from the front and idle
+ *  threads steal half of what is left from the back of another range, so
+ *  an uneven split never leaves the other threads waiting on a straggler.
  *
+ *  Idle workers spin for an adaptive number of iterations before parking
+ *  on a condition variable, so back to back calls never pay for a wakeup
+ *  and long pauses do not burn a core. Launching and syncing only touch
+ *  atomics; the mutex is taken only to park or wake a parked worker.
+ *
+ *  Originally adapted from and inspired by threadpool and llvm.
  *  threadpool: https://github.com/PaulRitaldato1/ThreadPool
  *  llvm: https://code.woboq.org/llvm/llvm/lib/Support/ThreadPool.cpp.html
  **************************************************************************/
@@ -13,103 +21,181 @@
 
 #include <thread>
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
-#include <functional>
-#include <future>
 #include <atomic>
-#include <type_traits>
-#include <typeinfo>
-#include <array>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#endif
 
-template <std::size_t NUM_THREADS = 1>
 class ReusableThreads{
 public:
-	// Constructor
-	ReusableThreads(){
-		shutdown = false;
-		ActiveThreads = 0;
-		createThreads();
+	// Constructor (num_threads counts the calling thread, which helps out in sync)
+	explicit ReusableThreads(int num_threads = static_cast<int>(std::thread::hardware_concurrency())) :
+		slots(num_threads > 0 ? num_threads : 1){
+		shutdown = false; open = false; epoch = 0; sleepers = 0; busy = 0; remaining = 0;
+		job = nullptr; ctx = nullptr; grain = 1;
+		for (int tid = 1; tid < size(); tid++){threads.emplace_back([this,tid](){workerLoop(tid);});}
 	}
 
 	// Destructor
 	~ReusableThreads(){
-		shutdown = true;
-		for (std::size_t tid = 0; tid < NUM_THREADS; tid++){taskNotifier[tid].notify_all(); threads[tid].join();}
+		sync();
+		{std::unique_lock<std::mutex> lock(parkMutex); shutdown = true;}
+		parkNotifier.notify_all();
+		for (std::thread &thread : threads){thread.join();}
 	}
 
-	// Add any arg # function to queue for TID (assume void function)
-	template <typename Func, typename... Args>
-	void addTask(int tid, Func&& f, Args&&... args){
-		auto task = std::make_shared<std::packaged_task<void()>>(std::bind(f, std::forward<Args>(args)...));
-		{
-			std::unique_lock<std::mutex> lock(taskMutex[tid]); // lock mutex
-			taskQueue[tid].emplace([=] {(*task)();}); //place the task into the queue
+	// Number of thread ids handed to tasks (workers plus the calling thread)
+	int size() const {return static_cast<int>(slots.size());}
+
+	// Start f(tid, kStart, kMax) over chunks of [0, numItems) without waiting
+	//   tid is in range(0,size()) and is unique among concurrently running chunks
+	//   f must outlive the matching sync()
+	template <typename Func>
+	void launch(int numItems, Func &f, int grainSize = 1){
+		sync();
+		if (numItems <= 0){return;}
+		job = &trampoline<Func>; ctx = static_cast<void *>(&f); grain = grainSize > 0 ? grainSize : 1;
+		// seed each deque with a contiguous share of the range
+		const int nslots = size();
+		for (int tid = 0; tid < nslots; tid++){
+			std::int64_t kStart = static_cast<std::int64_t>(numItems)*tid/nslots;
+			std::int64_t kMax = static_cast<std::int64_t>(numItems)*(tid+1)/nslots;
+			slots[tid].range.store(pack(static_cast<int>(kStart), static_cast<int>(kMax)), std::memory_order_relaxed);
+		}
+		remaining.store(numItems, std::memory_order_relaxed);
+		open.store(true);
+		epoch.fetch_add(1);
+		if (sleepers.load() > 0){
+			{std::unique_lock<std::mutex> lock(parkMutex);}
+			parkNotifier.notify_all();
 		}
-		taskNotifier[tid].notify_all(); // notify that a job is ready
-		return;
 	}
 
-	// Wait for all threads to complete and the queue to be empty
-	void sync() {
-  		std::unique_lock<std::mutex> lock(CompletionLock);
-  		// The order of the checks for ActiveThreads and taskQueue[tid].empty() matters because
-  		// any active threads might be modifying the jobQueue queue, and this would be a race.
-  		CompletionCondition.wait(lock, [&] {
-  			bool doneFlag = !ActiveThreads;
-  			for (std::size_t tid = 0; tid < NUM_THREADS; tid++){doneFlag &= taskQueue[tid].empty();}
-  			return doneFlag;
-  		});
+	// Wait for all launched work to finish (the calling thread works as tid 0 meanwhile)
+	void sync(){
+		if (!open.load()){return;}
+		runChunks(0);
+		while (remaining.load(std::memory_order_acquire) > 0){cpuRelax();}
+		// close the job and wait for every worker to leave it before it can be reused
+		open.store(false);
+		while (busy.load() > 0){cpuRelax();}
+	}
+
+	// launch + sync
+	template <typename Func>
+	void parallel_for(int numItems, Func &&f, int grainSize = 1){
+		launch(numItems, f, grainSize); sync();
 	}
 
 private:
+	typedef void (*Job)(void *, int, int, int);
 
-	using Job = std::function<void()>;
-	std::array<std::thread, NUM_THREADS> threads;
-	std::array<std::queue<Job>, NUM_THREADS> taskQueue;
-	std::array<std::mutex, NUM_THREADS> taskMutex;
-	std::array<std::condition_variable, NUM_THREADS> taskNotifier;
-	std::atomic<bool> shutdown;
-	std::condition_variable CompletionCondition;
-	std::mutex CompletionLock;
-	int ActiveThreads;//std::atomic<int> ActiveThreads;
-
-	void createThreads(){
-		for (std::size_t tid = 0; tid < NUM_THREADS; tid++){
-			threads[tid] = std::thread([this,tid](){
-				while (true){
-					Job task;
-					{
-						// wait on a job
-						std::unique_lock<std::mutex> lock(taskMutex[tid]);
-						taskNotifier[tid].wait(lock, [this,tid] {return !taskQueue[tid].empty() || shutdown;});
-
-						if (shutdown){break;}
-
-						task = std::move(taskQueue[tid].front());
-						// Yeah, we have a task, grab it and release the lock on the queue
-						// We first need to signal that we are active before popping the queue
-						// in order for wait() to properly detect that even if the queue is
-						// empty, there is still a task in flight.
-						{
-							std::unique_lock<std::mutex> lock(CompletionLock);
-							++ActiveThreads;
-						}
-						taskQueue[tid].pop();
-					}
-					task();
-					{
-						// Adjust ActiveThreads, in case someone waits on ThreadPool::wait()
-						std::unique_lock<std::mutex> lock(CompletionLock);
-						--ActiveThreads;
-					}
-					// Notify task completion, in case someone waits on ThreadPool::wait()
-					CompletionCondition.notify_all();
-				}
-			});
+	template <typename Func>
+	static void trampoline(void *f, int tid, int kStart, int kMax){(*static_cast<Func *>(f))(tid, kStart, kMax);}
+
+	// [kStart, kMax) of one deque packed into a single atomic word
+	static std::uint64_t pack(int kStart, int kMax){
+		return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(kMax)) << 32) | static_cast<std::uint32_t>(kStart);
+	}
+	static int rangeStart(std::uint64_t range){return static_cast<int>(static_cast<std::uint32_t>(range));}
+	static int rangeMax(std::uint64_t range){return static_cast<int>(range >> 32);}
+
+	static void cpuRelax(){
+		#if defined(__x86_64__) || defined(__i386__)
+			_mm_pause();
+		#else
+			std::this_thread::yield();
+		#endif
+	}
+
+	// owner: take up to grain items from the front
+	bool popFront(int tid, int &kStart, int &kMax){
+		std::atomic<std::uint64_t> &range = slots[tid].range;
+		std::uint64_t cur = range.load(std::memory_order_acquire);
+		while (rangeStart(cur) < rangeMax(cur)){
+			kStart = rangeStart(cur); kMax = kStart + grain < rangeMax(cur) ? kStart + grain : rangeMax(cur);
+			if (range.compare_exchange_weak(cur, pack(kMax, rangeMax(cur)))){return true;}
 		}
+		return false;
 	}
+
+	// thief: take the back half of another deque
+	bool stealBack(int victim, int &kStart, int &kMax){
+		std::atomic<std::uint64_t> &range = slots[victim].range;
+		std::uint64_t cur = range.load(std::memory_order_acquire);
+		while (rangeStart(cur) < rangeMax(cur)){
+			const int left = rangeMax(cur) - rangeStart(cur);
+			const int split = rangeMax(cur) - (left > 1 ? left/2 : 1);
+			if (range.compare_exchange_weak(cur, pack(rangeStart(cur), split))){kStart = split; kMax = rangeMax(cur); return true;}
+		}
+		return false;
+	}
+
+	void runChunks(int tid){
+		const int nslots = size();
+		while (true){
+			int kStart, kMax;
+			if (!popFront(tid, kStart, kMax)){
+				bool stolen = false;
+				for (int i = 1; i < nslots && !stolen; i++){stolen = stealBack((tid + i) % nslots, kStart, kMax);}
+				if (!stolen){return;}
+				// our deque is empty so nobody else can be touching it: keep what is left of the loot
+				const int chunkMax = kStart + grain < kMax ? kStart + grain : kMax;
+				slots[tid].range.store(pack(chunkMax, kMax), std::memory_order_release);
+				kMax = chunkMax;
+			}
+			job(ctx, tid, kStart, kMax);
+			remaining.fetch_sub(kMax - kStart, std::memory_order_acq_rel);
+		}
+	}
+
+	void workerLoop(int tid){
+		unsigned long seen = 0;
+		int spinLimit = SPIN_MIN;
+		while (true){
+			// spin, then park until a new job is launched
+			int spins = 0;
+			while (epoch.load() == seen && spins < spinLimit){cpuRelax(); spins++;}
+			if (epoch.load() == seen){
+				spinLimit = spinLimit/2 > SPIN_MIN ? spinLimit/2 : SPIN_MIN;
+				std::unique_lock<std::mutex> lock(parkMutex);
+				sleepers.fetch_add(1);
+				parkNotifier.wait(lock, [&]{return shutdown || epoch.load() != seen;});
+				sleepers.fetch_sub(1);
+			}
+			else {spinLimit = 2*spinLimit < SPIN_MAX ? 2*spinLimit : SPIN_MAX;}
+			if (shutdown){return;}
+			seen = epoch.load();
+			// only touch the deques while the job is open (sync waits on busy before closing it)
+			busy.fetch_add(1);
+			if (open.load()){runChunks(tid);}
+			busy.fetch_sub(1);
+		}
+	}
+
+	// one deque per cache line
+	struct Slot {std::atomic<std::uint64_t> range; char pad[64 - sizeof(std::atomic<std::uint64_t>)]; Slot() : range(0) {}};
+
+	static const int SPIN_MIN = 1 << 8;
+	static const int SPIN_MAX = 1 << 16;
+
+	std::vector<Slot> slots;
+	std::vector<std::thread> threads;
+	std::atomic<bool> open;
+	std::atomic<unsigned long> epoch;
+	std::atomic<int> sleepers;
+	std::atomic<int> busy;
+	std::atomic<int> remaining;
+	std::mutex parkMutex;
+	std::condition_variable parkNotifier;
+	std::atomic<bool> shutdown;
+	Job job;
+	void *ctx;
+	int grain;
+
 	ReusableThreads (const ReusableThreads&) = delete;
 	ReusableThreads& operator= (const ReusableThreads&) = delete;
-}; 
\ No newline at end of file
+};
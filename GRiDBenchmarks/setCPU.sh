@@ -1,10 +0,0 @@
-#!/bin/bash
-sudo cpufreq-set -c 0 -g performance
-sudo cpufreq-set -c 1 -g performance
-sudo cpufreq-set -c 2 -g performance
-sudo cpufreq-set -c 3 -g performance
-sudo cpufreq-set -c 4 -g performance
-sudo cpufreq-set -c 5 -g performance
-sudo cpufreq-set -c 6 -g performance
-sudo cpufreq-set -c 7 -g performance
-echo "Govenors set to performance"
\ No newline at end of file
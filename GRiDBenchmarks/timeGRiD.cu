@@ -1,16 +1,24 @@
 /***
 nvcc -std=c++11 -o timeGRiD.exe timeGRiD.cu -gencode arch=compute_86,code=sm_86 -O3 -ftz=true -prec-div=false -prec-sqrt=false
+g++ -std=c++11 -O3 -pthread -x c++ -DGRID_CPU -o timeGRiD.exe timeGRiD.cu
+example usage: ./timeGRiD.exe F --algs=ID,FD_DU --batches=16,64 --threads=1,8 --json=iiwa.json --baseline=old.json
+   (see util/benchmark_harness.h for every option)
 ***/
 
 #include "util/experiment_helpers.h" // include constants and other experiment consistency helpers
-#include "../grid.cuh"
+#include "util/benchmark_harness.h" // runtime sweep, pinning, percentile reports and baseline comparison
+#ifdef GRID_CPU
+	#include "../grid_cpu.hpp"
+#else
+	#include "../grid.cuh"
+#endif
 
 dim3 dimms(grid::SUGGESTED_THREADS,1,1); // all loops are single loops (all mat mult flattened into column opps)
 #define GRAVITY 9.81
 
-template <typename T, int TEST_ITERS>
+template <typename T>
 __host__
-void test(int NUM_TIMESTEPS, cudaStream_t *streams, grid::robotModel<T> *d_robotModel, grid::gridData<T> *hd_data){
+void test(BenchmarkSuite &suite, int NUM_TIMESTEPS, int num_threads, cudaStream_t *streams, grid::robotModel<T> *d_robotModel, grid::gridData<T> *hd_data){
    	#if TEST_FOR_EQUIVALENCE
 		printf("q,qd,u\n");
 	// 	printMat<T,1,grid::NUM_JOINTS>(hd_data->h_q_qd_u,1);
@@ -45,148 +53,37 @@ void test(int NUM_TIMESTEPS, cudaStream_t *streams, grid::robotModel<T> *d_robot
 	// 	printMat<T,grid::NUM_JOINTS,grid::NUM_JOINTS>(&hd_data->h_df_du[grid::NUM_JOINTS*grid::NUM_JOINTS],grid::NUM_JOINTS);
 		
    	#else
-		// Setup timer
-	   	struct timespec start, end;
-	   	std::vector<double> times = {};
-
-		if(NUM_TIMESTEPS == 1){
-			// first one is done twice to wake up the GPU and get it up to full speed
-			grid::inverse_dynamics_single_timing<T,false,true>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-			grid::inverse_dynamics_single_timing<T,false,true>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-    		grid::direct_minv_single_timing<T,true>(hd_data,d_robotModel,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-    		grid::forward_dynamics_single_timing<T>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-    		grid::inverse_dynamics_gradient_single_timing<T,false,true>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-    		grid::forward_dynamics_gradient_single_timing<T,false>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-			grid::idsva_so_host_single_timing<T>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-			grid::fdsva_so_single_timing<T>(hd_data,d_robotModel,GRAVITY,TEST_ITERS,dim3(1,1,1),dimms,streams);
-			cudaDeviceSynchronize();
-		}
-		else{
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::inverse_dynamics<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: ID WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::inverse_dynamics_compute_only<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: ID COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::direct_minv<T,true>(hd_data,d_robotModel,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: Minv WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::direct_minv_compute_only<T,true>(hd_data,d_robotModel,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: Minv COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::forward_dynamics<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: FD WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::forward_dynamics_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: FD COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::inverse_dynamics_gradient<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: ID_DU WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::inverse_dynamics_gradient_compute_only<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: ID_DU COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::forward_dynamics_gradient<T,false>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: FD_DU WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::forward_dynamics_gradient_compute_only<T,false>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: FD_DU COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::idsva_so_host<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: ID_SO WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::idsva_so_host_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: ID_SO COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::fdsva_so<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms,streams);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: FD_SO WITH MEMORY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-			for(int iter = 0; iter < TEST_ITERS; iter++){
-				clock_gettime(CLOCK_MONOTONIC,&start);
-				grid::fdsva_so_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,dim3(NUM_TIMESTEPS,1,1),dimms);
-				clock_gettime(CLOCK_MONOTONIC,&end);
-				times.push_back(time_delta_us_timespec(start,end));
-			}
-			printf("[N:%d]: FD_SO COMPUTE ONLY: ",NUM_TIMESTEPS); printStats(&times); times.clear();
-
-		}
+		const dim3 blocks(NUM_TIMESTEPS,1,1);
+		// WITH MEMORY includes the host <-> device copies, COMPUTE ONLY is the kernel alone
+		suite.run("ID", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::inverse_dynamics<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("ID", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::inverse_dynamics_compute_only<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		suite.run("Minv", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::direct_minv<T,true>(hd_data,d_robotModel,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("Minv", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::direct_minv_compute_only<T,true>(hd_data,d_robotModel,NUM_TIMESTEPS,blocks,dimms);});
+		suite.run("FD", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("FD", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		suite.run("ID_DU", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::inverse_dynamics_gradient<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("ID_DU", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::inverse_dynamics_gradient_compute_only<T,false,true>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		suite.run("FD_DU", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics_gradient<T,false>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("FD_DU", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics_gradient_compute_only<T,false>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		suite.run("ID_SO", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::idsva_so_host<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("ID_SO", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::idsva_so_host_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		suite.run("FD_SO", "memory", NUM_TIMESTEPS, num_threads, [&](){grid::fdsva_so<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms,streams);});
+		suite.run("FD_SO", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::fdsva_so_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		#ifdef GRID_CPU
+			// host backend only entry points
+			suite.run("BUNDLE", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::dynamics_bundle_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+			suite.run("Minv_PACKED", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::direct_minv_packed_compute_only<T,true>(hd_data,d_robotModel,NUM_TIMESTEPS,blocks,dimms);});
+			suite.run("CRBA_PACKED", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::crba_packed_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+			suite.run("FD_LTL", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics_ltl_compute_only<T>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+			suite.run("FD_DU_LTL", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics_gradient_ltl_compute_only<T,false>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+			suite.run("FD_DU_SPARSE", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::forward_dynamics_gradient_sparse_compute_only<T,false>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+			suite.run("EE_KIN", "compute", NUM_TIMESTEPS, num_threads, [&](){grid::end_effector_kinematics_compute_only<T,grid::EE_ALL>(hd_data,d_robotModel,GRAVITY,NUM_TIMESTEPS,blocks,dimms);});
+		#endif
 	#endif
 }
 
-template<typename T, int TEST_ITERS>
-void run_all_tests(bool floating_base){
+template<typename T>
+int run_all_tests(BenchmarkSuite &suite, bool floating_base){
 	// allocate memory for max of what we need
 	const int MAX_TIMESTEPS = 256;
 	cudaStream_t *streams = grid::init_grid<T>();
@@ -198,8 +95,10 @@ void run_all_tests(bool floating_base){
 		for (int ind = 0; ind < grid::NUM_JOINTS + floating_base; ind++) {
 			T val = getRand<double>();
 			hd_data->h_q_qd_u[k*(3*grid::NUM_JOINTS+floating_base) + ind] = val;
-			hd_data->h_q_qd[k*(2*grid::NUM_JOINTS+floating_base) + ind] = val;
-			hd_data->h_q[k*(grid::NUM_JOINTS+floating_base) + ind] = val;
+			#ifndef GRID_CPU
+				hd_data->h_q_qd[k*(2*grid::NUM_JOINTS+floating_base) + ind] = val;
+				hd_data->h_q[k*(grid::NUM_JOINTS+floating_base) + ind] = val;
+			#endif
 		}
 		for(int ind = 0; ind < grid::NUM_JOINTS; ind++){
 			// get values
@@ -207,32 +106,51 @@ void run_all_tests(bool floating_base){
 			hd_data->h_q_qd_u[k*(3*grid::NUM_JOINTS+floating_base) + grid::NUM_JOINTS + ind + floating_base] = val2;
 			hd_data->h_q_qd_u[k*(3*grid::NUM_JOINTS+floating_base) + 2*grid::NUM_JOINTS + ind + floating_base] = val3;
 			// load into alternate memory sizes
-			hd_data->h_q_qd[k*(2*grid::NUM_JOINTS+floating_base) + grid::NUM_JOINTS + ind + floating_base] = val2;
+			#ifndef GRID_CPU
+				hd_data->h_q_qd[k*(2*grid::NUM_JOINTS+floating_base) + grid::NUM_JOINTS + ind + floating_base] = val2;
+			#endif
 		}
 	}
+	#ifdef GRID_CPU
+		// the host backend can read every packing from h_q_qd_u so the inputs are only written once
+		grid::use_packed_inputs<T>(hd_data);
+	#endif
 	// copy values onto the GPU as default values (we will do more transfers later but this ensures things are initialized)
 	gpuErrchk(cudaMemcpy(hd_data->d_q_qd_u,hd_data->h_q_qd_u,3*grid::NUM_JOINTS*MAX_TIMESTEPS*sizeof(T),cudaMemcpyHostToDevice));
 	gpuErrchk(cudaMemcpy(hd_data->d_q_qd,hd_data->h_q_qd,2*grid::NUM_JOINTS*MAX_TIMESTEPS*sizeof(T),cudaMemcpyHostToDevice));
 	gpuErrchk(cudaMemcpy(hd_data->d_q,hd_data->h_q,grid::NUM_JOINTS*MAX_TIMESTEPS*sizeof(T),cudaMemcpyHostToDevice));
 	gpuErrchk(cudaDeviceSynchronize());
 
-	// then run the tests
-	test<T,TEST_ITERS*10>(1,streams,d_robotModel,hd_data); // more iters for single test
-	#if !TEST_FOR_EQUIVALENCE
-		test<T,TEST_ITERS>(16,streams,d_robotModel,hd_data);
-		test<T,TEST_ITERS>(32,streams,d_robotModel,hd_data);
-		test<T,TEST_ITERS>(64,streams,d_robotModel,hd_data);
-		test<T,TEST_ITERS>(128,streams,d_robotModel,hd_data);
-		test<T,TEST_ITERS>(256,streams,d_robotModel,hd_data);
+	// then run the tests (thread counts only apply to the host backend, the GPU sweeps batches once)
+	#if TEST_FOR_EQUIVALENCE
+		test<T>(suite,1,0,streams,d_robotModel,hd_data);
+	#else
+		#ifdef GRID_CPU
+			const std::vector<int> thread_counts = suite.config().threads;
+		#else
+			const std::vector<int> thread_counts = {0};
+		#endif
+		for (int num_threads : thread_counts){
+			#ifdef GRID_CPU
+				streams = grid::init_grid<T>(num_threads);
+			#endif
+			for (int num_timesteps : suite.config().batches){
+				if (num_timesteps < 1 || num_timesteps > MAX_TIMESTEPS){printf("[!Warning] skipping batch size %d (1 to %d)\n",num_timesteps,MAX_TIMESTEPS); continue;}
+				test<T>(suite,num_timesteps,num_threads,streams,d_robotModel,hd_data);
+			}
+		}
 	#endif
 	
 	// free all memory and exit
 	grid::close_grid<T>(streams,d_robotModel,hd_data);
+	return suite.finish();
 }
 
 int main(int argc, const char **argv){
+	BenchmarkConfig cfg = parseBenchmarkArgs(argc, argv);
 	bool floating_base = false;
-	if (argc > 1 && argv[1][0] == 'T') {floating_base = true; printf("Floating Base = True\n");}
+	if (!cfg.positional.empty() && cfg.positional[0][0] == 'T') {floating_base = true; printf("Floating Base = True\n");}
 	else {printf("Floating Base = False\n");}
-	run_all_tests<float,TEST_ITERS_GLOBAL>(floating_base); return 0;
-}
\ No newline at end of file
+	BenchmarkSuite suite(cfg);
+	return run_all_tests<float>(suite, floating_base);
+}
@@ -9,9 +9,12 @@ sys.path.append(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
 import util as util
 import URDFParser.URDFParser as URDFParser
 import GRiDCodeGenerator.GRiDCodeGenerator as GRiDCodeGenerator
+from GRiDCPUCodeGenerator import GRiDCPUCodeGenerator
 
 
 def main():
+    USE_CPU = util.useCPUBackend()
+    FLOATING_BASE = False
     inputs = util.parseInputs(NO_ARG_OPTION = True)
     if not inputs is None:
         URDF_PATH, DEBUG_MODE, FILE_NAMESPACE_NAME, FLOATING_BASE = inputs
@@ -20,22 +23,32 @@ def main():
 
         util.validateRobot(robot, NO_ARG_OPTION = True)
 
-        codegen = GRiDCodeGenerator(robot, DEBUG_MODE, True, FILE_NAMESPACE = FILE_NAMESPACE_NAME)
-        if FLOATING_BASE: include_homogenous_transforms = False
-        else: include_homogenous_transforms = True
-        print("-----------------")
-        print("Generating GRiD.cuh")
-        print("-----------------")
-        codegen.gen_all_code(include_homogenous_transforms = include_homogenous_transforms)
-        print("New code generated and saved to grid.cuh!")
+        if USE_CPU:
+            codegen = GRiDCPUCodeGenerator(robot, DEBUG_MODE, FILE_NAMESPACE = FILE_NAMESPACE_NAME)
+            print("-----------------")
+            print("Generating grid_cpu.hpp")
+            print("-----------------")
+            if not codegen.gen_all_code(): exit()
+            print("New code generated and saved to grid_cpu.hpp!")
+        else:
+            codegen = GRiDCodeGenerator(robot, DEBUG_MODE, True, FILE_NAMESPACE = FILE_NAMESPACE_NAME)
+            if FLOATING_BASE: include_homogenous_transforms = False
+            else: include_homogenous_transforms = True
+            print("-----------------")
+            print("Generating GRiD.cuh")
+            print("-----------------")
+            codegen.gen_all_code(include_homogenous_transforms = include_homogenous_transforms)
+            print("New code generated and saved to grid.cuh!")
 
     print("-----------------")
     print("Compiling timeGRiD")
     print("-----------------")
+    if USE_CPU: compile_cmd = ["g++", "-std=c++11", "-O3", "-pthread", "-x", "c++", "-DGRID_CPU", "-o", "timeGRiD.exe", "GRiDBenchmarks/timeGRiD.cu"]
+    else: compile_cmd = ["nvcc", "-std=c++11", "-o", "timeGRiD.exe", "GRiDBenchmarks/timeGRiD.cu", \
+                         "-gencode", "arch=compute_89,code=sm_89", \
+                         "-O3", "-ftz=true", "-prec-div=false", "-prec-sqrt=false"]
     result = subprocess.run( \
-        ["nvcc", "-std=c++11", "-o", "timeGRiD.exe", "GRiDBenchmarks/timeGRiD.cu", \
-         "-gencode", "arch=compute_89,code=sm_89", \
-         "-O3", "-ftz=true", "-prec-div=false", "-prec-sqrt=false"], \
+        compile_cmd, \
         capture_output=True, text=True \
     )
     if result.stderr:
@@ -48,16 +61,17 @@ def main():
     print("-----------------")
     print("This may take a few minutes....")
     print("     Outputs will show up at the end")
-    print("     ID single will show up twice as")
-    print("        this is used to warm up the GPU")
     print("-----------------")
-    result = subprocess.run(["./timeGRiD.exe"], capture_output=True, text=True)
+    result = subprocess.run(["./timeGRiD.exe", str(FLOATING_BASE)] + util.benchmarkArgs(), capture_output=True, text=True)
     if result.stderr:
         print("Runtime errors follow:")
         print(result.stderr)
         exit()
 
     print(result.stdout)
+    if result.returncode != 0:
+        print("[!Error] benchmark regressions against the baseline (see above)")
+        exit(result.returncode)
 
 if __name__ == "__main__":
     main()
\ No newline at end of file
@@ -1,9 +1,11 @@
 /*
  * This timing code is based on the benchmarking code as written in the Pinocchio repository
  * g++ -std=c++11 timePinocchio.cpp -o timePinocchio -O3 $(pkg-config --cflags --libs pinocchio cppadcg) 
- * example usage: ./timePinocchio.exe urdfs/atlas.urdf True
+ * example usage: ./timePinocchio.exe urdfs/atlas.urdf True --batches=16,64 --threads=1,8 --json=atlas.json
+ *    (see util/benchmark_harness.h for every option)
  */
 #include "util/experiment_helpers.h" // include constants and other experiment consistency helpers
+#include "util/benchmark_harness.h" // runtime sweep, pinning, percentile reports and baseline comparison
 #include "ReusableThreads/ReusableThreads.h" // multi-threading wrapper
 
 #include "pinocchio/algorithm/joint-configuration.hpp"
@@ -35,8 +37,6 @@
 using namespace Eigen;
 using namespace pinocchio;
 
-#define time_delta_us_timespec(start,end) (1e6*static_cast<double>(end.tv_sec - start.tv_sec)+1e-3*static_cast<double>(end.tv_nsec - start.tv_nsec))
-
 template<typename T>
 void inverseDynamicsThreaded_codegen_inner(CodeGenRNEAWithGetRes<T> *rnea_code_gen, int nq, int nv, \
                                            Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, int tid, int kStart, int kMax){
@@ -46,16 +46,13 @@ void inverseDynamicsThreaded_codegen_inner(CodeGenRNEAWithGetRes<T> *rnea_code_g
     }
 }
 
-template<typename T, int NUM_THREADS, int NUM_TIME_STEPS>
-void inverseDynamicsThreaded_codegen(CodeGenRNEAWithGetRes<T> **rnea_code_gen_arr, int nq, int nv, \
-                                     Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, ReusableThreads<NUM_THREADS> *threads){
-        for (int tid = 0; tid < NUM_THREADS; tid++){
-            int kStart = NUM_TIME_STEPS/NUM_THREADS*tid; int kMax = NUM_TIME_STEPS/NUM_THREADS*(tid+1); 
-            if(tid == NUM_THREADS-1){kMax = NUM_TIME_STEPS;} 
-            threads->addTask(tid, &inverseDynamicsThreaded_codegen_inner<T>, std::ref(rnea_code_gen_arr[tid]), nq, nv,
-                                                                             std::ref(qs), std::ref(qds), tid, kStart, kMax);
-        }
-        threads->sync();
+template<typename T>
+void inverseDynamicsThreaded_codegen(int num_timesteps, CodeGenRNEAWithGetRes<T> **rnea_code_gen_arr, int nq, int nv, \
+                                     Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, ReusableThreads *threads){
+        // timesteps are handed out in small chunks and idle threads steal from busy ones
+        threads->parallel_for(num_timesteps, [&](int tid, int kStart, int kMax){
+            inverseDynamicsThreaded_codegen_inner<T>(rnea_code_gen_arr[tid], nq, nv, qs, qds, tid, kStart, kMax);
+        });
 }
 
 template<typename T>
@@ -65,14 +62,12 @@ void minvThreaded_codegen_inner(CodeGenMinv<T> *minv_code_gen, int nq, int nv, M
     }
 }
 
-template<typename T, int NUM_THREADS, int NUM_TIME_STEPS>
-void minvThreaded_codegen(CodeGenMinv<T> **minv_code_gen_arr, int nq, int nv, Matrix<T, Eigen::Dynamic, 1> *qs, ReusableThreads<NUM_THREADS> *threads){
-        for (int tid = 0; tid < NUM_THREADS; tid++){
-            int kStart = NUM_TIME_STEPS/NUM_THREADS*tid; int kMax = NUM_TIME_STEPS/NUM_THREADS*(tid+1); 
-            if(tid == NUM_THREADS-1){kMax = NUM_TIME_STEPS;} 
-            threads->addTask(tid, &minvThreaded_codegen_inner<T>, std::ref(minv_code_gen_arr[tid]), nq, nv, std::ref(qs), tid, kStart, kMax);
-        }
-        threads->sync();
+template<typename T>
+void minvThreaded_codegen(int num_timesteps, CodeGenMinv<T> **minv_code_gen_arr, int nq, int nv, Matrix<T, Eigen::Dynamic, 1> *qs, ReusableThreads *threads){
+        // timesteps are handed out in small chunks and idle threads steal from busy ones
+        threads->parallel_for(num_timesteps, [&](int tid, int kStart, int kMax){
+            minvThreaded_codegen_inner<T>(minv_code_gen_arr[tid], nq, nv, qs, tid, kStart, kMax);
+        });
 }
 
 template<typename T>
@@ -90,19 +85,15 @@ void forwardDynamicsThreaded_codegen_inner(CodeGenMinv<T> *minv_code_gen, CodeGe
     }
 }
 
-template<typename T, int NUM_THREADS, int NUM_TIME_STEPS>
-void forwardDynamicsThreaded_codegen(CodeGenMinv<T> **minv_code_gen_arr, CodeGenRNEAWithGetRes<T> **rnea_code_gen_arr, int nq, int nv, \
+template<typename T>
+void forwardDynamicsThreaded_codegen(int num_timesteps, CodeGenMinv<T> **minv_code_gen_arr, CodeGenRNEAWithGetRes<T> **rnea_code_gen_arr, int nq, int nv, \
                                      Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, Matrix<T, Eigen::Dynamic, 1> *qdds, \
-                                     Matrix<T, Eigen::Dynamic, 1> *us, ReusableThreads<NUM_THREADS> *threads){
-        for (int tid = 0; tid < NUM_THREADS; tid++){
-            int kStart = NUM_TIME_STEPS/NUM_THREADS*tid; int kMax = NUM_TIME_STEPS/NUM_THREADS*(tid+1); 
-            if(tid == NUM_THREADS-1){kMax = NUM_TIME_STEPS;} 
-            threads->addTask(tid, &forwardDynamicsThreaded_codegen_inner<T>, std::ref(minv_code_gen_arr[tid]), 
-                                                                             std::ref(rnea_code_gen_arr[tid]), nq, nv,
-                                                                             std::ref(qs), std::ref(qds), std::ref(qdds), std::ref(us), 
-                                                                             tid, kStart, kMax);
-        }
-        threads->sync();
+                                     Matrix<T, Eigen::Dynamic, 1> *us, ReusableThreads *threads){
+        // timesteps are handed out in small chunks and idle threads steal from busy ones
+        threads->parallel_for(num_timesteps, [&](int tid, int kStart, int kMax){
+            forwardDynamicsThreaded_codegen_inner<T>(minv_code_gen_arr[tid], rnea_code_gen_arr[tid], nq, nv,
+                                                     qs, qds, qdds, us, tid, kStart, kMax);
+        });
 }
 
 template<typename T>
@@ -115,17 +106,14 @@ void inverseDynamicsGradientThreaded_codegen_inner(DerivedCodeGenRNEADerivatives
     }
 }
 
-template<typename T, int NUM_THREADS, int NUM_TIME_STEPS>
-void inverseDynamicsGradientThreaded_codegen(DerivedCodeGenRNEADerivatives<T> **rnea_derivatives_code_gen_arr, \
+template<typename T>
+void inverseDynamicsGradientThreaded_codegen(int num_timesteps, DerivedCodeGenRNEADerivatives<T> **rnea_derivatives_code_gen_arr, \
                                              int nq, int nv, Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, 
-                                             ReusableThreads<NUM_THREADS> *threads){
-        for (int tid = 0; tid < NUM_THREADS; tid++){
-            int kStart = NUM_TIME_STEPS/NUM_THREADS*tid; int kMax = NUM_TIME_STEPS/NUM_THREADS*(tid+1); 
-            if(tid == NUM_THREADS-1){kMax = NUM_TIME_STEPS;} 
-            threads->addTask(tid, &inverseDynamicsGradientThreaded_codegen_inner<T>, std::ref(rnea_derivatives_code_gen_arr[tid]), 
-                                                                                     nq, nv, std::ref(qs), std::ref(qds), tid, kStart, kMax);
-        }
-        threads->sync();
+                                             ReusableThreads *threads){
+        // timesteps are handed out in small chunks and idle threads steal from busy ones
+        threads->parallel_for(num_timesteps, [&](int tid, int kStart, int kMax){
+            inverseDynamicsGradientThreaded_codegen_inner<T>(rnea_derivatives_code_gen_arr[tid], nq, nv, qs, qds, tid, kStart, kMax);
+        });
 }
 
 template<typename T>
@@ -148,23 +136,17 @@ void forwardDynamicsGradientThreaded_codegen_inner(DerivedCodeGenRNEADerivatives
     }
 }
 
-template<typename T, int NUM_THREADS, int NUM_TIME_STEPS>
-void forwardDynamicsGradientThreaded_codegen(DerivedCodeGenRNEADerivatives<T> **rnea_derivatives_code_gen_arr, \
+template<typename T>
+void forwardDynamicsGradientThreaded_codegen(int num_timesteps, DerivedCodeGenRNEADerivatives<T> **rnea_derivatives_code_gen_arr, \
                                              CodeGenMinv<T> **minv_code_gen_arr, CodeGenRNEAWithGetRes<T> **rnea_code_gen_arr, \
                                              int nq, int nv, Matrix<T, Eigen::Dynamic, Eigen::Dynamic> *dqdd_dqs, Matrix<T, Eigen::Dynamic, Eigen::Dynamic> *dqdd_dvs, \
                                              Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, Matrix<T, Eigen::Dynamic, 1> *us, \
-                                             ReusableThreads<NUM_THREADS> *threads){
-        for (int tid = 0; tid < NUM_THREADS; tid++){
-            int kStart = NUM_TIME_STEPS/NUM_THREADS*tid; int kMax = NUM_TIME_STEPS/NUM_THREADS*(tid+1); 
-            if(tid == NUM_THREADS-1){kMax = NUM_TIME_STEPS;} 
-            threads->addTask(tid, &forwardDynamicsGradientThreaded_codegen_inner<T>, std::ref(rnea_derivatives_code_gen_arr[tid]), 
-                                                                                     std::ref(minv_code_gen_arr[tid]), 
-                                                                                     std::ref(rnea_code_gen_arr[tid]), nq, nv,
-                                                                                     std::ref(dqdd_dqs), std::ref(dqdd_dvs), 
-                                                                                     std::ref(qs), std::ref(qds), std::ref(us),
-                                                                                     tid, kStart, kMax);
-    }
-        threads->sync();
+                                             ReusableThreads *threads){
+        // timesteps are handed out in small chunks and idle threads steal from busy ones
+        threads->parallel_for(num_timesteps, [&](int tid, int kStart, int kMax){
+            forwardDynamicsGradientThreaded_codegen_inner<T>(rnea_derivatives_code_gen_arr[tid], minv_code_gen_arr[tid], rnea_code_gen_arr[tid],
+                                                             nq, nv, dqdd_dqs, dqdd_dvs, qs, qds, us, tid, kStart, kMax);
+        });
 }
 
 template<typename T>
@@ -176,43 +158,42 @@ void abaThreaded_codegen_inner(CodeGenABA<T> *aba_code_gen, int nq, int nv, \
     }
 }
 
-template<typename T, int NUM_THREADS, int NUM_TIME_STEPS>
-void abaThreaded_codegen(CodeGenABA<T> **aba_code_gen_arr, int nq, int nv, \
-                                     Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, ReusableThreads<NUM_THREADS> *threads){
-        for (int tid = 0; tid < NUM_THREADS; tid++){
-            int kStart = NUM_TIME_STEPS/NUM_THREADS*tid; int kMax = NUM_TIME_STEPS/NUM_THREADS*(tid+1); 
-            if(tid == NUM_THREADS-1){kMax = NUM_TIME_STEPS;} 
-            threads->addTask(tid, &abaThreaded_codegen_inner<T>, std::ref(aba_code_gen_arr[tid]), nq, nv,
-                                                                             std::ref(qs), std::ref(qds), tid, kStart, kMax);
-        }
-        threads->sync();
+template<typename T>
+void abaThreaded_codegen(int num_timesteps, CodeGenABA<T> **aba_code_gen_arr, int nq, int nv, \
+                                     Matrix<T, Eigen::Dynamic, 1> *qs, Matrix<T, Eigen::Dynamic, 1> *qds, ReusableThreads *threads){
+        // timesteps are handed out in small chunks and idle threads steal from busy ones
+        threads->parallel_for(num_timesteps, [&](int tid, int kStart, int kMax){
+            abaThreaded_codegen_inner<T>(aba_code_gen_arr[tid], nq, nv, qs, qds, tid, kStart, kMax);
+        });
 }
 
-template<typename T, int TEST_ITERS, int NUM_THREADS, int NUM_TIME_STEPS>
-void test(std::string urdf_filepath, bool floating_base){
-    // Setup timer
-    struct timespec start, end;
-
+template<typename T>
+int test(BenchmarkSuite &suite, std::string urdf_filepath, bool floating_base){
     // Matrix typedefs
     typedef Matrix<T, Eigen::Dynamic, Eigen::Dynamic> MatrixXT;
     typedef Matrix<T, Eigen::Dynamic, 1> VectorXT;
 
+    // size everything for the largest point of the sweep so the code_gen libraries are only built once
+    const std::vector<int> &thread_counts = suite.config().threads;
+    const std::vector<int> &batches = suite.config().batches;
+    const int MAX_THREADS = std::max(1, *std::max_element(thread_counts.begin(), thread_counts.end()));
+    const int MAX_TIME_STEPS = std::max(1, *std::max_element(batches.begin(), batches.end()));
+
     // Import URDF model and prepare pinnochio
     Model model;
     if (floating_base) {pinocchio::urdf::buildModel(urdf_filepath,pinocchio::JointModelFreeFlyer(), model);}
     else {pinocchio::urdf::buildModel(urdf_filepath,model);}
     // model.gravity.setZero();
     model.gravity.linear(Eigen::Vector3d(0,0,-9.81));
-    Data datas[NUM_THREADS]; 
-    for(int i = 0; i < NUM_THREADS; i++){datas[i] = Data(model);}
+    container::aligned_vector<Data> datas(MAX_THREADS, Data(model));
 
     // generate the code_gen
     CodeGenRNEAWithGetRes<T> rnea_code_gen(model.cast<T>());
     rnea_code_gen.initLib();
     rnea_code_gen.loadLib();
 
-    CodeGenRNEAWithGetRes<T> *rnea_code_gen_arr[NUM_THREADS];
-    for (int i = 0; i < NUM_THREADS; i++){
+    std::vector<CodeGenRNEAWithGetRes<T> *> rnea_code_gen_arr(MAX_THREADS);
+    for (int i = 0; i < MAX_THREADS; i++){
         rnea_code_gen_arr[i] = new CodeGenRNEAWithGetRes<T>(model.cast<T>());
         rnea_code_gen_arr[i]->initLib();
         rnea_code_gen_arr[i]->loadLib();
@@ -222,8 +203,8 @@ void test(std::string urdf_filepath, bool floating_base){
     minv_code_gen.initLib();
     minv_code_gen.loadLib();
 
-    CodeGenMinv<T> *minv_code_gen_arr[NUM_THREADS];
-    for (int i = 0; i < NUM_THREADS; i++){
+    std::vector<CodeGenMinv<T> *> minv_code_gen_arr(MAX_THREADS);
+    for (int i = 0; i < MAX_THREADS; i++){
         minv_code_gen_arr[i] = new CodeGenMinv<T>(model.cast<T>());
         minv_code_gen_arr[i]->initLib();
         minv_code_gen_arr[i]->loadLib();
@@ -233,8 +214,8 @@ void test(std::string urdf_filepath, bool floating_base){
     rnea_derivatives_code_gen.initLib();
     rnea_derivatives_code_gen.loadLib();
 
-    DerivedCodeGenRNEADerivatives<T> *rnea_derivatives_code_gen_arr[NUM_THREADS];
-    for (int i = 0; i < NUM_THREADS; i++){
+    std::vector<DerivedCodeGenRNEADerivatives<T> *> rnea_derivatives_code_gen_arr(MAX_THREADS);
+    for (int i = 0; i < MAX_THREADS; i++){
         rnea_derivatives_code_gen_arr[i] = new DerivedCodeGenRNEADerivatives<T>(model.cast<T>());
         rnea_derivatives_code_gen_arr[i]->initLib();
         rnea_derivatives_code_gen_arr[i]->loadLib();
@@ -245,21 +226,21 @@ void test(std::string urdf_filepath, bool floating_base){
     aba_code_gen.initLib();
     aba_code_gen.loadLib();
 
-    CodeGenABA<T> *aba_code_gen_arr[NUM_THREADS];
-    for (int i = 0; i < NUM_THREADS; i++) {
+    std::vector<CodeGenABA<T> *> aba_code_gen_arr(MAX_THREADS);
+    for (int i = 0; i < MAX_THREADS; i++) {
         aba_code_gen_arr[i] = new CodeGenABA<T>(model.cast<T>());
         aba_code_gen_arr[i]->initLib();
         aba_code_gen_arr[i]->loadLib();
     }
 
     // allocate and load on CPU
-    VectorXT qs[NUM_TIME_STEPS];
-    VectorXT qds[NUM_TIME_STEPS];
-    VectorXT qdds[NUM_TIME_STEPS];
-    VectorXT us[NUM_TIME_STEPS];
-    MatrixXT dqdd_dqs[NUM_TIME_STEPS];
-    MatrixXT dqdd_dvs[NUM_TIME_STEPS];
-    for(int i = 0; i < NUM_TIME_STEPS; i++){
+    std::vector<VectorXT> qs(MAX_TIME_STEPS);
+    std::vector<VectorXT> qds(MAX_TIME_STEPS);
+    std::vector<VectorXT> qdds(MAX_TIME_STEPS);
+    std::vector<VectorXT> us(MAX_TIME_STEPS);
+    std::vector<MatrixXT> dqdd_dqs(MAX_TIME_STEPS);
+    std::vector<MatrixXT> dqdd_dvs(MAX_TIME_STEPS);
+    for(int i = 0; i < MAX_TIME_STEPS; i++){
         qs[i] = VectorXT::Zero(model.nq);
         qds[i] = VectorXT::Zero(model.nv);
         qdds[i] = VectorXT::Zero(model.nv);
@@ -300,51 +281,22 @@ void test(std::string urdf_filepath, bool floating_base){
         // std::cout << "df_dqd" << std::endl << dqdd_dvs[0] << std::endl;
     #else
         // Single call
-        if(NUM_TIME_STEPS == 1){
+        if(std::find(batches.begin(), batches.end(), 1) != batches.end()){
             VectorXT zeros = VectorXT::Zero(model.nv);
 
-            clock_gettime(CLOCK_MONOTONIC,&start);
-            for(int i = 0; i < TEST_ITERS; i++){
-                rnea_code_gen.evalFunction(qs[0],qds[0],qdds[0]);
-            }
-            clock_gettime(CLOCK_MONOTONIC,&end);
-            printf("ID codegen %fus\n",time_delta_us_timespec(start,end)/static_cast<double>(TEST_ITERS));
-
-            clock_gettime(CLOCK_MONOTONIC,&start);
-            for(int i = 0; i < TEST_ITERS; i++){
-                minv_code_gen.evalFunction(qs[0]);
-            }
-            clock_gettime(CLOCK_MONOTONIC,&end);
-            printf("Minv codegen %fus\n",time_delta_us_timespec(start,end)/static_cast<double>(TEST_ITERS));
-
-            clock_gettime(CLOCK_MONOTONIC,&start);
-            for(int i = 0; i < TEST_ITERS; i++) {
-                aba_code_gen.evalFunction(qs[0],qds[0],us[0]);
-            }
-            clock_gettime(CLOCK_MONOTONIC,&end);
-            printf("ABA codegen %fus\n",time_delta_us_timespec(start,end)/static_cast<double>(TEST_ITERS));
-
-            clock_gettime(CLOCK_MONOTONIC,&start);
-            for(int i = 0; i < TEST_ITERS; i++){
+            suite.run("ID", "codegen", 1, 1, [&](){rnea_code_gen.evalFunction(qs[0],qds[0],qdds[0]);});
+            suite.run("Minv", "codegen", 1, 1, [&](){minv_code_gen.evalFunction(qs[0]);});
+            suite.run("ABA", "codegen", 1, 1, [&](){aba_code_gen.evalFunction(qs[0],qds[0],us[0]);});
+            suite.run("FD", "codegen", 1, 1, [&](){
                 minv_code_gen.evalFunction(qs[0]);
                 Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> minv = minv_code_gen.Minv.block(0,0,model.nv,model.nv);
                 minv.template triangularView<Eigen::StrictlyLower>() = 
                     minv.transpose().template triangularView<Eigen::StrictlyLower>(); 
                 rnea_code_gen.evalFunction(qs[0],qds[0],zeros);
                 qdds[0].noalias() = minv*(us[0] - rnea_code_gen.getRes());
-            }
-            clock_gettime(CLOCK_MONOTONIC,&end);
-            printf("FD codegen %fus\n",time_delta_us_timespec(start,end)/static_cast<double>(TEST_ITERS));
-
-            clock_gettime(CLOCK_MONOTONIC,&start);
-            for(int i = 0; i < TEST_ITERS; i++){
-                rnea_derivatives_code_gen.evalFunction(qs[0],qds[0],qdds[0]);
-            }
-            clock_gettime(CLOCK_MONOTONIC,&end);
-            printf("ID_DU codegen %fus\n",time_delta_us_timespec(start,end)/static_cast<double>(TEST_ITERS));
-
-            clock_gettime(CLOCK_MONOTONIC,&start);
-            for(int i = 0; i < TEST_ITERS; i++){
+            });
+            suite.run("ID_DU", "codegen", 1, 1, [&](){rnea_derivatives_code_gen.evalFunction(qs[0],qds[0],qdds[0]);});
+            suite.run("FD_DU", "codegen", 1, 1, [&](){
                 minv_code_gen.evalFunction(qs[0]);
                 Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> minv = minv_code_gen.Minv.block(0,0,model.nv,model.nv);
                 minv.template triangularView<Eigen::StrictlyLower>() = 
@@ -354,104 +306,54 @@ void test(std::string urdf_filepath, bool floating_base){
                 rnea_derivatives_code_gen.evalFunction(qs[0],qds[0],qdd);
                 dqdd_dqs[0].noalias() = -minv*rnea_derivatives_code_gen.getDtauDq();
                 dqdd_dvs[0].noalias() = -minv*rnea_derivatives_code_gen.getDtauDv();
-            }
-            clock_gettime(CLOCK_MONOTONIC,&end);
-            printf("FD_DU codegen %fus\n",time_delta_us_timespec(start,end)/static_cast<double>(TEST_ITERS));
-
+            });
         }
         // multi call with threadPools
-        else{
-            ReusableThreads<NUM_THREADS> threads;
-            std::vector<double> times = {};
-
-            for(int iter = 0; iter < TEST_ITERS; iter++){
-                clock_gettime(CLOCK_MONOTONIC,&start);
-                inverseDynamicsThreaded_codegen<T,NUM_THREADS,NUM_TIME_STEPS>(rnea_code_gen_arr,
-                                                                              model.nq,model.nv,qs,qds,&threads);
-                clock_gettime(CLOCK_MONOTONIC,&end);
-                times.push_back(time_delta_us_timespec(start,end));
+        for (int num_threads : thread_counts){
+            ReusableThreads threads(num_threads);
+            for (int N : batches){
+                if (N <= 1){continue;}
+                suite.run("ID", "codegen", N, num_threads, [&](){
+                    inverseDynamicsThreaded_codegen<T>(N,rnea_code_gen_arr.data(),model.nq,model.nv,qs.data(),qds.data(),&threads);
+                });
+                suite.run("Minv", "codegen", N, num_threads, [&](){
+                    minvThreaded_codegen<T>(N,minv_code_gen_arr.data(),model.nq,model.nv,qs.data(),&threads);
+                });
+                suite.run("ABA", "codegen", N, num_threads, [&](){
+                    abaThreaded_codegen<T>(N,aba_code_gen_arr.data(),model.nq,model.nv,qs.data(),qds.data(),&threads);
+                });
+                suite.run("FD", "codegen", N, num_threads, [&](){
+                    forwardDynamicsThreaded_codegen<T>(N,minv_code_gen_arr.data(),rnea_code_gen_arr.data(),
+                                                       model.nq,model.nv,qs.data(),qds.data(),qdds.data(),us.data(),&threads);
+                });
+                suite.run("ID_DU", "codegen", N, num_threads, [&](){
+                    inverseDynamicsGradientThreaded_codegen<T>(N,rnea_derivatives_code_gen_arr.data(),model.nq,model.nv,qs.data(),qds.data(),&threads);
+                });
+                suite.run("FD_DU", "codegen", N, num_threads, [&](){
+                    forwardDynamicsGradientThreaded_codegen<T>(N,rnea_derivatives_code_gen_arr.data(),
+                                                               minv_code_gen_arr.data(),rnea_code_gen_arr.data(),
+                                                               model.nq,model.nv,dqdd_dqs.data(),dqdd_dvs.data(),
+                                                               qs.data(),qds.data(),us.data(),&threads);
+                });
             }
-            printf("[N:%d]: ID codegen: ",NUM_TIME_STEPS); printStats(&times); times.clear();
-            printf("----------------------------------------\n");
-
-            for(int iter = 0; iter < TEST_ITERS; iter++){
-                clock_gettime(CLOCK_MONOTONIC,&start);
-                minvThreaded_codegen<T,NUM_THREADS,NUM_TIME_STEPS>(minv_code_gen_arr,model.nq,model.nv,qs,&threads);
-                clock_gettime(CLOCK_MONOTONIC,&end);
-                times.push_back(time_delta_us_timespec(start,end));
-            }
-            printf("[N:%d]: Minv codegen: ",NUM_TIME_STEPS); printStats(&times); times.clear();
-            printf("----------------------------------------\n");
-
-            for(int iter = 0; iter < TEST_ITERS; iter++){
-                clock_gettime(CLOCK_MONOTONIC,&start);
-                abaThreaded_codegen<T,NUM_THREADS,NUM_TIME_STEPS>(aba_code_gen_arr,
-                                                                              model.nq,model.nv,qs,qds,&threads);
-                clock_gettime(CLOCK_MONOTONIC,&end);
-                times.push_back(time_delta_us_timespec(start,end));
-            }
-            printf("[N:%d]: ABA codegen: ",NUM_TIME_STEPS); printStats(&times); times.clear();
-            printf("----------------------------------------\n");
-
-            for(int iter = 0; iter < TEST_ITERS; iter++){
-                clock_gettime(CLOCK_MONOTONIC,&start);
-                forwardDynamicsThreaded_codegen<T,NUM_THREADS,NUM_TIME_STEPS>(minv_code_gen_arr,rnea_code_gen_arr,
-                                                                              model.nq,model.nv,qs,qds,qdds,us,&threads);
-                clock_gettime(CLOCK_MONOTONIC,&end);
-                times.push_back(time_delta_us_timespec(start,end));
-            }
-            printf("[N:%d]: FD codegen: ",NUM_TIME_STEPS); printStats(&times); times.clear();
-            printf("----------------------------------------\n");
-
-            for(int iter = 0; iter < TEST_ITERS; iter++){
-                clock_gettime(CLOCK_MONOTONIC,&start);
-                inverseDynamicsGradientThreaded_codegen<T,NUM_THREADS,NUM_TIME_STEPS>(rnea_derivatives_code_gen_arr,
-                                                                                      model.nq,model.nv,qs,qds,&threads);
-                clock_gettime(CLOCK_MONOTONIC,&end);
-                times.push_back(time_delta_us_timespec(start,end));
-            }
-            printf("[N:%d]: ID_DU codegen: ",NUM_TIME_STEPS); printStats(&times); times.clear();
-            printf("----------------------------------------\n");
-
-            for(int iter = 0; iter < TEST_ITERS; iter++){
-                clock_gettime(CLOCK_MONOTONIC,&start);
-                forwardDynamicsGradientThreaded_codegen<T,NUM_THREADS,NUM_TIME_STEPS>(rnea_derivatives_code_gen_arr,
-                                                                                    minv_code_gen_arr,rnea_code_gen_arr,
-                                                                                    model.nq,model.nv,dqdd_dqs,dqdd_dvs,
-                                                                                    qs,qds,us,&threads);
-                clock_gettime(CLOCK_MONOTONIC,&end);
-                times.push_back(time_delta_us_timespec(start,end));
-            }
-            printf("[N:%d]: FD_DU codegen: ",NUM_TIME_STEPS); printStats(&times); times.clear();
-            printf("----------------------------------------\n");
         }
     #endif
 
     // make sure to delete objs
-    for (int i = 0; i < NUM_THREADS; i++){delete rnea_derivatives_code_gen_arr[i];}// delete rnea_code_gen_arr[i]; delete minv_code_gen_arr[i];}
-}
-
-template<typename T, int TEST_ITERS, int CPU_THREADS>
-void run_all_tests(std::string urdf_filepath, bool floating_base){
-    test<T,10*TEST_ITERS,CPU_THREADS,1>(urdf_filepath, floating_base);
-    #if !TEST_FOR_EQUIVALENCE
-        test<T,TEST_ITERS,CPU_THREADS,16>(urdf_filepath, floating_base);
-        test<T,TEST_ITERS,CPU_THREADS,32>(urdf_filepath, floating_base);
-        test<T,TEST_ITERS,CPU_THREADS,64>(urdf_filepath, floating_base);
-        test<T,TEST_ITERS,CPU_THREADS,128>(urdf_filepath, floating_base);
-        test<T,TEST_ITERS,CPU_THREADS,256>(urdf_filepath, floating_base);
-    #endif
+    for (int i = 0; i < MAX_THREADS; i++){delete rnea_derivatives_code_gen_arr[i];}// delete rnea_code_gen_arr[i]; delete minv_code_gen_arr[i];}
+    return suite.finish();
 }
 
 int main(int argc, const char ** argv){
+    BenchmarkConfig cfg = parseBenchmarkArgs(argc, argv);
     std::string urdf_filepath;
     bool floating_base = false;
-    if(argc>1){
-        urdf_filepath = argv[1];
-        if (argc>2 && argv[2][0] == 'T') {floating_base = true; printf("Floating Base = True\n");}
+    if(!cfg.positional.empty()){
+        urdf_filepath = cfg.positional[0];
+        if (cfg.positional.size()>1 && cfg.positional[1][0] == 'T') {floating_base = true; printf("Floating Base = True\n");}
     }
-    else{printf("Usage is: urdf_filepath floating_base\n"); return 1;}
+    else{printf("Usage is: urdf_filepath floating_base [--benchmark options]\n"); return 1;}
     if(!floating_base) {printf("Floating Base = False\n");}
-    run_all_tests<float,TEST_ITERS_GLOBAL,CPU_THREADS_GLOBAL>(urdf_filepath, floating_base);
-    return 0;
-}
\ No newline at end of file
+    BenchmarkSuite suite(cfg);
+    return test<float>(suite, urdf_filepath, floating_base);
+}
@@ -44,7 +44,7 @@ def main():
     print("This may take a few minutes....")
     print("     Outputs will show up at the end")
     print("-----------------")
-    result = subprocess.run(["./timePinocchio.exe", URDF_PATH, str(FLOATING_BASE)], capture_output=True, text=True)
+    result = subprocess.run(["./timePinocchio.exe", URDF_PATH, str(FLOATING_BASE)] + util.benchmarkArgs(), capture_output=True, text=True)
     if result.stderr:
         print("Runtime errors follow:")
         print(result.stdout)
@@ -52,6 +52,9 @@ def main():
         exit()
 
     print(result.stdout)
+    if result.returncode != 0:
+        print("[!Error] benchmark regressions against the baseline (see above)")
+        exit(result.returncode)
 
 if __name__ == "__main__":
     main()
\ No newline at end of file
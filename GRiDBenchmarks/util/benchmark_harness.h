@@ -0,0 +1,300 @@
+/***
+ * Benchmark harness shared by timeGRiD.cu and timePinocchio.cpp
+ *
+ * Every knob is a runtime flag so sweeps do not need a recompile:
+ *   --algs=ID,FD_DU          algorithms to run (default: all)
+ *   --modes=memory,compute   GRiD only: with or without host<->device copies (default: both)
+ *   --batches=1,16,32        batch sizes (default: 1,16,32,64,128,256)
+ *   --threads=1,4,8          CPU thread counts (default: CPU_THREADS_GLOBAL)
+ *   --iters=N                timed iterations per point (default: TEST_ITERS_GLOBAL, 10x for batch 1)
+ *   --warmup=N               untimed iterations before every point (default: 1)
+ *   --cpus=0-7               restrict the process (and so every pool thread) to these CPUs
+ *   --governor=performance   set the cpufreq governor of those CPUs first (replaces setCPU.sh, needs root)
+ *   --json=FILE --csv=FILE   write every point with its full percentile set
+ *   --baseline=FILE          compare against an earlier --json or --csv run
+ *   --tolerance=0.05         relative p50 slowdown that counts as a regression (default 5%)
+ *   --label=NAME             robot / configuration tag stored with every point
+ * Arguments that do not start with -- are left for the caller (e.g., URDF path, floating base).
+ * Include after experiment_helpers.h.
+ ***/
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+
+struct BenchmarkConfig {
+   std::vector<std::string> algs;     // empty means all
+   std::vector<std::string> modes;    // empty means all
+   std::vector<int> batches = {1,16,32,64,128,256};
+   std::vector<int> threads = {CPU_THREADS_GLOBAL};
+   int iters = -1;                    // -1 means TEST_ITERS_GLOBAL (10x for batch 1)
+   int warmup = 1;
+   std::vector<int> cpus;
+   std::string governor;
+   std::string json_path;
+   std::string csv_path;
+   std::string baseline_path;
+   double tolerance = 0.05;
+   std::string label = "robot";
+   std::vector<std::string> positional;
+};
+
+struct BenchmarkResult {
+   std::string label, alg, mode;
+   int batch, threads, iters;
+   double mean, stdev, min, max, p50, p90, p95, p99, p999;
+   double throughput; // evaluations per second at the mean
+};
+
+inline std::vector<std::string> splitList(const std::string &s){
+   std::vector<std::string> out; std::stringstream ss(s); std::string item;
+   while (std::getline(ss, item, ',')){if (!item.empty()){out.push_back(item);}}
+   return out;
+}
+
+// "0-3,6" -> {0,1,2,3,6}
+inline std::vector<int> parseIntList(const std::string &s){
+   std::vector<int> out;
+   for (const std::string &item : splitList(s)){
+      size_t dash = item.find('-', 1);
+      if (dash == std::string::npos){out.push_back(std::atoi(item.c_str())); continue;}
+      int lo = std::atoi(item.substr(0,dash).c_str()), hi = std::atoi(item.substr(dash+1).c_str());
+      for (int i = lo; i <= hi; i++){out.push_back(i);}
+   }
+   return out;
+}
+
+inline BenchmarkConfig parseBenchmarkArgs(int argc, const char **argv){
+   BenchmarkConfig cfg;
+   for (int i = 1; i < argc; i++){
+      std::string arg = argv[i];
+      if (arg.compare(0, 2, "--") != 0){cfg.positional.push_back(arg); continue;}
+      size_t eq = arg.find('=');
+      std::string key = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+      std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+      if (key == "algs"){cfg.algs = splitList(value);}
+      else if (key == "modes"){cfg.modes = splitList(value);}
+      else if (key == "batches"){cfg.batches = parseIntList(value);}
+      else if (key == "threads"){cfg.threads = parseIntList(value);}
+      else if (key == "iters"){cfg.iters = std::atoi(value.c_str());}
+      else if (key == "warmup"){cfg.warmup = std::atoi(value.c_str());}
+      else if (key == "cpus"){cfg.cpus = parseIntList(value);}
+      else if (key == "governor"){cfg.governor = value;}
+      else if (key == "json"){cfg.json_path = value;}
+      else if (key == "csv"){cfg.csv_path = value;}
+      else if (key == "baseline"){cfg.baseline_path = value;}
+      else if (key == "tolerance"){cfg.tolerance = std::atof(value.c_str());}
+      else if (key == "label"){cfg.label = value;}
+      else {printf("[!Warning] unknown benchmark option %s\n", arg.c_str());}
+   }
+   return cfg;
+}
+
+inline bool listSelected(const std::vector<std::string> &list, const std::string &name){
+   return list.empty() || std::find(list.begin(), list.end(), name) != list.end();
+}
+
+// Writes the cpufreq governor of every listed CPU (all online CPUs if none are listed)
+inline void setGovernor(const std::string &governor, std::vector<int> cpus){
+   if (governor.empty()){return;}
+   if (cpus.empty()){for (int i = 0; i < static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)); i++){cpus.push_back(i);}}
+   int failed = 0;
+   for (int cpu : cpus){
+      char path[128]; snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+      FILE *f = fopen(path, "w");
+      if (f == nullptr || fputs(governor.c_str(), f) < 0){failed++;}
+      if (f != nullptr){fclose(f);}
+   }
+   if (failed){printf("[!Warning] could not set the %s governor on %d of %d CPUs (needs root and cpufreq)\n", governor.c_str(), failed, static_cast<int>(cpus.size()));}
+   else {printf("Governors set to %s\n", governor.c_str());}
+}
+
+// Restricts the calling thread to cpus; threads created afterwards (the pools) inherit the mask
+inline void pinToCPUs(const std::vector<int> &cpus){
+   if (cpus.empty()){return;}
+   cpu_set_t set; CPU_ZERO(&set);
+   for (int cpu : cpus){CPU_SET(cpu, &set);}
+   if (sched_setaffinity(0, sizeof(set), &set) != 0){printf("[!Warning] could not pin to the requested CPUs\n");}
+}
+
+inline std::string cpuModelName(){
+   std::ifstream cpuinfo("/proc/cpuinfo"); std::string line;
+   while (std::getline(cpuinfo, line)){
+      if (line.compare(0, 10, "model name") == 0){
+         size_t colon = line.find(':');
+         return colon == std::string::npos ? "" : line.substr(line.find_first_not_of(' ', colon + 1));
+      }
+   }
+   return "unknown";
+}
+
+// nearest rank percentile of an already sorted sample
+inline double percentileSorted(const std::vector<double> &sorted, double p){
+   if (sorted.empty()){return 0;}
+   size_t rank = static_cast<size_t>(std::ceil(p/100.0*static_cast<double>(sorted.size())));
+   return sorted[rank == 0 ? 0 : std::min(rank, sorted.size()) - 1];
+}
+
+class BenchmarkSuite {
+public:
+   explicit BenchmarkSuite(const BenchmarkConfig &cfg_) : cfg(cfg_) {
+      setGovernor(cfg.governor, cfg.cpus);
+      pinToCPUs(cfg.cpus);
+   }
+
+   bool selected(const std::string &alg, const std::string &mode = "") const {
+      return listSelected(cfg.algs, alg) && (mode.empty() || listSelected(cfg.modes, mode));
+   }
+
+   int itersFor(int batch) const {return cfg.iters > 0 ? cfg.iters : (batch == 1 ? 10 : 1)*TEST_ITERS_GLOBAL;}
+
+   // Times fn() (one call evaluates batch items) after cfg.warmup untimed calls
+   template <typename Func>
+   void run(const std::string &alg, const std::string &mode, int batch, int num_threads, Func fn){
+      if (!selected(alg, mode)){return;}
+      for (int i = 0; i < cfg.warmup; i++){fn();}
+      const int iters = itersFor(batch);
+      struct timespec start, end;
+      std::vector<double> times; times.reserve(iters);
+      for (int i = 0; i < iters; i++){
+         clock_gettime(CLOCK_MONOTONIC,&start);
+         fn();
+         clock_gettime(CLOCK_MONOTONIC,&end);
+         times.push_back(1e6*static_cast<double>(end.tv_sec - start.tv_sec) + 1e-3*static_cast<double>(end.tv_nsec - start.tv_nsec));
+      }
+      record(alg, mode, batch, num_threads, times);
+   }
+
+   // For callers that time themselves (e.g., the GPU single timing kernels report one aggregate)
+   void record(const std::string &alg, const std::string &mode, int batch, int num_threads, std::vector<double> times){
+      if (times.empty()){return;}
+      printf("[N:%d T:%d]: %s %s: ", batch, num_threads, alg.c_str(), mode.c_str());
+      BenchmarkResult r;
+      r.label = cfg.label; r.alg = alg; r.mode = mode; r.batch = batch; r.threads = num_threads;
+      r.iters = static_cast<int>(times.size());
+      r.mean = std::accumulate(times.begin(), times.end(), 0.0)/static_cast<double>(times.size());
+      double sq_sum = 0; for (double t : times){sq_sum += (t - r.mean)*(t - r.mean);}
+      r.stdev = std::sqrt(sq_sum/static_cast<double>(times.size()));
+      printStats<false>(&times);
+      std::sort(times.begin(), times.end());
+      r.min = times.front(); r.max = times.back();
+      r.p50 = percentileSorted(times,50); r.p90 = percentileSorted(times,90); r.p95 = percentileSorted(times,95);
+      r.p99 = percentileSorted(times,99); r.p999 = percentileSorted(times,99.9);
+      r.throughput = r.mean > 0 ? 1e6*static_cast<double>(batch)/r.mean : 0;
+      printf("    p50 [%.2fus] p90 [%.2fus] p99 [%.2fus] p99.9 [%.2fus] throughput [%.0f/s]\n", r.p50, r.p90, r.p99, r.p999, r.throughput);
+      results.push_back(r);
+   }
+
+   // Writes the requested outputs and compares against the baseline; returns the process exit code
+   int finish(){
+      if (!cfg.json_path.empty()){writeJSON(cfg.json_path);}
+      if (!cfg.csv_path.empty()){writeCSV(cfg.csv_path);}
+      if (cfg.baseline_path.empty()){return 0;}
+      return compareBaseline(cfg.baseline_path) > 0 ? 1 : 0;
+   }
+
+   const BenchmarkConfig &config() const {return cfg;}
+   const std::vector<BenchmarkResult> &all() const {return results;}
+
+private:
+   static std::string key(const std::string &label, const std::string &alg, const std::string &mode, int batch, int threads){
+      std::ostringstream ss; ss << label << "|" << alg << "|" << mode << "|" << batch << "|" << threads; return ss.str();
+   }
+
+   // one result object per line so the file stays greppable and is easy to read back
+   void writeJSON(const std::string &path) const {
+      FILE *f = fopen(path.c_str(), "w");
+      if (f == nullptr){printf("[!Error] could not write %s\n", path.c_str()); return;}
+      char host[256] = "unknown"; gethostname(host, sizeof(host) - 1);
+      fprintf(f, "{\"host\":\"%s\",\"cpu\":\"%s\",\"timestamp\":%ld,\"results\":[\n", host, cpuModelName().c_str(), static_cast<long>(time(nullptr)));
+      for (size_t i = 0; i < results.size(); i++){
+         const BenchmarkResult &r = results[i];
+         fprintf(f, "{\"label\":\"%s\",\"alg\":\"%s\",\"mode\":\"%s\",\"batch\":%d,\"threads\":%d,\"iters\":%d,"
+                    "\"mean_us\":%.4f,\"stdev_us\":%.4f,\"min_us\":%.4f,\"p50_us\":%.4f,\"p90_us\":%.4f,\"p95_us\":%.4f,"
+                    "\"p99_us\":%.4f,\"p999_us\":%.4f,\"max_us\":%.4f,\"throughput_per_s\":%.2f}%s\n",
+                 r.label.c_str(), r.alg.c_str(), r.mode.c_str(), r.batch, r.threads, r.iters,
+                 r.mean, r.stdev, r.min, r.p50, r.p90, r.p95, r.p99, r.p999, r.max, r.throughput,
+                 i + 1 < results.size() ? "," : "");
+      }
+      fprintf(f, "]}\n"); fclose(f);
+   }
+
+   void writeCSV(const std::string &path) const {
+      FILE *f = fopen(path.c_str(), "w");
+      if (f == nullptr){printf("[!Error] could not write %s\n", path.c_str()); return;}
+      fprintf(f, "label,alg,mode,batch,threads,iters,mean_us,stdev_us,min_us,p50_us,p90_us,p95_us,p99_us,p999_us,max_us,throughput_per_s\n");
+      for (const BenchmarkResult &r : results){
+         fprintf(f, "%s,%s,%s,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f\n",
+                 r.label.c_str(), r.alg.c_str(), r.mode.c_str(), r.batch, r.threads, r.iters,
+                 r.mean, r.stdev, r.min, r.p50, r.p90, r.p95, r.p99, r.p999, r.max, r.throughput);
+      }
+      fclose(f);
+   }
+
+   static std::string jsonField(const std::string &line, const std::string &name){
+      std::string tag = "\"" + name + "\":";
+      size_t pos = line.find(tag);
+      if (pos == std::string::npos){return "";}
+      pos += tag.size();
+      if (line[pos] == '"'){return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);}
+      return line.substr(pos, line.find_first_of(",}", pos) - pos);
+   }
+
+   // p50 of every point in a --json or --csv file keyed by label|alg|mode|batch|threads
+   static std::map<std::string,double> loadBaseline(const std::string &path){
+      std::map<std::string,double> base;
+      std::ifstream in(path.c_str()); std::string line;
+      std::vector<std::string> header;
+      while (std::getline(in, line)){
+         if (line.find("\"alg\":") != std::string::npos){
+            base[key(jsonField(line,"label"), jsonField(line,"alg"), jsonField(line,"mode"),
+                     std::atoi(jsonField(line,"batch").c_str()), std::atoi(jsonField(line,"threads").c_str()))] = std::atof(jsonField(line,"p50_us").c_str());
+         }
+         else if (header.empty() && line.compare(0, 6, "label,") == 0){header = splitList(line);}
+         else if (!header.empty()){
+            std::vector<std::string> cols; std::stringstream ss(line); std::string col;
+            while (std::getline(ss, col, ',')){cols.push_back(col);}
+            if (cols.size() != header.size()){continue;}
+            std::map<std::string,std::string> row;
+            for (size_t i = 0; i < cols.size(); i++){row[header[i]] = cols[i];}
+            base[key(row["label"], row["alg"], row["mode"], std::atoi(row["batch"].c_str()), std::atoi(row["threads"].c_str()))] = std::atof(row["p50_us"].c_str());
+         }
+      }
+      return base;
+   }
+
+   // Flags every point whose median slowed down by more than the tolerance; returns how many did
+   int compareBaseline(const std::string &path) const {
+      std::map<std::string,double> base = loadBaseline(path);
+      if (base.empty()){printf("[!Warning] baseline %s has no results\n", path.c_str()); return 0;}
+      int regressions = 0, compared = 0;
+      printf("----------------------------------------\n");
+      printf("Comparing p50 against %s (tolerance %.1f%%)\n", path.c_str(), 100.0*cfg.tolerance);
+      for (const BenchmarkResult &r : results){
+         std::map<std::string,double>::const_iterator it = base.find(key(r.label, r.alg, r.mode, r.batch, r.threads));
+         if (it == base.end() || it->second <= 0){continue;}
+         compared++;
+         double change = r.p50/it->second - 1.0;
+         const char *verdict = change > cfg.tolerance ? "REGRESSION" : (change < -cfg.tolerance ? "improved" : "ok");
+         if (change > cfg.tolerance){regressions++;}
+         printf("  %-10s [N:%d T:%d] %s %s: %.2fus -> %.2fus (%+.1f%%)\n", verdict, r.batch, r.threads,
+                r.alg.c_str(), r.mode.c_str(), it->second, r.p50, 100.0*change);
+      }
+      printf("%d of %d points regressed\n", regressions, compared);
+      return regressions;
+   }
+
+   BenchmarkConfig cfg;
+   std::vector<BenchmarkResult> results;
+};
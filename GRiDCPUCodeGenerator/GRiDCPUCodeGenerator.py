@@ -0,0 +1,558 @@
+import os
+import hashlib
+import subprocess
+import multiprocessing
+from concurrent.futures import ThreadPoolExecutor
+
+CPP_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "cpp")
+
+# model independent runtime (shared by every generated header, include guarded)
+RUNTIME_FRAGMENTS = ["compat.hpp", "threads.hpp", "spatial.hpp", "dual.hpp", "simd.hpp", "ring.hpp", "registry.hpp", "arena.hpp", "mapped_file.hpp", "tuning.hpp"]
+# templated algorithms that are compiled against the generated model constants
+MODEL_FRAGMENTS = ["data.hpp", "dynamics.hpp", "second_order.hpp", "host_api.hpp", "sparse.hpp", "aosoa.hpp", "server.hpp", "fleet.hpp", "stream.hpp", "rollout.hpp"]
+# floating base models reuse the fixed base algorithms for their limbs under the free-flyer fast path
+FLOATING_BASE_FRAGMENTS = ["data.hpp", "dynamics.hpp", "second_order.hpp", "host_api.hpp", "floating_base.hpp"]
+# emitted after the HOST_API wrappers (and autotune_targets) they call
+TUNING_FRAGMENTS = ["autotune.hpp"]
+# pybind11 module source emitted next to the header by gen_python_bindings
+PYTHON_FRAGMENTS = ["bindings.hpp"]
+
+# (name, timing label, extra template params, takes gravity, timestep call, gridData outputs it writes)
+HOST_API = [
+    ("inverse_dynamics", "ID", ["bool USE_QDD_FLAG = false", "bool USE_COMPRESSED_MEM = false"], True,
+        "inverse_dynamics_timestep<T,USE_QDD_FLAG,USE_COMPRESSED_MEM>(hd_data,d_robotModel,gravity,k)", "BUFFER_C"),
+    ("direct_minv", "Minv", ["bool USE_COMPRESSED_MEM = false"], False,
+        "direct_minv_timestep<T,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_MINV"),
+    ("direct_minv_packed", "Minv_PACKED", ["bool USE_COMPRESSED_MEM = false"], False,
+        "direct_minv_packed_timestep<T,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_MINV_PACKED"),
+    ("forward_dynamics", "FD", [], True,
+        "forward_dynamics_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD"),
+    ("inverse_dynamics_gradient", "ID_DU", ["bool USE_QDD_FLAG = false", "bool USE_COMPRESSED_MEM = false"], True,
+        "inverse_dynamics_gradient_timestep<T,USE_QDD_FLAG,USE_COMPRESSED_MEM>(hd_data,d_robotModel,gravity,k)", "BUFFER_DC_DU"),
+    ("forward_dynamics_gradient", "FD_DU", ["bool USE_QDD_FLAG = false"], True,
+        "forward_dynamics_gradient_timestep<T,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD | BUFFER_DF_DU"),
+    ("forward_dynamics_ltl", "FD_LTL", [], True,
+        "forward_dynamics_ltl_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD"),
+    ("forward_dynamics_gradient_ltl", "FD_DU_LTL", ["bool USE_QDD_FLAG = false"], True,
+        "forward_dynamics_gradient_ltl_timestep<T,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD | BUFFER_DF_DU"),
+    ("direct_minv_mixed", "Minv_MIXED", ["typename T_ACC = double", "bool USE_COMPRESSED_MEM = false"], False,
+        "direct_minv_mixed_timestep<T,T_ACC,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_MINV"),
+    ("forward_dynamics_mixed", "FD_MIXED", ["typename T_ACC = double"], True,
+        "forward_dynamics_mixed_timestep<T,T_ACC>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD"),
+    ("forward_dynamics_gradient_mixed", "FD_DU_MIXED", ["typename T_ACC = double", "bool USE_QDD_FLAG = false"], True,
+        "forward_dynamics_gradient_mixed_timestep<T,T_ACC,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD | BUFFER_DF_DU"),
+    ("dynamics_bundle", "BUNDLE", ["int OUTPUTS = BUNDLE_ALL"], True,
+        "dynamics_bundle_timestep<T,OUTPUTS>(hd_data,d_robotModel,gravity,k)", "bundle_buffers(OUTPUTS)"),
+    ("end_effector_kinematics", "EE_KIN", ["int OUTPUTS = EE_KINEMATICS", "bool USE_QDD_FLAG = false"], True,
+        "end_effector_kinematics_timestep<T,OUTPUTS,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "ee_kinematics_buffers(OUTPUTS)"),
+    ("aba", "ABA", [], True,
+        "aba_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD"),
+    ("crba", "CRBA", [], True,
+        "crba_timestep<T>(hd_data,d_robotModel,k)", "BUFFER_M"),
+    ("crba_packed", "CRBA_PACKED", [], True,
+        "crba_packed_timestep<T>(hd_data,d_robotModel,k)", "BUFFER_M_PACKED"),
+    ("end_effector_positions", "EEPOS", ["bool USE_COMPRESSED_MEM = false"], False,
+        "end_effector_positions_timestep<T,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_EEPOS"),
+    ("end_effector_positions_gradient", "DEEPOS", ["bool USE_COMPRESSED_MEM = false"], False,
+        "end_effector_positions_gradient_timestep<T,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_DEEPOS"),
+    ("inverse_dynamics_gradient_sparse", "ID_DU_SPARSE", ["bool USE_QDD_FLAG = false", "bool USE_COMPRESSED_MEM = false"], True,
+        "inverse_dynamics_gradient_sparse_timestep<T,USE_QDD_FLAG,USE_COMPRESSED_MEM>(hd_data,d_robotModel,gravity,k)", "BUFFER_DC_DU_SPARSE"),
+    ("forward_dynamics_gradient_sparse", "FD_DU_SPARSE", ["bool USE_QDD_FLAG = false"], True,
+        "forward_dynamics_gradient_sparse_timestep<T,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD | BUFFER_DF_DU_SPARSE"),
+    ("idsva_so_host", "ID_SO", ["bool PACKED = false"], True,
+        "idsva_so_timestep<T,PACKED>(hd_data,d_robotModel,gravity,k)", "PACKED ? BUFFER_IDSVA_SO_PACKED : BUFFER_IDSVA_SO"),
+    ("fdsva_so", "FD_SO", ["bool PACKED = false"], True,
+        "fdsva_so_timestep<T,PACKED>(hd_data,d_robotModel,gravity,k)", "PACKED ? BUFFER_DF2_PACKED : BUFFER_DF2"),
+    ("idsva_so_contracted", "ID_SO_CONTRACTED", [], True,
+        "idsva_so_contracted_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_IDSVA_SO_CONTRACTED"),
+    ("fdsva_so_contracted", "FD_SO_CONTRACTED", [], True,
+        "fdsva_so_contracted_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_DF2_CONTRACTED"),
+]
+
+# the HOST_API entries of floating base models (same public names, the free-flyer timesteps of floating_base.hpp)
+FLOATING_BASE_HOST_API = [
+    ("inverse_dynamics", "ID", ["bool USE_QDD_FLAG = false", "bool USE_COMPRESSED_MEM = false"], True,
+        "fb_inverse_dynamics_timestep<T,USE_QDD_FLAG,USE_COMPRESSED_MEM>(hd_data,d_robotModel,gravity,k)", "BUFFER_C"),
+    ("direct_minv", "Minv", ["bool USE_COMPRESSED_MEM = false"], False,
+        "fb_direct_minv_timestep<T,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_MINV"),
+    ("direct_minv_packed", "Minv_PACKED", ["bool USE_COMPRESSED_MEM = false"], False,
+        "fb_direct_minv_packed_timestep<T,USE_COMPRESSED_MEM>(hd_data,d_robotModel,k)", "BUFFER_MINV_PACKED"),
+    ("forward_dynamics", "FD", [], True,
+        "fb_forward_dynamics_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD"),
+    ("inverse_dynamics_gradient", "ID_DU", ["bool USE_QDD_FLAG = false", "bool USE_COMPRESSED_MEM = false"], True,
+        "fb_inverse_dynamics_gradient_timestep<T,USE_QDD_FLAG,USE_COMPRESSED_MEM>(hd_data,d_robotModel,gravity,k)", "BUFFER_DC_DU"),
+    ("forward_dynamics_gradient", "FD_DU", ["bool USE_QDD_FLAG = false"], True,
+        "fb_forward_dynamics_gradient_timestep<T,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD | BUFFER_DF_DU"),
+    ("forward_dynamics_ltl", "FD_LTL", [], True,
+        "fb_forward_dynamics_ltl_timestep<T>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD"),
+    ("forward_dynamics_gradient_ltl", "FD_DU_LTL", ["bool USE_QDD_FLAG = false"], True,
+        "fb_forward_dynamics_gradient_ltl_timestep<T,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "BUFFER_QDD | BUFFER_DF_DU"),
+    ("crba", "CRBA", [], True,
+        "fb_crba_timestep<T>(hd_data,d_robotModel,k)", "BUFFER_M"),
+    ("crba_packed", "CRBA_PACKED", [], True,
+        "fb_crba_packed_timestep<T>(hd_data,d_robotModel,k)", "BUFFER_M_PACKED"),
+    ("end_effector_kinematics", "EE_KIN", ["int OUTPUTS = EE_KINEMATICS", "bool USE_QDD_FLAG = false"], True,
+        "fb_end_effector_kinematics_timestep<T,OUTPUTS,USE_QDD_FLAG>(hd_data,d_robotModel,gravity,k)", "ee_kinematics_buffers(OUTPUTS)"),
+]
+
+# inputs each HOST_API entry reads with its default template arguments, by timing label (see pyInput in bindings.hpp)
+PYTHON_INPUTS = {
+    "ID": "PY_Q | PY_QD | PY_QDD", "Minv": "PY_Q", "Minv_PACKED": "PY_Q", "FD": "PY_Q | PY_QD | PY_U",
+    "ID_DU": "PY_Q | PY_QD | PY_QDD", "FD_DU": "PY_Q | PY_QD | PY_U", "FD_LTL": "PY_Q | PY_QD | PY_U", "FD_DU_LTL": "PY_Q | PY_QD | PY_U",
+    "Minv_MIXED": "PY_Q", "FD_MIXED": "PY_Q | PY_QD | PY_U", "FD_DU_MIXED": "PY_Q | PY_QD | PY_U", "BUNDLE": "PY_Q | PY_QD | PY_U",
+    "EE_KIN": "PY_Q | PY_QD", "ABA": "PY_Q | PY_QD | PY_U", "CRBA": "PY_Q", "CRBA_PACKED": "PY_Q", "EEPOS": "PY_Q", "DEEPOS": "PY_Q",
+    "ID_DU_SPARSE": "PY_Q | PY_QD | PY_QDD", "FD_DU_SPARSE": "PY_Q | PY_QD | PY_U", "ID_SO": "PY_Q | PY_QD | PY_U", "FD_SO": "PY_Q | PY_QD | PY_U",
+    "ID_SO_CONTRACTED": "PY_Q | PY_QD | PY_U | PY_LAMBDA", "FD_SO_CONTRACTED": "PY_Q | PY_QD | PY_U | PY_LAMBDA",
+}
+# gridData outputs as returned to python: buffer -> (name, per timestep dims as (extent, element stride)), matrices as [row, col]
+PYTHON_OUTPUTS = {
+    "BUFFER_C": ("c", [("NUM_VEL", "1")]),
+    "BUFFER_MINV": ("Minv", [("NUM_VEL", "1"), ("NUM_VEL", "NUM_VEL")]),
+    "BUFFER_QDD": ("qdd", [("NUM_VEL", "1")]),
+    "BUFFER_DC_DU": ("dc_du", [("NUM_VEL", "1"), ("2*NUM_VEL", "NUM_VEL")]),
+    "BUFFER_DF_DU": ("df_du", [("NUM_VEL", "1"), ("2*NUM_VEL", "NUM_VEL")]),
+    "BUFFER_DC_DU_SPARSE": ("dc_du_sparse", [("2*DC_DU_NNZ", "1")]),
+    "BUFFER_DF_DU_SPARSE": ("df_du_sparse", [("2*DF_DU_NNZ", "1")]),
+    "BUFFER_EEPOS": ("eePos", [("NUM_EES", "6"), ("6", "1")]),
+    "BUFFER_DEEPOS": ("deePos", [("NUM_EES", "6*NUM_JOINTS"), ("6", "1"), ("NUM_JOINTS", "6")]),
+    "BUFFER_M": ("M", [("NUM_VEL", "1"), ("NUM_VEL", "NUM_VEL")]),
+    "BUFFER_IDSVA_SO": ("idsva_so", [("4", "NUM_VEL*NUM_VEL*NUM_VEL"), ("NUM_VEL", "NUM_VEL*NUM_VEL"), ("NUM_VEL", "1"), ("NUM_VEL", "NUM_VEL")]),
+    "BUFFER_DF2": ("df2", [("4", "NUM_VEL*NUM_VEL*NUM_VEL"), ("NUM_VEL", "NUM_VEL*NUM_VEL"), ("NUM_VEL", "1"), ("NUM_VEL", "NUM_VEL")]),
+    "BUFFER_IDSVA_SO_CONTRACTED": ("idsva_so_contracted", [("4", "NUM_VEL*NUM_VEL"), ("NUM_VEL", "1"), ("NUM_VEL", "NUM_VEL")]),
+    "BUFFER_DF2_CONTRACTED": ("df2_contracted", [("4", "NUM_VEL*NUM_VEL"), ("NUM_VEL", "1"), ("NUM_VEL", "NUM_VEL")]),
+    "BUFFER_EE_JACOBIAN": ("eeJacobian", [("NUM_EES", "6*NUM_VEL"), ("6", "1"), ("NUM_VEL", "6")]),
+    "BUFFER_EE_JDQD": ("eeJdqd", [("NUM_EES", "6"), ("6", "1")]),
+    "BUFFER_MINV_PACKED": ("Minv_packed", [("SYM_PACKED_SIZE", "1")]),
+    "BUFFER_M_PACKED": ("M_packed", [("SYM_PACKED_SIZE", "1")]),
+    "BUFFER_IDSVA_SO_PACKED": ("idsva_so_packed", [("SO_PACKED_SIZE", "1")]),
+    "BUFFER_DF2_PACKED": ("df2_packed", [("SO_PACKED_SIZE", "1")]),
+}
+# outputs of the HOST_API entries whose buffers depend on a template parameter, at its default
+PYTHON_DEFAULT_BUFFERS = {
+    "bundle_buffers(OUTPUTS)": "BUFFER_C | BUFFER_MINV | BUFFER_QDD | BUFFER_DC_DU | BUFFER_DF_DU",
+    "ee_kinematics_buffers(OUTPUTS)": "BUFFER_EEPOS | BUFFER_EE_JACOBIAN | BUFFER_EE_JDQD",
+    "PACKED ? BUFFER_IDSVA_SO_PACKED : BUFFER_IDSVA_SO": "BUFFER_IDSVA_SO",
+    "PACKED ? BUFFER_DF2_PACKED : BUFFER_DF2": "BUFFER_DF2",
+}
+
+# values of each kind of HOST_API template parameter explicitly instantiated by gen_split_code
+# (entries with any other kind, e.g., int OUTPUTS, stay defined in the shared model header)
+SPLIT_INSTANTIATIONS = {"typename": ["float", "double"], "bool": ["false", "true"]}
+SPLIT_CXXFLAGS = ["-std=c++11", "-O3", "-march=native", "-pthread"]
+
+class GRiDCPUCodeGenerator:
+    """
+    Emits grid_cpu.hpp, a plain C++ (host thread) backend exposing the same
+    entry points and gridData / robotModel layouts as the CUDA grid.cuh.
+    The robot model is baked in as compile time constants and the templated
+    algorithms in the cpp folder are specialized against it.
+    """
+    def __init__(self, robot, DEBUG_MODE = False, FILE_NAMESPACE = "grid"):
+        self.robot = robot
+        self.DEBUG_MODE = DEBUG_MODE
+        self.file_namespace = FILE_NAMESPACE
+        self.code_str = ""
+        self.indent_level = 0
+
+    def gen_add_code_line(self, new_code_line, add_indent_after = False):
+        self.code_str += "\t" * self.indent_level + new_code_line + "\n"
+        if add_indent_after:
+            self.indent_level += 1
+
+    def gen_add_code_lines(self, new_code_lines, add_indent_after = False):
+        for new_code_line in new_code_lines:
+            self.gen_add_code_line(new_code_line)
+        if add_indent_after:
+            self.indent_level += 1
+
+    def gen_add_end_control_flow(self):
+        self.indent_level -= 1
+        self.gen_add_code_line("}")
+
+    def gen_add_fragment(self, file_name):
+        with open(os.path.join(CPP_DIR, file_name)) as f:
+            for line in f.read().rstrip().split("\n"):
+                self.gen_add_code_line(line if line.strip() else "")
+        self.gen_add_code_line("")
+
+    def is_floating_base(self):
+        # the parser models a floating base as joint 0, a free-flyer with a quaternion (one more position than velocity)
+        return self.robot.get_num_pos() != self.robot.get_num_vel()
+
+    def validate_robot(self):
+        parent_ids = self.robot.get_parent_id_array()
+        for jid, parent in enumerate(parent_ids):
+            if parent >= jid:
+                print("[!Error] grid_cpu.hpp requires joints ordered so that parents come before their children")
+                return False
+        if self.is_floating_base():
+            if self.robot.get_num_pos() != self.robot.get_num_vel() + 1 or parent_ids.count(-1) != 1 or len(parent_ids) < 2:
+                print("[!Error] grid_cpu.hpp supports floating base robots with one quaternion free-flyer root joint and at least one limb joint")
+                return False
+        return True
+
+    def get_limbs(self):
+        """
+        Joints, spatial inertias and parent ids of the generic joints. For a floating base the free-flyer joint 0
+        is dropped (it is handled by floating_base.hpp) and the remaining joints are renumbered so that a joint
+        attached to the base has parent -1, as in a fixed base model.
+        """
+        joints = self.robot.get_joints_ordered_by_id()
+        Imats = self.robot.get_Imats_ordered_by_id()
+        parent_ids = self.robot.get_parent_id_array()
+        if not self.is_floating_base():
+            return joints, Imats, parent_ids
+        return joints[1:], Imats[1:], [parent - 1 for parent in parent_ids[1:]]
+
+    def host_api(self):
+        return FLOATING_BASE_HOST_API if self.is_floating_base() else HOST_API
+
+    def model_fragments(self):
+        return FLOATING_BASE_FRAGMENTS if self.is_floating_base() else MODEL_FRAGMENTS
+
+    def get_ee_joint_ids(self):
+        # end effectors are the leaf links of the kinematic tree
+        parent_ids = self.get_limbs()[2]
+        return [jid for jid in range(len(parent_ids)) if jid not in parent_ids]
+
+    def get_sparsity(self):
+        # ancestor[i][j] is true if j is in the subtree of i (i included), root_ids[i] is the base joint of i's tree
+        parent_ids = self.get_limbs()[2]
+        n = len(parent_ids)
+        ancestor = [[False]*n for _ in range(n)]
+        for j in range(n):
+            i = j
+            while i != -1:
+                ancestor[i][j] = True
+                i = parent_ids[i]
+        root_ids = []
+        for jid in range(n):
+            root = jid
+            while parent_ids[root] != -1:
+                root = parent_ids[root]
+            root_ids.append(root)
+        return ancestor, root_ids
+
+    def get_csc_pattern(self, nonzero, n):
+        # compressed sparse column index map of an n x n pattern (rows ascending within each column)
+        # and the value index of every (row, col) in column-major order (-1 for a structural zero)
+        col_ptr = [0]
+        row_idx = []
+        entry = [-1]*(n*n)
+        for col in range(n):
+            for row in range(n):
+                if nonzero(row, col):
+                    entry[row + n*col] = len(row_idx)
+                    row_idx.append(row)
+            col_ptr.append(len(row_idx))
+        return col_ptr, row_idx, entry
+
+    def gen_array_str(self, values, fmt = "{:.16g}"):
+        return "{" + ",".join(fmt.format(val) for val in values) + "}"
+
+    def gen_model_constants(self):
+        joints, Imats, parent_ids = self.get_limbs()
+        n = len(joints)
+        S_vectors = []
+        revolute = []
+        for joint in joints:
+            S = [float(joint.S[i]) for i in range(6)]
+            S_vectors.extend(S)
+            revolute.append("true" if any(abs(val) > 0 for val in S[:3]) else "false")
+        XImats = []
+        for joint in joints:
+            Xmat = joint.origin.Xmat_sp_fixed
+            XImats.extend(float(Xmat[row, col]) for col in range(6) for row in range(6))
+        for Imat in Imats:
+            XImats.extend(float(Imat[row, col]) for col in range(6) for row in range(6))
+        ee_ids = self.get_ee_joint_ids()
+        ancestor, root_ids = self.get_sparsity()
+        is_ancestor = ["true" if ancestor[i][j] else "false" for j in range(n) for i in range(n)]
+        dc_col_ptr, dc_row_idx, dc_entry = self.get_csc_pattern(lambda row, col: ancestor[row][col] or ancestor[col][row], n)
+        df_col_ptr, df_row_idx, _ = self.get_csc_pattern(lambda row, col: root_ids[row] == root_ids[col], n)
+        num_threads = max(1, multiprocessing.cpu_count())
+        self.gen_add_code_lines([
+            "const char MODEL_NAME[] = \"" + self.file_namespace + "\"; // FILE_NAMESPACE (see register_model)",
+            "const char ROBOT_NAME[] = \"" + str(self.robot.name) + "\";",
+            "const bool FLOATING_BASE = " + ("true" if self.is_floating_base() else "false") + ";",
+            "const int NUM_JOINTS = " + str(n) + ";" + (" // limb joints (the free-flyer base is not one of them)" if self.is_floating_base() else ""),
+            "const int NUM_POS = " + str(n + 7 if self.is_floating_base() else n) + ";",
+            "const int NUM_VEL = " + str(n + 6 if self.is_floating_base() else n) + ";",
+            "const int NUM_EES = " + str(len(ee_ids)) + ";",
+            "const int SUGGESTED_THREADS = " + str(num_threads) + "; // host worker threads",
+            "const int PARENT_IDS[NUM_JOINTS] = " + self.gen_array_str(parent_ids, "{:d}") + ";",
+            "const bool JOINT_REVOLUTE[NUM_JOINTS] = {" + ",".join(revolute) + "};",
+            "const double S_VECTORS[6*NUM_JOINTS] = " + self.gen_array_str(S_vectors) + ";",
+            "const int EE_JOINT_IDS[NUM_EES] = " + self.gen_array_str(ee_ids, "{:d}") + ";",
+            "// Xtree for every joint followed by every spatial inertia (6x6 column-major)",
+            "const double XIMATS[72*NUM_JOINTS] = " + self.gen_array_str(XImats) + ";",
+            "// Kinematic tree sparsity: IS_ANCESTOR[i + NUM_JOINTS*j] if j is in the subtree of i (i included)",
+            "const bool IS_ANCESTOR[NUM_JOINTS*NUM_JOINTS] = {" + ",".join(is_ancestor) + "};",
+            "const int ROOT_IDS[NUM_JOINTS] = " + self.gen_array_str(root_ids, "{:d}") + ";",
+            "// Compressed sparse column maps of one NUM_JOINTS x NUM_JOINTS gradient block",
+            "//   dc_du: nonzero where row and col are ancestor / descendant, df_du: where they share a tree",
+            "//   block value v of column col is at row DC_DU_ROW_IDX[v] for v in [DC_DU_COL_PTR[col], DC_DU_COL_PTR[col+1])",
+            "//   and (row,col) is value DC_DU_ENTRY[row + NUM_JOINTS*col] (-1 for a structural zero)",
+            "const int DC_DU_NNZ = " + str(len(dc_row_idx)) + ";",
+            "const int DC_DU_COL_PTR[NUM_JOINTS+1] = " + self.gen_array_str(dc_col_ptr, "{:d}") + ";",
+            "const int DC_DU_ROW_IDX[DC_DU_NNZ] = " + self.gen_array_str(dc_row_idx, "{:d}") + ";",
+            "const int DC_DU_ENTRY[NUM_JOINTS*NUM_JOINTS] = " + self.gen_array_str(dc_entry, "{:d}") + ";",
+            "const int DF_DU_NNZ = " + str(len(df_row_idx)) + ";",
+            "const int DF_DU_COL_PTR[NUM_JOINTS+1] = " + self.gen_array_str(df_col_ptr, "{:d}") + ";",
+            "const int DF_DU_ROW_IDX[DF_DU_NNZ] = " + self.gen_array_str(df_row_idx, "{:d}") + ";",
+            "",
+        ])
+        if self.is_floating_base():
+            base_Imat = self.robot.get_Imats_ordered_by_id()[0]
+            self.gen_add_code_lines([
+                "// Spatial inertia of the floating base link (6x6 column-major)",
+                "const double BASE_INERTIA[36] = " + self.gen_array_str(float(base_Imat[row, col]) for col in range(6) for row in range(6)) + ";",
+                "",
+            ])
+
+    def host_api_variants(self, name, label):
+        # (function name, count argument, threads argument, timesteps to reserve, batch runner)
+        # the single timing runs one timestep on the calling thread, so it leaves its pool unnamed
+        return [
+            (name, "const int num_timesteps", ", hostThreads *threads", "num_timesteps", "run_batch<T>(\"" + label + "\", threads, num_timesteps, f);"),
+            (name + "_compute_only", "const int num_timesteps", "", "num_timesteps", "run_batch<T>(\"" + label + "\", nullptr, num_timesteps, f);"),
+            (name + "_single_timing", "const int num_reps", ", hostThreads * /*threads*/", "1", "run_single_timing(\"" + label + "\", num_reps, f);"),
+        ]
+
+    def host_api_args(self, T, use_gravity, count_arg, threads_arg):
+        # the launch dimensions only keep the GPU signatures, so they are left unnamed
+        gravity_arg = "const " + T + " gravity, " if use_gravity else ""
+        return "gridData<" + T + "> *hd_data, const robotModel<" + T + "> *d_robotModel, " + gravity_arg + count_arg + \
+               ", const dim3 /*block_dimms*/, const dim3 /*thread_dimms*/" + threads_arg
+
+    def split_instantiations(self, template_params):
+        # every template argument list of the explicit instantiations, or None if one of the params cannot be enumerated
+        arg_lists = [[]]
+        for param in ["typename T"] + template_params:
+            kind = param.split("=")[0].split()[0]
+            if kind not in SPLIT_INSTANTIATIONS:
+                return None
+            arg_lists = [args + [val] for args in arg_lists for val in SPLIT_INSTANTIATIONS[kind]]
+        return arg_lists
+
+    def gen_host_api(self, name, label, template_params, use_gravity, timestep_call, buffers, mode = "inline"):
+        """
+        mode inline defines the wrappers in place, declare only declares them (with the default template
+        arguments) and define defines them without defaults followed by every explicit instantiation
+        """
+        if mode == "define":
+            template_params = [param.split("=")[0].strip() for param in template_params]
+        template_str = "template <" + ", ".join(["typename T"] + template_params) + ">"
+        unused = "(void)gravity; " if use_gravity and "gravity" not in timestep_call else ""
+        for (func_name, count_arg, threads_arg, reserve_count, run_str) in self.host_api_variants(name, label):
+            self.gen_add_code_lines([template_str, "__host__"])
+            signature = "void " + func_name + "(" + self.host_api_args("T", use_gravity, count_arg, threads_arg) + ")"
+            if mode == "declare":
+                self.gen_add_code_line(signature + ";")
+                self.gen_add_code_line("")
+                continue
+            self.gen_add_code_line(signature + "{", True)
+            self.gen_add_code_line("reserve_gridData<T>(hd_data, " + reserve_count + ", " + buffers + "); // outputs are allocated on first use")
+            self.gen_add_code_line(unused + "auto f = [&](int k){" + timestep_call + ";};")
+            self.gen_add_code_line(run_str)
+            self.gen_add_end_control_flow()
+            if mode == "define":
+                for args in self.split_instantiations(template_params):
+                    self.gen_add_code_line("template void " + func_name + "<" + ",".join(args) + ">(" + \
+                                           self.host_api_args(args[0], use_gravity, count_arg, threads_arg) + ");")
+            self.gen_add_code_line("")
+
+    def gen_autotune(self):
+        # autotune_targets lists the _compute_only wrapper of every HOST_API entry, followed by the autotuner itself
+        self.gen_add_code_lines(["// (timing label, batch call) of every HOST_API entry with its default template arguments (see autotune)",
+                                 "template <typename T>", "__host__"])
+        self.gen_add_code_line("std::vector<autotuneTarget<T>> autotune_targets(){", True)
+        self.gen_add_code_line("std::vector<autotuneTarget<T>> targets;")
+        for (name, label, template_params, use_gravity, timestep_call, buffers) in self.host_api():
+            gravity_arg = "gravity," if use_gravity else ""
+            unused = "" if use_gravity else "(void)gravity; "
+            self.gen_add_code_line("targets.push_back({\"" + label + "\", [](gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int num_timesteps){" + \
+                                   unused + name + "_compute_only<T>(hd_data,d_robotModel," + gravity_arg + "num_timesteps,dim3(),dim3());}});")
+        self.gen_add_code_line("return targets;")
+        self.gen_add_end_control_flow()
+        self.gen_add_code_line("")
+        for fragment in TUNING_FRAGMENTS:
+            self.gen_add_fragment(fragment)
+
+    def gen_python_bindings(self, file_name = "grid_cpu_py.cpp", header = "grid_cpu.hpp"):
+        """
+        Emits the source of a pybind11 module (FILE_NAMESPACE_cpu) over header with a Workspace (float64) and a
+        Workspace32 (float32) class that bind every HOST_API entry with its default template arguments (see
+        bindings.hpp). For the split backend link it against libgrid_cpu.a.
+        """
+        if not self.validate_robot():
+            return False
+        module = self.file_namespace + "_cpu"
+        self.code_str = ""
+        self.indent_level = 0
+        self.gen_add_code_lines([
+            "/**************************************************************************",
+            " *  " + os.path.basename(file_name) + ": python bindings generated by GRiDCPUCodeGenerator",
+            " *  Robot: " + str(self.robot.name),
+            " *  g++ -std=c++14 -O3 -march=native -pthread -shared -fPIC $(python3 -m pybind11 --includes) \\",
+            " *      " + os.path.basename(file_name) + " -o " + module + "$(python3-config --extension-suffix)",
+            " **************************************************************************/",
+            "#include <pybind11/pybind11.h>",
+            "#include <pybind11/numpy.h>",
+            "#include <condition_variable>",
+            "#include <functional>",
+            "#include <memory>",
+            "#include <string>",
+            "#include \"" + header + "\"",
+            "",
+            "namespace py = pybind11;",
+            "",
+        ])
+        self.gen_add_code_line("namespace " + self.file_namespace + " {", True)
+        for fragment in PYTHON_FRAGMENTS:
+            self.gen_add_fragment(fragment)
+        self.gen_add_code_lines(["// every HOST_API entry as bound", "template <typename T>", "std::vector<pyEntry<T>> py_entries(){"], True)
+        self.gen_add_code_line("std::vector<pyEntry<T>> entries;")
+        for (name, label, template_params, use_gravity, timestep_call, buffers) in self.host_api():
+            inputs = PYTHON_INPUTS[label]
+            outputs = []
+            for buffer in PYTHON_DEFAULT_BUFFERS.get(buffers, buffers).split("|"):
+                (out_name, dims) = PYTHON_OUTPUTS[buffer.strip()]
+                outputs.append("{\"" + out_name + "\", buffer_index(" + buffer.strip() + "), " + str(len(dims)) + ", {" + \
+                               ", ".join(extent for (extent, stride) in dims) + "}, {" + ", ".join(stride for (extent, stride) in dims) + "}}")
+            args = "(hd_data,d_robotModel," + ("gravity," if use_gravity else "") + "num_timesteps,dim3(),dim3(),threads);"
+            unused = "" if use_gravity else "(void)gravity; "
+            if "PY_QDD" in inputs:
+                call = unused + "if (qdd_given){" + name + "<T,true>" + args + "} else {" + name + "<T>" + args + "}"
+            else:
+                call = unused + "(void)qdd_given; " + name + "<T>" + args
+            self.gen_add_code_line("entries.push_back({\"" + name + "\", " + inputs + ", {" + ", ".join(outputs) + "},", True)
+            self.gen_add_code_line("[](gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int num_timesteps, " + \
+                                   "hostThreads *threads, const bool qdd_given){" + call + "}});")
+            self.indent_level -= 1
+        self.gen_add_code_line("return entries;")
+        self.gen_add_end_control_flow()
+        self.gen_add_end_control_flow()
+        self.gen_add_code_line("")
+        self.gen_add_code_line("PYBIND11_MODULE(" + module + ", m){", True)
+        self.gen_add_code_lines([
+            "m.doc() = \"Batched " + str(self.robot.name) + " dynamics (grid_cpu) over numpy arrays of shape (N, ...)\";",
+            self.file_namespace + "::bind_module(m);",
+            self.file_namespace + "::bind_workspace<double>(m, \"Workspace\", " + self.file_namespace + "::py_entries<double>());",
+            self.file_namespace + "::bind_workspace<float>(m, \"Workspace32\", " + self.file_namespace + "::py_entries<float>());",
+        ])
+        self.gen_add_end_control_flow()
+        self.write_if_changed(file_name, self.code_str)
+        return True
+
+    def gen_model_header(self, title, compile_str):
+        # runtime, model constants and templated algorithms, left open inside the model namespace
+        self.code_str = ""
+        self.indent_level = 0
+        self.gen_add_code_lines([
+            "/**************************************************************************",
+            " *  " + title,
+            " *  Robot: " + str(self.robot.name),
+            " *  " + compile_str,
+            " **************************************************************************/",
+            "#pragma once",
+            "",
+        ])
+        for fragment in RUNTIME_FRAGMENTS:
+            self.gen_add_fragment(fragment)
+        self.gen_add_code_line("namespace " + self.file_namespace + " {", True)
+        self.gen_add_code_line("using grid_cpu::hostThreads;")
+        self.gen_add_code_line("")
+        self.gen_model_constants()
+        for fragment in self.model_fragments():
+            self.gen_add_fragment(fragment)
+
+    def gen_all_code(self, file_name = "grid_cpu.hpp"):
+        if not self.validate_robot():
+            return False
+        self.gen_model_header("grid_cpu.hpp: host CPU backend generated by GRiDCPUCodeGenerator", "g++ -std=c++11 -O3 -march=native -pthread")
+        for (name, label, template_params, use_gravity, timestep_call, buffers) in self.host_api():
+            self.gen_host_api(name, label, template_params, use_gravity, timestep_call, buffers)
+        self.gen_autotune()
+        self.gen_add_end_control_flow()
+        with open(file_name, "w") as f:
+            f.write(self.code_str)
+        return True
+
+    def gen_split_code(self, out_dir = "grid_cpu"):
+        """
+        Emits the same backend as gen_all_code split into out_dir/grid_cpu.hpp, the shared model header that
+        declares the ALGORITHM wrappers, and one grid_cpu_ALGORITHM.cpp per HOST_API entry that defines and
+        explicitly instantiates them, so they compile in parallel (see build_split_code) and a consumer only
+        links the algorithms it calls. Files whose contents did not change are not rewritten so their objects
+        stay current. Returns the list of translation units.
+        """
+        if not self.validate_robot():
+            return None
+        os.makedirs(out_dir, exist_ok = True)
+        self.gen_model_header("grid_cpu.hpp: shared model header of the split host CPU backend generated by GRiDCPUCodeGenerator", \
+                              "link against libgrid_cpu.a (one grid_cpu_ALGORITHM.cpp per algorithm)")
+        split_api = [entry for entry in self.host_api() if self.split_instantiations(entry[2]) is not None]
+        for entry in self.host_api():
+            self.gen_host_api(*entry, mode = "declare" if entry in split_api else "inline")
+        self.gen_autotune()
+        self.gen_add_end_control_flow()
+        self.write_if_changed(os.path.join(out_dir, "grid_cpu.hpp"), self.code_str)
+        sources = []
+        for entry in split_api:
+            self.code_str = ""
+            self.indent_level = 0
+            self.gen_add_code_lines(["// " + entry[0] + " of the split host CPU backend generated by GRiDCPUCodeGenerator", \
+                                     "#include \"grid_cpu.hpp\"", ""])
+            self.gen_add_code_line("namespace " + self.file_namespace + " {", True)
+            self.gen_host_api(*entry, mode = "define")
+            self.gen_add_end_control_flow()
+            source = os.path.join(out_dir, "grid_cpu_" + entry[0] + ".cpp")
+            self.write_if_changed(source, self.code_str)
+            sources.append(source)
+        return sources
+
+    def write_if_changed(self, file_name, code_str):
+        if os.path.isfile(file_name):
+            with open(file_name) as f:
+                if f.read() == code_str:
+                    return
+        with open(file_name, "w") as f:
+            f.write(code_str)
+
+    def build_split_code(self, sources, out_dir = "grid_cpu", cxxflags = SPLIT_CXXFLAGS, jobs = None):
+        """
+        Compiles the translation units of gen_split_code in parallel and archives them into out_dir/libgrid_cpu.a.
+        An object is only rebuilt when the hash of its source, the model header and cxxflags (kept in OBJECT.hash)
+        changed. Returns False (after printing the compiler errors) if any of them failed.
+        """
+        with open(os.path.join(out_dir, "grid_cpu.hpp"), "rb") as f:
+            header = f.read()
+        def build(source):
+            obj = source[:-len(".cpp")] + ".o"
+            with open(source, "rb") as f:
+                key = hashlib.sha256(f.read() + header + " ".join(cxxflags).encode()).hexdigest()
+            if os.path.isfile(obj) and os.path.isfile(obj + ".hash"):
+                with open(obj + ".hash") as f:
+                    if f.read().strip() == key:
+                        return (obj, False, "")
+            result = subprocess.run(["g++"] + cxxflags + ["-c", source, "-o", obj], capture_output = True, text = True)
+            if result.returncode != 0:
+                return (obj, True, result.stderr)
+            with open(obj + ".hash", "w") as f:
+                f.write(key + "\n")
+            return (obj, True, "")
+        with ThreadPoolExecutor(max_workers = jobs or max(1, multiprocessing.cpu_count())) as pool:
+            results = list(pool.map(build, sources))
+        errors = [err for (obj, rebuilt, err) in results if err]
+        if errors:
+            print("[!Error] compiling the split grid_cpu backend failed:")
+            for err in errors:
+                print(err)
+            return False
+        archive = os.path.join(out_dir, "libgrid_cpu.a")
+        if any(rebuilt for (obj, rebuilt, err) in results) or not os.path.isfile(archive):
+            if os.path.isfile(archive):
+                os.remove(archive)
+            subprocess.run(["ar", "rcs", archive] + [obj for (obj, rebuilt, err) in results], check = True)
+        return True
@@ -0,0 +1 @@
+from .GRiDCPUCodeGenerator import GRiDCPUCodeGenerator
@@ -0,0 +1,171 @@
+/**************************************************************************
+ *  Lane interleaved (AoSoA) batches
+ *
+ *  Timesteps are grouped into blocks of W. Within a block each element of
+ *  the per-timestep record is stored for all W timesteps back to back:
+ *      aosoa[b*W*stride + e*W + l] = record e of timestep b*W + l
+ *  so one block is an array of stride lanes<T,W> values. A partial final
+ *  block repeats the last timestep in its spare lanes (keeping them finite)
+ *  and those lanes are never copied back out.
+ **************************************************************************/
+
+template <int W>
+inline int aosoa_blocks(const int num_timesteps){return (num_timesteps + W - 1) / W;}
+
+// number of T needed to hold num_timesteps records of size stride
+template <int W>
+inline int aosoa_size(const int stride, const int num_timesteps){return aosoa_blocks<W>(num_timesteps)*W*stride;}
+
+/**
+ * Converts timestep major records (e.g. h_q_qd_u) into the AoSoA layout
+ * @param dst is the aosoa_size<W>(stride,num_timesteps) output
+ */
+template <typename T, int W>
+__host__
+void to_aosoa(T *dst, const T *src, const int stride, const int num_timesteps){
+	for (int b = 0; b < aosoa_blocks<W>(num_timesteps); b++){
+		T *block = &dst[b*W*stride];
+		for (int l = 0; l < W; l++){
+			const int k = b*W + l < num_timesteps ? b*W + l : num_timesteps - 1;
+			const T *rec = &src[k*stride];
+			for (int e = 0; e < stride; e++){block[e*W + l] = rec[e];}
+		}
+	}
+}
+
+/**
+ * Converts AoSoA records back to timestep major order (e.g. h_c, h_Minv, h_dc_du, h_df_du)
+ */
+template <typename T, int W>
+__host__
+void from_aosoa(T *dst, const T *src, const int stride, const int num_timesteps){
+	for (int k = 0; k < num_timesteps; k++){
+		const T *block = &src[(k/W)*W*stride]; const int l = k % W;
+		T *rec = &dst[k*stride];
+		for (int e = 0; e < stride; e++){rec[e] = block[e*W + l];}
+	}
+}
+
+template <typename T, int W>
+inline void load_lanes(grid_cpu::lanes<T,W> *out, const T *block, const int count){
+	std::memcpy(static_cast<void *>(out), block, count*W*sizeof(T));
+}
+
+template <typename T, int W>
+inline void store_lanes(T *block, const grid_cpu::lanes<T,W> *in, const int count){
+	std::memcpy(block, static_cast<const void *>(in), count*W*sizeof(T));
+}
+
+// broadcasts the model once per batch into the calling thread's (72*NUM_JOINTS) XImats, then shared read only by every worker
+template <typename T, int W>
+inline void broadcast_XImats(grid_cpu::lanes<T,W> *XImats, const T *d_XImats){
+	for (int i = 0; i < 72*NUM_JOINTS; i++){XImats[i] = grid_cpu::lanes<T,W>(d_XImats[i]);}
+}
+
+template <typename T, int W, typename Func>
+inline void run_aosoa_batch(hostThreads *threads, const int num_timesteps, Func &f){
+	if (threads == nullptr){threads = grid_cpu::default_threads();}
+	threads->parallel_for(aosoa_blocks<W>(num_timesteps), f);
+}
+
+/**
+ * Inverse dynamics on W timesteps per pass
+ * @param c_aosoa is the AoSoA (stride NUM_VEL) output
+ * @param q_qd_u_aosoa is the AoSoA (stride Q_QD_U_STRIDE) input, where the last block holds qdd if USE_QDD_FLAG
+ */
+template <typename T, int W, bool USE_QDD_FLAG = false>
+__host__
+void inverse_dynamics_aosoa(T *c_aosoa, const T *q_qd_u_aosoa, const robotModel<T> *d_robotModel, const T gravity,
+                            const int num_timesteps, hostThreads *threads = nullptr){
+	typedef grid_cpu::lanes<T,W> L;
+	L XImats[72*NUM_JOINTS]; broadcast_XImats<T,W>(XImats, d_robotModel->d_XImats); const L g = L(gravity);
+	auto f = [&](int b){
+		L s_q[Q_QD_U_STRIDE]; L s_X[36*NUM_JOINTS]; L s_vaf[18*NUM_JOINTS]; L s_c[NUM_VEL];
+		load_lanes<T,W>(s_q, &q_qd_u_aosoa[b*W*Q_QD_U_STRIDE], Q_QD_U_STRIDE);
+		load_update_XImats_helpers<L>(s_X, s_q, XImats);
+		inverse_dynamics_inner<L>(s_c, s_vaf, &s_q[NUM_JOINTS], USE_QDD_FLAG ? &s_q[NUM_JOINTS + NUM_VEL] : nullptr, s_X, XImats, g);
+		store_lanes<T,W>(&c_aosoa[b*W*NUM_VEL], s_c, NUM_VEL);
+	};
+	run_aosoa_batch<T,W>(threads, num_timesteps, f);
+}
+
+/**
+ * Direct inverse of the mass matrix on W timesteps per pass
+ * @param Minv_aosoa is the AoSoA (stride NUM_VEL*NUM_VEL) output
+ */
+template <typename T, int W>
+__host__
+void direct_minv_aosoa(T *Minv_aosoa, const T *q_qd_u_aosoa, const robotModel<T> *d_robotModel, const int num_timesteps,
+                       hostThreads *threads = nullptr){
+	typedef grid_cpu::lanes<T,W> L;
+	L XImats[72*NUM_JOINTS]; broadcast_XImats<T,W>(XImats, d_robotModel->d_XImats);
+	auto f = [&](int b){
+		L s_q[NUM_JOINTS]; L s_X[36*NUM_JOINTS]; L s_Minv[NUM_VEL*NUM_VEL];
+		load_lanes<T,W>(s_q, &q_qd_u_aosoa[b*W*Q_QD_U_STRIDE], NUM_JOINTS);
+		load_update_XImats_helpers<L>(s_X, s_q, XImats);
+		direct_minv_inner<L>(s_Minv, s_X, XImats);
+		store_lanes<T,W>(&Minv_aosoa[b*W*NUM_VEL*NUM_VEL], s_Minv, NUM_VEL*NUM_VEL);
+	};
+	run_aosoa_batch<T,W>(threads, num_timesteps, f);
+}
+
+/**
+ * Forward dynamics on W timesteps per pass
+ * @param qdd_aosoa is the AoSoA (stride NUM_VEL) output
+ */
+template <typename T, int W>
+__host__
+void forward_dynamics_aosoa(T *qdd_aosoa, const T *q_qd_u_aosoa, const robotModel<T> *d_robotModel, const T gravity,
+                            const int num_timesteps, hostThreads *threads = nullptr){
+	typedef grid_cpu::lanes<T,W> L;
+	L XImats[72*NUM_JOINTS]; broadcast_XImats<T,W>(XImats, d_robotModel->d_XImats); const L g = L(gravity);
+	auto f = [&](int b){
+		L s_q[Q_QD_U_STRIDE]; L s_X[36*NUM_JOINTS]; L s_qdd[NUM_VEL];
+		load_lanes<T,W>(s_q, &q_qd_u_aosoa[b*W*Q_QD_U_STRIDE], Q_QD_U_STRIDE);
+		load_update_XImats_helpers<L>(s_X, s_q, XImats);
+		forward_dynamics_inner<L>(s_qdd, &s_q[NUM_JOINTS], &s_q[NUM_JOINTS + NUM_VEL], s_X, XImats, g);
+		store_lanes<T,W>(&qdd_aosoa[b*W*NUM_VEL], s_qdd, NUM_VEL);
+	};
+	run_aosoa_batch<T,W>(threads, num_timesteps, f);
+}
+
+/**
+ * Gradient of inverse dynamics on W timesteps per pass
+ * @param dc_du_aosoa is the AoSoA (stride 2*NUM_VEL*NUM_VEL) output
+ */
+template <typename T, int W, bool USE_QDD_FLAG = false>
+__host__
+void inverse_dynamics_gradient_aosoa(T *dc_du_aosoa, const T *q_qd_u_aosoa, const robotModel<T> *d_robotModel, const T gravity,
+                                     const int num_timesteps, hostThreads *threads = nullptr){
+	typedef grid_cpu::lanes<T,W> L;
+	L XImats[72*NUM_JOINTS]; broadcast_XImats<T,W>(XImats, d_robotModel->d_XImats); const L g = L(gravity);
+	auto f = [&](int b){
+		L s_q[Q_QD_U_STRIDE]; L s_X[36*NUM_JOINTS]; L s_vaf[18*NUM_JOINTS]; L s_c[NUM_VEL]; L s_dc_du[2*NUM_VEL*NUM_VEL];
+		load_lanes<T,W>(s_q, &q_qd_u_aosoa[b*W*Q_QD_U_STRIDE], Q_QD_U_STRIDE);
+		load_update_XImats_helpers<L>(s_X, s_q, XImats);
+		inverse_dynamics_inner<L>(s_c, s_vaf, &s_q[NUM_JOINTS], USE_QDD_FLAG ? &s_q[NUM_JOINTS + NUM_VEL] : nullptr, s_X, XImats, g);
+		inverse_dynamics_gradient_inner<L>(s_dc_du, s_vaf, &s_q[NUM_JOINTS], s_X, XImats, g);
+		store_lanes<T,W>(&dc_du_aosoa[b*W*2*NUM_VEL*NUM_VEL], s_dc_du, 2*NUM_VEL*NUM_VEL);
+	};
+	run_aosoa_batch<T,W>(threads, num_timesteps, f);
+}
+
+/**
+ * Gradient of forward dynamics on W timesteps per pass
+ * @param df_du_aosoa is the AoSoA (stride 2*NUM_VEL*NUM_VEL) output
+ */
+template <typename T, int W>
+__host__
+void forward_dynamics_gradient_aosoa(T *df_du_aosoa, const T *q_qd_u_aosoa, const robotModel<T> *d_robotModel, const T gravity,
+                                     const int num_timesteps, hostThreads *threads = nullptr){
+	typedef grid_cpu::lanes<T,W> L;
+	L XImats[72*NUM_JOINTS]; broadcast_XImats<T,W>(XImats, d_robotModel->d_XImats); const L g = L(gravity);
+	auto f = [&](int b){
+		L s_q[Q_QD_U_STRIDE]; L s_X[36*NUM_JOINTS]; L s_qdd[NUM_VEL]; L s_df_du[2*NUM_VEL*NUM_VEL];
+		load_lanes<T,W>(s_q, &q_qd_u_aosoa[b*W*Q_QD_U_STRIDE], Q_QD_U_STRIDE);
+		load_update_XImats_helpers<L>(s_X, s_q, XImats);
+		forward_dynamics_gradient_inner<L>(s_df_du, s_qdd, &s_q[NUM_JOINTS], &s_q[NUM_JOINTS + NUM_VEL], s_X, XImats, g);
+		store_lanes<T,W>(&df_du_aosoa[b*W*2*NUM_VEL*NUM_VEL], s_df_du, 2*NUM_VEL*NUM_VEL);
+	};
+	run_aosoa_batch<T,W>(threads, num_timesteps, f);
+}
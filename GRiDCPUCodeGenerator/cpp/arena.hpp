@@ -0,0 +1,85 @@
+/**************************************************************************
+ *  Aligned workspace arena
+ *
+ *  Bump allocator over a short list of large chunks. Every allocation is
+ *  cache line aligned and zeroed, and nothing is freed individually: the
+ *  whole arena is released at once. Chunks of at least one huge page are
+ *  mmapped and marked for transparent huge pages so a batch's buffers sit
+ *  on few TLB entries; smaller chunks come from posix_memalign. When a
+ *  chunk runs out the next one is at least as large as everything so far,
+ *  so a growing workspace needs O(log size) chunks.
+ **************************************************************************/
+#ifndef GRID_CPU_ARENA_HPP
+#define GRID_CPU_ARENA_HPP
+
+#include <new>
+#include <sys/mman.h>
+
+namespace grid_cpu {
+
+const size_t ARENA_ALIGN = 64;
+const size_t HUGE_PAGE_BYTES = static_cast<size_t>(2) << 20;
+
+inline size_t round_up(const size_t bytes, const size_t align){return (bytes + align - 1) / align * align;}
+
+class arena {
+public:
+	explicit arena(const size_t initial_bytes = 0) : used(0), total(0) {if (initial_bytes > 0){add_chunk(initial_bytes);}}
+	~arena(){release();}
+
+	void *allocate(size_t bytes){
+		bytes = round_up(bytes > 0 ? bytes : 1, ARENA_ALIGN);
+		if (chunks.empty() || used + bytes > chunks.back().size){add_chunk(bytes > total ? bytes : total);}
+		char *ptr = chunks.back().ptr + used; used += bytes;
+		return static_cast<void *>(ptr);
+	}
+
+	template <typename T>
+	T *allocate_array(const size_t count){return static_cast<T *>(allocate(count*sizeof(T)));}
+
+	// bytes held from the OS / allocator (not just handed out)
+	size_t bytes_reserved() const {return total;}
+
+	void release(){
+		for (const chunk &c : chunks){
+			if (c.mapped){munmap(c.ptr, c.size);} else {free(c.ptr);}
+		}
+		chunks.clear(); used = 0; total = 0;
+	}
+
+private:
+	struct chunk {char *ptr; size_t size; bool mapped;};
+
+	void add_chunk(size_t bytes){
+		chunk c; c.ptr = nullptr; c.mapped = false;
+		if (bytes >= HUGE_PAGE_BYTES){
+			c.size = round_up(bytes, HUGE_PAGE_BYTES);
+			void *ptr = mmap(nullptr, c.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (ptr != MAP_FAILED){
+				#ifdef MADV_HUGEPAGE
+					madvise(ptr, c.size, MADV_HUGEPAGE);
+				#endif
+				c.ptr = static_cast<char *>(ptr); c.mapped = true; // anonymous pages are already zero
+			}
+		}
+		if (c.ptr == nullptr){
+			c.size = round_up(bytes, ARENA_ALIGN);
+			void *ptr = nullptr;
+			if (posix_memalign(&ptr, ARENA_ALIGN, c.size) != 0){throw std::bad_alloc();}
+			std::memset(ptr, 0, c.size);
+			c.ptr = static_cast<char *>(ptr);
+		}
+		chunks.push_back(c); used = 0; total += c.size;
+	}
+
+	std::vector<chunk> chunks;
+	size_t used;   // bytes handed out from the last chunk
+	size_t total;
+
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+};
+
+} // namespace grid_cpu
+
+#endif
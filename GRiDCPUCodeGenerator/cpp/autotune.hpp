@@ -0,0 +1,86 @@
+/**************************************************************************
+ *  Autotuning mode
+ *
+ *  Sweeps the thread count (powers of two up to the pool size) and grain
+ *  (powers of two up to batch / threads) of every HOST_API entry for each
+ *  requested batch size, keeps the fastest pair per batch size in the
+ *  process wide tuning cache and writes it to a file keyed by robot and CPU
+ *  model. Later processes load the file (grid_cpu::tuning_cache().load or
+ *  $GRID_CPU_TUNING_CACHE) and every batch call picks its entry up.
+ *
+ *      const int batches[] = {16, 64, 256};
+ *      autotune<double>("grid_tuning.txt", batches, 3);            // every entry at gravity 9.81
+ *      autotune<float>("grid_tuning.txt", batches, 3, 9.81f, "FD_DU");  // or only the listed labels
+ *
+ *  Emitted after the wrappers it sweeps (see autotune_targets).
+ **************************************************************************/
+
+// true if label is one of the comma separated labels (every label when labels is nullptr)
+inline bool autotune_selected(const char *labels, const char *label){
+	if (labels == nullptr){return true;}
+	const size_t len = strlen(label);
+	for (const char *c = labels; *c != '\0';){
+		const char *end = strchr(c, ',');
+		const size_t n = end == nullptr ? strlen(c) : static_cast<size_t>(end - c);
+		if (n == len && strncmp(c, label, len) == 0){return true;}
+		if (end == nullptr){break;}
+		c = end + 1;
+	}
+	return false;
+}
+
+/**
+ * Tunes the selected HOST_API entries on the default pool and merges the winners into cache_path
+ * @param labels comma separated timing labels to tune (e.g., "ID,FD_DU"), nullptr for every entry
+ * @param num_reps batches timed per configuration (after one warm up batch)
+ * Returns false, with a message on stdout, if a batch size is not positive or the file cannot be written.
+ */
+template <typename T>
+__host__
+bool autotune(const char *cache_path, const int *batch_sizes, const int num_batch_sizes, const T gravity = static_cast<T>(9.81),
+              const char *labels = nullptr, const int num_reps = 20){
+	int max_batch = 0;
+	for (int b = 0; b < num_batch_sizes; b++){
+		if (batch_sizes[b] <= 0){printf("[!Error] autotune batch sizes must be positive\n"); return false;}
+		if (batch_sizes[b] > max_batch){max_batch = batch_sizes[b];}
+	}
+	grid_cpu::tuningCache &cache = grid_cpu::tuning_cache();
+	FILE *existing = fopen(cache_path, "r");
+	if (existing != nullptr){fclose(existing); cache.load(cache_path);}
+	const int pool = grid_cpu::default_threads()->size();
+	robotModel<T> *d_robotModel = init_robotModel<T>();
+	gridData<T> *hd_data = init_gridData<T>(max_batch, BUFFER_INPUTS);
+	// every input packing gets values in [-1,1] (the timing of these kernels does not depend on them)
+	unsigned state = 12345u;
+	T *inputs[4] = {hd_data->h_q_qd_u, hd_data->h_q_qd, hd_data->h_q, hd_data->h_lambda};
+	const int strides[4] = {Q_QD_U_STRIDE, Q_QD_STRIDE, Q_STRIDE, NUM_VEL};
+	for (int b = 0; b < 4; b++){
+		for (int i = 0; i < strides[b]*max_batch; i++){state = state*1664525u + 1013904223u; inputs[b][i] = static_cast<T>(static_cast<double>(state >> 8)/8388608.0 - 1.0);}
+	}
+	const std::vector<autotuneTarget<T>> targets = autotune_targets<T>();
+	for (const autotuneTarget<T> &target : targets){
+		if (!autotune_selected(labels, target.label)){continue;}
+		for (int b = 0; b < num_batch_sizes; b++){
+			const int batch = batch_sizes[b];
+			grid_cpu::tuningConfig best; best.threads = 1; best.grain = 1; double best_us = -1;
+			for (int nthreads = 1; nthreads <= pool; nthreads = (nthreads < pool && 2*nthreads > pool) ? pool : 2*nthreads){
+				for (int grain = 1; grain == 1 || grain*nthreads <= batch; grain *= 2){
+					grid_cpu::tuningConfig config; config.threads = nthreads; config.grain = grain;
+					cache.force(&config);
+					target.run(hd_data, d_robotModel, gravity, batch);
+					const unsigned long long start = grid_cpu::monotonic_ns();
+					for (int rep = 0; rep < num_reps; rep++){target.run(hd_data, d_robotModel, gravity, batch);}
+					const double us = (grid_cpu::monotonic_ns() - start)*1e-3/num_reps;
+					if (best_us < 0 || us < best_us){best = config; best_us = us;}
+				}
+				if (nthreads >= batch || nthreads == pool){break;}
+			}
+			cache.force(nullptr);
+			cache.record(ROBOT_NAME, target.label, sizeof(T), batch, best, best_us);
+			printf("Tuned %s batch %d: threads %d grain %d %fus\n", target.label, batch, best.threads, best.grain, best_us);
+		}
+	}
+	free_gridData<T>(hd_data);
+	free_robotModel<T>(d_robotModel);
+	return cache.save(cache_path);
+}
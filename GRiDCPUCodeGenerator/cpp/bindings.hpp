@@ -0,0 +1,313 @@
+/**************************************************************************
+ *  Python bindings (pybind11) over the batched host API
+ *
+ *  A Workspace owns one gridData of fixed capacity, the robotModel and
+ *  (optionally) its own worker threads. Each HOST_API entry becomes a
+ *  method taking (N, width) arrays through the buffer protocol:
+ *
+ *      ws = grid_cpu.Workspace(256, gravity = 9.81)
+ *      qdd, df_du = ws.forward_dynamics_gradient(q, qd, u)
+ *      pending = ws.forward_dynamics_async(q, qd, u); ...; qdd = pending.wait()
+ *
+ *  Inputs are read in place through input views (the row stride may be
+ *  anything, e.g. column slices of one [q, qd, u] array, but every row
+ *  must be contiguous and of the workspace's dtype), so nothing is copied
+ *  but lam. Outputs are views of the workspace buffers in the gridData
+ *  per timestep layouts (matrices indexed [k, row, col]), valid until the
+ *  next call on the workspace overwrites them; .copy() what is kept. The
+ *  GIL is released while the batch runs. An _async call runs the batch
+ *  on the workspace's own thread and returns a Pending right away; the
+ *  input arrays must not change until it is done. A workspace runs one
+ *  batch at a time, use one per Python thread. Workspaces made with
+ *  num_threads 0 share the default pool, and a batch that finds the pool
+ *  busy with another workspace's batch waits for it, so Python threads
+ *  that need their batches to overlap give each workspace its own pool.
+ **************************************************************************/
+
+// Runs jobs one after another on a thread of its own (started on first use), tickets count them
+class pyAsyncWorker {
+public:
+	pyAsyncWorker() : launched(0), completed(0), shutdown(false){}
+
+	~pyAsyncWorker(){
+		{std::unique_lock<std::mutex> lock(mtx); shutdown = true;}
+		work_cv.notify_one();
+		if (worker.joinable()){worker.join();}
+	}
+
+	// Queues job after the one in flight (waiting for it to finish) and returns its ticket
+	unsigned long long launch(std::function<void()> job){
+		std::unique_lock<std::mutex> lock(mtx);
+		if (!worker.joinable()){worker = std::thread([this](){loop();});}
+		done_cv.wait(lock, [this](){return completed == launched;});
+		next = std::move(job);
+		const unsigned long long ticket = ++launched;
+		work_cv.notify_one();
+		return ticket;
+	}
+
+	bool done(const unsigned long long ticket){
+		std::unique_lock<std::mutex> lock(mtx);
+		return completed >= ticket;
+	}
+
+	void wait(const unsigned long long ticket){
+		std::unique_lock<std::mutex> lock(mtx);
+		done_cv.wait(lock, [this, ticket](){return completed >= ticket;});
+	}
+
+	void wait_idle(){
+		std::unique_lock<std::mutex> lock(mtx);
+		done_cv.wait(lock, [this](){return completed == launched;});
+	}
+
+private:
+	void loop(){
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true){
+			work_cv.wait(lock, [this](){return shutdown || completed < launched;});
+			if (completed == launched){return;} // shutdown with nothing queued
+			std::function<void()> job = std::move(next);
+			lock.unlock();
+			job();
+			lock.lock();
+			completed++;
+			done_cv.notify_all();
+		}
+	}
+
+	std::mutex mtx;
+	std::condition_variable work_cv;
+	std::condition_variable done_cv;
+	std::thread worker;
+	std::function<void()> next;
+	unsigned long long launched;
+	unsigned long long completed;
+	bool shutdown;
+
+	pyAsyncWorker(const pyAsyncWorker&) = delete;
+	pyAsyncWorker& operator=(const pyAsyncWorker&) = delete;
+};
+
+// Inputs a binding reads (PY_QDD is an optional u that holds qdd and selects USE_QDD_FLAG)
+enum pyInput {PY_Q = 1, PY_QD = 2, PY_U = 4, PY_QDD = 8, PY_LAMBDA = 16};
+
+// index of a gridBuffer bit in grid_buffer_info
+constexpr int buffer_index(const unsigned buffer, const int i = 0){return (buffer >> i) == 1u ? i : buffer_index(buffer, i + 1);}
+
+// One output of a binding: a gridData buffer viewed per timestep as dims of (extent, element stride)
+struct pyOutput {
+	const char *name;
+	int buffer;
+	int ndim;
+	int extent[4];
+	int stride[4];
+};
+
+// A HOST_API entry as bound (generated by GRiDCPUCodeGenerator.gen_python_bindings)
+template <typename T>
+struct pyEntry {
+	const char *name;
+	int inputs;
+	std::vector<pyOutput> outputs;
+	void (*run)(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int num_timesteps, hostThreads *threads,
+	            const bool qdd_given);
+};
+
+template <typename T>
+class pyWorkspace {
+public:
+	pyWorkspace(const int max_batch_, const T gravity_, const int num_threads) : max_batch(max_batch_), gravity(gravity_){
+		if (max_batch <= 0){throw py::value_error("max_batch must be positive");}
+		// the capacity never grows, so output views handed out earlier stay valid
+		hd_data = init_gridData<T>(max_batch);
+		d_robotModel = init_robotModel<T>();
+		threads = num_threads > 0 ? new hostThreads(num_threads) : nullptr; // nullptr runs on the default pool
+	}
+
+	~pyWorkspace(){
+		worker.wait_idle();
+		delete threads;
+		free_robotModel<T>(d_robotModel);
+		free_gridData<T>(hd_data);
+	}
+
+	const int max_batch;
+	T gravity;
+	gridData<T> *hd_data;
+	robotModel<T> *d_robotModel;
+	hostThreads *threads;
+	pyAsyncWorker worker;
+	std::mutex batch_mtx;  // held while a batch runs
+
+	pyWorkspace(const pyWorkspace&) = delete;
+	pyWorkspace& operator=(const pyWorkspace&) = delete;
+};
+
+// A batch launched by an _async call, holds the input buffers until it is done
+class pyPending {
+public:
+	pyPending(pyAsyncWorker *worker_, py::object owner_, py::object result_) : worker(worker_), ticket(0), owner(owner_), result(result_){}
+
+	~pyPending(){
+		if (ticket != 0){py::gil_scoped_release release; worker->wait(ticket);} // the batch still reads the inputs
+	}
+
+	bool done(){return worker->done(ticket);}
+
+	// Blocks (without the GIL) until the batch is done and returns its outputs
+	py::object wait(){
+		{py::gil_scoped_release release; worker->wait(ticket);}
+		inputs.clear();
+		return result;
+	}
+
+	pyAsyncWorker *worker;
+	unsigned long long ticket;
+	py::object owner;
+	py::object result;
+	std::vector<std::unique_ptr<py::buffer_info>> inputs;
+};
+
+inline std::string py_input_names(const int inputs){
+	std::string names = "q";
+	if (inputs & PY_QD){names += ", qd";}
+	if (inputs & PY_U){names += ", u";}
+	if (inputs & PY_QDD){names += ", u (qdd, optional)";}
+	if (inputs & PY_LAMBDA){names += ", lam";}
+	return names;
+}
+
+template <typename T>
+inline bool py_format_is(const std::string &format){
+	const std::string want = py::format_descriptor<T>::format();
+	return format == want || format == "<" + want || format == "=" + want || format == "@" + want;
+}
+
+/**
+ * Requests the buffer of a (num_timesteps, width) input (num_timesteps < 0 takes it from the array)
+ * Throws ValueError unless it has the workspace dtype and contiguous rows of width values.
+ */
+template <typename T>
+inline std::unique_ptr<py::buffer_info> py_input(const py::object &obj, const char *name, const int width, int &num_timesteps){
+	if (!py::isinstance<py::buffer>(obj)){throw py::type_error(std::string(name) + " must be an array");}
+	std::unique_ptr<py::buffer_info> info(new py::buffer_info(py::reinterpret_borrow<py::buffer>(obj).request()));
+	const std::string shape = "(N, " + std::to_string(width) + ")";
+	if (!py_format_is<T>(info->format) || info->ndim != 2 || info->shape[1] != width){
+		throw py::value_error(std::string(name) + " must be a " + (sizeof(T) == sizeof(double) ? "float64" : "float32") + " array of shape " + shape);
+	}
+	if ((info->strides[1] != static_cast<py::ssize_t>(sizeof(T)) && width > 1) || info->strides[0] % static_cast<py::ssize_t>(sizeof(T)) != 0){
+		throw py::value_error(std::string(name) + " must have contiguous rows (e.g., a C ordered array or a column slice of one)");
+	}
+	if (num_timesteps < 0){num_timesteps = static_cast<int>(info->shape[0]);}
+	else if (info->shape[0] != num_timesteps){throw py::value_error(std::string(name) + " must have as many rows as q");}
+	return info;
+}
+
+template <typename T>
+inline inputView<T> py_view(const std::unique_ptr<py::buffer_info> &info){
+	if (info == nullptr){return make_input_view<T>(nullptr, 0);}
+	return make_input_view<T>(static_cast<const T *>(info->ptr), static_cast<int>(info->strides[0]/static_cast<py::ssize_t>(sizeof(T))));
+}
+
+// View of one output for num_timesteps, based on the workspace object so it keeps the buffers alive
+template <typename T>
+inline py::array py_output(const pyOutput &out, const gridData<T> *hd_data, const int num_timesteps, const py::object &owner){
+	const gridBufferInfo<T> &info = grid_buffer_info<T>(out.buffer);
+	std::vector<py::ssize_t> shape(1, num_timesteps), strides(1, static_cast<py::ssize_t>(info.stride*sizeof(T)));
+	for (int d = 0; d < out.ndim; d++){shape.push_back(out.extent[d]); strides.push_back(static_cast<py::ssize_t>(out.stride[d]*sizeof(T)));}
+	return py::array(py::dtype::of<T>(), shape, strides, hd_data->*info.h, owner);
+}
+
+// The outputs of one call, a single array or a tuple in HOST_API buffer order
+template <typename T>
+inline py::object py_outputs(const pyEntry<T> &entry, const gridData<T> *hd_data, const int num_timesteps, const py::object &owner){
+	if (entry.outputs.size() == 1){return py_output<T>(entry.outputs[0], hd_data, num_timesteps, owner);}
+	py::tuple result(entry.outputs.size());
+	for (size_t o = 0; o < entry.outputs.size(); o++){result[o] = py_output<T>(entry.outputs[o], hd_data, num_timesteps, owner);}
+	return result;
+}
+
+/**
+ * One call of a binding: checks the inputs, makes sure the outputs exist, then runs the batch without the GIL
+ * (or launches it on the workspace's thread when async) and returns its outputs (or a Pending)
+ */
+template <typename T>
+py::object py_call(const pyEntry<T> &entry, py::object self, const py::object &q, const py::object &qd, const py::object &u,
+                   const py::object &lam, const bool async){
+	pyWorkspace<T> &ws = self.cast<pyWorkspace<T> &>();
+	if ((!qd.is_none() && !(entry.inputs & PY_QD)) || (!u.is_none() && !(entry.inputs & (PY_U | PY_QDD))) ||
+	    (!lam.is_none() && !(entry.inputs & PY_LAMBDA))){
+		throw py::value_error(std::string(entry.name) + " reads only " + py_input_names(entry.inputs));
+	}
+	int num_timesteps = -1;
+	std::vector<std::unique_ptr<py::buffer_info>> inputs(4);
+	inputs[0] = py_input<T>(q, "q", NUM_POS, num_timesteps);
+	if (entry.inputs & PY_QD){inputs[1] = py_input<T>(qd, "qd", NUM_VEL, num_timesteps);}
+	if ((entry.inputs & PY_U) || ((entry.inputs & PY_QDD) && !u.is_none())){inputs[2] = py_input<T>(u, "u", NUM_VEL, num_timesteps);}
+	if (entry.inputs & PY_LAMBDA){inputs[3] = py_input<T>(lam, "lam", NUM_VEL, num_timesteps);}
+	if (num_timesteps <= 0 || num_timesteps > ws.max_batch){
+		throw py::value_error("batch of " + std::to_string(num_timesteps) + " timesteps, the workspace holds 1 to " + std::to_string(ws.max_batch));
+	}
+	{py::gil_scoped_release release; ws.worker.wait_idle();} // an earlier _async batch may still use the buffers
+	unsigned buffers = 0;
+	for (const pyOutput &out : entry.outputs){buffers |= 1u << out.buffer;}
+	reserve_gridData<T>(ws.hd_data, num_timesteps, buffers);
+	py::object result = py_outputs<T>(entry, ws.hd_data, num_timesteps, self);
+	const inputView<T> q_view = py_view<T>(inputs[0]), qd_view = py_view<T>(inputs[1]), u_view = py_view<T>(inputs[2]);
+	const inputView<T> lam_view = py_view<T>(inputs[3]);
+	const bool qdd_given = (entry.inputs & PY_QDD) && inputs[2] != nullptr;
+	pyWorkspace<T> *wsp = &ws; const pyEntry<T> *ep = &entry; const T gravity = ws.gravity;
+	auto batch = [wsp, ep, gravity, num_timesteps, q_view, qd_view, u_view, lam_view, qdd_given](){
+		std::lock_guard<std::mutex> lock(wsp->batch_mtx);
+		if (lam_view.ptr != nullptr){ // the contracted second order kernels read lambda from gridData
+			for (int k = 0; k < num_timesteps; k++){memcpy(&wsp->hd_data->h_lambda[k*NUM_VEL], lam_view.at(k), NUM_VEL*sizeof(T));}
+		}
+		use_input_views<T>(wsp->hd_data, q_view, qd_view, u_view);
+		ep->run(wsp->hd_data, wsp->d_robotModel, gravity, num_timesteps, wsp->threads, qdd_given);
+	};
+	if (!async){
+		py::gil_scoped_release release;
+		batch();
+		return result;
+	}
+	std::unique_ptr<pyPending> pending(new pyPending(&ws.worker, self, result));
+	for (std::unique_ptr<py::buffer_info> &info : inputs){if (info != nullptr){pending->inputs.push_back(std::move(info));}}
+	{py::gil_scoped_release release; pending->ticket = ws.worker.launch(batch);}
+	return py::cast(pending.release(), py::return_value_policy::take_ownership);
+}
+
+// Model constants, the tuning cache and Pending (shared by both precisions)
+inline void bind_module(py::module_ &m){
+	m.attr("ROBOT_NAME") = ROBOT_NAME;
+	m.attr("FLOATING_BASE") = FLOATING_BASE;
+	m.attr("NUM_JOINTS") = NUM_JOINTS;
+	m.attr("NUM_POS") = NUM_POS;
+	m.attr("NUM_VEL") = NUM_VEL;
+	m.attr("NUM_EES") = NUM_EES;
+	m.def("load_tuning_cache", [](const std::string &path){return grid_cpu::tuning_cache().load(path.c_str());}, py::arg("path"),
+	      "Adds the entries of an autotune cache file to the process wide tuning cache");
+	py::class_<pyPending>(m, "Pending", "A batch launched by an _async call")
+		.def("done", &pyPending::done, "True once the batch has finished")
+		.def("wait", &pyPending::wait, "Waits for the batch and returns its outputs");
+}
+
+// Workspace class of one precision with a method and an _async method per entry
+template <typename T>
+void bind_workspace(py::module_ &m, const char *class_name, const std::vector<pyEntry<T>> &entries){
+	py::class_<pyWorkspace<T>> cls(m, class_name);
+	cls.def(py::init<int, T, int>(), py::arg("max_batch"), py::arg("gravity") = static_cast<T>(9.81), py::arg("num_threads") = 0,
+	        "Preallocated batch of up to max_batch timesteps (num_threads 0 shares the default pool, where the batches of "
+	        "workspaces used from several threads take turns, else the workspace owns a pool)");
+	cls.def_readonly("max_batch", &pyWorkspace<T>::max_batch);
+	cls.def_readwrite("gravity", &pyWorkspace<T>::gravity);
+	cls.def("wait", [](pyWorkspace<T> &ws){py::gil_scoped_release release; ws.worker.wait_idle();}, "Waits for the batch in flight");
+	for (const pyEntry<T> &entry : entries){
+		for (int async = 0; async < 2; async++){
+			const std::string name = std::string(entry.name) + (async ? "_async" : "");
+			cls.def(name.c_str(), [entry, async](py::object self, py::object q, py::object qd, py::object u, py::object lam){
+				return py_call<T>(entry, self, q, qd, u, lam, async != 0);
+			}, py::arg("q"), py::arg("qd") = py::none(), py::arg("u") = py::none(), py::arg("lam") = py::none());
+		}
+	}
+}
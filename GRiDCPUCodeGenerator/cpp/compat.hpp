@@ -0,0 +1,57 @@
+/**************************************************************************
+ *  CUDA compatibility shims
+ *
+ *  Lets code written against grid.cuh (timeGRiD.cu, the TestGRiD drivers) compile
+ *  unchanged as plain C++ against grid_cpu.hpp. Host and "device" buffers
+ *  alias each other on the CPU backend so every copy below is a no-op
+ *  unless the caller passes two distinct buffers.
+ **************************************************************************/
+#ifndef GRID_CPU_COMPAT_HPP
+#define GRID_CPU_COMPAT_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <type_traits>
+
+#ifndef __CUDACC__
+	#define __host__
+	#define __device__
+	#define __global__
+
+	struct dim3 {
+		unsigned x, y, z;
+		dim3(unsigned x_ = 1, unsigned y_ = 1, unsigned z_ = 1) : x(x_), y(y_), z(z_) {}
+	};
+
+	enum cudaError_t {cudaSuccess = 0};
+	enum cudaMemcpyKind {cudaMemcpyHostToHost = 0, cudaMemcpyHostToDevice = 1, cudaMemcpyDeviceToHost = 2, cudaMemcpyDeviceToDevice = 3};
+
+	inline cudaError_t cudaMemcpy(void *dst, const void *src, size_t count, cudaMemcpyKind kind){
+		(void)kind; if (dst != src){std::memmove(dst,src,count);} return cudaSuccess;
+	}
+	inline cudaError_t cudaDeviceSynchronize(){return cudaSuccess;}
+	#define gpuErrchk(ans) (ans)
+#endif
+
+#ifndef time_delta_us_timespec
+	#define time_delta_us_timespec(start,end) (1e6*static_cast<double>(end.tv_sec - start.tv_sec)+1e-3*static_cast<double>(end.tv_nsec - start.tv_nsec))
+#endif
+
+template <typename T, int M, int N>
+__host__ __device__
+void printMat(T *A, int lda){
+	for(int i=0; i<M; i++){
+		for(int j=0; j<N; j++){printf("%.4f ",static_cast<double>(A[i + lda*j]));}
+		printf("\n");
+	}
+}
+
+#endif
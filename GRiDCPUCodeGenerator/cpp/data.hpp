@@ -0,0 +1,439 @@
+/**************************************************************************
+ *  Model and batch data
+ *
+ *  robotModel and gridData keep the field names and per-timestep layouts of
+ *  grid.cuh. On the CPU every d_ pointer aliases its h_ twin so existing
+ *  cudaMemcpy calls in user code become no-ops.
+ *
+ *  gridData holds max_timesteps timesteps (set at runtime and grown with
+ *  resize_gridData) in one aligned arena. The inputs are allocated up front;
+ *  each output is carved from the arena the first time an algorithm that
+ *  writes it runs, so the footprint follows the algorithms actually called.
+ **************************************************************************/
+
+// Strides of the three input packings (per timestep, q is NUM_POS long as it also holds a floating base pose)
+const int Q_QD_U_STRIDE = NUM_POS + 2*NUM_VEL;
+const int Q_QD_STRIDE = NUM_POS + NUM_VEL;
+const int Q_STRIDE = NUM_POS;
+// Values per timestep of a symmetric NUM_VEL x NUM_VEL matrix kept as its packed upper triangle
+const int SYM_PACKED_SIZE = NUM_VEL*(NUM_VEL + 1)/2;
+// Values per timestep of the second order outputs, dense and symmetry packed (see second_order.hpp)
+const int SO_SYM_SIZE = NUM_VEL*(NUM_VEL + 1)/2;
+const int SO_PACKED_SIZE = 3*NUM_VEL*SO_SYM_SIZE + NUM_VEL*NUM_VEL*NUM_VEL;
+const int SO_DENSE_SIZE = 4*NUM_VEL*NUM_VEL*NUM_VEL;
+
+template <typename T>
+struct robotModel {
+	T *d_XImats;              // NUM_JOINTS Xtree then NUM_JOINTS spatial inertias (6x6 column-major)
+	int *d_topology_helpers;  // parent ids
+};
+
+// Per timestep joint transforms keyed on the configuration they were built at (see enable_kinematics_cache)
+template <typename T>
+struct kinematicsCache {
+	T *X;                      // 36*NUM_JOINTS per timestep
+	T *q;                      // NUM_JOINTS per timestep
+	unsigned long long *key;   // fingerprint of q per timestep (0 is empty)
+	int num_timesteps;
+	std::atomic<unsigned long long> hits;
+	std::atomic<unsigned long long> misses;
+};
+
+// FNV-1a over the bytes of q (never 0 so an empty slot cannot match)
+template <typename T>
+inline unsigned long long kinematics_fingerprint(const T *s_q){
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(s_q);
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < NUM_JOINTS*sizeof(T); i++){hash = (hash ^ bytes[i]) * 1099511628211ULL;}
+	return hash == 0 ? 1 : hash;
+}
+
+/**
+ * Optional external (e.g., contact) wrenches per timestep (see enable_contacts). Contact c of timestep k acts on
+ * the link of joint body[k*max_contacts + c] (-1 is a floating base) with the wrench [moment about the origin; force]
+ * wrench[6*(k*max_contacts + c)] expressed in the world frame.
+ */
+template <typename T>
+struct contactList {
+	int *count;       // contacts of each timestep
+	int *body;        // max_contacts per timestep
+	T *wrench;        // 6*max_contacts per timestep
+	T *base_wrench;   // 6*max_contacts per timestep, the wrenches in the floating base frame (nullptr for a fixed base)
+	int max_contacts;
+	int num_timesteps;
+};
+
+// The contacts of one timestep as read by the algorithms (count is 0 when contacts are disabled)
+template <typename T>
+struct timestepContacts {int count; const int *body; const T *wrench;};
+
+// Strided view of one caller owned input: element i of timestep k is ptr[offset + k*stride + i]
+template <typename T>
+struct inputView {
+	const T *ptr;
+	int stride;
+	int offset;
+	const T *at(const int k) const {return ptr == nullptr ? nullptr : &ptr[offset + k*stride];}
+};
+
+template <typename T>
+inline inputView<T> make_input_view(const T *ptr, const int stride, const int offset = 0){
+	inputView<T> view; view.ptr = ptr; view.stride = stride; view.offset = offset; return view;
+}
+
+// Where the algorithms read q, qd and u (see use_packed_inputs and use_input_views)
+enum inputMode {INPUTS_GRID = 0, INPUTS_PACKED, INPUTS_VIEWS};
+// Which grid.cuh input buffer an algorithm reads in INPUTS_GRID mode
+enum inputPacking {PACKING_Q_QD_U = 0, PACKING_Q_QD, PACKING_Q};
+
+template <typename T>
+struct gridData {
+	// GPU INPUTS (alias the CPU inputs)
+	T *d_q_qd_u;
+	T *d_q_qd;
+	T *d_q;
+	// CPU INPUTS
+	T *h_q_qd_u;
+	T *h_q_qd;
+	T *h_q;
+	T *d_lambda;  // costate per timestep for the contracted second order outputs
+	T *h_lambda;
+	// GPU OUTPUTS (alias the CPU outputs)
+	T *d_c;
+	T *d_Minv;
+	T *d_qdd;
+	T *d_dc_du;
+	T *d_df_du;
+	T *d_dc_du_sparse;
+	T *d_df_du_sparse;
+	T *d_eePos;
+	T *d_deePos;
+	T *d_M;
+	T *d_idsva_so;
+	T *d_df2;
+	T *d_idsva_so_contracted;
+	T *d_df2_contracted;
+	T *d_eeJacobian;
+	T *d_eeJdqd;
+	T *d_Minv_packed;
+	T *d_M_packed;
+	T *d_idsva_so_packed;
+	T *d_df2_packed;
+	// CPU OUTPUTS
+	T *h_c;
+	T *h_Minv;
+	T *h_qdd;
+	T *h_dc_du;
+	T *h_df_du;
+	T *h_dc_du_sparse;  // [dq | dqd] values of the DC_DU_* index map, 2*DC_DU_NNZ per timestep
+	T *h_df_du_sparse;  // [dq | dqd] values of the DF_DU_* index map, 2*DF_DU_NNZ per timestep
+	T *h_eePos;
+	T *h_deePos;
+	T *h_M;
+	T *h_idsva_so;
+	T *h_df2;
+	T *h_idsva_so_contracted;  // 4*NUM_VEL*NUM_VEL per timestep
+	T *h_df2_contracted;       // 4*NUM_VEL*NUM_VEL per timestep
+	T *h_eeJacobian;           // 6 x NUM_VEL column-major per end effector, 6*NUM_EES*NUM_VEL per timestep
+	T *h_eeJdqd;               // 6*NUM_EES per timestep
+	T *h_Minv_packed;          // upper triangle in packed storage, SYM_PACKED_SIZE per timestep
+	T *h_M_packed;             // upper triangle in packed storage, SYM_PACKED_SIZE per timestep
+	T *h_idsva_so_packed;      // symmetry packed idsva_so, SO_PACKED_SIZE per timestep
+	T *h_df2_packed;           // symmetry packed df2, SO_PACKED_SIZE per timestep
+	// INPUT SOURCE (INPUTS_GRID reads h_q_qd_u / h_q_qd / h_q like grid.cuh)
+	int input_mode;
+	inputView<T> q_view;
+	inputView<T> qd_view;
+	inputView<T> u_view;
+	// OPTIONAL KINEMATICS CACHE (nullptr unless enabled)
+	kinematicsCache<T> *kinematics_cache;
+	// OPTIONAL EXTERNAL WRENCHES (nullptr unless enabled)
+	contactList<T> *contacts;
+	// STORAGE
+	int max_timesteps;       // capacity of every allocated buffer
+	unsigned allocated;      // gridBuffer bits whose buffers exist
+	grid_cpu::arena *arena;
+};
+
+// Buffers of gridData as bits (the inputs are always allocated, outputs on first use)
+enum gridBuffer {BUFFER_Q_QD_U = 1u << 0, BUFFER_Q_QD = 1u << 1, BUFFER_Q = 1u << 2, BUFFER_LAMBDA = 1u << 3,
+                 BUFFER_C = 1u << 4, BUFFER_MINV = 1u << 5, BUFFER_QDD = 1u << 6, BUFFER_DC_DU = 1u << 7, BUFFER_DF_DU = 1u << 8,
+                 BUFFER_DC_DU_SPARSE = 1u << 9, BUFFER_DF_DU_SPARSE = 1u << 10, BUFFER_EEPOS = 1u << 11, BUFFER_DEEPOS = 1u << 12,
+                 BUFFER_M = 1u << 13, BUFFER_IDSVA_SO = 1u << 14, BUFFER_DF2 = 1u << 15,
+                 BUFFER_IDSVA_SO_CONTRACTED = 1u << 16, BUFFER_DF2_CONTRACTED = 1u << 17,
+                 BUFFER_EE_JACOBIAN = 1u << 18, BUFFER_EE_JDQD = 1u << 19,
+                 BUFFER_MINV_PACKED = 1u << 20, BUFFER_M_PACKED = 1u << 21,
+                 BUFFER_IDSVA_SO_PACKED = 1u << 22, BUFFER_DF2_PACKED = 1u << 23};
+const int NUM_GRID_BUFFERS = 24;
+const unsigned BUFFER_INPUTS = BUFFER_Q_QD_U | BUFFER_Q_QD | BUFFER_Q | BUFFER_LAMBDA;
+const unsigned BUFFER_ALL = (1u << NUM_GRID_BUFFERS) - 1;
+
+template <typename T>
+struct gridBufferInfo {
+	T *gridData<T>::*h;
+	T *gridData<T>::*d;
+	int stride;  // T per timestep
+};
+
+template <typename T>
+inline const gridBufferInfo<T> &grid_buffer_info(const int i){
+	typedef gridData<T> D;
+	static const gridBufferInfo<T> table[NUM_GRID_BUFFERS] = {
+		{&D::h_q_qd_u, &D::d_q_qd_u, Q_QD_U_STRIDE}, {&D::h_q_qd, &D::d_q_qd, Q_QD_STRIDE}, {&D::h_q, &D::d_q, Q_STRIDE},
+		{&D::h_lambda, &D::d_lambda, NUM_VEL},
+		{&D::h_c, &D::d_c, NUM_VEL}, {&D::h_Minv, &D::d_Minv, NUM_VEL*NUM_VEL}, {&D::h_qdd, &D::d_qdd, NUM_VEL},
+		{&D::h_dc_du, &D::d_dc_du, 2*NUM_VEL*NUM_VEL}, {&D::h_df_du, &D::d_df_du, 2*NUM_VEL*NUM_VEL},
+		{&D::h_dc_du_sparse, &D::d_dc_du_sparse, 2*DC_DU_NNZ}, {&D::h_df_du_sparse, &D::d_df_du_sparse, 2*DF_DU_NNZ},
+		{&D::h_eePos, &D::d_eePos, 6*NUM_EES}, {&D::h_deePos, &D::d_deePos, 6*NUM_EES*NUM_JOINTS}, {&D::h_M, &D::d_M, NUM_VEL*NUM_VEL},
+		{&D::h_idsva_so, &D::d_idsva_so, SO_DENSE_SIZE}, {&D::h_df2, &D::d_df2, SO_DENSE_SIZE},
+		{&D::h_idsva_so_contracted, &D::d_idsva_so_contracted, 4*NUM_VEL*NUM_VEL}, {&D::h_df2_contracted, &D::d_df2_contracted, 4*NUM_VEL*NUM_VEL},
+		{&D::h_eeJacobian, &D::d_eeJacobian, 6*NUM_EES*NUM_VEL}, {&D::h_eeJdqd, &D::d_eeJdqd, 6*NUM_EES},
+		{&D::h_Minv_packed, &D::d_Minv_packed, SYM_PACKED_SIZE}, {&D::h_M_packed, &D::d_M_packed, SYM_PACKED_SIZE},
+		{&D::h_idsva_so_packed, &D::d_idsva_so_packed, SO_PACKED_SIZE}, {&D::h_df2_packed, &D::d_df2_packed, SO_PACKED_SIZE},
+	};
+	return table[i];
+}
+
+template <typename T>
+inline size_t grid_buffer_bytes(const int i, const int num_timesteps){
+	return grid_cpu::round_up(static_cast<size_t>(grid_buffer_info<T>(i).stride)*num_timesteps*sizeof(T), grid_cpu::ARENA_ALIGN);
+}
+
+template <typename T>
+__host__
+hostThreads *init_grid(int num_threads = SUGGESTED_THREADS){
+	// another model may still run on the pool an earlier init_grid returned, so pools are shared, never replaced
+	hostThreads *threads = grid_cpu::shared_threads(num_threads);
+	grid_cpu::default_threads_ptr().store(threads);
+	return threads;
+}
+
+template <typename T>
+__host__
+robotModel<T> *init_robotModel(){
+	robotModel<T> *h_robotModel = new robotModel<T>;
+	h_robotModel->d_XImats = new T[72*NUM_JOINTS];
+	for (int i = 0; i < 72*NUM_JOINTS; i++){h_robotModel->d_XImats[i] = static_cast<T>(XIMATS[i]);}
+	h_robotModel->d_topology_helpers = new int[NUM_JOINTS];
+	for (int i = 0; i < NUM_JOINTS; i++){h_robotModel->d_topology_helpers[i] = PARENT_IDS[i];}
+	return h_robotModel;
+}
+
+/**
+ * Grows the capacity to max_timesteps (never shrinks). Every allocated buffer moves
+ * into one new arena with its first (old capacity) timesteps preserved, so pointers
+ * taken from hd_data before the call are invalid after it.
+ */
+template <typename T>
+__host__
+void resize_gridData(gridData<T> *hd_data, const int max_timesteps){
+	if (max_timesteps <= hd_data->max_timesteps){return;}
+	size_t bytes = 0;
+	for (int i = 0; i < NUM_GRID_BUFFERS; i++){if (hd_data->allocated & (1u << i)){bytes += grid_buffer_bytes<T>(i, max_timesteps);}}
+	grid_cpu::arena *arena = new grid_cpu::arena(bytes);
+	for (int i = 0; i < NUM_GRID_BUFFERS; i++){
+		if (!(hd_data->allocated & (1u << i))){continue;}
+		const gridBufferInfo<T> &info = grid_buffer_info<T>(i);
+		T *buf = static_cast<T *>(arena->allocate(grid_buffer_bytes<T>(i, max_timesteps)));
+		std::memcpy(buf, hd_data->*info.h, static_cast<size_t>(info.stride)*hd_data->max_timesteps*sizeof(T));
+		hd_data->*info.h = buf; hd_data->*info.d = buf;
+	}
+	delete hd_data->arena;
+	hd_data->arena = arena; hd_data->max_timesteps = max_timesteps;
+}
+
+/**
+ * Makes sure the given buffers exist and hold at least num_timesteps timesteps
+ * (called by every ALGORITHM wrapper for its outputs). New buffers are zeroed.
+ */
+template <typename T>
+__host__
+void reserve_gridData(gridData<T> *hd_data, const int num_timesteps, const unsigned buffers){
+	if (num_timesteps > hd_data->max_timesteps){resize_gridData<T>(hd_data, num_timesteps);}
+	const unsigned missing = buffers & ~hd_data->allocated;
+	if (missing == 0){return;}
+	for (int i = 0; i < NUM_GRID_BUFFERS; i++){
+		if (!(missing & (1u << i))){continue;}
+		const gridBufferInfo<T> &info = grid_buffer_info<T>(i);
+		T *buf = static_cast<T *>(hd_data->arena->allocate(grid_buffer_bytes<T>(i, hd_data->max_timesteps)));
+		hd_data->*info.h = buf; hd_data->*info.d = buf; // the "device" buffers are the same memory
+	}
+	hd_data->allocated |= missing;
+}
+
+/**
+ * Allocates gridData for up to max_timesteps timesteps
+ * @param buffers are the outputs (gridBuffer bits) to allocate now rather than on first use
+ */
+template <typename T>
+__host__
+gridData<T> *init_gridData(const int max_timesteps, const unsigned buffers = BUFFER_INPUTS){
+	gridData<T> *hd_data = new gridData<T>;
+	for (int i = 0; i < NUM_GRID_BUFFERS; i++){hd_data->*grid_buffer_info<T>(i).h = nullptr; hd_data->*grid_buffer_info<T>(i).d = nullptr;}
+	hd_data->kinematics_cache = nullptr;
+	hd_data->contacts = nullptr;
+	hd_data->input_mode = INPUTS_GRID;
+	hd_data->q_view = hd_data->qd_view = hd_data->u_view = make_input_view<T>(nullptr, 0);
+	hd_data->max_timesteps = max_timesteps > 0 ? max_timesteps : 1;
+	hd_data->allocated = 0;
+	size_t bytes = 0;
+	for (int i = 0; i < NUM_GRID_BUFFERS; i++){if ((buffers | BUFFER_INPUTS) & (1u << i)){bytes += grid_buffer_bytes<T>(i, hd_data->max_timesteps);}}
+	hd_data->arena = new grid_cpu::arena(bytes);
+	reserve_gridData<T>(hd_data, hd_data->max_timesteps, buffers | BUFFER_INPUTS);
+	return hd_data;
+}
+
+template <typename T, int NUM_TIMESTEPS>
+__host__
+gridData<T> *init_gridData(){return init_gridData<T>(NUM_TIMESTEPS);}
+
+/**
+ * Every algorithm reads its inputs from h_q_qd_u, including the USE_COMPRESSED_MEM variants
+ * that would otherwise read h_q_qd or h_q, so the inputs are written (and copied) once
+ */
+template <typename T>
+__host__
+void use_packed_inputs(gridData<T> *hd_data){hd_data->input_mode = INPUTS_PACKED;}
+
+/**
+ * Reads the inputs straight from caller owned buffers (e.g., a solver's state and control
+ * trajectories) without repacking. Views must cover every timestep of later calls, u may be
+ * left empty for algorithms that do not read it, and with USE_QDD_FLAG u holds qdd.
+ * The buffers must outlive every call made before use_grid_inputs.
+ */
+template <typename T>
+__host__
+void use_input_views(gridData<T> *hd_data, const inputView<T> q, const inputView<T> qd, const inputView<T> u = make_input_view<T>(nullptr, 0)){
+	hd_data->q_view = q; hd_data->qd_view = qd; hd_data->u_view = u;
+	hd_data->input_mode = INPUTS_VIEWS;
+}
+
+// Back to the grid.cuh input buffers
+template <typename T>
+__host__
+void use_grid_inputs(gridData<T> *hd_data){hd_data->input_mode = INPUTS_GRID;}
+
+// bytes currently reserved for the batch buffers (not counting the kinematics cache)
+template <typename T>
+__host__
+size_t gridData_bytes(const gridData<T> *hd_data){return hd_data->arena->bytes_reserved();}
+
+/**
+ * Keeps the joint transforms of every timestep in hd_data so later calls at an unchanged q (e.g., Minv and
+ * then gradients, or a line search over qd / u) skip the position pass. A timestep is rebuilt whenever its
+ * q differs bitwise; call invalidate_kinematics_cache after changing the robotModel.
+ */
+template <typename T>
+__host__
+void enable_kinematics_cache(gridData<T> *hd_data, int num_timesteps = 0){
+	if (hd_data->kinematics_cache != nullptr){return;}
+	if (num_timesteps <= 0){num_timesteps = hd_data->max_timesteps;} // timesteps past the cache are simply not cached
+	kinematicsCache<T> *cache = new kinematicsCache<T>;
+	cache->X = new T[36*NUM_JOINTS*num_timesteps]; cache->q = new T[NUM_JOINTS*num_timesteps];
+	cache->key = new unsigned long long[num_timesteps]();
+	cache->num_timesteps = num_timesteps; cache->hits = 0; cache->misses = 0;
+	hd_data->kinematics_cache = cache;
+}
+
+template <typename T, int NUM_TIMESTEPS>
+__host__
+void enable_kinematics_cache(gridData<T> *hd_data){enable_kinematics_cache<T>(hd_data, NUM_TIMESTEPS);}
+
+template <typename T>
+__host__
+void invalidate_kinematics_cache(gridData<T> *hd_data){
+	kinematicsCache<T> *cache = hd_data->kinematics_cache;
+	if (cache != nullptr){for (int k = 0; k < cache->num_timesteps; k++){cache->key[k] = 0;}}
+}
+
+template <typename T>
+__host__
+void disable_kinematics_cache(gridData<T> *hd_data){
+	kinematicsCache<T> *cache = hd_data->kinematics_cache;
+	if (cache == nullptr){return;}
+	delete[] cache->X; delete[] cache->q; delete[] cache->key; delete cache;
+	hd_data->kinematics_cache = nullptr;
+}
+
+// hit / miss counts (per timestep lookup) since the cache was enabled or the counters were reset
+template <typename T>
+__host__
+void kinematics_cache_stats(const gridData<T> *hd_data, unsigned long long *hits, unsigned long long *misses, const bool reset = false){
+	kinematicsCache<T> *cache = hd_data->kinematics_cache;
+	*hits = cache == nullptr ? 0 : (reset ? cache->hits.exchange(0) : cache->hits.load());
+	*misses = cache == nullptr ? 0 : (reset ? cache->misses.exchange(0) : cache->misses.load());
+}
+
+/**
+ * Lets inverse_dynamics, forward_dynamics, aba, dynamics_bundle and the first order gradients apply up to
+ * max_contacts external wrenches per timestep (see contactList). The wrenches enter the same RNEA / ABA
+ * pass and their dependence on q is part of dc_du and df_du. Every timestep starts with no contacts.
+ */
+template <typename T>
+__host__
+void enable_contacts(gridData<T> *hd_data, const int max_contacts = NUM_EES, int num_timesteps = 0){
+	if (hd_data->contacts != nullptr){return;}
+	if (num_timesteps <= 0){num_timesteps = hd_data->max_timesteps;} // timesteps past the list have no contacts
+	contactList<T> *contacts = new contactList<T>;
+	contacts->max_contacts = max_contacts > 0 ? max_contacts : 1; contacts->num_timesteps = num_timesteps;
+	contacts->count = new int[num_timesteps]();
+	contacts->body = new int[contacts->max_contacts*num_timesteps];
+	contacts->wrench = new T[6*contacts->max_contacts*num_timesteps];
+	contacts->base_wrench = NUM_VEL > NUM_JOINTS ? new T[6*contacts->max_contacts*num_timesteps] : nullptr;
+	hd_data->contacts = contacts;
+}
+
+// Appends a world frame wrench on the link of joint body to timestep k (false if it does not fit)
+template <typename T>
+__host__
+bool add_contact(gridData<T> *hd_data, const int k, const int body, const T *wrench){
+	contactList<T> *contacts = hd_data->contacts;
+	if (contacts == nullptr || k < 0 || k >= contacts->num_timesteps || body < -1 || body >= NUM_JOINTS){
+		printf("[!Error] add_contact needs enable_contacts, a timestep in range and a valid body id\n"); return false;
+	}
+	if (contacts->count[k] >= contacts->max_contacts){printf("[!Error] timestep %d already has max_contacts contacts\n", k); return false;}
+	const int c = k*contacts->max_contacts + contacts->count[k]++;
+	contacts->body[c] = body;
+	for (int r = 0; r < 6; r++){contacts->wrench[6*c + r] = wrench[r];}
+	return true;
+}
+
+// Removes the contacts of every timestep
+template <typename T>
+__host__
+void clear_contacts(gridData<T> *hd_data){
+	contactList<T> *contacts = hd_data->contacts;
+	if (contacts != nullptr){for (int k = 0; k < contacts->num_timesteps; k++){contacts->count[k] = 0;}}
+}
+
+template <typename T>
+__host__
+void disable_contacts(gridData<T> *hd_data){
+	contactList<T> *contacts = hd_data->contacts;
+	if (contacts == nullptr){return;}
+	delete[] contacts->count; delete[] contacts->body; delete[] contacts->wrench; delete[] contacts->base_wrench; delete contacts;
+	hd_data->contacts = nullptr;
+}
+
+template <typename T>
+__host__
+void free_robotModel(robotModel<T> *d_robotModel){
+	delete[] d_robotModel->d_XImats; delete[] d_robotModel->d_topology_helpers; delete d_robotModel;
+}
+
+template <typename T>
+__host__
+void free_gridData(gridData<T> *hd_data){
+	disable_kinematics_cache<T>(hd_data);
+	disable_contacts<T>(hd_data);
+	delete hd_data->arena;
+	delete hd_data;
+}
+
+template <typename T>
+__host__
+void close_grid(hostThreads *threads, robotModel<T> *d_robotModel, gridData<T> *hd_data){
+	(void)threads; // the pool is shared by every model and lives for the whole process
+	free_robotModel<T>(d_robotModel);
+	free_gridData<T>(hd_data);
+}
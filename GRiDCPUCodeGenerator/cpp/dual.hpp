@@ -0,0 +1,51 @@
+/**************************************************************************
+ *  Forward-mode dual numbers
+ *
+ *  The templated algorithms below are instantiated on dual<T> to get exact
+ *  directional derivatives of the analytical gradients (second order terms)
+ *  and of the end effector poses without any finite differencing.
+ **************************************************************************/
+#ifndef GRID_CPU_DUAL_HPP
+#define GRID_CPU_DUAL_HPP
+
+namespace grid_cpu {
+
+template <typename T>
+struct dual {
+	T val; T der;
+	dual() : val(0), der(0) {}
+	dual(const T v) : val(v), der(0) {}
+	dual(const T v, const T d) : val(v), der(d) {}
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value && !std::is_same<U,T>::value>::type>
+	dual(const U v) : val(static_cast<T>(v)), der(0) {}
+	dual &operator+=(const dual &b){val += b.val; der += b.der; return *this;}
+	dual &operator-=(const dual &b){val -= b.val; der -= b.der; return *this;}
+	dual &operator*=(const dual &b){der = der*b.val + val*b.der; val *= b.val; return *this;}
+	dual &operator/=(const dual &b){der = (der*b.val - val*b.der)/(b.val*b.val); val /= b.val; return *this;}
+	explicit operator T() const {return val;}
+};
+
+template <typename T> inline dual<T> operator+(dual<T> a, const dual<T> &b){return a += b;}
+template <typename T> inline dual<T> operator-(dual<T> a, const dual<T> &b){return a -= b;}
+template <typename T> inline dual<T> operator*(dual<T> a, const dual<T> &b){return a *= b;}
+template <typename T> inline dual<T> operator/(dual<T> a, const dual<T> &b){return a /= b;}
+template <typename T> inline dual<T> operator-(const dual<T> &a){return dual<T>(-a.val,-a.der);}
+template <typename T> inline bool operator<(const dual<T> &a, const dual<T> &b){return a.val < b.val;}
+template <typename T> inline bool operator>(const dual<T> &a, const dual<T> &b){return a.val > b.val;}
+
+template <typename T> inline dual<T> sin(const dual<T> &a){return dual<T>(std::sin(a.val), std::cos(a.val)*a.der);}
+template <typename T> inline dual<T> cos(const dual<T> &a){return dual<T>(std::cos(a.val), -std::sin(a.val)*a.der);}
+template <typename T> inline dual<T> sqrt(const dual<T> &a){T s = std::sqrt(a.val); return dual<T>(s, s > 0 ? a.der/(2*s) : 0);}
+template <typename T> inline dual<T> atan2(const dual<T> &y, const dual<T> &x){
+	T den = x.val*x.val + y.val*y.val;
+	return dual<T>(std::atan2(y.val,x.val), den > 0 ? (x.val*y.der - y.val*x.der)/den : 0);
+}
+
+// value / derivative access that also works on plain scalars
+template <typename T> inline T value_of(const T &a){return a;}
+template <typename T> inline T value_of(const dual<T> &a){return a.val;}
+template <typename T> inline T derivative_of(const dual<T> &a){return a.der;}
+
+} // namespace grid_cpu
+
+#endif
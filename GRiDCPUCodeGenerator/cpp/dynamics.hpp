@@ -0,0 +1,856 @@
+/**************************************************************************
+ *  Single timestep algorithms (the CPU analogue of ALGORITHM_inner)
+ *
+ *  Inputs and outputs use the per-timestep layouts of grid.cuh: vectors
+ *  are NUM_VEL long and matrices are NUM_VEL x NUM_VEL column-major. Joint
+ *  ids are topologically ordered (PARENT_IDS[i] < i), with -1 marking a
+ *  joint attached to the fixed base. The model arrays are compile time
+ *  constants so the compiler fully unrolls the topology.
+ **************************************************************************/
+
+// Structural sparsity of the joint space matrices: M and dc_du are zero between
+// joints that are not ancestor / descendant, Minv and df_du between separate trees
+inline bool joints_related(const int i, const int j){return IS_ANCESTOR[i + NUM_JOINTS*j] || IS_ANCESTOR[j + NUM_JOINTS*i];}
+inline bool joints_same_tree(const int i, const int j){return ROOT_IDS[i] == ROOT_IDS[j];}
+
+template <typename T>
+inline T S_dot(const int jid, const T *f){
+	const double *S = &S_VECTORS[6*jid]; T val = static_cast<T>(0);
+	for (int r = 0; r < 6; r++){if (S[r] != 0.0){val += static_cast<T>(S[r]) * f[r];}}
+	return val;
+}
+
+template <typename T>
+inline void S_vec(T *out, const int jid, const T scale){
+	const double *S = &S_VECTORS[6*jid];
+	for (int r = 0; r < 6; r++){out[r] = static_cast<T>(S[r]) * scale;}
+}
+
+template <typename T>
+inline void X_a_parent(T *out, const int jid, const T *s_X, const T *s_a, const T gravity){
+	// the fixed base accelerates upwards to model gravity
+	const int parent = PARENT_IDS[jid];
+	if (parent < 0){for (int r = 0; r < 6; r++){out[r] = s_X[36*jid + r + 30] * gravity;}}
+	else {grid_cpu::matVMult6(out, &s_X[36*jid], &s_a[6*parent]);}
+}
+
+/**
+ * Computes the joint to parent transforms X_J(q) * X_tree for every joint
+ * @param s_X is the (36*NUM_JOINTS) output
+ * @param s_q is the joint position vector
+ * @param s_XImats is the robotModel's XImats array
+ */
+template <typename T>
+inline void load_update_XImats_helpers(T *s_X, const T *s_q, const T *s_XImats){
+	for (int jid = 0; jid < NUM_JOINTS; jid++){
+		grid_cpu::jointXmat(&s_X[36*jid], s_q[jid], &s_XImats[36*jid], &S_VECTORS[6*jid], JOINT_REVOLUTE[jid]);
+	}
+}
+
+// Joints from the root down to (and including) body, returns how many
+inline int contact_path(int *path, const int body){
+	int depth = 0;
+	for (int jid = body; jid >= 0; jid = PARENT_IDS[jid]){depth++;}
+	for (int jid = body, d = depth - 1; jid >= 0; jid = PARENT_IDS[jid], d--){path[d] = jid;}
+	return depth;
+}
+
+/**
+ * Subtracts each external wrench, carried from the root frame (the fixed base, or a floating base body) to the
+ * frame of the link it acts on, from that link's body force (wrenches on body -1 are left to the caller)
+ * @param s_f is the (6*NUM_JOINTS) per joint body force
+ */
+template <typename T>
+inline void subtract_contact_wrenches(T *s_f, const T *s_X, const timestepContacts<T> *s_contacts){
+	if (s_contacts == nullptr){return;}
+	for (int c = 0; c < s_contacts->count; c++){
+		const int body = s_contacts->body[c]; if (body < 0){continue;}
+		int path[NUM_JOINTS]; const int depth = contact_path(path, body);
+		T g[6]; for (int r = 0; r < 6; r++){g[r] = s_contacts->wrench[6*c + r];}
+		for (int d = 0; d < depth; d++){T tmp[6]; grid_cpu::forceXMult6(tmp, &s_X[36*path[d]], g); for (int r = 0; r < 6; r++){g[r] = tmp[r];}}
+		for (int r = 0; r < 6; r++){s_f[6*body + r] -= g[r];}
+	}
+}
+
+/**
+ * Recursive Newton Euler: c = ID(q,qd,qdd)
+ * @param s_c is the output vector
+ * @param s_vaf is (18*NUM_JOINTS) scratch that returns v, a and the accumulated f per joint
+ * @param s_qdd may be nullptr for qdd = 0
+ * @param s_contacts are the external wrenches (nullptr for none)
+ */
+template <typename T>
+void inverse_dynamics_inner(T *s_c, T *s_vaf, const T *s_qd, const T *s_qdd, const T *s_X, const T *s_XImats, const T gravity,
+                            const timestepContacts<T> *s_contacts = nullptr){
+	T *s_v = s_vaf; T *s_a = &s_vaf[6*NUM_JOINTS]; T *s_f = &s_vaf[12*NUM_JOINTS];
+	for (int jid = 0; jid < NUM_JOINTS; jid++){
+		const int parent = PARENT_IDS[jid]; const T *I = &s_XImats[36*(NUM_JOINTS + jid)];
+		T *v = &s_v[6*jid]; T *a = &s_a[6*jid]; T *f = &s_f[6*jid];
+		T vJ[6]; S_vec(vJ, jid, s_qd[jid]);
+		if (parent < 0){for (int r = 0; r < 6; r++){v[r] = vJ[r];}}
+		else {grid_cpu::matVMult6(v, &s_X[36*jid], &s_v[6*parent]); for (int r = 0; r < 6; r++){v[r] += vJ[r];}}
+		X_a_parent(a, jid, s_X, s_a, gravity);
+		if (s_qdd != nullptr){T aJ[6]; S_vec(aJ, jid, s_qdd[jid]); for (int r = 0; r < 6; r++){a[r] += aJ[r];}}
+		grid_cpu::mxPeq(a, v, vJ, static_cast<T>(1));
+		T Iv[6]; grid_cpu::matVMult6(Iv, I, v);
+		grid_cpu::matVMult6(f, I, a);
+		grid_cpu::fxPeq(f, v, Iv);
+	}
+	subtract_contact_wrenches<T>(s_f, s_X, s_contacts);
+	for (int jid = NUM_JOINTS - 1; jid >= 0; jid--){
+		const int parent = PARENT_IDS[jid];
+		s_c[jid] = S_dot(jid, &s_f[6*jid]);
+		if (parent >= 0){grid_cpu::matTVMult6Peq(&s_f[6*parent], &s_X[36*jid], &s_f[6*jid]);}
+	}
+}
+
+/**
+ * Adds d(-f_ext)/dq of every external wrench to the body force derivatives: the wrench g_j in the frame of
+ * joint j on the path to the body turns with q_j, so column j gets X*_{body<-j} (S_j x* g_j)
+ * @param df is the [joint][column][6] body force derivative scratch of inverse_dynamics_gradient_inner
+ */
+template <typename T>
+inline void contact_wrenches_gradient(T *df, const T *s_X, const timestepContacts<T> *s_contacts, const int q_col_min){
+	const int N = NUM_JOINTS;
+	for (int c = 0; c < s_contacts->count; c++){
+		const int body = s_contacts->body[c]; if (body < 0){continue;}
+		int path[NUM_JOINTS]; const int depth = contact_path(path, body);
+		T g[6*NUM_JOINTS]; const T *w = &s_contacts->wrench[6*c];
+		for (int d = 0; d < depth; d++){grid_cpu::forceXMult6(&g[6*d], &s_X[36*path[d]], d == 0 ? w : &g[6*(d - 1)]);}
+		for (int d = 0; d < depth; d++){
+			const int col = path[d]; if (col < q_col_min){continue;}
+			T S[6]; S_vec(S, col, static_cast<T>(1));
+			T h[6]; grid_cpu::fx(h, S, &g[6*d]);
+			for (int e = d + 1; e < depth; e++){T tmp[6]; grid_cpu::forceXMult6(tmp, &s_X[36*path[e]], h); for (int r = 0; r < 6; r++){h[r] = tmp[r];}}
+			for (int r = 0; r < 6; r++){df[6*(body*N + col) + r] += h[r];}
+		}
+	}
+}
+
+/**
+ * Analytical gradient of inverse dynamics: dc_du = [dc_dq, dc_dqd]
+ * @param s_dc_du is the (2*NUM_VEL*NUM_VEL) output, or with SPARSE the (2*DC_DU_NNZ) [dq | dqd] CSC values
+ *        (structural zeros are then never written, see sparse.hpp)
+ * @param s_vaf holds v, a and accumulated f from inverse_dynamics_inner at the same (q,qd,qdd)
+ * @param q_col_min, qd_col_min skip the dc_dq / dc_dqd columns below them (left unspecified)
+ * @param s_contacts are the external wrenches s_vaf was computed with (nullptr for none)
+ */
+template <typename T, bool SPARSE = false>
+void inverse_dynamics_gradient_inner(T *s_dc_du, const T *s_vaf, const T *s_qd, const T *s_X, const T *s_XImats, const T gravity,
+                                     const int q_col_min = 0, const int qd_col_min = 0, const timestepContacts<T> *s_contacts = nullptr){
+	const int N = NUM_JOINTS;
+	const T *s_v = s_vaf; const T *s_a = &s_vaf[6*N]; const T *s_f = &s_vaf[12*N];
+	// [joint][column][6] for dv, da, df with respect to q then qd. Only related joints are ever read and the
+	// rest is assigned before it is read, except what is accumulated into: the diagonal of dv and da and the
+	// df of the subtree columns, so only those start at zero
+	T scratch[36*NUM_JOINTS*NUM_JOINTS];
+	T *dv = scratch; T *da = &dv[6*N*N]; T *df = &da[6*N*N];
+	T *dvd = &df[6*N*N]; T *dad = &dvd[6*N*N]; T *dfd = &dad[6*N*N];
+	for (int jid = 0; jid < N; jid++){
+		for (int col = jid; col < N; col++){
+			if (!IS_ANCESTOR[jid + N*col]){continue;}
+			const int ind = 6*(jid*N + col);
+			for (int r = 0; r < 6; r++){df[ind + r] = static_cast<T>(0); dfd[ind + r] = static_cast<T>(0);}
+			if (col == jid){for (int r = 0; r < 6; r++){dv[ind + r] = static_cast<T>(0); da[ind + r] = static_cast<T>(0); dvd[ind + r] = static_cast<T>(0); dad[ind + r] = static_cast<T>(0);}}
+		}
+	}
+	for (int jid = 0; jid < N; jid++){
+		const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid]; const T *I = &s_XImats[36*(N + jid)];
+		const T *v = &s_v[6*jid];
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T vJ[6]; S_vec(vJ, jid, s_qd[jid]);
+		T Xvp[6] = {0,0,0,0,0,0}; if (parent >= 0){grid_cpu::matVMult6(Xvp, X, &s_v[6*parent]);}
+		T Xap[6]; X_a_parent(Xap, jid, s_X, s_a, gravity);
+		T Iv[6]; grid_cpu::matVMult6(Iv, I, v);
+		for (int col = 0; col <= jid; col++){
+			// motion only depends on the joints supporting this one
+			if (!IS_ANCESTOR[col + N*jid]){continue;}
+			const int ind = 6*(jid*N + col);
+			for (int wrt = 0; wrt < 2; wrt++){
+				if (col < (wrt ? qd_col_min : q_col_min)){continue;}
+				T *dv_c = wrt ? &dvd[ind] : &dv[ind]; T *da_c = wrt ? &dad[ind] : &da[ind]; T *df_c = wrt ? &dfd[ind] : &df[ind];
+				if (parent >= 0 && col < jid){
+					const int pind = 6*(parent*N + col);
+					grid_cpu::matVMult6(dv_c, X, wrt ? &dvd[pind] : &dv[pind]);
+					grid_cpu::matVMult6(da_c, X, wrt ? &dad[pind] : &da[pind]);
+				}
+				if (col == jid){
+					if (wrt){for (int r = 0; r < 6; r++){dv_c[r] += S[r];} grid_cpu::mxPeq(da_c, v, S, static_cast<T>(1));}
+					else {grid_cpu::mxPeq(dv_c, Xvp, S, static_cast<T>(1)); grid_cpu::mxPeq(da_c, Xap, S, static_cast<T>(1));}
+				}
+				grid_cpu::mxPeq(da_c, dv_c, vJ, static_cast<T>(1));
+				T Idv[6]; grid_cpu::matVMult6(Idv, I, dv_c);
+				grid_cpu::matVMult6(df_c, I, da_c);
+				grid_cpu::fxPeq(df_c, dv_c, Iv);
+				grid_cpu::fxPeq(df_c, v, Idv);
+			}
+		}
+	}
+	if (s_contacts != nullptr){contact_wrenches_gradient<T>(df, s_X, s_contacts, q_col_min);}
+	const int BLOCK = SPARSE ? DC_DU_NNZ : N*N;
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid];
+		for (int col = 0; col < N; col++){
+			const int out = SPARSE ? DC_DU_ENTRY[jid + N*col] : jid + N*col;
+			if (!joints_related(jid, col)){
+				if (!SPARSE){s_dc_du[out] = static_cast<T>(0); s_dc_du[BLOCK + out] = static_cast<T>(0);}
+				continue;
+			}
+			const int ind = 6*(jid*N + col); const int pind = 6*(parent*N + col);
+			if (col >= q_col_min){
+				s_dc_du[out] = S_dot(jid, &df[ind]);
+				if (parent >= 0){grid_cpu::matTVMult6Peq(&df[pind], X, &df[ind]);}
+			}
+			if (col >= qd_col_min){
+				s_dc_du[BLOCK + out] = S_dot(jid, &dfd[ind]);
+				if (parent >= 0){grid_cpu::matTVMult6Peq(&dfd[pind], X, &dfd[ind]);}
+			}
+		}
+		if (parent >= 0 && jid >= q_col_min){
+			// d(X^T f)/dq = X^T (S x* f)
+			T S[6]; S_vec(S, jid, static_cast<T>(1));
+			T SxF[6]; grid_cpu::fx(SxF, S, &s_f[6*jid]);
+			grid_cpu::matTVMult6Peq(&df[6*(parent*N + jid)], X, SxF);
+		}
+	}
+}
+
+/**
+ * Contracted gradient of inverse dynamics: lambda^T dc_du = [d(lambda^T c)/dq, d(lambda^T c)/dqd] in O(N)
+ * lambda^T c = sum_j Lambda_j . f_j with Lambda_j = X_j Lambda_parent + S_j lambda_j, so one adjoint
+ * (reverse) sweep over the RNEA recursion gives every column without forming dc_du
+ * @param s_lam_dc_du is the (2*NUM_VEL) output
+ * @param s_vaf holds v, a and accumulated f from inverse_dynamics_inner at the same (q,qd,qdd)
+ */
+template <typename T>
+void inverse_dynamics_gradient_contracted_inner(T *s_lam_dc_du, const T *s_lambda, const T *s_vaf, const T *s_qd, const T *s_X, const T *s_XImats, const T gravity){
+	const int N = NUM_JOINTS;
+	const T *s_v = s_vaf; const T *s_a = &s_vaf[6*N]; const T *s_f = &s_vaf[12*N];
+	T Lambda[6*NUM_JOINTS]; T a_bar[6*NUM_JOINTS]; T v_bar[6*NUM_JOINTS];
+	for (int jid = 0; jid < N; jid++){
+		const int parent = PARENT_IDS[jid]; T *L = &Lambda[6*jid];
+		S_vec(L, jid, s_lambda[jid]);
+		if (parent >= 0){grid_cpu::matVMult6Peq(L, &s_X[36*jid], &Lambda[6*parent]);}
+		for (int r = 0; r < 6; r++){a_bar[6*jid + r] = static_cast<T>(0); v_bar[6*jid + r] = static_cast<T>(0);}
+	}
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid]; const T *I = &s_XImats[36*(N + jid)];
+		const T *v = &s_v[6*jid]; const T *L = &Lambda[6*jid]; T *ab = &a_bar[6*jid]; T *vb = &v_bar[6*jid];
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T vJ[6]; S_vec(vJ, jid, s_qd[jid]);
+		// f = I a + v x* I v with adjoint Lambda
+		grid_cpu::matVMult6Peq(ab, I, L);
+		T Iv[6]; grid_cpu::matVMult6(Iv, I, v);
+		T tmp[6]; grid_cpu::fx(tmp, L, Iv);
+		T vxL[6]; grid_cpu::mx(vxL, v, L);
+		T IvxL[6]; grid_cpu::matVMult6(IvxL, I, vxL);
+		for (int r = 0; r < 6; r++){vb[r] -= tmp[r] + IvxL[r];}
+		// a = X a_parent + S qdd + v x vJ
+		grid_cpu::fxPeq(vb, vJ, ab);
+		// qd enters through vJ in v and in v x vJ
+		T vxS[6]; grid_cpu::mx(vxS, v, S);
+		s_lam_dc_du[N + jid] = grid_cpu::dot6(S, vb) + grid_cpu::dot6(ab, vxS);
+		// q enters through X in v, a and Lambda: d(X y)/dq = (X y) x S
+		T Xvp[6] = {0,0,0,0,0,0}; if (parent >= 0){grid_cpu::matVMult6(Xvp, X, &s_v[6*parent]);}
+		T Xap[6]; X_a_parent(Xap, jid, s_X, s_a, gravity);
+		T dX[6];
+		grid_cpu::mx(dX, Xvp, S); T val = grid_cpu::dot6(vb, dX);
+		grid_cpu::mx(dX, Xap, S); val += grid_cpu::dot6(ab, dX);
+		grid_cpu::mx(dX, L, S); val += grid_cpu::dot6(&s_f[6*jid], dX);
+		s_lam_dc_du[jid] = val;
+		if (parent >= 0){
+			grid_cpu::matTVMult6Peq(&a_bar[6*parent], X, ab);
+			grid_cpu::matTVMult6Peq(&v_bar[6*parent], X, vb);
+		}
+	}
+}
+
+// Packed symmetric storage keeps the upper triangle column by column (LAPACK 'U' packed):
+// element (row,col) with row <= col sits at row + col*(col+1)/2, either order may be passed
+inline int sym_packed_index(const int row, const int col){return row <= col ? row + col*(col + 1)/2 : col + row*(row + 1)/2;}
+
+// Index of (row,col), row <= col, in an n x n column-major matrix or in its packed upper triangle
+template <bool PACKED>
+inline int upper_index(const int row, const int col, const int n){return PACKED ? row + col*(col + 1)/2 : row + n*col;}
+
+// Structural sparsity over all NUM_VEL dofs: the NUM_VEL - NUM_JOINTS floating base dofs are related to
+// every dof, and as every limb hangs off the base the floating base Minv is dense
+inline bool dofs_same_tree(const int i, const int j){return NUM_VEL > NUM_JOINTS || joints_same_tree(i, j);}
+inline bool dofs_related(const int i, const int j){
+	const int NB = NUM_VEL - NUM_JOINTS;
+	return i < NB || j < NB || joints_related(i - NB, j - NB);
+}
+
+/**
+ * Direct inverse of the mass matrix (Carpentier's analytical Minv)
+ * @param s_Minv is the (NUM_VEL*NUM_VEL) output (both triangles are written), or with PACKED
+ *        the (SYM_PACKED_SIZE) upper triangle in packed storage (only that triangle is computed)
+ */
+template <typename T, bool PACKED = false>
+void direct_minv_inner(T *s_Minv, const T *s_X, const T *s_XImats){
+	const int N = NUM_JOINTS;
+	// F accumulates the subtree columns of each joint in the backward pass, every other entry is assigned first
+	T IA[36*NUM_JOINTS]; T U[6*NUM_JOINTS]; T Dinv[NUM_JOINTS]; T F[6*NUM_JOINTS*NUM_JOINTS];
+	for (int jid = 0; jid < N; jid++){
+		for (int col = jid; col < N; col++){if (IS_ANCESTOR[jid + N*col]){for (int r = 0; r < 6; r++){F[6*(N*jid + col) + r] = static_cast<T>(0);}}}
+	}
+	for (int i = 0; i < 36*N; i++){IA[i] = s_XImats[36*N + i];}
+	for (int i = 0; i < (PACKED ? N*(N + 1)/2 : N*N); i++){s_Minv[i] = static_cast<T>(0);}
+	// backward pass
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid];
+		T *Ui = &U[6*jid]; T *Fi = &F[6*N*jid];
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		grid_cpu::matVMult6(Ui, &IA[36*jid], S);
+		Dinv[jid] = static_cast<T>(1) / S_dot(jid, Ui);
+		s_Minv[upper_index<PACKED>(jid, jid, N)] = Dinv[jid];
+		for (int col = jid + 1; col < N; col++){if (IS_ANCESTOR[jid + N*col]){s_Minv[upper_index<PACKED>(jid, col, N)] -= Dinv[jid] * S_dot(jid, &Fi[6*col]);}}
+		if (parent >= 0){
+			T *Fp = &F[6*N*parent];
+			for (int col = jid; col < N; col++){
+				// F only reaches the columns of this subtree
+				if (!IS_ANCESTOR[jid + N*col]){continue;}
+				for (int r = 0; r < 6; r++){Fi[6*col + r] += Ui[r] * s_Minv[upper_index<PACKED>(jid, col, N)];}
+				grid_cpu::matTVMult6Peq(&Fp[6*col], X, &Fi[6*col]);
+			}
+			T Ia[36];
+			for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){Ia[r + 6*c] = IA[36*jid + r + 6*c] - Ui[r]*Ui[c]*Dinv[jid];}}
+			grid_cpu::congruence6Peq(&IA[36*parent], X, Ia);
+		}
+	}
+	// forward pass (F is reused to hold the propagated P = S*Minv rows)
+	for (int jid = 0; jid < N; jid++){
+		const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid];
+		T *Pi = &F[6*N*jid];
+		for (int col = jid; col < N; col++){
+			if (!joints_same_tree(jid, col)){continue;}
+			T XPp[6] = {0,0,0,0,0,0};
+			if (parent >= 0){
+				grid_cpu::matVMult6(XPp, X, &F[6*N*parent + 6*col]);
+				s_Minv[upper_index<PACKED>(jid, col, N)] -= Dinv[jid] * grid_cpu::dot6(&U[6*jid], XPp);
+			}
+			S_vec(&Pi[6*col], jid, s_Minv[upper_index<PACKED>(jid, col, N)]);
+			for (int r = 0; r < 6; r++){Pi[6*col + r] += XPp[r];}
+		}
+	}
+	if (PACKED){return;}
+	for (int col = 0; col < N; col++){for (int row = col + 1; row < N; row++){s_Minv[row + N*col] = s_Minv[col + N*row];}}
+}
+
+// qdd = Minv(u - c)
+template <typename T>
+inline void minv_solve(T *s_qdd, const T *s_Minv, const T *s_u, const T *s_c){
+	const int N = NUM_JOINTS;
+	for (int row = 0; row < N; row++){
+		T val = static_cast<T>(0);
+		for (int col = 0; col < N; col++){if (joints_same_tree(row, col)){val += s_Minv[row + N*col] * (s_u[col] - s_c[col]);}}
+		s_qdd[row] = val;
+	}
+}
+
+// df_du = -Minv * dc_du (columns below q_col_min / qd_col_min are skipped)
+template <typename T>
+inline void minv_gradient_product(T *s_df_du, const T *s_Minv, const T *s_dc_du, const int q_col_min = 0, const int qd_col_min = 0){
+	const int N = NUM_JOINTS;
+	for (int col = 0; col < 2*N; col++){
+		if (col % N < (col < N ? q_col_min : qd_col_min)){continue;}
+		for (int row = 0; row < N; row++){
+			T val = static_cast<T>(0);
+			if (joints_same_tree(row, col % N)){
+				for (int k = 0; k < N; k++){if (joints_same_tree(row, k) && joints_related(k, col % N)){val += s_Minv[row + N*k] * s_dc_du[k + N*col];}}
+			}
+			s_df_du[row + N*col] = -val;
+		}
+	}
+}
+
+// qdd = Minv(u - c) over all NUM_VEL dofs with Minv in packed storage: each stored
+// off diagonal entry feeds both of its rows, so the lower triangle is never formed
+// (accumulated in T_ACC, which is also Minv's precision)
+template <typename T, typename T_ACC = T>
+inline void packed_minv_solve(T *s_qdd, const T_ACC *s_Minv_packed, const T *s_u, const T *s_c){
+	const int NV = NUM_VEL;
+	T_ACC d[NUM_VEL]; T_ACC qdd[NUM_VEL];
+	for (int i = 0; i < NV; i++){d[i] = static_cast<T_ACC>(s_u[i]) - static_cast<T_ACC>(s_c[i]); qdd[i] = static_cast<T_ACC>(0);}
+	for (int col = 0; col < NV; col++){
+		const T_ACC *m = &s_Minv_packed[col*(col + 1)/2];
+		T_ACC val = m[col] * d[col];
+		for (int row = 0; row < col; row++){
+			if (!dofs_same_tree(row, col)){continue;}
+			qdd[row] += m[row] * d[col];
+			val += m[row] * d[row];
+		}
+		qdd[col] += val;
+	}
+	for (int i = 0; i < NV; i++){s_qdd[i] = static_cast<T>(qdd[i]);}
+}
+
+// df_du = -Minv * dc_du over all NUM_VEL dofs with Minv in packed storage (columns below
+// q_col_min / qd_col_min are skipped), both products of a stored entry are fused as above
+template <typename T, typename T_ACC = T>
+inline void packed_minv_gradient_product(T *s_df_du, const T_ACC *s_Minv_packed, const T *s_dc_du, const int q_col_min = 0, const int qd_col_min = 0){
+	const int NV = NUM_VEL;
+	T_ACC df[NUM_VEL];
+	for (int col = 0; col < 2*NV; col++){
+		const int dof = col % NV;
+		if (dof < (col < NV ? q_col_min : qd_col_min)){continue;}
+		const T *dc = &s_dc_du[NV*col];
+		for (int row = 0; row < NV; row++){df[row] = static_cast<T_ACC>(0);}
+		for (int k = 0; k < NV; k++){
+			const T_ACC *m = &s_Minv_packed[k*(k + 1)/2];
+			const bool k_related = dofs_related(k, dof);
+			T_ACC val = k_related ? m[k] * static_cast<T_ACC>(dc[k]) : static_cast<T_ACC>(0);
+			for (int row = 0; row < k; row++){
+				if (!dofs_same_tree(row, k)){continue;}
+				if (k_related){df[row] -= m[row] * static_cast<T_ACC>(dc[k]);}
+				if (dofs_related(row, dof)){val += m[row] * static_cast<T_ACC>(dc[row]);}
+			}
+			df[k] -= val;
+		}
+		for (int row = 0; row < NV; row++){s_df_du[NV*col + row] = static_cast<T>(df[row]);}
+	}
+}
+
+/**
+ * Forward dynamics: qdd = Minv(u - ID(q,qd,0))
+ */
+template <typename T>
+void forward_dynamics_inner(T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+                            const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_Minv[SYM_PACKED_SIZE];
+	inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);
+	direct_minv_inner<T,true>(s_Minv, s_X, s_XImats);
+	packed_minv_solve<T>(s_qdd, s_Minv, s_u, s_c);
+}
+
+/**
+ * Gradient of forward dynamics: df_du = -Minv * dc_du evaluated at qdd = FD(q,qd,u)
+ * @param s_df_du is the (2*NUM_VEL*NUM_VEL) output
+ * @param s_qdd is the forward dynamics result (computed here unless QDD_PROVIDED)
+ * @param q_col_min, qd_col_min skip the df_dq / df_dqd columns below them (left unspecified)
+ */
+template <typename T, bool QDD_PROVIDED = false>
+void forward_dynamics_gradient_inner(T *s_df_du, T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+                                     const int q_col_min = 0, const int qd_col_min = 0, const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_Minv[SYM_PACKED_SIZE]; T s_dc_du[2*NUM_JOINTS*NUM_JOINTS];
+	direct_minv_inner<T,true>(s_Minv, s_X, s_XImats);
+	if (!QDD_PROVIDED){
+		inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);
+		packed_minv_solve<T>(s_qdd, s_Minv, s_u, s_c);
+	}
+	inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, s_qdd, s_X, s_XImats, gravity, s_contacts);
+	inverse_dynamics_gradient_inner<T>(s_dc_du, s_vaf, s_qd, s_X, s_XImats, gravity, q_col_min, qd_col_min, s_contacts);
+	packed_minv_gradient_product<T>(s_df_du, s_Minv, s_dc_du, q_col_min, qd_col_min);
+}
+
+/**
+ * Mixed precision Minv: the transforms and inertias are built in T, and the articulated
+ * inertia backward pass and forward pass of direct_minv_inner run in T_ACC
+ * @param s_Minv is the (NUM_VEL*NUM_VEL, or SYM_PACKED_SIZE if PACKED) output in T_ACC (cast by the caller when needed)
+ */
+template <typename T, typename T_ACC, bool PACKED = false>
+void direct_minv_mixed_inner(T_ACC *s_Minv, const T *s_X, const T *s_XImats){
+	const int N = NUM_JOINTS;
+	// direct_minv_inner only reads the transforms and the inertias (the second half of XImats)
+	T_ACC s_X_acc[36*NUM_JOINTS]; T_ACC s_XImats_acc[72*NUM_JOINTS];
+	for (int i = 0; i < 36*N; i++){s_X_acc[i] = static_cast<T_ACC>(s_X[i]); s_XImats_acc[36*N + i] = static_cast<T_ACC>(s_XImats[36*N + i]);}
+	direct_minv_inner<T_ACC,PACKED>(s_Minv, s_X_acc, s_XImats_acc);
+}
+
+/**
+ * Mixed precision forward dynamics: c = ID(q,qd,0) in T, Minv and qdd = Minv(u - c) in T_ACC
+ * (the packed solve of forward_dynamics_inner, so T_ACC = T gives the same qdd)
+ */
+template <typename T, typename T_ACC>
+void forward_dynamics_mixed_inner(T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+                                  const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T_ACC s_Minv[SYM_PACKED_SIZE];
+	inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);
+	direct_minv_mixed_inner<T,T_ACC,true>(s_Minv, s_X, s_XImats);
+	packed_minv_solve<T,T_ACC>(s_qdd, s_Minv, s_u, s_c);
+}
+
+/**
+ * Mixed precision gradient of forward dynamics: the RNEA passes and dc_du stay in T while Minv,
+ * qdd = Minv(u - c) and df_du = -Minv * dc_du are accumulated in T_ACC (packed as in forward_dynamics_gradient_inner)
+ */
+template <typename T, typename T_ACC, bool QDD_PROVIDED = false>
+void forward_dynamics_gradient_mixed_inner(T *s_df_du, T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+                                           const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T_ACC s_Minv[SYM_PACKED_SIZE]; T s_dc_du[2*NUM_JOINTS*NUM_JOINTS];
+	direct_minv_mixed_inner<T,T_ACC,true>(s_Minv, s_X, s_XImats);
+	if (!QDD_PROVIDED){
+		inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);
+		packed_minv_solve<T,T_ACC>(s_qdd, s_Minv, s_u, s_c);
+	}
+	inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, s_qdd, s_X, s_XImats, gravity, s_contacts);
+	inverse_dynamics_gradient_inner<T>(s_dc_du, s_vaf, s_qd, s_X, s_XImats, gravity, 0, 0, s_contacts);
+	packed_minv_gradient_product<T,T_ACC>(s_df_du, s_Minv, s_dc_du);
+}
+
+// Outputs of dynamics_bundle (or together any subset)
+enum bundleOutput {BUNDLE_C = 1, BUNDLE_MINV = 2, BUNDLE_QDD = 4, BUNDLE_DC_DU = 8, BUNDLE_DF_DU = 16, BUNDLE_ALL = 31};
+
+/**
+ * Fused c, Minv, qdd = FD(q,qd,u), dc_du and df_du from one set of transforms and one Minv
+ * @param OUTPUTS is a bundleOutput mask; pointers of outputs that are not requested may be nullptr
+ * @param s_c is ID(q,qd,0) and s_dc_du is evaluated at the forward dynamics qdd (as used by df_du)
+ */
+template <typename T, int OUTPUTS>
+void dynamics_bundle_inner(T *s_c, T *s_Minv, T *s_qdd, T *s_dc_du, T *s_df_du, const T *s_qd, const T *s_u,
+                           const T *s_X, const T *s_XImats, const T gravity, const timestepContacts<T> *s_contacts = nullptr){
+	const bool NEED_GRADIENT = (OUTPUTS & (BUNDLE_DC_DU | BUNDLE_DF_DU)) != 0;
+	const bool NEED_QDD = NEED_GRADIENT || (OUTPUTS & BUNDLE_QDD);
+	const bool NEED_C = NEED_QDD || (OUTPUTS & BUNDLE_C);
+	const bool NEED_MINV = NEED_QDD || (OUTPUTS & BUNDLE_MINV);
+	T c_local[NUM_JOINTS]; T Minv_local[NUM_JOINTS*NUM_JOINTS]; T qdd_local[NUM_JOINTS]; T dc_du_local[2*NUM_JOINTS*NUM_JOINTS];
+	T s_vaf[18*NUM_JOINTS];
+	T *c = (OUTPUTS & BUNDLE_C) ? s_c : c_local;
+	T *Minv = (OUTPUTS & BUNDLE_MINV) ? s_Minv : Minv_local;
+	T *qdd = (OUTPUTS & BUNDLE_QDD) ? s_qdd : qdd_local;
+	T *dc_du = (OUTPUTS & BUNDLE_DC_DU) ? s_dc_du : dc_du_local;
+	if (NEED_C){inverse_dynamics_inner<T>(c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);}
+	if (NEED_MINV){direct_minv_inner<T>(Minv, s_X, s_XImats);}
+	if (NEED_QDD){minv_solve<T>(qdd, Minv, s_u, c);}
+	if (NEED_GRADIENT){
+		// v is unchanged but a and f move with qdd, so the O(N) sweep is rerun before the O(N^2) gradient
+		T c_qdd[NUM_JOINTS];
+		inverse_dynamics_inner<T>(c_qdd, s_vaf, s_qd, qdd, s_X, s_XImats, gravity, s_contacts);
+		inverse_dynamics_gradient_inner<T>(dc_du, s_vaf, s_qd, s_X, s_XImats, gravity, 0, 0, s_contacts);
+		if (OUTPUTS & BUNDLE_DF_DU){minv_gradient_product<T>(s_df_du, Minv, dc_du);}
+	}
+}
+
+/**
+ * Featherstone's articulated body algorithm: qdd = FD(q,qd,u) in O(N)
+ */
+template <typename T>
+void aba_inner(T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+               const timestepContacts<T> *s_contacts = nullptr){
+	const int N = NUM_JOINTS;
+	T IA[36*NUM_JOINTS]; T pA[6*NUM_JOINTS]; T v[6*NUM_JOINTS]; T cJ[6*NUM_JOINTS]; T U[6*NUM_JOINTS]; T D[NUM_JOINTS]; T uu[NUM_JOINTS];
+	for (int jid = 0; jid < N; jid++){
+		const int parent = PARENT_IDS[jid]; const T *I = &s_XImats[36*(N + jid)];
+		T vJ[6]; S_vec(vJ, jid, s_qd[jid]);
+		if (parent < 0){for (int r = 0; r < 6; r++){v[6*jid + r] = vJ[r];}}
+		else {grid_cpu::matVMult6(&v[6*jid], &s_X[36*jid], &v[6*parent]); for (int r = 0; r < 6; r++){v[6*jid + r] += vJ[r];}}
+		grid_cpu::mx(&cJ[6*jid], &v[6*jid], vJ);
+		for (int i = 0; i < 36; i++){IA[36*jid + i] = I[i];}
+		T Iv[6]; grid_cpu::matVMult6(Iv, I, &v[6*jid]);
+		grid_cpu::fx(&pA[6*jid], &v[6*jid], Iv);
+	}
+	// external wrenches enter the bias forces
+	subtract_contact_wrenches<T>(pA, s_X, s_contacts);
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int parent = PARENT_IDS[jid];
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		grid_cpu::matVMult6(&U[6*jid], &IA[36*jid], S);
+		D[jid] = S_dot(jid, &U[6*jid]);
+		uu[jid] = s_u[jid] - S_dot(jid, &pA[6*jid]);
+		if (parent >= 0){
+			const T *Ui = &U[6*jid]; const T Dinv = static_cast<T>(1) / D[jid];
+			T Ia[36]; T pa[6];
+			for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){Ia[r + 6*c] = IA[36*jid + r + 6*c] - Ui[r]*Ui[c]*Dinv;}}
+			grid_cpu::matVMult6(pa, Ia, &cJ[6*jid]);
+			for (int r = 0; r < 6; r++){pa[r] += pA[6*jid + r] + Ui[r]*uu[jid]*Dinv;}
+			grid_cpu::congruence6Peq(&IA[36*parent], &s_X[36*jid], Ia);
+			grid_cpu::matTVMult6Peq(&pA[6*parent], &s_X[36*jid], pa);
+		}
+	}
+	// the forward pass reuses v to hold the accelerations
+	T *a = v;
+	for (int jid = 0; jid < N; jid++){
+		T ap[6]; X_a_parent(ap, jid, s_X, a, gravity);
+		for (int r = 0; r < 6; r++){ap[r] += cJ[6*jid + r];}
+		s_qdd[jid] = (uu[jid] - grid_cpu::dot6(&U[6*jid], ap)) / D[jid];
+		S_vec(&a[6*jid], jid, s_qdd[jid]);
+		for (int r = 0; r < 6; r++){a[6*jid + r] += ap[r];}
+	}
+}
+
+/**
+ * Composite rigid body algorithm: the joint space mass matrix M(q)
+ * @param s_M is the (NUM_VEL*NUM_VEL) output, or with PACKED the (SYM_PACKED_SIZE) upper triangle in packed storage
+ */
+template <typename T, bool PACKED = false>
+void crba_inner(T *s_M, const T *s_X, const T *s_XImats){
+	const int N = NUM_JOINTS;
+	T IC[36*NUM_JOINTS];
+	for (int i = 0; i < 36*N; i++){IC[i] = s_XImats[36*N + i];}
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int parent = PARENT_IDS[jid];
+		if (parent >= 0){grid_cpu::congruence6Peq(&IC[36*parent], &s_X[36*jid], &IC[36*jid]);}
+	}
+	for (int i = 0; i < (PACKED ? N*(N + 1)/2 : N*N); i++){s_M[i] = static_cast<T>(0);}
+	for (int jid = 0; jid < N; jid++){
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T F[6]; grid_cpu::matVMult6(F, &IC[36*jid], S);
+		s_M[upper_index<PACKED>(jid, jid, N)] = S_dot(jid, F);
+		int ind = jid;
+		while (PARENT_IDS[ind] >= 0){
+			T Fp[6]; grid_cpu::matTVMult6(Fp, &s_X[36*ind], F);
+			for (int r = 0; r < 6; r++){F[r] = Fp[r];}
+			ind = PARENT_IDS[ind];
+			// ancestors come first, so (ind,jid) is in the upper triangle
+			s_M[upper_index<PACKED>(ind, jid, N)] = S_dot(ind, F);
+			if (!PACKED){s_M[jid + N*ind] = s_M[ind + N*jid];}
+		}
+	}
+}
+
+// Parent of a dof in the tree the LTL factorization follows (-1 for a root): the NUM_VEL - NUM_JOINTS
+// dofs of a floating base form a chain above the root joints
+inline int ltl_parent(const int dof){
+	const int NB = NUM_VEL - NUM_JOINTS;
+	if (dof < NB){return dof - 1;}
+	const int parent = PARENT_IDS[dof - NB];
+	return parent >= 0 ? parent + NB : NB - 1;
+}
+
+/**
+ * Sparse LTL factorization M = L^T L that follows the kinematic tree (Featherstone, RBDA table 6.3). Only the
+ * entries between a dof and its ancestors are read and written, so it takes O(N depth^2) work and touches
+ * N*depth entries, and L has the sparsity of M's lower triangle (no fill in).
+ * @param s_L holds M on entry (at least its lower ancestor entries) and L on return (NUM_VEL x NUM_VEL column-major)
+ */
+template <typename T>
+inline void ltl_factor_inner(T *s_L){
+	using std::sqrt;
+	const int NV = NUM_VEL;
+	for (int k = NV - 1; k >= 0; k--){
+		const T Lkk = sqrt(s_L[k + NV*k]); s_L[k + NV*k] = Lkk;
+		for (int i = ltl_parent(k); i >= 0; i = ltl_parent(i)){s_L[k + NV*i] /= Lkk;}
+		for (int i = ltl_parent(k); i >= 0; i = ltl_parent(i)){
+			for (int j = i; j >= 0; j = ltl_parent(j)){s_L[i + NV*j] -= s_L[k + NV*i] * s_L[k + NV*j];}
+		}
+	}
+}
+
+// x = M^-1 x from the factor of ltl_factor_inner: L^T y = x then L x = y, each O(N depth)
+template <typename T>
+inline void ltl_solve_inner(T *s_x, const T *s_L){
+	const int NV = NUM_VEL;
+	for (int i = NV - 1; i >= 0; i--){
+		if (s_x[i] == static_cast<T>(0)){continue;} // e.g., the rows of a dc_du column outside its subtree path
+		s_x[i] /= s_L[i + NV*i];
+		for (int j = ltl_parent(i); j >= 0; j = ltl_parent(j)){s_x[j] -= s_L[i + NV*j] * s_x[i];}
+	}
+	for (int i = 0; i < NV; i++){
+		for (int j = ltl_parent(i); j >= 0; j = ltl_parent(j)){s_x[i] -= s_L[i + NV*j] * s_x[j];}
+		s_x[i] /= s_L[i + NV*i];
+	}
+}
+
+// df_du = -M^-1 dc_du in place, one factored solve per column (columns below q_col_min / qd_col_min are skipped)
+template <typename T>
+inline void ltl_gradient_solve(T *s_df_du, const T *s_L, const int q_col_min = 0, const int qd_col_min = 0){
+	const int NV = NUM_VEL;
+	for (int col = 0; col < 2*NV; col++){
+		if (col % NV < (col < NV ? q_col_min : qd_col_min)){continue;}
+		T *x = &s_df_du[NV*col];
+		for (int row = 0; row < NV; row++){x[row] = -x[row];}
+		ltl_solve_inner<T>(x, s_L);
+	}
+}
+
+/**
+ * Forward dynamics without Minv: qdd = M^-1 (u - ID(q,qd,0)) through the LTL factor of the CRBA mass matrix
+ */
+template <typename T>
+void forward_dynamics_ltl_inner(T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+                                const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_L[NUM_JOINTS*NUM_JOINTS];
+	inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);
+	crba_inner<T>(s_L, s_X, s_XImats);
+	ltl_factor_inner<T>(s_L);
+	for (int i = 0; i < NUM_JOINTS; i++){s_qdd[i] = s_u[i] - s_c[i];}
+	ltl_solve_inner<T>(s_qdd, s_L);
+}
+
+/**
+ * Gradient of forward dynamics without Minv: df_du = -M^-1 dc_du by factored solves at qdd = FD(q,qd,u)
+ * @param s_df_du is the (2*NUM_VEL*NUM_VEL) output
+ * @param s_qdd is the forward dynamics result (computed here unless QDD_PROVIDED)
+ * @param q_col_min, qd_col_min skip the df_dq / df_dqd columns below them (left unspecified)
+ */
+template <typename T, bool QDD_PROVIDED = false>
+void forward_dynamics_gradient_ltl_inner(T *s_df_du, T *s_qdd, const T *s_qd, const T *s_u, const T *s_X, const T *s_XImats, const T gravity,
+                                         const int q_col_min = 0, const int qd_col_min = 0, const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_L[NUM_JOINTS*NUM_JOINTS];
+	crba_inner<T>(s_L, s_X, s_XImats);
+	ltl_factor_inner<T>(s_L);
+	if (!QDD_PROVIDED){
+		inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_X, s_XImats, gravity, s_contacts);
+		for (int i = 0; i < NUM_JOINTS; i++){s_qdd[i] = s_u[i] - s_c[i];}
+		ltl_solve_inner<T>(s_qdd, s_L);
+	}
+	inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, s_qdd, s_X, s_XImats, gravity, s_contacts);
+	inverse_dynamics_gradient_inner<T>(s_df_du, s_vaf, s_qd, s_X, s_XImats, gravity, q_col_min, qd_col_min, s_contacts);
+	ltl_gradient_solve<T>(s_df_du, s_L, q_col_min, qd_col_min);
+}
+
+/**
+ * Rotation (link to world) and origin in the world of every joint frame
+ * @param R, p are the (9*NUM_JOINTS) column-major rotations and (3*NUM_JOINTS) origins
+ * @param R0, p0 place the frame the root joints are attached to (nullptr for the world)
+ */
+template <typename T>
+inline void joint_world_frames(T *R, T *p, const T *s_X, const T *R0 = nullptr, const T *p0 = nullptr){
+	for (int jid = 0; jid < NUM_JOINTS; jid++){
+		const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid];
+		// X = [E 0; -E rx E] so rx = -E^T X21
+		T E[9]; for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){E[r + 3*c] = X[r + 6*c];}}
+		T rx[9];
+		for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){
+			T val = static_cast<T>(0);
+			for (int k = 0; k < 3; k++){val += E[k + 3*r] * X[3 + k + 6*c];}
+			rx[r + 3*c] = -val;
+		}}
+		T rloc[3] = {rx[2 + 3*1], rx[0 + 3*2], rx[1 + 3*0]};
+		const T *Rp = parent >= 0 ? &R[9*parent] : R0; const T *pp = parent >= 0 ? &p[3*parent] : p0;
+		T *Ri = &R[9*jid]; T *pi = &p[3*jid];
+		for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){
+			if (Rp == nullptr){Ri[r + 3*c] = E[c + 3*r];}
+			else {
+				T val = static_cast<T>(0);
+				for (int k = 0; k < 3; k++){val += Rp[r + 3*k] * E[c + 3*k];}
+				Ri[r + 3*c] = val;
+			}
+		}}
+		for (int r = 0; r < 3; r++){
+			if (Rp == nullptr){pi[r] = rloc[r];}
+			else {
+				T val = pp != nullptr ? pp[r] : static_cast<T>(0);
+				for (int k = 0; k < 3; k++){val += Rp[r + 3*k] * rloc[k];}
+				pi[r] = val;
+			}
+		}
+	}
+}
+
+// [x, y, z, roll, pitch, yaw] of a frame with rotation R (link to world) and origin p
+template <typename T>
+inline void frame_pose_rpy(T *out, const T *R, const T *p){
+	using std::sqrt; using std::atan2;
+	for (int r = 0; r < 3; r++){out[r] = p[r];}
+	out[3] = atan2(R[2 + 3*1], R[2 + 3*2]);
+	out[4] = atan2(-R[2 + 3*0], sqrt(R[2 + 3*1]*R[2 + 3*1] + R[2 + 3*2]*R[2 + 3*2]));
+	out[5] = atan2(R[1 + 3*0], R[0 + 3*0]);
+}
+
+/**
+ * End effector poses [x, y, z, roll, pitch, yaw] of every leaf link frame
+ * @param s_eePos is the (6*NUM_EES) output
+ */
+template <typename T>
+void end_effector_positions_inner(T *s_eePos, const T *s_X){
+	T R[9*NUM_JOINTS]; T p[3*NUM_JOINTS];
+	joint_world_frames<T>(R, p, s_X);
+	for (int ee = 0; ee < NUM_EES; ee++){
+		const int jid = EE_JOINT_IDS[ee];
+		frame_pose_rpy<T>(&s_eePos[6*ee], &R[9*jid], &p[3*jid]);
+	}
+}
+
+// Outputs of end_effector_kinematics (or together any subset)
+enum eeOutput {EE_POSE = 1, EE_JACOBIAN = 2, EE_JDOT_QD = 4, EE_C = 8, EE_KINEMATICS = 7, EE_ALL = 15};
+
+/**
+ * Pose, Jacobian and Jdot*qd of every end effector from one set of transforms. J maps qd to the
+ * [angular; linear] velocity of the end effector frame origin expressed in the world frame, and Jdot*qd is
+ * that frame's [angular; linear] acceleration at qdd = 0 (without gravity).
+ * @param OUTPUTS is an eeOutput mask (EE_C is left to the caller); pointers of other outputs may be nullptr
+ * @param s_eePos is the (6*NUM_EES) [x, y, z, roll, pitch, yaw] output (end_effector_positions layout)
+ * @param s_J is the (6*NUM_EES*NUM_VEL) output (6 x NUM_VEL column-major per end effector)
+ * @param s_Jdqd is the (6*NUM_EES) output
+ * @param s_v are the joint velocities of an RNEA pass at the same (q,qd) (s_vaf, or nullptr to compute them)
+ * @param R0, p0, v0 are the pose and spatial velocity (in its own frame) of the frame the root joints are
+ *        attached to (nullptr for the fixed world); its NUM_VEL - NUM_JOINTS columns lead J
+ */
+template <typename T, int OUTPUTS>
+void end_effector_kinematics_inner(T *s_eePos, T *s_J, T *s_Jdqd, const T *s_qd, const T *s_X, const T *s_v = nullptr,
+                                   const T *R0 = nullptr, const T *p0 = nullptr, const T *v0 = nullptr){
+	const int NB = NUM_VEL - NUM_JOINTS; // columns of the root frame
+	T R[9*NUM_JOINTS]; T p[3*NUM_JOINTS];
+	joint_world_frames<T>(R, p, s_X, R0, p0);
+	if (OUTPUTS & EE_POSE){
+		for (int ee = 0; ee < NUM_EES; ee++){const int jid = EE_JOINT_IDS[ee]; frame_pose_rpy<T>(&s_eePos[6*ee], &R[9*jid], &p[3*jid]);}
+	}
+	if (OUTPUTS & EE_JACOBIAN){
+		for (int ee = 0; ee < NUM_EES; ee++){
+			const int ee_jid = EE_JOINT_IDS[ee]; const T *pe = &p[3*ee_jid];
+			for (int col = 0; col < NUM_VEL; col++){
+				T *J = &s_J[6*(ee*NUM_VEL + col)];
+				T ang[3] = {0, 0, 0}; T lin[3] = {0, 0, 0}; T origin[3] = {0, 0, 0};
+				if (col < NB){
+					// root frame [angular; linear] axis col
+					const int axis = col % 3;
+					for (int r = 0; r < 3; r++){(col < 3 ? ang : lin)[r] = R0[r + 3*axis];}
+					if (p0 != nullptr){for (int r = 0; r < 3; r++){origin[r] = p0[r];}}
+				}
+				else if (IS_ANCESTOR[(col - NB) + NUM_JOINTS*ee_jid]){
+					const int jid = col - NB; const T *Rj = &R[9*jid]; T S[6]; S_vec(S, jid, static_cast<T>(1));
+					for (int r = 0; r < 3; r++){
+						for (int k = 0; k < 3; k++){ang[r] += Rj[r + 3*k] * S[k]; lin[r] += Rj[r + 3*k] * S[3 + k];}
+						origin[r] = p[3*jid + r];
+					}
+				}
+				// carry the linear part from the joint origin to the end effector origin
+				const T d[3] = {pe[0] - origin[0], pe[1] - origin[1], pe[2] - origin[2]};
+				J[0] = ang[0]; J[1] = ang[1]; J[2] = ang[2];
+				J[3] = lin[0] + ang[1]*d[2] - ang[2]*d[1];
+				J[4] = lin[1] + ang[2]*d[0] - ang[0]*d[2];
+				J[5] = lin[2] + ang[0]*d[1] - ang[1]*d[0];
+			}
+		}
+	}
+	if (OUTPUTS & EE_JDOT_QD){
+		// velocities and velocity product accelerations per joint frame: a = X a_parent + v x vJ
+		T v_local[6*NUM_JOINTS]; T a[6*NUM_JOINTS];
+		const T *v = s_v != nullptr ? s_v : v_local;
+		for (int jid = 0; jid < NUM_JOINTS; jid++){
+			const int parent = PARENT_IDS[jid]; const T *X = &s_X[36*jid];
+			T vJ[6]; S_vec(vJ, jid, s_qd[NB + jid]);
+			if (s_v == nullptr){
+				T *vi = &v_local[6*jid];
+				if (parent >= 0){grid_cpu::matVMult6(vi, X, &v_local[6*parent]);}
+				else if (v0 != nullptr){grid_cpu::matVMult6(vi, X, v0);}
+				else {for (int r = 0; r < 6; r++){vi[r] = static_cast<T>(0);}}
+				for (int r = 0; r < 6; r++){vi[r] += vJ[r];}
+			}
+			T *ai = &a[6*jid];
+			if (parent >= 0){grid_cpu::matVMult6(ai, X, &a[6*parent]);} else {for (int r = 0; r < 6; r++){ai[r] = static_cast<T>(0);}}
+			grid_cpu::mxPeq(ai, &v[6*jid], vJ, static_cast<T>(1));
+		}
+		for (int ee = 0; ee < NUM_EES; ee++){
+			const int jid = EE_JOINT_IDS[ee]; const T *Ri = &R[9*jid]; const T *vi = &v[6*jid]; const T *ai = &a[6*jid];
+			// classical acceleration of the frame origin: spatial a_lin + w x v_lin
+			const T acc[6] = {ai[0], ai[1], ai[2],
+			                  ai[3] + vi[1]*vi[5] - vi[2]*vi[4], ai[4] + vi[2]*vi[3] - vi[0]*vi[5], ai[5] + vi[0]*vi[4] - vi[1]*vi[3]};
+			T *out = &s_Jdqd[6*ee];
+			for (int r = 0; r < 3; r++){
+				out[r] = static_cast<T>(0); out[3 + r] = static_cast<T>(0);
+				for (int k = 0; k < 3; k++){out[r] += Ri[r + 3*k] * acc[k]; out[3 + r] += Ri[r + 3*k] * acc[3 + k];}
+			}
+		}
+	}
+}
+
+/**
+ * Gradient of the end effector poses with respect to q
+ * @param s_deePos is the (6*NUM_EES*NUM_JOINTS) output (6 x NUM_EES*NUM_JOINTS column-major)
+ */
+template <typename T>
+void end_effector_positions_gradient_inner(T *s_deePos, const T *s_q, const T *s_XImats){
+	typedef grid_cpu::dual<T> D;
+	D q[NUM_JOINTS]; D XImats[36*NUM_JOINTS]; D X[36*NUM_JOINTS]; D eePos[6*NUM_EES];
+	for (int i = 0; i < 36*NUM_JOINTS; i++){XImats[i] = D(s_XImats[i]);}
+	for (int col = 0; col < NUM_JOINTS; col++){
+		for (int jid = 0; jid < NUM_JOINTS; jid++){q[jid] = D(s_q[jid], jid == col ? static_cast<T>(1) : static_cast<T>(0));}
+		load_update_XImats_helpers<D>(X, q, XImats);
+		end_effector_positions_inner<D>(eePos, X);
+		for (int ee = 0; ee < NUM_EES; ee++){
+			for (int r = 0; r < 6; r++){s_deePos[r + 6*(ee*NUM_JOINTS + col)] = eePos[6*ee + r].der;}
+		}
+	}
+}
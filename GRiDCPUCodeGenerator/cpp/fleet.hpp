@@ -0,0 +1,69 @@
+/**************************************************************************
+ *  Registry entry of this model
+ *
+ *  register_model<T>() adds the type erased descriptor of this namespace to
+ *  grid_cpu::modelRegistry<T> so one grid_cpu::fleetScheduler can serve it
+ *  alongside the other generated models of the process.
+ **************************************************************************/
+
+// fleet outputs are the dynamicsServer ones, allocated up front so requests never allocate
+const unsigned FLEET_BUFFERS = BUFFER_INPUTS | SERVER_BUFFERS;
+
+template <typename T>
+inline void fleet_timestep(const int algorithm, void *hd_data_, const void *d_robotModel_, const T gravity, const int k){
+	gridData<T> *hd_data = static_cast<gridData<T> *>(hd_data_);
+	const robotModel<T> *model = static_cast<const robotModel<T> *>(d_robotModel_);
+	switch (algorithm){
+		case grid_cpu::FLEET_ID: inverse_dynamics_timestep<T,false,false>(hd_data,model,gravity,k); break;
+		case grid_cpu::FLEET_MINV: direct_minv_timestep<T,false>(hd_data,model,k); break;
+		case grid_cpu::FLEET_FD: forward_dynamics_timestep<T>(hd_data,model,gravity,k); break;
+		case grid_cpu::FLEET_ID_DU: inverse_dynamics_gradient_timestep<T,false,false>(hd_data,model,gravity,k); break;
+		case grid_cpu::FLEET_FD_DU: forward_dynamics_gradient_timestep<T,false>(hd_data,model,gravity,k); break;
+		case grid_cpu::FLEET_ABA: aba_timestep<T>(hd_data,model,gravity,k); break;
+		case grid_cpu::FLEET_CRBA: crba_timestep<T>(hd_data,model,k); break;
+		case grid_cpu::FLEET_EEPOS: end_effector_positions_timestep<T,false>(hd_data,model,k); break;
+		case grid_cpu::FLEET_DEEPOS: end_effector_positions_gradient_timestep<T,false>(hd_data,model,k); break;
+		default: break;
+	}
+}
+
+template <typename T>
+inline T *fleet_output(void *hd_data_, const int algorithm){
+	gridData<T> *hd_data = static_cast<gridData<T> *>(hd_data_);
+	switch (algorithm){
+		case grid_cpu::FLEET_ID: return hd_data->h_c;
+		case grid_cpu::FLEET_MINV: return hd_data->h_Minv;
+		case grid_cpu::FLEET_FD: case grid_cpu::FLEET_ABA: return hd_data->h_qdd;
+		case grid_cpu::FLEET_ID_DU: return hd_data->h_dc_du;
+		case grid_cpu::FLEET_FD_DU: return hd_data->h_df_du;
+		case grid_cpu::FLEET_CRBA: return hd_data->h_M;
+		case grid_cpu::FLEET_EEPOS: return hd_data->h_eePos;
+		case grid_cpu::FLEET_DEEPOS: return hd_data->h_deePos;
+		default: return nullptr;
+	}
+}
+
+// Registers this model (once, later calls return the same descriptor)
+template <typename T>
+__host__
+const grid_cpu::modelDescriptor<T> *register_model(){
+	grid_cpu::modelDescriptor<T> desc;
+	desc.name = MODEL_NAME; desc.robot = ROBOT_NAME;
+	desc.num_joints = NUM_JOINTS; desc.num_vel = NUM_VEL; desc.num_ees = NUM_EES; desc.q_qd_u_stride = Q_QD_U_STRIDE;
+	const int strides[grid_cpu::FLEET_NUM_ALGORITHMS] = {NUM_VEL, NUM_VEL*NUM_VEL, NUM_VEL, 2*NUM_VEL*NUM_VEL, 2*NUM_VEL*NUM_VEL,
+	                                                     NUM_VEL, NUM_VEL*NUM_VEL, 6*NUM_EES, 6*NUM_EES*NUM_JOINTS};
+	for (int alg = 0; alg < grid_cpu::FLEET_NUM_ALGORITHMS; alg++){desc.output_stride[alg] = strides[alg];}
+	desc.workspace_bytes = [](int max_timesteps){
+		size_t bytes = 0;
+		for (int i = 0; i < NUM_GRID_BUFFERS; i++){if (FLEET_BUFFERS & (1u << i)){bytes += grid_buffer_bytes<T>(i, max_timesteps);}}
+		return bytes;
+	};
+	desc.init_robotModel = [](){return static_cast<void *>(init_robotModel<T>());};
+	desc.free_robotModel = [](void *d_robotModel){free_robotModel<T>(static_cast<robotModel<T> *>(d_robotModel));};
+	desc.init_gridData = [](int max_timesteps){return static_cast<void *>(init_gridData<T>(max_timesteps, FLEET_BUFFERS));};
+	desc.free_gridData = [](void *hd_data){free_gridData<T>(static_cast<gridData<T> *>(hd_data));};
+	desc.inputs = [](void *hd_data){return static_cast<gridData<T> *>(hd_data)->h_q_qd_u;};
+	desc.output = &fleet_output<T>;
+	desc.run_timestep = &fleet_timestep<T>;
+	return grid_cpu::modelRegistry<T>::instance().add(desc);
+}
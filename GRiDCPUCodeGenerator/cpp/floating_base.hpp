@@ -0,0 +1,569 @@
+/**************************************************************************
+ *  Free-flyer root of floating base models
+ *
+ *  The 6 DoF base is not run through the generic joint machinery: body 0 is
+ *  the base (BASE_INERTIA) and the NUM_JOINTS limb joints hang off it (a
+ *  PARENT_IDS entry of -1 attaches a limb to the base), so the limb
+ *  transforms, the limb Minv and every limb pass are the fixed base ones.
+ *  Per timestep
+ *      q  = [base position (3), base quaternion (x,y,z,w), limb q]        NUM_POS
+ *      qd = [base spatial velocity in the base frame [w; v], limb qd]     NUM_VEL
+ *  and u, qdd and c start with the base wrench / spatial acceleration in
+ *  the base frame. The base orientation enters the dynamics through
+ *  gravity in the base frame, which is read in closed form off the
+ *  quaternion, and the base pose through the external wrenches (see
+ *  enable_contacts), which are carried from the world to the base frame.
+ *  The q columns of dc_du and df_du are [base rotation, base translation,
+ *  limb q] with the base perturbed in its own frame, so the base
+ *  translation columns are zero without contacts.
+ **************************************************************************/
+
+const int BASE_POS = 7;  // q entries of the base ahead of the limb q
+const int BASE_VEL = 6;  // qd entries of the base ahead of the limb qd
+
+/**
+ * Gravity as an upward acceleration of the world expressed in the base frame:
+ * gravity * R(quat)^T e_z, i.e., gravity times the last row of R (any nonzero scale of the quaternion)
+ * @param s_ag is the (6) spatial acceleration output
+ */
+template <typename T>
+inline void fb_base_gravity(T *s_ag, const T *s_quat, const T gravity){
+	const T x = s_quat[0]; const T y = s_quat[1]; const T z = s_quat[2]; const T w = s_quat[3];
+	const T s = static_cast<T>(2) * gravity / (x*x + y*y + z*z + w*w);
+	s_ag[0] = static_cast<T>(0); s_ag[1] = static_cast<T>(0); s_ag[2] = static_cast<T>(0);
+	s_ag[3] = s*(x*z - w*y); s_ag[4] = s*(y*z + w*x); s_ag[5] = gravity - s*(x*x + y*y);
+}
+
+// Base to world rotation R(quat) (column-major, any nonzero scale of the quaternion)
+template <typename T>
+inline void fb_base_rotation(T *R, const T *s_quat){
+	const T x = s_quat[0]; const T y = s_quat[1]; const T z = s_quat[2]; const T w = s_quat[3];
+	const T s = static_cast<T>(2) / (x*x + y*y + z*z + w*w); const T one = static_cast<T>(1);
+	R[0] = one - s*(y*y + z*z); R[3] = s*(x*y - w*z);       R[6] = s*(x*z + w*y);
+	R[1] = s*(x*y + w*z);       R[4] = one - s*(x*x + z*z); R[7] = s*(y*z - w*x);
+	R[2] = s*(x*z - w*y);       R[5] = s*(y*z + w*x);       R[8] = one - s*(x*x + y*y);
+}
+
+/**
+ * The world frame wrenches of timestep k in the base frame, [R^T (n - p x f); R^T f] for the base pose
+ * (p, quat) with R(quat) the base to world rotation (any nonzero scale of the quaternion), written to
+ * the base_wrench storage enable_contacts keeps for the timestep
+ */
+template <typename T>
+inline timestepContacts<T> fb_base_frame_contacts(const T *s_pose, const gridData<T> *hd_data, const int k){
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	if (contacts.count == 0){return contacts;}
+	const T *p = s_pose; T R[9]; fb_base_rotation<T>(R, &s_pose[3]);
+	T *s_w = &hd_data->contacts->base_wrench[6*k*hd_data->contacts->max_contacts];
+	for (int c = 0; c < contacts.count; c++){
+		const T *n = &contacts.wrench[6*c]; const T *f = &n[3];
+		const T m[3] = {n[0] - (p[1]*f[2] - p[2]*f[1]), n[1] - (p[2]*f[0] - p[0]*f[2]), n[2] - (p[0]*f[1] - p[1]*f[0])};
+		for (int r = 0; r < 3; r++){
+			s_w[6*c + r] = R[3*r]*m[0] + R[3*r + 1]*m[1] + R[3*r + 2]*m[2];
+			s_w[6*c + 3 + r] = R[3*r]*f[0] + R[3*r + 1]*f[1] + R[3*r + 2]*f[2];
+		}
+	}
+	timestepContacts<T> out = contacts; out.wrench = s_w;
+	return out;
+}
+
+template <typename T>
+inline void fb_base_inertia(T *I0){for (int i = 0; i < 36; i++){I0[i] = static_cast<T>(BASE_INERTIA[i]);}}
+
+/**
+ * Floating base RNEA: c = [base wrench; limb torques] = ID(q,qd,qdd)
+ * @param s_vaf is (18*(NUM_JOINTS+1)) scratch that returns v, a and the accumulated f per body (base first)
+ * @param s_ag is fb_base_gravity of the base orientation
+ * @param s_qdd may be nullptr for qdd = 0
+ * @param s_contacts are the external wrenches in the base frame (see fb_base_frame_contacts, nullptr for none)
+ */
+template <typename T>
+void fb_inverse_dynamics_inner(T *s_c, T *s_vaf, const T *s_qd, const T *s_qdd, const T *s_ag, const T *s_X, const T *s_XImats,
+                               const timestepContacts<T> *s_contacts = nullptr){
+	const int N = NUM_JOINTS;
+	T *s_v = s_vaf; T *s_a = &s_vaf[6*(N + 1)]; T *s_f = &s_vaf[12*(N + 1)];
+	// the base velocity is the first 6 qd
+	T I0[36]; fb_base_inertia(I0);
+	for (int r = 0; r < 6; r++){s_v[r] = s_qd[r]; s_a[r] = s_ag[r] + (s_qdd != nullptr ? s_qdd[r] : static_cast<T>(0));}
+	T I0v[6]; grid_cpu::matVMult6(I0v, I0, s_v);
+	grid_cpu::matVMult6(s_f, I0, s_a);
+	grid_cpu::fxPeq(s_f, s_v, I0v);
+	for (int jid = 0; jid < N; jid++){
+		const int body = jid + 1; const int parent = PARENT_IDS[jid] + 1; const T *I = &s_XImats[36*(N + jid)];
+		T *v = &s_v[6*body]; T *a = &s_a[6*body]; T *f = &s_f[6*body];
+		T vJ[6]; S_vec(vJ, jid, s_qd[BASE_VEL + jid]);
+		grid_cpu::matVMult6(v, &s_X[36*jid], &s_v[6*parent]); for (int r = 0; r < 6; r++){v[r] += vJ[r];}
+		grid_cpu::matVMult6(a, &s_X[36*jid], &s_a[6*parent]);
+		if (s_qdd != nullptr){T aJ[6]; S_vec(aJ, jid, s_qdd[BASE_VEL + jid]); for (int r = 0; r < 6; r++){a[r] += aJ[r];}}
+		grid_cpu::mxPeq(a, v, vJ, static_cast<T>(1));
+		T Iv[6]; grid_cpu::matVMult6(Iv, I, v);
+		grid_cpu::matVMult6(f, I, a);
+		grid_cpu::fxPeq(f, v, Iv);
+	}
+	if (s_contacts != nullptr){
+		for (int c = 0; c < s_contacts->count; c++){
+			if (s_contacts->body[c] < 0){for (int r = 0; r < 6; r++){s_f[r] -= s_contacts->wrench[6*c + r];}}
+		}
+		subtract_contact_wrenches<T>(&s_f[6], s_X, s_contacts);
+	}
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int body = jid + 1; const int parent = PARENT_IDS[jid] + 1;
+		s_c[BASE_VEL + jid] = S_dot(jid, &s_f[6*body]);
+		grid_cpu::matTVMult6Peq(&s_f[6*parent], &s_X[36*jid], &s_f[6*body]);
+	}
+	for (int r = 0; r < 6; r++){s_c[r] = s_f[r];}
+}
+
+// Composite inertias per body with the base first (IC[0..35] is the whole robot in the base frame)
+template <typename T>
+inline void fb_composite_inertias(T *IC, const T *s_X, const T *s_XImats){
+	const int N = NUM_JOINTS;
+	fb_base_inertia(IC);
+	for (int i = 0; i < 36*N; i++){IC[36 + i] = s_XImats[36*N + i];}
+	for (int jid = N - 1; jid >= 0; jid--){grid_cpu::congruence6Peq(&IC[36*(PARENT_IDS[jid] + 1)], &s_X[36*jid], &IC[36*(jid + 1)]);}
+}
+
+/**
+ * Base rows of the mass matrix: column jid of s_F (6*NUM_JOINTS) is the composite inertia
+ * of the subtree of joint jid times its S, carried into the base frame
+ */
+template <typename T>
+inline void fb_base_rows(T *s_F, const T *IC, const T *s_X){
+	for (int jid = 0; jid < NUM_JOINTS; jid++){
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T F[6]; grid_cpu::matVMult6(F, &IC[36*(jid + 1)], S);
+		for (int ind = jid; ind >= 0; ind = PARENT_IDS[ind]){
+			T Fp[6]; grid_cpu::matTVMult6(Fp, &s_X[36*ind], F);
+			for (int r = 0; r < 6; r++){F[r] = Fp[r];}
+		}
+		for (int r = 0; r < 6; r++){s_F[6*jid + r] = F[r];}
+	}
+}
+
+/**
+ * Floating base CRBA: M = [IC_base, F; F^T, M_limbs] with the base block the composite inertia of the whole robot
+ * @param s_M is the (NUM_VEL*NUM_VEL) output, or with PACKED the (SYM_PACKED_SIZE) upper triangle in packed storage
+ */
+template <typename T, bool PACKED = false>
+void fb_crba_inner(T *s_M, const T *s_X, const T *s_XImats){
+	const int N = NUM_JOINTS; const int NV = NUM_VEL;
+	T IC[36*(NUM_JOINTS + 1)]; T F[6*NUM_JOINTS];
+	fb_composite_inertias<T>(IC, s_X, s_XImats);
+	fb_base_rows<T>(F, IC, s_X);
+	for (int i = 0; i < (PACKED ? SYM_PACKED_SIZE : NV*NV); i++){s_M[i] = static_cast<T>(0);}
+	for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){if (!PACKED || r <= c){s_M[upper_index<PACKED>(r, c, NV)] = IC[r + 6*c];}}}
+	for (int jid = 0; jid < N; jid++){
+		const int col = BASE_VEL + jid;
+		for (int r = 0; r < 6; r++){
+			s_M[upper_index<PACKED>(r, col, NV)] = F[6*jid + r];
+			if (!PACKED){s_M[col + NV*r] = F[6*jid + r];}
+		}
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T Fj[6]; grid_cpu::matVMult6(Fj, &IC[36*(jid + 1)], S);
+		s_M[upper_index<PACKED>(col, col, NV)] = S_dot(jid, Fj);
+		for (int ind = jid; PARENT_IDS[ind] >= 0;){
+			T Fp[6]; grid_cpu::matTVMult6(Fp, &s_X[36*ind], Fj);
+			for (int r = 0; r < 6; r++){Fj[r] = Fp[r];}
+			ind = PARENT_IDS[ind];
+			s_M[upper_index<PACKED>(BASE_VEL + ind, col, NV)] = S_dot(ind, Fj);
+			if (!PACKED){s_M[col + NV*(BASE_VEL + ind)] = s_M[BASE_VEL + ind + NV*col];}
+		}
+	}
+}
+
+// out = A^-1 for a symmetric positive definite 6x6 A (LDL^T, both triangles written)
+template <typename T>
+inline void fb_inverse6(T *out, const T *A){
+	T L[36]; T D[6];
+	for (int j = 0; j < 6; j++){
+		T d = A[j + 6*j];
+		for (int k = 0; k < j; k++){d -= L[j + 6*k]*L[j + 6*k]*D[k];}
+		D[j] = d;
+		for (int i = j + 1; i < 6; i++){
+			T val = A[i + 6*j];
+			for (int k = 0; k < j; k++){val -= L[i + 6*k]*L[j + 6*k]*D[k];}
+			L[i + 6*j] = val / d;
+		}
+	}
+	for (int c = 0; c < 6; c++){
+		// solve L D L^T x = e_c
+		T x[6];
+		for (int i = 0; i < 6; i++){x[i] = i == c ? static_cast<T>(1) : static_cast<T>(0); for (int k = 0; k < i; k++){x[i] -= L[i + 6*k]*x[k];}}
+		for (int i = 0; i < 6; i++){x[i] /= D[i];}
+		for (int i = 5; i >= 0; i--){for (int k = i + 1; k < 6; k++){x[i] -= L[k + 6*i]*x[k];}}
+		for (int r = 0; r < 6; r++){out[r + 6*c] = x[r];}
+	}
+}
+
+/**
+ * Floating base Minv from the fixed base limb Minv and the base rows of M by block elimination:
+ * with Y = Minv_limbs F^T and the 6x6 base articulated inertia A = IC_base - F Y,
+ * Minv = [A^-1, -A^-1 Y^T; -Y A^-1, Minv_limbs + Y A^-1 Y^T]
+ * @param s_Minv is the (NUM_VEL*NUM_VEL) output (both triangles are written), or with PACKED
+ *        the (SYM_PACKED_SIZE) upper triangle in packed storage (only that triangle is computed)
+ */
+template <typename T, bool PACKED = false>
+void fb_direct_minv_inner(T *s_Minv, const T *s_X, const T *s_XImats){
+	const int N = NUM_JOINTS; const int NV = NUM_VEL;
+	T Hinv[NUM_JOINTS*NUM_JOINTS]; T Y[6*NUM_JOINTS]; T Z[6*NUM_JOINTS];
+	T IC[36*(NUM_JOINTS + 1)]; T F[6*NUM_JOINTS];
+	direct_minv_inner<T>(Hinv, s_X, s_XImats);
+	fb_composite_inertias<T>(IC, s_X, s_XImats);
+	fb_base_rows<T>(F, IC, s_X);
+	// Y (NUM_JOINTS x 6): limbs on separate trees do not couple in the limb Minv
+	for (int c = 0; c < 6; c++){
+		for (int row = 0; row < N; row++){
+			T val = static_cast<T>(0);
+			for (int k = 0; k < N; k++){if (joints_same_tree(row, k)){val += Hinv[row + N*k] * F[6*k + c];}}
+			Y[row + N*c] = val;
+		}
+	}
+	T A[36]; T Ainv[36];
+	for (int c = 0; c < 6; c++){
+		for (int r = 0; r < 6; r++){
+			T val = IC[r + 6*c];
+			for (int k = 0; k < N; k++){val -= F[6*k + r] * Y[k + N*c];}
+			A[r + 6*c] = val;
+		}
+	}
+	fb_inverse6<T>(Ainv, A);
+	// Z = Y A^-1
+	for (int c = 0; c < 6; c++){
+		for (int row = 0; row < N; row++){
+			T val = static_cast<T>(0);
+			for (int k = 0; k < 6; k++){val += Y[row + N*k] * Ainv[k + 6*c];}
+			Z[row + N*c] = val;
+		}
+	}
+	for (int c = 0; c < 6; c++){
+		for (int r = 0; r < 6; r++){if (!PACKED || r <= c){s_Minv[upper_index<PACKED>(r, c, NV)] = Ainv[r + 6*c];}}
+		for (int row = 0; row < N; row++){
+			s_Minv[upper_index<PACKED>(c, BASE_VEL + row, NV)] = -Z[row + N*c];
+			if (!PACKED){s_Minv[BASE_VEL + row + NV*c] = -Z[row + N*c];}
+		}
+	}
+	for (int col = 0; col < N; col++){
+		for (int row = col; row < N; row++){
+			T val = Hinv[row + N*col];
+			for (int k = 0; k < 6; k++){val += Z[row + N*k] * Y[col + N*k];}
+			s_Minv[upper_index<PACKED>(BASE_VEL + col, BASE_VEL + row, NV)] = val;
+			if (!PACKED){s_Minv[BASE_VEL + row + NV*(BASE_VEL + col)] = val;}
+		}
+	}
+}
+
+/**
+ * Floating base forward dynamics: qdd = Minv(u - ID(q,qd,0))
+ */
+template <typename T>
+void fb_forward_dynamics_inner(T *s_qdd, const T *s_qd, const T *s_u, const T *s_ag, const T *s_X, const T *s_XImats,
+                               const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_VEL]; T s_vaf[18*(NUM_JOINTS + 1)]; T s_Minv[SYM_PACKED_SIZE];
+	fb_inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_ag, s_X, s_XImats, s_contacts);
+	fb_direct_minv_inner<T,true>(s_Minv, s_X, s_XImats);
+	packed_minv_solve<T>(s_qdd, s_Minv, s_u, s_c);
+}
+
+/**
+ * Floating base gradient of inverse dynamics: dc_du = [dc_dq, dc_dqd], the fixed base recursion of
+ * inverse_dynamics_gradient_inner with the base as the root body. A base qd column seeds dv = e_i on the
+ * base and every limb column only reaches the subtree of its joint. A base rotation turns gravity and the
+ * wrenches in the base frame and a base translation only moves the wrenches, so the base q columns are the
+ * base columns of M times the change of the base acceleration (see fb_crba_inner) less the wrench changes
+ * carried along the paths of their bodies.
+ * @param s_dc_du is the (2*NUM_VEL*NUM_VEL) output
+ * @param s_vaf holds v, a and accumulated f from fb_inverse_dynamics_inner at the same (q,qd,qdd)
+ * @param s_contacts are the external wrenches in the base frame s_vaf was computed with (nullptr for none)
+ */
+template <typename T>
+void fb_inverse_dynamics_gradient_inner(T *s_dc_du, const T *s_vaf, const T *s_qd, const T *s_ag, const T *s_X, const T *s_XImats,
+                                        const timestepContacts<T> *s_contacts = nullptr){
+	const int N = NUM_JOINTS; const int NV = NUM_VEL;
+	const T *s_v = s_vaf; const T *s_a = &s_vaf[6*(N + 1)]; const T *s_f = &s_vaf[12*(N + 1)];
+	// [joint][limb column][6] for dv, da, df with respect to the limb q, [body][column][6] with respect to qd
+	// and the base force with respect to the limb q. As in inverse_dynamics_gradient_inner only what is
+	// accumulated into starts at zero: the base body row, the diagonal of dv and da and the df of the subtree columns
+	T scratch[18*NUM_JOINTS*NUM_JOINTS + 18*(NUM_JOINTS + 1)*NUM_VEL + 6*NUM_JOINTS];
+	T *dv = scratch; T *da = &dv[6*N*N]; T *df = &da[6*N*N];
+	T *dvd = &df[6*N*N]; T *dad = &dvd[6*(N + 1)*NV]; T *dfd = &dad[6*(N + 1)*NV]; T *df0 = &dfd[6*(N + 1)*NV];
+	for (int i = 0; i < 6*NV; i++){dvd[i] = static_cast<T>(0); dad[i] = static_cast<T>(0); dfd[i] = static_cast<T>(0);}
+	for (int i = 0; i < 6*N; i++){df0[i] = static_cast<T>(0);}
+	for (int jid = 0; jid < N; jid++){
+		const int body = jid + 1;
+		for (int col = jid; col < N; col++){
+			if (!IS_ANCESTOR[jid + N*col]){continue;}
+			const int ind = 6*(jid*N + col); const int indd = 6*(body*NV + BASE_VEL + col);
+			for (int r = 0; r < 6; r++){df[ind + r] = static_cast<T>(0); dfd[indd + r] = static_cast<T>(0);}
+			if (col == jid){for (int r = 0; r < 6; r++){dv[ind + r] = static_cast<T>(0); da[ind + r] = static_cast<T>(0); dvd[indd + r] = static_cast<T>(0); dad[indd + r] = static_cast<T>(0);}}
+		}
+	}
+	T I0[36]; fb_base_inertia(I0);
+	T I0v[6]; grid_cpu::matVMult6(I0v, I0, s_v);
+	for (int c = 0; c < BASE_VEL; c++){
+		T *dv_c = &dvd[6*c]; T *df_c = &dfd[6*c]; dv_c[c] = static_cast<T>(1);
+		T Idv[6]; grid_cpu::matVMult6(Idv, I0, dv_c);
+		grid_cpu::fxPeq(df_c, dv_c, I0v);
+		grid_cpu::fxPeq(df_c, s_v, Idv);
+	}
+	for (int jid = 0; jid < N; jid++){
+		const int body = jid + 1; const int parent = PARENT_IDS[jid]; const int pbody = parent + 1;
+		const T *X = &s_X[36*jid]; const T *I = &s_XImats[36*(N + jid)]; const T *v = &s_v[6*body];
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T vJ[6]; S_vec(vJ, jid, s_qd[BASE_VEL + jid]);
+		T Xvp[6]; grid_cpu::matVMult6(Xvp, X, &s_v[6*pbody]);
+		T Xap[6]; grid_cpu::matVMult6(Xap, X, &s_a[6*pbody]);
+		T Iv[6]; grid_cpu::matVMult6(Iv, I, v);
+		for (int col = 0; col < N + NV; col++){
+			// col < N is limb q column col, else qd column col - N: motion depends on the base and the joints supporting this one
+			const bool wrt = col >= N; const int limb = wrt ? col - N - BASE_VEL : col;
+			if (limb >= 0 && !IS_ANCESTOR[limb + N*jid]){continue;}
+			T *dv_c = wrt ? &dvd[6*(body*NV + col - N)] : &dv[6*(jid*N + col)];
+			T *da_c = wrt ? &dad[6*(body*NV + col - N)] : &da[6*(jid*N + col)];
+			T *df_c = wrt ? &dfd[6*(body*NV + col - N)] : &df[6*(jid*N + col)];
+			if (limb != jid){
+				if (wrt){
+					grid_cpu::matVMult6(dv_c, X, &dvd[6*(pbody*NV + col - N)]);
+					grid_cpu::matVMult6(da_c, X, &dad[6*(pbody*NV + col - N)]);
+				}
+				else if (parent >= 0){
+					grid_cpu::matVMult6(dv_c, X, &dv[6*(parent*N + col)]);
+					grid_cpu::matVMult6(da_c, X, &da[6*(parent*N + col)]);
+				}
+			}
+			else if (wrt){for (int r = 0; r < 6; r++){dv_c[r] += S[r];} grid_cpu::mxPeq(da_c, v, S, static_cast<T>(1));}
+			else {grid_cpu::mxPeq(dv_c, Xvp, S, static_cast<T>(1)); grid_cpu::mxPeq(da_c, Xap, S, static_cast<T>(1));}
+			grid_cpu::mxPeq(da_c, dv_c, vJ, static_cast<T>(1));
+			T Idv[6]; grid_cpu::matVMult6(Idv, I, dv_c);
+			grid_cpu::matVMult6(df_c, I, da_c);
+			grid_cpu::fxPeq(df_c, dv_c, Iv);
+			grid_cpu::fxPeq(df_c, v, Idv);
+		}
+	}
+	if (s_contacts != nullptr){contact_wrenches_gradient<T>(df, s_X, s_contacts, 0);}
+	for (int jid = N - 1; jid >= 0; jid--){
+		const int body = jid + 1; const int parent = PARENT_IDS[jid]; const int pbody = parent + 1; const T *X = &s_X[36*jid];
+		const int row = BASE_VEL + jid;
+		for (int col = 0; col < N; col++){
+			if (!joints_related(jid, col)){s_dc_du[row + NV*(BASE_VEL + col)] = static_cast<T>(0); continue;}
+			const int ind = 6*(jid*N + col);
+			s_dc_du[row + NV*(BASE_VEL + col)] = S_dot(jid, &df[ind]);
+			grid_cpu::matTVMult6Peq(parent >= 0 ? &df[6*(parent*N + col)] : &df0[6*col], X, &df[ind]);
+		}
+		for (int col = 0; col < NV; col++){
+			T *out = &s_dc_du[NV*NV + row + NV*col];
+			if (col >= BASE_VEL && !joints_related(jid, col - BASE_VEL)){*out = static_cast<T>(0); continue;}
+			const int ind = 6*(body*NV + col);
+			*out = S_dot(jid, &dfd[ind]);
+			grid_cpu::matTVMult6Peq(&dfd[6*(pbody*NV + col)], X, &dfd[ind]);
+		}
+		// d(X^T f)/dq = X^T (S x* f)
+		T S[6]; S_vec(S, jid, static_cast<T>(1));
+		T SxF[6]; grid_cpu::fx(SxF, S, &s_f[6*body]);
+		grid_cpu::matTVMult6Peq(parent >= 0 ? &df[6*(parent*N + jid)] : &df0[6*jid], X, SxF);
+	}
+	for (int col = 0; col < N; col++){for (int r = 0; r < 6; r++){s_dc_du[r + NV*(BASE_VEL + col)] = df0[6*col + r];}}
+	for (int col = 0; col < NV; col++){for (int r = 0; r < 6; r++){s_dc_du[NV*NV + r + NV*col] = dfd[6*col + r];}}
+	// base q columns
+	T IC[36*(NUM_JOINTS + 1)]; T F[6*NUM_JOINTS];
+	fb_composite_inertias<T>(IC, s_X, s_XImats);
+	fb_base_rows<T>(F, IC, s_X);
+	const int num_contacts = s_contacts != nullptr ? s_contacts->count : 0;
+	for (int col = 0; col < BASE_VEL; col++){
+		T *out = &s_dc_du[NV*col];
+		for (int r = 0; r < NV; r++){out[r] = static_cast<T>(0);}
+		// R exp(dtheta) turns a base frame vector y into y + y x dtheta (gravity, moments and forces)
+		// and p + R dp adds f x dp to the moments
+		const int axis = col % 3;
+		const T e[3] = {static_cast<T>(axis == 0), static_cast<T>(axis == 1), static_cast<T>(axis == 2)};
+		if (col < 3){
+			const T da0[6] = {0, 0, 0, s_ag[4]*e[2] - s_ag[5]*e[1], s_ag[5]*e[0] - s_ag[3]*e[2], s_ag[3]*e[1] - s_ag[4]*e[0]};
+			grid_cpu::matVMult6(out, IC, da0);
+			for (int jid = 0; jid < N; jid++){
+				T val = static_cast<T>(0); for (int r = 3; r < 6; r++){val += F[6*jid + r]*da0[r];}
+				out[BASE_VEL + jid] = val;
+			}
+		}
+		for (int i = 0; i < num_contacts; i++){
+			const T *wi = &s_contacts->wrench[6*i]; const T *y = col < 3 ? wi : &wi[3];
+			T dw[6] = {y[1]*e[2] - y[2]*e[1], y[2]*e[0] - y[0]*e[2], y[0]*e[1] - y[1]*e[0], 0, 0, 0};
+			if (col < 3){dw[3] = wi[4]*e[2] - wi[5]*e[1]; dw[4] = wi[5]*e[0] - wi[3]*e[2]; dw[5] = wi[3]*e[1] - wi[4]*e[0];}
+			// the base row takes the whole change, the joints on the path to the body its part in their frames
+			for (int r = 0; r < 6; r++){out[r] -= dw[r];}
+			const int body = s_contacts->body[i]; if (body < 0){continue;}
+			int path[NUM_JOINTS]; const int depth = contact_path(path, body);
+			T g[6]; for (int r = 0; r < 6; r++){g[r] = dw[r];}
+			for (int d = 0; d < depth; d++){
+				T tmp[6]; grid_cpu::forceXMult6(tmp, &s_X[36*path[d]], g);
+				for (int r = 0; r < 6; r++){g[r] = tmp[r];}
+				out[BASE_VEL + path[d]] -= S_dot(path[d], g);
+			}
+		}
+	}
+}
+
+/**
+ * Floating base gradient of forward dynamics: df_du = -Minv * dc_du evaluated at qdd = FD(q,qd,u)
+ * @param s_qdd is the forward dynamics result (computed here unless QDD_PROVIDED)
+ */
+template <typename T, bool QDD_PROVIDED = false>
+void fb_forward_dynamics_gradient_inner(T *s_df_du, T *s_qdd, const T *s_qd, const T *s_u, const T *s_ag, const T *s_X, const T *s_XImats,
+                                        const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_VEL]; T s_vaf[18*(NUM_JOINTS + 1)]; T s_Minv[SYM_PACKED_SIZE]; T s_dc_du[2*NUM_VEL*NUM_VEL];
+	fb_direct_minv_inner<T,true>(s_Minv, s_X, s_XImats);
+	if (!QDD_PROVIDED){
+		fb_inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_ag, s_X, s_XImats, s_contacts);
+		packed_minv_solve<T>(s_qdd, s_Minv, s_u, s_c);
+	}
+	fb_inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, s_qdd, s_ag, s_X, s_XImats, s_contacts);
+	fb_inverse_dynamics_gradient_inner<T>(s_dc_du, s_vaf, s_qd, s_ag, s_X, s_XImats, s_contacts);
+	packed_minv_gradient_product<T>(s_df_du, s_Minv, s_dc_du);
+}
+
+/**
+ * Floating base forward dynamics without Minv: the LTL factor of M (the base dofs as a chain above the limbs)
+ */
+template <typename T>
+void fb_forward_dynamics_ltl_inner(T *s_qdd, const T *s_qd, const T *s_u, const T *s_ag, const T *s_X, const T *s_XImats,
+                                   const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_VEL]; T s_vaf[18*(NUM_JOINTS + 1)]; T s_L[NUM_VEL*NUM_VEL];
+	fb_inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_ag, s_X, s_XImats, s_contacts);
+	fb_crba_inner<T>(s_L, s_X, s_XImats);
+	ltl_factor_inner<T>(s_L);
+	for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = s_u[i] - s_c[i];}
+	ltl_solve_inner<T>(s_qdd, s_L);
+}
+
+template <typename T, bool QDD_PROVIDED = false>
+void fb_forward_dynamics_gradient_ltl_inner(T *s_df_du, T *s_qdd, const T *s_qd, const T *s_u, const T *s_ag, const T *s_X, const T *s_XImats,
+                                            const timestepContacts<T> *s_contacts = nullptr){
+	T s_c[NUM_VEL]; T s_vaf[18*(NUM_JOINTS + 1)]; T s_L[NUM_VEL*NUM_VEL];
+	fb_crba_inner<T>(s_L, s_X, s_XImats);
+	ltl_factor_inner<T>(s_L);
+	if (!QDD_PROVIDED){
+		fb_inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, nullptr, s_ag, s_X, s_XImats, s_contacts);
+		for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = s_u[i] - s_c[i];}
+		ltl_solve_inner<T>(s_qdd, s_L);
+	}
+	fb_inverse_dynamics_inner<T>(s_c, s_vaf, s_qd, s_qdd, s_ag, s_X, s_XImats, s_contacts);
+	fb_inverse_dynamics_gradient_inner<T>(s_df_du, s_vaf, s_qd, s_ag, s_X, s_XImats, s_contacts);
+	ltl_gradient_solve<T>(s_df_du, s_L);
+}
+
+// One timestep of each floating base algorithm (the limb transforms go through the kinematics cache)
+template <typename T, bool USE_QDD_FLAG, bool USE_COMPRESSED_MEM>
+inline void fb_inverse_dynamics_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q_QD : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_vaf[18*(NUM_JOINTS + 1)]; T s_ag[6];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+	const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+	fb_inverse_dynamics_inner<T>(&hd_data->h_c[k*NUM_VEL], s_vaf, in.qd, USE_QDD_FLAG ? in.u : nullptr, s_ag, s_X, d_robotModel->d_XImats, &contacts);
+}
+
+template <typename T, bool USE_COMPRESSED_MEM>
+inline void fb_direct_minv_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_direct_minv_inner<T>(&hd_data->h_Minv[k*NUM_VEL*NUM_VEL], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T, bool USE_COMPRESSED_MEM>
+inline void fb_direct_minv_packed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_direct_minv_inner<T,true>(&hd_data->h_Minv_packed[k*SYM_PACKED_SIZE], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T>
+inline void fb_forward_dynamics_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_ag[6];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+	const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+	fb_forward_dynamics_inner<T>(&hd_data->h_qdd[k*NUM_VEL], in.qd, in.u, s_ag, s_X, d_robotModel->d_XImats, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG, bool USE_COMPRESSED_MEM>
+inline void fb_inverse_dynamics_gradient_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q_QD : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_c[NUM_VEL]; T s_vaf[18*(NUM_JOINTS + 1)]; T s_ag[6];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+	const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+	fb_inverse_dynamics_inner<T>(s_c, s_vaf, in.qd, USE_QDD_FLAG ? in.u : nullptr, s_ag, s_X, d_robotModel->d_XImats, &contacts);
+	fb_inverse_dynamics_gradient_inner<T>(&hd_data->h_dc_du[k*2*NUM_VEL*NUM_VEL], s_vaf, in.qd, s_ag, s_X, d_robotModel->d_XImats, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG>
+inline void fb_forward_dynamics_gradient_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_ag[6];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+	// with USE_QDD_FLAG the u input already holds qdd
+	T *s_qdd = &hd_data->h_qdd[k*NUM_VEL];
+	if (USE_QDD_FLAG){for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = in.u[i];}}
+	const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+	fb_forward_dynamics_gradient_inner<T,USE_QDD_FLAG>(&hd_data->h_df_du[k*2*NUM_VEL*NUM_VEL], s_qdd, in.qd, in.u,
+	                                                   s_ag, s_X, d_robotModel->d_XImats, &contacts);
+}
+
+template <typename T>
+inline void fb_forward_dynamics_ltl_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_ag[6];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+	const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+	fb_forward_dynamics_ltl_inner<T>(&hd_data->h_qdd[k*NUM_VEL], in.qd, in.u, s_ag, s_X, d_robotModel->d_XImats, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG>
+inline void fb_forward_dynamics_gradient_ltl_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_ag[6];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+	T *s_qdd = &hd_data->h_qdd[k*NUM_VEL];
+	if (USE_QDD_FLAG){for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = in.u[i];}}
+	const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+	fb_forward_dynamics_gradient_ltl_inner<T,USE_QDD_FLAG>(&hd_data->h_df_du[k*2*NUM_VEL*NUM_VEL], s_qdd, in.qd, in.u,
+	                                                       s_ag, s_X, d_robotModel->d_XImats, &contacts);
+}
+
+// The base pose and velocity place the root frame of the limb kinematics (see end_effector_kinematics_inner)
+template <typename T, int OUTPUTS, bool USE_QDD_FLAG>
+inline void fb_end_effector_kinematics_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_vaf[18*(NUM_JOINTS + 1)]; T R0[9];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_base_rotation<T>(R0, &in.q[3]);
+	if (OUTPUTS & EE_C){
+		T s_ag[6]; fb_base_gravity<T>(s_ag, &in.q[3], gravity);
+		const timestepContacts<T> contacts = fb_base_frame_contacts<T>(in.q, hd_data, k);
+		fb_inverse_dynamics_inner<T>(&hd_data->h_c[k*NUM_VEL], s_vaf, in.qd, USE_QDD_FLAG ? in.u : nullptr, s_ag, s_X, d_robotModel->d_XImats, &contacts);
+	}
+	end_effector_kinematics_inner<T,OUTPUTS>((OUTPUTS & EE_POSE) ? &hd_data->h_eePos[k*6*NUM_EES] : nullptr,
+	                                         (OUTPUTS & EE_JACOBIAN) ? &hd_data->h_eeJacobian[k*6*NUM_EES*NUM_VEL] : nullptr,
+	                                         (OUTPUTS & EE_JDOT_QD) ? &hd_data->h_eeJdqd[k*6*NUM_EES] : nullptr,
+	                                         in.qd, s_X, (OUTPUTS & EE_C) ? &s_vaf[6] : nullptr, R0, in.q, in.qd);
+}
+
+template <typename T>
+inline void fb_crba_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_crba_inner<T>(&hd_data->h_M[k*NUM_VEL*NUM_VEL], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T>
+inline void fb_crba_packed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, &in.q[BASE_POS], hd_data, d_robotModel, k);
+	fb_crba_inner<T,true>(&hd_data->h_M_packed[k*SYM_PACKED_SIZE], s_X, d_robotModel->d_XImats);
+}
@@ -0,0 +1,320 @@
+/**************************************************************************
+ *  Batched host helpers
+ *
+ *  One timestep of each algorithm from gridData inputs to gridData outputs.
+ *  The public ALGORITHM / ALGORITHM_compute_only / ALGORITHM_single_timing
+ *  wrappers around these are emitted by GRiDCPUCodeGenerator.
+ **************************************************************************/
+
+// q, qd and u (or qdd with USE_QDD_FLAG) of timestep k, nullptr where the input has no such block
+template <typename T>
+struct timestepInputs {const T *q; const T *qd; const T *u;};
+
+/**
+ * Resolves the inputs of timestep k for an algorithm that reads PACKING from the grid.cuh layouts.
+ * Packed inputs always read h_q_qd_u and input views read the caller's buffers (see use_input_views).
+ */
+template <typename T, int PACKING>
+inline timestepInputs<T> timestep_inputs(const gridData<T> *hd_data, const int k){
+	timestepInputs<T> in;
+	if (hd_data->input_mode == INPUTS_VIEWS){
+		in.q = hd_data->q_view.at(k); in.qd = hd_data->qd_view.at(k); in.u = hd_data->u_view.at(k);
+	}
+	else if (PACKING == PACKING_Q_QD_U || hd_data->input_mode == INPUTS_PACKED){
+		in.q = &hd_data->h_q_qd_u[k*Q_QD_U_STRIDE]; in.qd = &in.q[NUM_POS]; in.u = &in.q[NUM_POS + NUM_VEL];
+	}
+	else if (PACKING == PACKING_Q_QD){
+		in.q = &hd_data->h_q_qd[k*Q_QD_STRIDE]; in.qd = &in.q[NUM_POS]; in.u = nullptr;
+	}
+	else {
+		in.q = &hd_data->h_q[k*Q_STRIDE]; in.qd = nullptr; in.u = nullptr;
+	}
+	return in;
+}
+
+// External wrenches of timestep k (none unless enable_contacts was called)
+template <typename T>
+inline timestepContacts<T> timestep_contacts(const gridData<T> *hd_data, const int k){
+	timestepContacts<T> contacts; contacts.count = 0; contacts.body = nullptr; contacts.wrench = nullptr;
+	const contactList<T> *list = hd_data->contacts;
+	if (list != nullptr && k < list->num_timesteps){
+		const int first = k*list->max_contacts;
+		contacts.count = list->count[k]; contacts.body = &list->body[first]; contacts.wrench = &list->wrench[6*first];
+	}
+	return contacts;
+}
+
+// Transforms of timestep k: served from the gridData kinematics cache when q is unchanged, else built into s_X_buf
+template <typename T>
+inline const T *load_update_XImats_cached(T *s_X_buf, const T *s_q, gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	kinematicsCache<T> *cache = hd_data->kinematics_cache;
+	if (cache == nullptr || k >= cache->num_timesteps){
+		load_update_XImats_helpers<T>(s_X_buf, s_q, d_robotModel->d_XImats);
+		return s_X_buf;
+	}
+	T *s_X = &cache->X[k*36*NUM_JOINTS]; T *s_q_cached = &cache->q[k*NUM_JOINTS];
+	const unsigned long long key = kinematics_fingerprint<T>(s_q);
+	if (cache->key[k] == key && memcmp(s_q_cached, s_q, NUM_JOINTS*sizeof(T)) == 0){
+		cache->hits.fetch_add(1, std::memory_order_relaxed);
+		return s_X;
+	}
+	cache->misses.fetch_add(1, std::memory_order_relaxed);
+	load_update_XImats_helpers<T>(s_X, s_q, d_robotModel->d_XImats);
+	memcpy(s_q_cached, s_q, NUM_JOINTS*sizeof(T));
+	cache->key[k] = key;
+	return s_X;
+}
+
+// Runs a batch with the tuned thread count and grain of this call (see tuning.hpp), label is the timing label
+template <typename T, typename Func>
+inline void run_batch(const char *label, hostThreads *threads, const int num_timesteps, Func &f){
+	if (threads == nullptr){threads = grid_cpu::default_threads();}
+	grid_cpu::tuningConfig config;
+	if (grid_cpu::tuning_cache().lookup(config, ROBOT_NAME, label, sizeof(T), num_timesteps)){
+		threads->parallel_for(num_timesteps, f, config.grain, config.threads);
+		return;
+	}
+	threads->parallel_for(num_timesteps, f);
+}
+
+// A HOST_API entry as swept by autotune (its _compute_only wrapper with the default template arguments)
+template <typename T>
+struct autotuneTarget {
+	const char *label;
+	void (*run)(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int num_timesteps);
+};
+
+template <typename Func>
+inline void run_single_timing(const char *name, const int num_reps, Func &f){
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC,&start);
+	for (int rep = 0; rep < num_reps; rep++){f(0);}
+	clock_gettime(CLOCK_MONOTONIC,&end);
+	printf("Single Call %s %fus\n", name, time_delta_us_timespec(start,end)/static_cast<double>(num_reps));
+}
+
+template <typename T, bool USE_QDD_FLAG, bool USE_COMPRESSED_MEM>
+inline void inverse_dynamics_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q_QD : PACKING_Q_QD_U>(hd_data,k);
+	const T *s_qdd = USE_QDD_FLAG ? in.u : nullptr;
+	T s_X_buf[36*NUM_JOINTS]; T s_vaf[18*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	inverse_dynamics_inner<T>(&hd_data->h_c[k*NUM_VEL], s_vaf, in.qd, s_qdd, s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+template <typename T, bool USE_COMPRESSED_MEM>
+inline void direct_minv_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	direct_minv_inner<T>(&hd_data->h_Minv[k*NUM_VEL*NUM_VEL], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T, bool USE_COMPRESSED_MEM>
+inline void direct_minv_packed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	direct_minv_inner<T,true>(&hd_data->h_Minv_packed[k*SYM_PACKED_SIZE], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T>
+inline void forward_dynamics_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	forward_dynamics_inner<T>(&hd_data->h_qdd[k*NUM_VEL], in.qd, in.u, s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG, bool USE_COMPRESSED_MEM>
+inline void inverse_dynamics_gradient_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q_QD : PACKING_Q_QD_U>(hd_data,k);
+	const T *s_qdd = USE_QDD_FLAG ? in.u : nullptr;
+	T s_X_buf[36*NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_c[NUM_VEL];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	inverse_dynamics_inner<T>(s_c, s_vaf, in.qd, s_qdd, s_X, d_robotModel->d_XImats, gravity, &contacts);
+	inverse_dynamics_gradient_inner<T>(&hd_data->h_dc_du[k*2*NUM_VEL*NUM_VEL], s_vaf, in.qd, s_X, d_robotModel->d_XImats, gravity, 0, 0, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG>
+inline void forward_dynamics_gradient_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	// with USE_QDD_FLAG the u input already holds qdd
+	T *s_qdd = &hd_data->h_qdd[k*NUM_VEL];
+	if (USE_QDD_FLAG){for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = in.u[i];}}
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	forward_dynamics_gradient_inner<T,USE_QDD_FLAG>(&hd_data->h_df_du[k*2*NUM_VEL*NUM_VEL], s_qdd, in.qd, in.u,
+	                                                s_X, d_robotModel->d_XImats, gravity, 0, 0, &contacts);
+}
+
+template <typename T>
+inline void forward_dynamics_ltl_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	forward_dynamics_ltl_inner<T>(&hd_data->h_qdd[k*NUM_VEL], in.qd, in.u, s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG>
+inline void forward_dynamics_gradient_ltl_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	// with USE_QDD_FLAG the u input already holds qdd
+	T *s_qdd = &hd_data->h_qdd[k*NUM_VEL];
+	if (USE_QDD_FLAG){for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = in.u[i];}}
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	forward_dynamics_gradient_ltl_inner<T,USE_QDD_FLAG>(&hd_data->h_df_du[k*2*NUM_VEL*NUM_VEL], s_qdd, in.qd, in.u,
+	                                                    s_X, d_robotModel->d_XImats, gravity, 0, 0, &contacts);
+}
+
+template <typename T>
+inline void aba_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	aba_inner<T>(&hd_data->h_qdd[k*NUM_VEL], in.qd, in.u, s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+template <typename T>
+inline void crba_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	crba_inner<T>(&hd_data->h_M[k*NUM_VEL*NUM_VEL], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T>
+inline void crba_packed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	crba_inner<T,true>(&hd_data->h_M_packed[k*SYM_PACKED_SIZE], s_X, d_robotModel->d_XImats);
+}
+
+template <typename T, bool USE_COMPRESSED_MEM>
+inline void end_effector_positions_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	end_effector_positions_inner<T>(&hd_data->h_eePos[k*6*NUM_EES], s_X);
+}
+
+template <typename T, bool USE_COMPRESSED_MEM>
+inline void end_effector_positions_gradient_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	end_effector_positions_gradient_inner<T>(&hd_data->h_deePos[k*6*NUM_EES*NUM_JOINTS], in.q, d_robotModel->d_XImats);
+}
+
+// Mixed precision variants: transforms and RNEA passes in T, Minv and the products with it in T_ACC
+template <typename T, typename T_ACC, bool USE_COMPRESSED_MEM>
+inline void direct_minv_mixed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q : PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T_ACC s_Minv[NUM_VEL*NUM_VEL];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	direct_minv_mixed_inner<T,T_ACC>(s_Minv, s_X, d_robotModel->d_XImats);
+	T *out = &hd_data->h_Minv[k*NUM_VEL*NUM_VEL];
+	for (int i = 0; i < NUM_VEL*NUM_VEL; i++){out[i] = static_cast<T>(s_Minv[i]);}
+}
+
+template <typename T, typename T_ACC>
+inline void forward_dynamics_mixed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	forward_dynamics_mixed_inner<T,T_ACC>(&hd_data->h_qdd[k*NUM_VEL], in.qd, in.u, s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+template <typename T, typename T_ACC, bool USE_QDD_FLAG>
+inline void forward_dynamics_gradient_mixed_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	T *s_qdd = &hd_data->h_qdd[k*NUM_VEL];
+	if (USE_QDD_FLAG){for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = in.u[i];}}
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	forward_dynamics_gradient_mixed_inner<T,T_ACC,USE_QDD_FLAG>(&hd_data->h_df_du[k*2*NUM_VEL*NUM_VEL], s_qdd, in.qd, in.u,
+	                                                            s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+// gridData buffers written by dynamics_bundle<T,OUTPUTS>
+constexpr unsigned bundle_buffers(const int OUTPUTS){
+	return ((OUTPUTS & BUNDLE_C) ? static_cast<unsigned>(BUFFER_C) : 0u) | ((OUTPUTS & BUNDLE_MINV) ? static_cast<unsigned>(BUFFER_MINV) : 0u) |
+	       ((OUTPUTS & BUNDLE_QDD) ? static_cast<unsigned>(BUFFER_QDD) : 0u) | ((OUTPUTS & BUNDLE_DC_DU) ? static_cast<unsigned>(BUFFER_DC_DU) : 0u) |
+	       ((OUTPUTS & BUNDLE_DF_DU) ? static_cast<unsigned>(BUFFER_DF_DU) : 0u);
+}
+
+template <typename T, int OUTPUTS>
+inline void dynamics_bundle_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	// unselected outputs may not be allocated (see bundle_buffers)
+	dynamics_bundle_inner<T,OUTPUTS>((OUTPUTS & BUNDLE_C) ? &hd_data->h_c[k*NUM_VEL] : nullptr,
+	                                 (OUTPUTS & BUNDLE_MINV) ? &hd_data->h_Minv[k*NUM_VEL*NUM_VEL] : nullptr,
+	                                 (OUTPUTS & BUNDLE_QDD) ? &hd_data->h_qdd[k*NUM_VEL] : nullptr,
+	                                 (OUTPUTS & BUNDLE_DC_DU) ? &hd_data->h_dc_du[k*2*NUM_VEL*NUM_VEL] : nullptr,
+	                                 (OUTPUTS & BUNDLE_DF_DU) ? &hd_data->h_df_du[k*2*NUM_VEL*NUM_VEL] : nullptr,
+	                                 in.qd, in.u, s_X, d_robotModel->d_XImats, gravity, &contacts);
+}
+
+// gridData buffers written by end_effector_kinematics<T,OUTPUTS>
+constexpr unsigned ee_kinematics_buffers(const int OUTPUTS){
+	return ((OUTPUTS & EE_POSE) ? static_cast<unsigned>(BUFFER_EEPOS) : 0u) | ((OUTPUTS & EE_JACOBIAN) ? static_cast<unsigned>(BUFFER_EE_JACOBIAN) : 0u) |
+	       ((OUTPUTS & EE_JDOT_QD) ? static_cast<unsigned>(BUFFER_EE_JDQD) : 0u) | ((OUTPUTS & EE_C) ? static_cast<unsigned>(BUFFER_C) : 0u);
+}
+
+// With EE_C the RNEA pass (qdd from u with USE_QDD_FLAG, else 0) shares the transforms and its velocities feed Jdot*qd
+template <typename T, int OUTPUTS, bool USE_QDD_FLAG>
+inline void end_effector_kinematics_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_vaf[18*NUM_JOINTS];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	if (OUTPUTS & EE_C){
+		const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+		inverse_dynamics_inner<T>(&hd_data->h_c[k*NUM_VEL], s_vaf, in.qd, USE_QDD_FLAG ? in.u : nullptr, s_X, d_robotModel->d_XImats, gravity, &contacts);
+	}
+	// unselected outputs may not be allocated (see ee_kinematics_buffers)
+	end_effector_kinematics_inner<T,OUTPUTS>((OUTPUTS & EE_POSE) ? &hd_data->h_eePos[k*6*NUM_EES] : nullptr,
+	                                         (OUTPUTS & EE_JACOBIAN) ? &hd_data->h_eeJacobian[k*6*NUM_EES*NUM_VEL] : nullptr,
+	                                         (OUTPUTS & EE_JDOT_QD) ? &hd_data->h_eeJdqd[k*6*NUM_EES] : nullptr,
+	                                         in.qd, s_X, (OUTPUTS & EE_C) ? s_vaf : nullptr);
+}
+
+// PACKED writes SO_PACKED_SIZE values per timestep to h_idsva_so_packed / h_df2_packed instead
+template <typename T, bool PACKED>
+inline void idsva_so_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	idsva_so_inner<T,PACKED>(PACKED ? &hd_data->h_idsva_so_packed[k*SO_PACKED_SIZE] : &hd_data->h_idsva_so[k*SO_DENSE_SIZE], in.q, in.qd, in.u,
+	                  d_robotModel->d_XImats, gravity);
+}
+
+template <typename T, bool PACKED>
+inline void fdsva_so_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	fdsva_so_inner<T,PACKED>(PACKED ? &hd_data->h_df2_packed[k*SO_PACKED_SIZE] : &hd_data->h_df2[k*SO_DENSE_SIZE], in.q, in.qd, in.u,
+	                  d_robotModel->d_XImats, gravity);
+}
+
+template <typename T>
+inline void idsva_so_contracted_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	idsva_so_contracted_inner<T>(&hd_data->h_idsva_so_contracted[k*4*NUM_VEL*NUM_VEL], &hd_data->h_lambda[k*NUM_VEL], in.q, in.qd,
+	                             in.u, d_robotModel->d_XImats, gravity);
+}
+
+template <typename T>
+inline void fdsva_so_contracted_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	fdsva_so_contracted_inner<T>(&hd_data->h_df2_contracted[k*4*NUM_VEL*NUM_VEL], &hd_data->h_lambda[k*NUM_VEL], in.q, in.qd,
+	                             in.u, d_robotModel->d_XImats, gravity);
+}
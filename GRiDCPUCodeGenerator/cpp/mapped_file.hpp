@@ -0,0 +1,111 @@
+/**************************************************************************
+ *  Memory-mapped files
+ *
+ *  Read-only or freshly created read-write mappings of a whole file, with
+ *  the two hints a sequential streaming pass needs: prefetch a byte range
+ *  ahead of use, and drop a range that has been consumed so resident
+ *  memory stays bounded however large the file is. Written pages live in
+ *  the page cache, so dropping them does not lose data.
+ **************************************************************************/
+#ifndef GRID_CPU_MAPPED_FILE_HPP
+#define GRID_CPU_MAPPED_FILE_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace grid_cpu {
+
+class mappedFile {
+public:
+	mappedFile() : fd(-1), ptr(nullptr), bytes(0), writable(false), prefetch_sink(0) {}
+	~mappedFile(){close();}
+
+	bool open_read(const char *path){
+		close();
+		fd = ::open(path, O_RDONLY);
+		if (fd < 0){return false;}
+		struct stat st;
+		if (fstat(fd, &st) != 0){close(); return false;}
+		bytes = static_cast<size_t>(st.st_size);
+		return map(PROT_READ, MAP_PRIVATE);
+	}
+
+	// Creates (or truncates) path at exactly size bytes
+	bool create(const char *path, const size_t size){
+		close();
+		fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0){return false;}
+		bytes = size; writable = true;
+		// reserve the blocks up front so first writes do not allocate on the filesystem
+		if (bytes > 0 && posix_fallocate(fd, 0, static_cast<off_t>(bytes)) != 0 && ftruncate(fd, static_cast<off_t>(bytes)) != 0){close(); return false;}
+		return map(PROT_READ | PROT_WRITE, MAP_SHARED);
+	}
+
+	// Faults in [offset, offset + len) ahead of use (reads one value per page)
+	void prefetch(const size_t offset, size_t len) const {
+		if (ptr == nullptr || offset >= bytes){return;}
+		if (len > bytes - offset){len = bytes - offset;}
+		const size_t page = page_bytes(), begin = offset / page * page;
+		madvise(ptr + begin, offset + len - begin, MADV_WILLNEED);
+		if (writable){return;} // touching output pages would only map them read-only
+		unsigned char sink = 0;
+		for (size_t i = offset; i < offset + len; i += page){sink ^= *reinterpret_cast<volatile const unsigned char *>(ptr + i);}
+		prefetch_sink = sink;
+	}
+
+	// Drops the whole pages of [offset, offset + len) from this process (written pages are queued for writeback)
+	void release(const size_t offset, size_t len) const {
+		if (ptr == nullptr || offset >= bytes){return;}
+		if (len > bytes - offset){len = bytes - offset;}
+		const size_t page = page_bytes();
+		const size_t begin = round_up(offset, page), end = (offset + len) / page * page;
+		if (end <= begin){return;}
+		if (writable){msync(ptr + begin, end - begin, MS_ASYNC);}
+		madvise(ptr + begin, end - begin, MADV_DONTNEED);
+	}
+
+	// Unmaps and closes (flushing a writable mapping); returns false if the flush failed
+	bool close(){
+		bool ok = true;
+		if (ptr != nullptr){
+			if (writable){ok = msync(ptr, bytes, MS_SYNC) == 0;}
+			munmap(ptr, bytes);
+		}
+		if (fd >= 0){::close(fd);}
+		fd = -1; ptr = nullptr; bytes = 0; writable = false;
+		return ok;
+	}
+
+	char *data() const {return ptr;}
+	size_t size() const {return bytes;}
+	bool is_open() const {return fd >= 0;}
+
+	static size_t page_bytes(){
+		static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		return page;
+	}
+
+private:
+	bool map(const int prot, const int flags){
+		if (bytes == 0){return true;} // nothing to map, data() stays nullptr
+		void *p = mmap(nullptr, bytes, prot, flags, fd, 0);
+		if (p == MAP_FAILED){close(); return false;}
+		ptr = static_cast<char *>(p);
+		madvise(ptr, bytes, MADV_SEQUENTIAL);
+		return true;
+	}
+
+	int fd;
+	char *ptr;
+	size_t bytes;
+	bool writable;
+	mutable unsigned char prefetch_sink; // keeps the prefetch reads from being optimized out
+
+	mappedFile(const mappedFile&) = delete;
+	mappedFile& operator=(const mappedFile&) = delete;
+};
+
+} // namespace grid_cpu
+
+#endif
@@ -0,0 +1,262 @@
+/**************************************************************************
+ *  Multi-robot model registry and shared scheduler
+ *
+ *  Every generated model (one per FILE_NAMESPACE) registers a type erased
+ *  modelDescriptor with its dimensions, workspace size and entry points
+ *  through its register_model<T>(). One fleetScheduler serves any number
+ *  of registered models from a single pool of worker threads: its dispatch
+ *  thread collects the submitted requests, groups them per model and
+ *  algorithm, and runs the timesteps of each group as one parallel batch,
+ *  so many small per robot requests still keep every core busy.
+ *
+ *      grid_cpu::fleetScheduler<double> fleet;
+ *      int arm = fleet.add_model(iiwa::register_model<double>());
+ *      int dog = fleet.add_model("hyq");               // registered elsewhere
+ *      fleetScheduler<double>::request *req = fleet.acquire(arm);
+ *      fill fleet.inputs(req)                          // h_q_qd_u layout of iiwa
+ *      fleet.submit(req, FLEET_FD, num_timesteps);
+ *      fleet.wait(req);
+ *      read fleet.output(req)
+ *      fleet.release(req);
+ **************************************************************************/
+#ifndef GRID_CPU_REGISTRY_HPP
+#define GRID_CPU_REGISTRY_HPP
+
+#include <algorithm>
+#include <deque>
+
+namespace grid_cpu {
+
+enum fleetAlgorithm {FLEET_ID = 0, FLEET_MINV, FLEET_FD, FLEET_ID_DU, FLEET_FD_DU, FLEET_ABA, FLEET_CRBA,
+                     FLEET_EEPOS, FLEET_DEEPOS, FLEET_NUM_ALGORITHMS};
+
+// Everything the scheduler needs from a generated model, with gridData and robotModel passed as void *
+template <typename T>
+struct modelDescriptor {
+	const char *name;   // FILE_NAMESPACE
+	const char *robot;  // robot name of the URDF
+	int num_joints;
+	int num_vel;
+	int num_ees;
+	int q_qd_u_stride;
+	int output_stride[FLEET_NUM_ALGORITHMS];       // T per timestep of each algorithm's output
+	size_t (*workspace_bytes)(int max_timesteps);  // gridData bytes of init_gridData below
+	void *(*init_robotModel)();
+	void (*free_robotModel)(void *d_robotModel);
+	void *(*init_gridData)(int max_timesteps);     // inputs and every fleet output allocated up front
+	void (*free_gridData)(void *hd_data);
+	T *(*inputs)(void *hd_data);                   // h_q_qd_u
+	T *(*output)(void *hd_data, int algorithm);
+	void (*run_timestep)(int algorithm, void *hd_data, const void *d_robotModel, T gravity, int k);
+};
+
+// Process wide table of the registered models of precision T
+template <typename T>
+class modelRegistry {
+public:
+	static modelRegistry &instance(){static modelRegistry registry; return registry;}
+
+	// Registers desc unless a model of the same name already is, and returns the registered descriptor
+	const modelDescriptor<T> *add(const modelDescriptor<T> &desc){
+		std::unique_lock<std::mutex> lock(mtx);
+		for (const modelDescriptor<T> &model : models){if (!strcmp(model.name, desc.name)){return &model;}}
+		models.push_back(desc);
+		return &models.back();
+	}
+
+	// nullptr if no model of that name is registered
+	const modelDescriptor<T> *find(const char *name){
+		std::unique_lock<std::mutex> lock(mtx);
+		for (const modelDescriptor<T> &model : models){if (!strcmp(model.name, name)){return &model;}}
+		return nullptr;
+	}
+
+	int size(){std::unique_lock<std::mutex> lock(mtx); return static_cast<int>(models.size());}
+	const modelDescriptor<T> *at(const int i){std::unique_lock<std::mutex> lock(mtx); return &models[i];}
+
+private:
+	modelRegistry(){}
+	std::mutex mtx;
+	std::deque<modelDescriptor<T> > models;  // deque so registered descriptors never move
+};
+
+template <typename T>
+class fleetScheduler {
+	struct fleetModel;
+public:
+	enum requestState {REQUEST_FREE = 0, REQUEST_ACQUIRED, REQUEST_QUEUED, REQUEST_DONE};
+
+	struct request {
+		int model;
+		int algorithm;
+		int num_timesteps;
+		void *hd_data;  // the model's gridData<T>
+		std::atomic<int> state;
+		fleetModel *owner;
+	};
+
+	explicit fleetScheduler(const int num_threads = 0) : threads(num_threads){
+		shutdown = false; num_batches = 0; num_requests = 0;
+		dispatcher = std::thread([this](){dispatch_loop();});
+	}
+
+	~fleetScheduler(){
+		{std::unique_lock<std::mutex> lock(mtx); shutdown = true;}
+		wake_cv.notify_all();
+		dispatcher.join();
+		for (fleetModel &model : models){
+			for (request *req : model.requests){model.desc->free_gridData(req->hd_data); delete req;}
+			model.desc->free_robotModel(model.d_robotModel);
+		}
+	}
+
+	/**
+	 * Serves a registered model with its own robotModel and gravity from queue_depth request
+	 * buffers of max_timesteps each (allocated now). Returns the id passed to acquire.
+	 */
+	int add_model(const modelDescriptor<T> *desc, const T gravity = static_cast<T>(9.81), const int max_timesteps = 1024, const int queue_depth = 8){
+		if (desc == nullptr){printf("[!Error] fleetScheduler::add_model given no model\n"); return -1;}
+		std::unique_lock<std::mutex> lock(mtx);
+		models.emplace_back();
+		fleetModel &model = models.back();
+		model.desc = desc; model.gravity = gravity; model.max_timesteps = max_timesteps;
+		model.d_robotModel = desc->init_robotModel();
+		const int id = static_cast<int>(models.size()) - 1;
+		for (int i = 0; i < queue_depth; i++){
+			request *req = new request;
+			req->model = id; req->owner = &model; req->hd_data = desc->init_gridData(max_timesteps); req->state.store(REQUEST_FREE);
+			model.requests.push_back(req); model.free_slots.push_back(req);
+		}
+		return id;
+	}
+
+	int add_model(const char *name, const T gravity = static_cast<T>(9.81), const int max_timesteps = 1024, const int queue_depth = 8){
+		const modelDescriptor<T> *desc = modelRegistry<T>::instance().find(name);
+		if (desc == nullptr){printf("[!Error] no model named %s is registered\n", name); return -1;}
+		return add_model(desc, gravity, max_timesteps, queue_depth);
+	}
+
+	// Claims a free buffer of the model (nullptr if all of them are in flight)
+	request *acquire(const int model_id){
+		std::unique_lock<std::mutex> lock(mtx);
+		if (model_id < 0 || model_id >= static_cast<int>(models.size())){return nullptr;}
+		fleetModel &model = models[model_id];
+		if (model.free_slots.empty()){return nullptr;}
+		request *req = model.free_slots.back(); model.free_slots.pop_back();
+		req->state.store(REQUEST_ACQUIRED, std::memory_order_relaxed);
+		return req;
+	}
+
+	T *inputs(request *req){return req->owner->desc->inputs(req->hd_data);}
+	T *output(request *req){return req->owner->desc->output(req->hd_data, req->algorithm);}
+
+	// Queues an acquired buffer whose inputs are filled in
+	bool submit(request *req, const int algorithm, const int num_timesteps){
+		if (req == nullptr || algorithm < 0 || algorithm >= FLEET_NUM_ALGORITHMS || num_timesteps < 0 ||
+		    num_timesteps > req->owner->max_timesteps){return false;}
+		req->algorithm = algorithm; req->num_timesteps = num_timesteps;
+		req->state.store(REQUEST_QUEUED, std::memory_order_relaxed);
+		{std::unique_lock<std::mutex> lock(mtx); pending.push_back(req);}
+		wake_cv.notify_one();
+		return true;
+	}
+
+	bool done(const request *req) const {return req->state.load(std::memory_order_acquire) == REQUEST_DONE;}
+
+	// Spins briefly and then yields until the request completes
+	void wait(const request *req) const {
+		for (int spin = 0; !done(req); spin++){
+			if (spin < (1 << 12)){cpu_relax();} else {std::this_thread::yield();}
+		}
+	}
+
+	// Hands the buffer back once its outputs have been read
+	void release(request *req){
+		std::unique_lock<std::mutex> lock(mtx);
+		req->state.store(REQUEST_FREE, std::memory_order_relaxed);
+		req->owner->free_slots.push_back(req);
+	}
+
+	int num_models(){std::unique_lock<std::mutex> lock(mtx); return static_cast<int>(models.size());}
+	const modelDescriptor<T> *descriptor(const int model_id){std::unique_lock<std::mutex> lock(mtx); return models[model_id].desc;}
+
+	// gridData bytes of every request buffer of every model
+	size_t workspace_bytes(){
+		std::unique_lock<std::mutex> lock(mtx);
+		size_t bytes = 0;
+		for (const fleetModel &model : models){bytes += model.requests.size()*model.desc->workspace_bytes(model.max_timesteps);}
+		return bytes;
+	}
+
+	// parallel batches run and requests served so far (requests / batches is the mean grouping)
+	unsigned long long batches() const {return num_batches.load();}
+	unsigned long long requests() const {return num_requests.load();}
+
+	int size() const {return threads.size();}
+
+private:
+	struct fleetModel {
+		const modelDescriptor<T> *desc;
+		void *d_robotModel;
+		T gravity;
+		int max_timesteps;
+		std::vector<request *> requests;
+		std::vector<request *> free_slots;
+	};
+
+	static bool group_order(const request *a, const request *b){
+		return a->model != b->model ? a->model < b->model : a->algorithm < b->algorithm;
+	}
+
+	// Runs the timesteps of every request in [first, last) (same model and algorithm) as one batch
+	void run_group(request **first, request **last){
+		const fleetModel &model = *(*first)->owner;
+		const int count = static_cast<int>(last - first); const int algorithm = (*first)->algorithm;
+		offsets.assign(1, 0);
+		for (int r = 0; r < count; r++){offsets.push_back(offsets.back() + first[r]->num_timesteps);}
+		const int *offset = offsets.data();
+		auto f = [&](int idx){
+			const int r = static_cast<int>(std::upper_bound(offset, offset + count + 1, idx) - offset) - 1;
+			model.desc->run_timestep(algorithm, first[r]->hd_data, model.d_robotModel, model.gravity, idx - offset[r]);
+		};
+		threads.parallel_for(offsets.back(), f);
+		for (int r = 0; r < count; r++){first[r]->state.store(REQUEST_DONE, std::memory_order_release);}
+		num_batches.fetch_add(1); num_requests.fetch_add(count);
+	}
+
+	void dispatch_loop(){
+		std::vector<request *> batch;
+		while (true){
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				wake_cv.wait(lock, [&]{return shutdown || !pending.empty();});
+				if (pending.empty()){return;}
+				batch.swap(pending);
+			}
+			std::stable_sort(batch.begin(), batch.end(), group_order);
+			for (size_t begin = 0, end = 0; begin < batch.size(); begin = end){
+				for (end = begin + 1; end < batch.size() && !group_order(batch[begin], batch[end]) && !group_order(batch[end], batch[begin]); end++){}
+				run_group(&batch[begin], &batch[0] + end);
+			}
+			batch.clear();
+		}
+	}
+
+	hostThreads threads;
+	std::deque<fleetModel> models;  // deque so add_model never moves a model a request points to
+	std::vector<request *> pending;
+	std::vector<int> offsets;
+	std::thread dispatcher;
+	std::mutex mtx;
+	std::condition_variable wake_cv;
+	std::atomic<unsigned long long> num_batches;
+	std::atomic<unsigned long long> num_requests;
+	bool shutdown;
+
+	fleetScheduler(const fleetScheduler&) = delete;
+	fleetScheduler& operator=(const fleetScheduler&) = delete;
+};
+
+} // namespace grid_cpu
+
+#endif
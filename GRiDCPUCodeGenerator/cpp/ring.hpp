@@ -0,0 +1,137 @@
+/**************************************************************************
+ *  Lock-free request ring and latency histogram
+ *
+ *  boundedRing is a fixed capacity multi-producer / multi-consumer queue
+ *  (sequence numbered cells, after Vyukov) that never allocates after
+ *  construction. latencyHistogram records samples into fixed log-linear
+ *  buckets with atomic counters so tail percentiles (p50/p99/p99.9) can be
+ *  read at any time without locks or per-sample storage.
+ **************************************************************************/
+#ifndef GRID_CPU_RING_HPP
+#define GRID_CPU_RING_HPP
+
+namespace grid_cpu {
+
+template <typename T, int CAPACITY>
+class boundedRing {
+	static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "boundedRing CAPACITY must be a power of two");
+public:
+	boundedRing(){
+		for (int i = 0; i < CAPACITY; i++){cells[i].seq.store(static_cast<size_t>(i), std::memory_order_relaxed);}
+		head.store(0, std::memory_order_relaxed); tail.store(0, std::memory_order_relaxed);
+	}
+
+	// returns false if the ring is full
+	bool push(const T &val){
+		size_t pos = tail.load(std::memory_order_relaxed);
+		while (true){
+			cell &c = cells[pos & (CAPACITY - 1)];
+			const size_t seq = c.seq.load(std::memory_order_acquire);
+			const long diff = static_cast<long>(seq) - static_cast<long>(pos);
+			if (diff == 0){if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){c.data = val; c.seq.store(pos + 1, std::memory_order_release); return true;}}
+			else if (diff < 0){return false;}
+			else {pos = tail.load(std::memory_order_relaxed);}
+		}
+	}
+
+	// returns false if the ring is empty
+	bool pop(T &val){
+		size_t pos = head.load(std::memory_order_relaxed);
+		while (true){
+			cell &c = cells[pos & (CAPACITY - 1)];
+			const size_t seq = c.seq.load(std::memory_order_acquire);
+			const long diff = static_cast<long>(seq) - static_cast<long>(pos + 1);
+			if (diff == 0){if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){val = c.data; c.seq.store(pos + CAPACITY, std::memory_order_release); return true;}}
+			else if (diff < 0){return false;}
+			else {pos = head.load(std::memory_order_relaxed);}
+		}
+	}
+
+private:
+	struct cell {std::atomic<size_t> seq; T data;};
+	cell cells[CAPACITY];
+	char pad0[64];
+	std::atomic<size_t> head;
+	char pad1[64];
+	std::atomic<size_t> tail;
+	char pad2[64];
+
+	boundedRing(const boundedRing&) = delete;
+	boundedRing& operator=(const boundedRing&) = delete;
+};
+
+class latencyHistogram {
+public:
+	latencyHistogram(){reset();}
+
+	void reset(){
+		for (int i = 0; i < NUM_BUCKETS; i++){buckets[i].store(0, std::memory_order_relaxed);}
+		num_samples.store(0); total_ns.store(0); max_ns.store(0);
+	}
+
+	void record(const unsigned long long ns){
+		buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+		num_samples.fetch_add(1, std::memory_order_relaxed);
+		total_ns.fetch_add(ns, std::memory_order_relaxed);
+		unsigned long long prev = max_ns.load(std::memory_order_relaxed);
+		while (ns > prev && !max_ns.compare_exchange_weak(prev, ns, std::memory_order_relaxed)){}
+	}
+
+	unsigned long long count() const {return num_samples.load();}
+	double mean_us() const {return count() ? 1e-3*static_cast<double>(total_ns.load())/static_cast<double>(count()) : 0.0;}
+	double max_us() const {return 1e-3*static_cast<double>(max_ns.load());}
+
+	// upper edge of the bucket holding the p-th percentile (p in [0,100]); within 1/SUB_BUCKETS of the true value
+	double percentile_us(const double p) const {
+		const unsigned long long n = count(); if (n == 0){return 0.0;}
+		unsigned long long rank = static_cast<unsigned long long>(std::ceil(p/100.0*static_cast<double>(n)));
+		if (rank == 0){rank = 1;}
+		unsigned long long seen = 0;
+		for (int i = 0; i < NUM_BUCKETS; i++){
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= rank){return 1e-3*static_cast<double>(bucket_upper(i) < max_ns.load() ? bucket_upper(i) : max_ns.load());}
+		}
+		return max_us();
+	}
+
+	void print(const char *label) const {
+		printf("%s: N[%llu] Average[%fus] p50[%fus] p90[%fus] p99[%fus] p99.9[%fus] Max[%fus]\n", label, count(), mean_us(),
+		       percentile_us(50), percentile_us(90), percentile_us(99), percentile_us(99.9), max_us());
+	}
+
+private:
+	// buckets are exact below SUB_BUCKETS ns and then split each power of two into SUB_BUCKETS pieces
+	static const int SUB_BITS = 4;
+	static const int SUB_BUCKETS = 1 << SUB_BITS;
+	static const int NUM_BUCKETS = (64 - SUB_BITS + 1)*SUB_BUCKETS;
+
+	static int bucket_of(const unsigned long long ns){
+		if (ns < static_cast<unsigned long long>(SUB_BUCKETS)){return static_cast<int>(ns);}
+		int msb = 63; while (!((ns >> msb) & 1ULL)){msb--;}
+		const int shift = msb - SUB_BITS;
+		return (shift + 1)*SUB_BUCKETS + static_cast<int>((ns >> shift) & (SUB_BUCKETS - 1));
+	}
+	static unsigned long long bucket_upper(const int bucket){
+		if (bucket < SUB_BUCKETS){return static_cast<unsigned long long>(bucket);}
+		const int shift = bucket/SUB_BUCKETS - 1;
+		const unsigned long long mantissa = static_cast<unsigned long long>(SUB_BUCKETS + bucket % SUB_BUCKETS);
+		return ((mantissa + 1) << shift) - 1;
+	}
+
+	std::atomic<unsigned long long> buckets[NUM_BUCKETS];
+	std::atomic<unsigned long long> num_samples;
+	std::atomic<unsigned long long> total_ns;
+	std::atomic<unsigned long long> max_ns;
+
+	latencyHistogram(const latencyHistogram&) = delete;
+	latencyHistogram& operator=(const latencyHistogram&) = delete;
+};
+
+inline unsigned long long monotonic_ns(){
+	struct timespec now; clock_gettime(CLOCK_MONOTONIC,&now);
+	return 1000000000ULL*static_cast<unsigned long long>(now.tv_sec) + static_cast<unsigned long long>(now.tv_nsec);
+}
+
+} // namespace grid_cpu
+
+#endif
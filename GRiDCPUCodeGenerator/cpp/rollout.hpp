@@ -0,0 +1,155 @@
+/**************************************************************************
+ *  Batched rollout engine (sampling based MPC, e.g., MPPI)
+ *
+ *  Simulates K control sequences of H steps forward from one initial state
+ *  x0 = [q; qd]. Each rollout keeps its state on its worker's stack for
+ *  all H steps and rollouts are spread across the worker threads, so there
+ *  is no per step call or gridData round trip. The dynamics are aba_inner
+ *  and the integrator is semi-implicit Euler or RK4 (u held over a step).
+ *
+ *      u        rollout r step t = u[(r*H + t)*NUM_JOINTS]          (K*H*NUM_JOINTS values)
+ *      states   rollout r step t = trajectory(r)[t*2*NUM_JOINTS]    (t = 0..H, t = 0 is x0)
+ *      costs    rollout r = sum_t cost(x_t, u_t, t) + cost(x_H, nullptr, H)
+ *
+ *      rolloutEngine<float> engine;                      // gravity 9.81, SUGGESTED_THREADS workers
+ *      engine.run(x0, u, K, H, 0.01f, ROLLOUT_RK4, cost, ROLLOUT_COST);
+ *      read engine.costs()
+ *
+ *  cost is any callable T(const T *x, const T *u, int step) and is called
+ *  from every worker at once.
+ **************************************************************************/
+
+enum rolloutIntegrator {ROLLOUT_SEMI_IMPLICIT_EULER = 0, ROLLOUT_RK4};
+// Outputs of rolloutEngine::run (or together any subset)
+enum rolloutOutput {ROLLOUT_TRAJECTORY = 1, ROLLOUT_COST = 2, ROLLOUT_ALL = 3};
+
+const int STATE_SIZE = 2*NUM_JOINTS;
+
+// x = [q; qd] -> dx = [qd; qdd] with qdd = ABA(q,qd,u)
+template <typename T>
+inline void rollout_derivative(T *s_dx, const T *s_x, const T *s_u, const T *s_XImats, const T gravity){
+	T s_X[36*NUM_JOINTS];
+	load_update_XImats_helpers<T>(s_X, s_x, s_XImats);
+	aba_inner<T>(&s_dx[NUM_JOINTS], &s_x[NUM_JOINTS], s_u, s_X, s_XImats, gravity);
+	for (int i = 0; i < NUM_JOINTS; i++){s_dx[i] = s_x[NUM_JOINTS + i];}
+}
+
+/**
+ * One integration step of x = [q; qd] in place
+ * semi-implicit Euler: qd += dt*qdd(q,qd,u), q += dt*qd (the updated qd)
+ * RK4: the classic four stage scheme on dx = [qd; qdd]
+ */
+template <typename T, int INTEGRATOR>
+inline void rollout_step(T *s_x, const T *s_u, const T dt, const T *s_XImats, const T gravity){
+	const int NS = STATE_SIZE;
+	if (INTEGRATOR == ROLLOUT_SEMI_IMPLICIT_EULER){
+		T s_dx[STATE_SIZE];
+		rollout_derivative<T>(s_dx, s_x, s_u, s_XImats, gravity);
+		for (int i = 0; i < NUM_JOINTS; i++){s_x[NUM_JOINTS + i] += dt*s_dx[NUM_JOINTS + i]; s_x[i] += dt*s_x[NUM_JOINTS + i];}
+		return;
+	}
+	const T half = dt/static_cast<T>(2); const T sixth = dt/static_cast<T>(6);
+	T k1[STATE_SIZE]; T k2[STATE_SIZE]; T k3[STATE_SIZE]; T k4[STATE_SIZE]; T xs[STATE_SIZE];
+	rollout_derivative<T>(k1, s_x, s_u, s_XImats, gravity);
+	for (int i = 0; i < NS; i++){xs[i] = s_x[i] + half*k1[i];}
+	rollout_derivative<T>(k2, xs, s_u, s_XImats, gravity);
+	for (int i = 0; i < NS; i++){xs[i] = s_x[i] + half*k2[i];}
+	rollout_derivative<T>(k3, xs, s_u, s_XImats, gravity);
+	for (int i = 0; i < NS; i++){xs[i] = s_x[i] + dt*k3[i];}
+	rollout_derivative<T>(k4, xs, s_u, s_XImats, gravity);
+	for (int i = 0; i < NS; i++){s_x[i] += sixth*(k1[i] + static_cast<T>(2)*(k2[i] + k3[i]) + k4[i]);}
+}
+
+// cost of rolloutEngine::run when only the trajectories are wanted
+template <typename T>
+struct rolloutNoCost {
+	T operator()(const T *, const T *, int) const {return static_cast<T>(0);}
+};
+
+template <typename T>
+class rolloutEngine {
+public:
+	explicit rolloutEngine(const T gravity_ = static_cast<T>(9.81), const int num_threads = SUGGESTED_THREADS) :
+		gravity(gravity_), threads(num_threads), num_rollouts(0), horizon(0){
+		d_robotModel = init_robotModel<T>();
+	}
+
+	~rolloutEngine(){free_robotModel<T>(d_robotModel);}
+
+	/**
+	 * Rolls out num_rollouts control sequences of horizon steps from x0 (STATE_SIZE values)
+	 * @param integrator is a rolloutIntegrator
+	 * @param outputs is a rolloutOutput mask (trajectories are not stored without ROLLOUT_TRAJECTORY)
+	 * Returns false, with a message on stdout, for an unknown integrator or an empty batch.
+	 * The workspace only grows, so repeated calls of the same size never allocate.
+	 */
+	template <typename Cost>
+	bool run(const T *x0, const T *u, const int num_rollouts_, const int horizon_, const T dt, const int integrator,
+	         Cost &cost, const int outputs = ROLLOUT_ALL){
+		if (num_rollouts_ <= 0 || horizon_ <= 0){printf("[!Error] rollouts need num_rollouts > 0 and horizon > 0\n"); return false;}
+		switch (integrator){
+			case ROLLOUT_SEMI_IMPLICIT_EULER: return run_batch<ROLLOUT_SEMI_IMPLICIT_EULER>(x0, u, num_rollouts_, horizon_, dt, cost, outputs);
+			case ROLLOUT_RK4: return run_batch<ROLLOUT_RK4>(x0, u, num_rollouts_, horizon_, dt, cost, outputs);
+			default: printf("[!Error] unknown rollout integrator %d\n", integrator); return false;
+		}
+	}
+
+	// Trajectories only
+	bool run(const T *x0, const T *u, const int num_rollouts_, const int horizon_, const T dt, const int integrator){
+		rolloutNoCost<T> cost;
+		return run(x0, u, num_rollouts_, horizon_, dt, integrator, cost, ROLLOUT_TRAJECTORY);
+	}
+
+	// (horizon + 1)*STATE_SIZE states of rollout r from the last run with ROLLOUT_TRAJECTORY
+	const T *trajectory(const int r) const {return &states[static_cast<size_t>(r)*(horizon + 1)*STATE_SIZE];}
+	// num_rollouts costs from the last run with ROLLOUT_COST
+	const T *costs() const {return total_costs.data();}
+	// x_H of rollout r from the last run
+	const T *terminal_state(const int r) const {return &terminal_states[static_cast<size_t>(r)*STATE_SIZE];}
+
+	int size() const {return num_rollouts;}
+	int steps() const {return horizon;}
+	const robotModel<T> *model() const {return d_robotModel;}
+
+private:
+	template <int INTEGRATOR, typename Cost>
+	bool run_batch(const T *x0, const T *u, const int num_rollouts_, const int horizon_, const T dt, Cost &cost, const int outputs){
+		num_rollouts = num_rollouts_; horizon = horizon_;
+		const size_t K = static_cast<size_t>(num_rollouts); const size_t H = static_cast<size_t>(horizon);
+		if (outputs & ROLLOUT_TRAJECTORY){if (states.size() < K*(H + 1)*STATE_SIZE){states.resize(K*(H + 1)*STATE_SIZE);}}
+		if (total_costs.size() < K){total_costs.resize(K);}
+		if (terminal_states.size() < K*STATE_SIZE){terminal_states.resize(K*STATE_SIZE);}
+		const T *s_XImats = d_robotModel->d_XImats; const T g = gravity;
+		T *traj = states.data(); T *J = total_costs.data(); T *xH = terminal_states.data();
+		auto f = [&](int r){
+			T s_x[STATE_SIZE];
+			for (int i = 0; i < STATE_SIZE; i++){s_x[i] = x0[i];}
+			T *s_traj = (outputs & ROLLOUT_TRAJECTORY) ? &traj[r*(H + 1)*STATE_SIZE] : nullptr;
+			T total = static_cast<T>(0);
+			for (size_t t = 0; t < H; t++){
+				const T *s_u = &u[(r*H + t)*NUM_JOINTS];
+				if (s_traj != nullptr){for (int i = 0; i < STATE_SIZE; i++){s_traj[t*STATE_SIZE + i] = s_x[i];}}
+				if (outputs & ROLLOUT_COST){total += cost(s_x, s_u, static_cast<int>(t));}
+				rollout_step<T,INTEGRATOR>(s_x, s_u, dt, s_XImats, g);
+			}
+			if (s_traj != nullptr){for (int i = 0; i < STATE_SIZE; i++){s_traj[H*STATE_SIZE + i] = s_x[i];}}
+			if (outputs & ROLLOUT_COST){total += cost(s_x, static_cast<const T *>(nullptr), horizon);}
+			J[r] = total;
+			for (int i = 0; i < STATE_SIZE; i++){xH[r*STATE_SIZE + i] = s_x[i];}
+		};
+		threads.parallel_for(num_rollouts, f);
+		return true;
+	}
+
+	const T gravity;
+	hostThreads threads;
+	robotModel<T> *d_robotModel;
+	int num_rollouts;
+	int horizon;
+	std::vector<T> states;
+	std::vector<T> total_costs;
+	std::vector<T> terminal_states;
+
+	rolloutEngine(const rolloutEngine&) = delete;
+	rolloutEngine& operator=(const rolloutEngine&) = delete;
+};
@@ -0,0 +1,242 @@
+/**************************************************************************
+ *  Second order dynamics gradients
+ *
+ *  Each column of the second order tensors is the exact directional
+ *  derivative of the analytical first order gradient, obtained by running
+ *  it once on dual numbers per seeded input. Slice layouts match grid.cuh:
+ *  slice i of a d2/du2 tensor is the NUM_VEL x NUM_VEL Hessian of output i,
+ *  and slice k of dM_dq / dMinv_dq is the derivative with respect to q_k.
+ *
+ *  With PACKED the symmetric slices (d2/dq2, d2/dqd2, dM_dq, dMinv_dq) keep
+ *  only their lower triangle and only those entries are computed; the
+ *  cross term d2/dqdqd is not symmetric and stays dense. Per timestep
+ *  (SO_PACKED_SIZE values of h_idsva_so_packed / h_df2_packed):
+ *
+ *      [d2_dq2: N x SO_SYM_SIZE | d2_dqd2: N x SO_SYM_SIZE | d2_dqdqd: N x N*N | dM_dq: N x SO_SYM_SIZE]
+ *
+ *  so_packed_entry reads one element and so_packed_slice expands a slice.
+ **************************************************************************/
+
+// column-major lower triangle index of (row,col) in a symmetric slice
+inline int so_sym_index(int row, int col){
+	if (row < col){const int tmp = row; row = col; col = tmp;}
+	return col*NUM_VEL - col*(col - 1)/2 + (row - col);
+}
+
+// start of slice of tensor (0: d2_dq2, 1: d2_dqd2, 2: d2_dqdqd, 3: dM_dq / dMinv_dq) in one packed timestep
+inline int so_packed_offset(const int tensor, const int slice){
+	const int N = NUM_VEL;
+	if (tensor == 2){return 2*N*SO_SYM_SIZE + slice*N*N;}
+	return (tensor == 3 ? 2*N*SO_SYM_SIZE + N*N*N : tensor*N*SO_SYM_SIZE) + slice*SO_SYM_SIZE;
+}
+
+template <typename T>
+inline T so_packed_entry(const T *s_packed, const int tensor, const int slice, const int row, const int col){
+	const T *s_slice = &s_packed[so_packed_offset(tensor, slice)];
+	return tensor == 2 ? s_slice[row + NUM_VEL*col] : s_slice[so_sym_index(row, col)];
+}
+
+// expand one slice into a dense column-major NUM_VEL x NUM_VEL matrix
+template <typename T>
+__host__
+void so_packed_slice(T *s_dense, const T *s_packed, const int tensor, const int slice){
+	for (int col = 0; col < NUM_VEL; col++){
+		for (int row = 0; row < NUM_VEL; row++){s_dense[row + NUM_VEL*col] = so_packed_entry<T>(s_packed, tensor, slice, row, col);}
+	}
+}
+
+template <typename T>
+inline void to_dual_XImats(grid_cpu::dual<T> *out, const T *s_XImats){
+	for (int i = 0; i < 72*NUM_JOINTS; i++){out[i] = grid_cpu::dual<T>(s_XImats[i]);}
+}
+
+template <typename T>
+inline void seed_dual(grid_cpu::dual<T> *out, const T *in, const int seed){
+	for (int i = 0; i < NUM_JOINTS; i++){out[i] = grid_cpu::dual<T>(in[i], i == seed ? static_cast<T>(1) : static_cast<T>(0));}
+}
+
+/**
+ * Second order inverse dynamics gradients (IDSVA outputs)
+ * @param s_idsva_so is the (4*NUM_VEL^3) output [d2tau_dq2, d2tau_dqd2, d2tau_dqdqd, dM_dq]
+ *        where element (j,k) of cross slice i is d2tau_i/dq_j dqd_k (SO_PACKED_SIZE if PACKED)
+ */
+template <typename T, bool PACKED = false>
+void idsva_so_inner(T *s_idsva_so, const T *s_q, const T *s_qd, const T *s_qdd, const T *s_XImats, const T gravity){
+	typedef grid_cpu::dual<T> D;
+	const int N = NUM_JOINTS; const int NNN = N*N*N;
+	D XImats[72*NUM_JOINTS]; D X[36*NUM_JOINTS]; D q[NUM_JOINTS]; D qd[NUM_JOINTS]; D qdd[NUM_JOINTS];
+	D vaf[18*NUM_JOINTS]; D dc_du[2*NUM_JOINTS*NUM_JOINTS]; D M[NUM_JOINTS*NUM_JOINTS];
+	D c[NUM_JOINTS]; const D g = D(gravity);
+	to_dual_XImats(XImats, s_XImats);
+	for (int i = 0; i < N; i++){qdd[i] = D(s_qdd[i]);}
+	for (int k = 0; k < N; k++){
+		// d/dq_k
+		seed_dual(q, s_q, k); seed_dual(qd, s_qd, -1);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		inverse_dynamics_inner<D>(c, vaf, qd, qdd, X, XImats, g);
+		if (PACKED){
+			// symmetry: only dc_dq columns j >= k are needed
+			inverse_dynamics_gradient_inner<D>(dc_du, vaf, qd, X, XImats, g, k, N);
+			crba_inner<D>(M, X, XImats);
+			for (int i = 0; i < N; i++){
+				for (int j = k; j < N; j++){s_idsva_so[so_packed_offset(0,i) + so_sym_index(j,k)] = dc_du[i + N*j].der;}
+				for (int j = 0; j <= i; j++){s_idsva_so[so_packed_offset(3,k) + so_sym_index(i,j)] = M[i + N*j].der;}
+			}
+			seed_dual(q, s_q, -1); seed_dual(qd, s_qd, k);
+			load_update_XImats_helpers<D>(X, q, XImats);
+			inverse_dynamics_inner<D>(c, vaf, qd, qdd, X, XImats, g);
+			inverse_dynamics_gradient_inner<D>(dc_du, vaf, qd, X, XImats, g, 0, k);
+			for (int i = 0; i < N; i++){
+				for (int j = k; j < N; j++){s_idsva_so[so_packed_offset(1,i) + so_sym_index(j,k)] = dc_du[N*N + i + N*j].der;}
+				for (int j = 0; j < N; j++){s_idsva_so[so_packed_offset(2,i) + j + N*k] = dc_du[i + N*j].der;}
+			}
+			continue;
+		}
+		inverse_dynamics_gradient_inner<D>(dc_du, vaf, qd, X, XImats, g);
+		crba_inner<D>(M, X, XImats);
+		for (int i = 0; i < N; i++){
+			for (int j = 0; j < N; j++){
+				s_idsva_so[i*N*N + j + N*k] = dc_du[i + N*j].der;
+				s_idsva_so[3*NNN + k*N*N + i + N*j] = M[i + N*j].der;
+			}
+		}
+		// d/dqd_k
+		seed_dual(q, s_q, -1); seed_dual(qd, s_qd, k);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		inverse_dynamics_inner<D>(c, vaf, qd, qdd, X, XImats, g);
+		inverse_dynamics_gradient_inner<D>(dc_du, vaf, qd, X, XImats, g);
+		for (int i = 0; i < N; i++){
+			for (int j = 0; j < N; j++){
+				s_idsva_so[NNN + i*N*N + j + N*k] = dc_du[N*N + i + N*j].der;
+				s_idsva_so[2*NNN + i*N*N + j + N*k] = dc_du[i + N*j].der;
+			}
+		}
+	}
+}
+
+/**
+ * Second order forward dynamics gradients (FDSVA outputs) at qdd = FD(q,qd,u)
+ * @param s_df2 is the (4*NUM_VEL^3) output [d2qdd_dq2, d2qdd_dqd2, d2qdd_dqdqd, dMinv_dq] (SO_PACKED_SIZE if PACKED)
+ */
+template <typename T, bool PACKED = false>
+void fdsva_so_inner(T *s_df2, const T *s_q, const T *s_qd, const T *s_u, const T *s_XImats, const T gravity){
+	typedef grid_cpu::dual<T> D;
+	const int N = NUM_JOINTS; const int NNN = N*N*N;
+	D XImats[72*NUM_JOINTS]; D X[36*NUM_JOINTS]; D q[NUM_JOINTS]; D qd[NUM_JOINTS]; D u[NUM_JOINTS]; D qdd[NUM_JOINTS];
+	D df_du[2*NUM_JOINTS*NUM_JOINTS]; D Minv[NUM_JOINTS*NUM_JOINTS];
+	const D g = D(gravity);
+	to_dual_XImats(XImats, s_XImats);
+	for (int i = 0; i < N; i++){u[i] = D(s_u[i]);}
+	for (int k = 0; k < N; k++){
+		// d/dq_k
+		seed_dual(q, s_q, k); seed_dual(qd, s_qd, -1);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		if (PACKED){
+			forward_dynamics_gradient_inner<D>(df_du, qdd, qd, u, X, XImats, g, k, N);
+			direct_minv_inner<D>(Minv, X, XImats);
+			for (int i = 0; i < N; i++){
+				for (int j = k; j < N; j++){s_df2[so_packed_offset(0,i) + so_sym_index(j,k)] = df_du[i + N*j].der;}
+				for (int j = 0; j <= i; j++){s_df2[so_packed_offset(3,k) + so_sym_index(i,j)] = Minv[i + N*j].der;}
+			}
+			seed_dual(q, s_q, -1); seed_dual(qd, s_qd, k);
+			load_update_XImats_helpers<D>(X, q, XImats);
+			forward_dynamics_gradient_inner<D>(df_du, qdd, qd, u, X, XImats, g, 0, k);
+			for (int i = 0; i < N; i++){
+				for (int j = k; j < N; j++){s_df2[so_packed_offset(1,i) + so_sym_index(j,k)] = df_du[N*N + i + N*j].der;}
+				for (int j = 0; j < N; j++){s_df2[so_packed_offset(2,i) + j + N*k] = df_du[i + N*j].der;}
+			}
+			continue;
+		}
+		forward_dynamics_gradient_inner<D>(df_du, qdd, qd, u, X, XImats, g);
+		direct_minv_inner<D>(Minv, X, XImats);
+		for (int i = 0; i < N; i++){
+			for (int j = 0; j < N; j++){
+				s_df2[i*N*N + j + N*k] = df_du[i + N*j].der;
+				s_df2[3*NNN + k*N*N + i + N*j] = Minv[i + N*j].der;
+			}
+		}
+		// d/dqd_k
+		seed_dual(q, s_q, -1); seed_dual(qd, s_qd, k);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		forward_dynamics_gradient_inner<D>(df_du, qdd, qd, u, X, XImats, g);
+		for (int i = 0; i < N; i++){
+			for (int j = 0; j < N; j++){
+				s_df2[NNN + i*N*N + j + N*k] = df_du[N*N + i + N*j].der;
+				s_df2[2*NNN + i*N*N + j + N*k] = df_du[i + N*j].der;
+			}
+		}
+	}
+}
+
+/**
+ * Second order inverse dynamics gradients contracted with lambda over the output index (for DDP)
+ * @param s_so_contracted is the (4*NUM_VEL^2) output [d2(lambda^T c)/dq2, d2(lambda^T c)/dqd2, d2(lambda^T c)/dqdqd, d(M lambda)/dq]
+ *        where element (j,k) of the cross block is d2(lambda^T c)/dq_j dqd_k and of the last block d(M lambda)_j/dq_k
+ * Each column is the derivative of the O(N) contracted gradient, so the N^3 tensor is never formed
+ */
+template <typename T>
+void idsva_so_contracted_inner(T *s_so_contracted, const T *s_lambda, const T *s_q, const T *s_qd, const T *s_qdd, const T *s_XImats, const T gravity){
+	typedef grid_cpu::dual<T> D;
+	const int N = NUM_JOINTS; const int NN = N*N;
+	D XImats[72*NUM_JOINTS]; D X[36*NUM_JOINTS]; D q[NUM_JOINTS]; D qd[NUM_JOINTS]; D qdd[NUM_JOINTS]; D lambda[NUM_JOINTS]; D zeros[NUM_JOINTS];
+	D vaf[18*NUM_JOINTS]; D grad[2*NUM_JOINTS];
+	D c[NUM_JOINTS]; const D g = D(gravity);
+	to_dual_XImats(XImats, s_XImats);
+	for (int i = 0; i < N; i++){qdd[i] = D(s_qdd[i]); lambda[i] = D(s_lambda[i]); zeros[i] = D(static_cast<T>(0));}
+	for (int k = 0; k < N; k++){
+		// d/dq_k (M lambda = ID(q,0,lambda) without gravity)
+		seed_dual(q, s_q, k); seed_dual(qd, s_qd, -1);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		inverse_dynamics_inner<D>(c, vaf, qd, qdd, X, XImats, g);
+		inverse_dynamics_gradient_contracted_inner<D>(grad, lambda, vaf, qd, X, XImats, g);
+		for (int j = 0; j < N; j++){s_so_contracted[j + N*k] = grad[j].der;}
+		inverse_dynamics_inner<D>(c, vaf, zeros, lambda, X, XImats, D(static_cast<T>(0)));
+		for (int j = 0; j < N; j++){s_so_contracted[3*NN + j + N*k] = c[j].der;}
+		// d/dqd_k
+		seed_dual(q, s_q, -1); seed_dual(qd, s_qd, k);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		inverse_dynamics_inner<D>(c, vaf, qd, qdd, X, XImats, g);
+		inverse_dynamics_gradient_contracted_inner<D>(grad, lambda, vaf, qd, X, XImats, g);
+		for (int j = 0; j < N; j++){
+			s_so_contracted[NN + j + N*k] = grad[N + j].der;
+			s_so_contracted[2*NN + j + N*k] = grad[j].der;
+		}
+	}
+}
+
+/**
+ * Second order forward dynamics gradients contracted with lambda at qdd = FD(q,qd,u) (for DDP)
+ * lambda^T df_du = -mu^T dc_du with mu = Minv lambda, and both qdd and mu come from O(N) ABA sweeps
+ * @param s_df2_contracted is the (4*NUM_VEL^2) output [d2(lambda^T qdd)/dq2, d2(lambda^T qdd)/dqd2, d2(lambda^T qdd)/dqdqd, d(Minv lambda)/dq]
+ */
+template <typename T>
+void fdsva_so_contracted_inner(T *s_df2_contracted, const T *s_lambda, const T *s_q, const T *s_qd, const T *s_u, const T *s_XImats, const T gravity){
+	typedef grid_cpu::dual<T> D;
+	const int N = NUM_JOINTS; const int NN = N*N;
+	D XImats[72*NUM_JOINTS]; D X[36*NUM_JOINTS]; D q[NUM_JOINTS]; D qd[NUM_JOINTS]; D u[NUM_JOINTS]; D qdd[NUM_JOINTS];
+	D lambda[NUM_JOINTS]; D mu[NUM_JOINTS]; D zeros[NUM_JOINTS]; D vaf[18*NUM_JOINTS]; D grad[2*NUM_JOINTS];
+	D c[NUM_JOINTS]; const D g = D(gravity);
+	to_dual_XImats(XImats, s_XImats);
+	for (int i = 0; i < N; i++){u[i] = D(s_u[i]); lambda[i] = D(s_lambda[i]); zeros[i] = D(static_cast<T>(0));}
+	for (int pass = 0; pass < 2*N; pass++){
+		const int k = pass % N; const bool wrt_qd = pass >= N;
+		seed_dual(q, s_q, wrt_qd ? -1 : k); seed_dual(qd, s_qd, wrt_qd ? k : -1);
+		load_update_XImats_helpers<D>(X, q, XImats);
+		aba_inner<D>(qdd, qd, u, X, XImats, g);
+		aba_inner<D>(mu, zeros, lambda, X, XImats, D(static_cast<T>(0)));
+		inverse_dynamics_inner<D>(c, vaf, qd, qdd, X, XImats, g);
+		inverse_dynamics_gradient_contracted_inner<D>(grad, mu, vaf, qd, X, XImats, g);
+		if (!wrt_qd){
+			for (int j = 0; j < N; j++){
+				s_df2_contracted[j + N*k] = -grad[j].der;
+				s_df2_contracted[3*NN + j + N*k] = mu[j].der;
+			}
+		}
+		else {
+			for (int j = 0; j < N; j++){
+				s_df2_contracted[NN + j + N*k] = -grad[N + j].der;
+				s_df2_contracted[2*NN + j + N*k] = -grad[j].der;
+			}
+		}
+	}
+}
@@ -0,0 +1,168 @@
+/**************************************************************************
+ *  Resident batch dynamics server
+ *
+ *  Owns its worker threads, robotModel and QUEUE_DEPTH preallocated
+ *  gridData buffers. A producer (e.g., an MPC loop) acquires a buffer,
+ *  fills its inputs, and submits it through a lock-free ring; a dispatch
+ *  thread runs the batch across the workers and raises the request's
+ *  completion flag. Nothing is allocated after construction.
+ *
+ *      request *req = server.acquire();              // nullptr if all buffers are in flight
+ *      fill req->hd_data->h_q_qd_u
+ *      server.submit(req, SERVER_FD_DU, num_timesteps);
+ *      server.wait(req);                             // or poll server.done(req)
+ *      read req->hd_data->h_df_du
+ *      server.release(req);
+ **************************************************************************/
+
+enum serverAlgorithm {SERVER_ID = 0, SERVER_MINV, SERVER_FD, SERVER_ID_DU, SERVER_FD_DU, SERVER_ABA, SERVER_CRBA,
+                      SERVER_EEPOS, SERVER_DEEPOS, SERVER_BUNDLE, SERVER_NUM_ALGORITHMS};
+
+// every output a server algorithm can write (allocated up front so requests never allocate)
+const unsigned SERVER_BUFFERS = BUFFER_C | BUFFER_MINV | BUFFER_QDD | BUFFER_DC_DU | BUFFER_DF_DU | BUFFER_M | BUFFER_EEPOS | BUFFER_DEEPOS;
+
+template <typename T, int MAX_TIMESTEPS, int QUEUE_DEPTH = 8>
+class dynamicsServer {
+public:
+	enum requestState {REQUEST_FREE = 0, REQUEST_ACQUIRED, REQUEST_QUEUED, REQUEST_DONE};
+
+	struct request {
+		gridData<T> *hd_data;       // inputs and outputs in the usual gridData layouts
+		int algorithm;
+		int num_timesteps;
+		std::atomic<int> state;
+		unsigned long long submit_ns;
+		unsigned long long start_ns;
+		unsigned long long done_ns;
+	};
+
+	explicit dynamicsServer(const T gravity_ = static_cast<T>(9.81), const int num_threads = SUGGESTED_THREADS) :
+		gravity(gravity_), threads(num_threads){
+		d_robotModel = init_robotModel<T>();
+		for (int i = 0; i < QUEUE_DEPTH; i++){
+			requests[i].hd_data = init_gridData<T>(MAX_TIMESTEPS, SERVER_BUFFERS);
+			requests[i].state.store(REQUEST_FREE);
+			free_slots.push(i);
+		}
+		shutdown = false; sleeping = 0;
+		dispatcher = std::thread([this](){dispatch_loop();});
+	}
+
+	~dynamicsServer(){
+		{std::unique_lock<std::mutex> lock(mtx); shutdown = true;}
+		wake_cv.notify_all();
+		dispatcher.join();
+		for (int i = 0; i < QUEUE_DEPTH; i++){free_gridData<T>(requests[i].hd_data);}
+		free_robotModel<T>(d_robotModel);
+	}
+
+	// Claims a free buffer (safe from any number of producer threads)
+	request *acquire(){
+		int slot;
+		if (!free_slots.pop(slot)){return nullptr;}
+		requests[slot].state.store(REQUEST_ACQUIRED, std::memory_order_relaxed);
+		return &requests[slot];
+	}
+
+	// Queues an acquired buffer whose inputs are filled in
+	bool submit(request *req, const int algorithm, const int num_timesteps){
+		if (req == nullptr || algorithm < 0 || algorithm >= SERVER_NUM_ALGORITHMS || num_timesteps < 0 || num_timesteps > MAX_TIMESTEPS){return false;}
+		req->algorithm = algorithm; req->num_timesteps = num_timesteps;
+		req->submit_ns = grid_cpu::monotonic_ns();
+		req->state.store(REQUEST_QUEUED); // seq_cst pairs with the dispatcher's sleeping count
+		pending.push(static_cast<int>(req - requests));
+		if (sleeping.load() > 0){
+			{std::unique_lock<std::mutex> lock(mtx);}
+			wake_cv.notify_one();
+		}
+		return true;
+	}
+
+	bool done(const request *req) const {return req->state.load(std::memory_order_acquire) == REQUEST_DONE;}
+
+	// Spins briefly and then yields until the request completes
+	void wait(const request *req) const {
+		for (int spin = 0; !done(req); spin++){
+			if (spin < (1 << 12)){grid_cpu::cpu_relax();} else {std::this_thread::yield();}
+		}
+	}
+
+	// Hands the buffer back once its outputs have been read
+	void release(request *req){
+		req->state.store(REQUEST_FREE, std::memory_order_relaxed);
+		free_slots.push(static_cast<int>(req - requests));
+	}
+
+	// submit to completion latency and pure compute time of every request since the last reset
+	const grid_cpu::latencyHistogram &latency() const {return latency_hist;}
+	const grid_cpu::latencyHistogram &service_time() const {return service_hist;}
+	void reset_stats(){latency_hist.reset(); service_hist.reset();}
+
+	const robotModel<T> *model() const {return d_robotModel;}
+
+private:
+	void run_request(request *req){
+		gridData<T> *hd_data = req->hd_data; const robotModel<T> *model = d_robotModel; const T g = gravity;
+		switch (req->algorithm){
+			case SERVER_ID: {auto f = [&](int k){inverse_dynamics_timestep<T,false,false>(hd_data,model,g,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_MINV: {auto f = [&](int k){direct_minv_timestep<T,false>(hd_data,model,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_FD: {auto f = [&](int k){forward_dynamics_timestep<T>(hd_data,model,g,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_ID_DU: {auto f = [&](int k){inverse_dynamics_gradient_timestep<T,false,false>(hd_data,model,g,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_FD_DU: {auto f = [&](int k){forward_dynamics_gradient_timestep<T,false>(hd_data,model,g,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_ABA: {auto f = [&](int k){aba_timestep<T>(hd_data,model,g,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_CRBA: {auto f = [&](int k){crba_timestep<T>(hd_data,model,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_EEPOS: {auto f = [&](int k){end_effector_positions_timestep<T,false>(hd_data,model,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_DEEPOS: {auto f = [&](int k){end_effector_positions_gradient_timestep<T,false>(hd_data,model,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			case SERVER_BUNDLE: {auto f = [&](int k){dynamics_bundle_timestep<T,BUNDLE_ALL>(hd_data,model,g,k);}; threads.parallel_for(req->num_timesteps, f); break;}
+			default: break;
+		}
+	}
+
+	void dispatch_loop(){
+		while (true){
+			int slot;
+			if (pending.pop(slot)){
+				request *req = &requests[slot];
+				req->start_ns = grid_cpu::monotonic_ns();
+				run_request(req);
+				req->done_ns = grid_cpu::monotonic_ns();
+				service_hist.record(req->done_ns - req->start_ns);
+				latency_hist.record(req->done_ns - req->submit_ns);
+				req->state.store(REQUEST_DONE, std::memory_order_release);
+				continue;
+			}
+			// spin for the next tick before parking
+			bool found = false;
+			for (int spin = 0; spin < (1 << 14) && !found; spin++){grid_cpu::cpu_relax(); found = !pending_empty();}
+			if (found){continue;}
+			std::unique_lock<std::mutex> lock(mtx);
+			sleeping.fetch_add(1);
+			wake_cv.wait(lock, [&]{return shutdown || !pending_empty();});
+			sleeping.fetch_sub(1);
+			if (shutdown && pending_empty()){return;}
+		}
+	}
+
+	bool pending_empty(){
+		// the ring has no peek, so look for a request that was submitted but not yet picked up
+		for (int i = 0; i < QUEUE_DEPTH; i++){if (requests[i].state.load(std::memory_order_acquire) == REQUEST_QUEUED){return false;}}
+		return true;
+	}
+
+	const T gravity;
+	hostThreads threads;
+	robotModel<T> *d_robotModel;
+	request requests[QUEUE_DEPTH];
+	grid_cpu::boundedRing<int,QUEUE_DEPTH> free_slots;
+	grid_cpu::boundedRing<int,QUEUE_DEPTH> pending;
+	grid_cpu::latencyHistogram latency_hist;
+	grid_cpu::latencyHistogram service_hist;
+	std::thread dispatcher;
+	std::mutex mtx;
+	std::condition_variable wake_cv;
+	std::atomic<int> sleeping;
+	bool shutdown;
+
+	dynamicsServer(const dynamicsServer&) = delete;
+	dynamicsServer& operator=(const dynamicsServer&) = delete;
+};
@@ -0,0 +1,94 @@
+/**************************************************************************
+ *  SIMD lanes
+ *
+ *  lanes<T,W> holds the same scalar from W different timesteps. Every
+ *  operator is a fixed length loop over the lanes which the compiler turns
+ *  into packed instructions, so instantiating the templated algorithms on
+ *  lanes<T,W> runs W timesteps through one pass of the unrolled topology.
+ *  Build with -O3 -march=native to get the widest vectors of the host.
+ **************************************************************************/
+#ifndef GRID_CPU_SIMD_HPP
+#define GRID_CPU_SIMD_HPP
+
+#if defined(__AVX512F__)
+	#define GRID_CPU_SIMD_BYTES 64
+#elif defined(__AVX__)
+	#define GRID_CPU_SIMD_BYTES 32
+#else
+	#define GRID_CPU_SIMD_BYTES 16
+#endif
+
+namespace grid_cpu {
+
+// number of T that fit in one vector register of the target
+template <typename T>
+struct default_lanes {static const int value = GRID_CPU_SIMD_BYTES / sizeof(T) > 0 ? GRID_CPU_SIMD_BYTES / sizeof(T) : 1;};
+
+template <typename T, int W>
+struct lanes {
+	T v[W];
+	lanes(){for (int l = 0; l < W; l++){v[l] = static_cast<T>(0);}}
+	lanes(const T s){for (int l = 0; l < W; l++){v[l] = s;}}
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value && !std::is_same<U,T>::value>::type>
+	lanes(const U s){for (int l = 0; l < W; l++){v[l] = static_cast<T>(s);}}
+	lanes &operator+=(const lanes &b){for (int l = 0; l < W; l++){v[l] += b.v[l];} return *this;}
+	lanes &operator-=(const lanes &b){for (int l = 0; l < W; l++){v[l] -= b.v[l];} return *this;}
+	lanes &operator*=(const lanes &b){for (int l = 0; l < W; l++){v[l] *= b.v[l];} return *this;}
+	lanes &operator/=(const lanes &b){for (int l = 0; l < W; l++){v[l] /= b.v[l];} return *this;}
+};
+
+template <typename T, int W> inline lanes<T,W> operator+(lanes<T,W> a, const lanes<T,W> &b){return a += b;}
+template <typename T, int W> inline lanes<T,W> operator-(lanes<T,W> a, const lanes<T,W> &b){return a -= b;}
+template <typename T, int W> inline lanes<T,W> operator*(lanes<T,W> a, const lanes<T,W> &b){return a *= b;}
+template <typename T, int W> inline lanes<T,W> operator/(lanes<T,W> a, const lanes<T,W> &b){return a /= b;}
+template <typename T, int W> inline lanes<T,W> operator-(lanes<T,W> a){for (int l = 0; l < W; l++){a.v[l] = -a.v[l];} return a;}
+
+/**
+ * sin and cos of every lane in one branch free polynomial pass, so the joint transforms of a pack take one
+ * vector sincos per joint instead of 2*W libm calls: a = k pi/2 + r with r in [-pi/4, pi/4] (Cody-Waite split
+ * of pi/2, exact for |a| < SIN_COS_MAX_ARG), Cephes polynomials for sin r and cos r, and k mod 4 picks and
+ * signs them. Lanes beyond SIN_COS_MAX_ARG fall back to std::sin / std::cos.
+ */
+const double SIN_COS_MAX_ARG = 8192.0;
+template <typename T, int W>
+inline void sin_cos(const lanes<T,W> &a, lanes<T,W> &s, lanes<T,W> &c){
+	const bool DBL = sizeof(T) >= sizeof(double);
+	// adding and subtracting 1.5*2^(mantissa bits) rounds to the nearest integer
+	const T ROUND = static_cast<T>(DBL ? 6755399441055744.0 : 12582912.0);
+	const T P1 = static_cast<T>(DBL ? 1.57079632673412561417e+00 : 1.5703125);
+	const T P2 = static_cast<T>(DBL ? 6.07710050650619224932e-11 : 4.837512969970703125e-4);
+	const T P3 = static_cast<T>(DBL ? 2.02226624879595063154e-21 : 7.54978995489188216e-8);
+	bool in_range = true;
+	for (int l = 0; l < W; l++){
+		const T x = a.v[l];
+		const T k = (x*static_cast<T>(0.63661977236758134308) + ROUND) - ROUND;
+		const T r = ((x - k*P1) - k*P2) - k*P3; const T z = r*r;
+		const T ps = r + r*z*(((((static_cast<T>(1.58962301576546568060e-10)*z - static_cast<T>(2.50507477628578072866e-8))*z +
+		             static_cast<T>(2.75573136213857245213e-6))*z - static_cast<T>(1.98412698295895385996e-4))*z +
+		             static_cast<T>(8.33333333332211858878e-3))*z - static_cast<T>(1.66666666666666307295e-1));
+		const T pc = static_cast<T>(1) - static_cast<T>(0.5)*z + z*z*(((((static_cast<T>(-1.13585365213876817300e-11)*z +
+		             static_cast<T>(2.08757008419747316778e-9))*z - static_cast<T>(2.75573141792967388112e-7))*z +
+		             static_cast<T>(2.48015872888517045348e-5))*z - static_cast<T>(1.38888888888730564116e-3))*z +
+		             static_cast<T>(4.16666666666665929218e-2));
+		const int q = static_cast<int>(k) & 3;
+		const T sv = (q & 1) ? pc : ps; const T cv = (q & 1) ? ps : pc;
+		s.v[l] = (q & 2) ? -sv : sv;
+		c.v[l] = ((q + 1) & 2) ? -cv : cv;
+		in_range = in_range && x < static_cast<T>(SIN_COS_MAX_ARG) && x > static_cast<T>(-SIN_COS_MAX_ARG);
+	}
+	if (!in_range){
+		for (int l = 0; l < W; l++){
+			if (!(a.v[l] < static_cast<T>(SIN_COS_MAX_ARG) && a.v[l] > static_cast<T>(-SIN_COS_MAX_ARG))){s.v[l] = std::sin(a.v[l]); c.v[l] = std::cos(a.v[l]);}
+		}
+	}
+}
+template <typename T, int W> inline lanes<T,W> sin(const lanes<T,W> &a){lanes<T,W> s, c; sin_cos(a, s, c); return s;}
+template <typename T, int W> inline lanes<T,W> cos(const lanes<T,W> &a){lanes<T,W> s, c; sin_cos(a, s, c); return c;}
+template <typename T, int W> inline lanes<T,W> sqrt(lanes<T,W> a){for (int l = 0; l < W; l++){a.v[l] = std::sqrt(a.v[l]);} return a;}
+template <typename T, int W> inline lanes<T,W> atan2(lanes<T,W> y, const lanes<T,W> &x){
+	for (int l = 0; l < W; l++){y.v[l] = std::atan2(y.v[l], x.v[l]);} return y;
+}
+
+} // namespace grid_cpu
+
+#endif
@@ -0,0 +1,93 @@
+/**************************************************************************
+ *  Block-sparse gradient outputs
+ *
+ *  dc_du and df_du are stored as two NUM_JOINTS x NUM_JOINTS blocks per
+ *  timestep ([dq | dqd]) holding only the structurally nonzero entries in
+ *  compressed sparse column order. Both blocks share one index map:
+ *
+ *      dc_du: DC_DU_NNZ, DC_DU_COL_PTR, DC_DU_ROW_IDX (row and col are ancestor / descendant)
+ *      df_du: DF_DU_NNZ, DF_DU_COL_PTR, DF_DU_ROW_IDX (row and col are in the same tree)
+ *
+ *  so the values of timestep k, block b (0 = dq, 1 = dqd) start at
+ *  h_dc_du_sparse[(2*k + b)*DC_DU_NNZ] and column col of that block is
+ *  rows DC_DU_ROW_IDX[v] for v in [DC_DU_COL_PTR[col], DC_DU_COL_PTR[col+1]).
+ *
+ *  Neither entry point forms a dense block: the gradient backward pass
+ *  writes each related (row,col) straight to value DC_DU_ENTRY[row + N*col]
+ *  and df_du = -Minv * dc_du only visits the stored dc_du entries.
+ **************************************************************************/
+
+// df_du = -Minv * dc_du on the CSC values of both blocks: df_du(row,col) sums Minv(row,k) dc_du(k,col) over the
+// rows k stored in dc_du column col, all of which share row's tree, so structural zeros are never touched
+template <typename T>
+inline void sparse_minv_gradient_product(T *s_df_du_sparse, const T *s_Minv_packed, const T *s_dc_du_sparse){
+	for (int b = 0; b < 2; b++){
+		const T *dc = &s_dc_du_sparse[b*DC_DU_NNZ]; T *df = &s_df_du_sparse[b*DF_DU_NNZ];
+		for (int col = 0; col < NUM_JOINTS; col++){
+			for (int v = DF_DU_COL_PTR[col]; v < DF_DU_COL_PTR[col+1]; v++){
+				const int row = DF_DU_ROW_IDX[v];
+				T val = static_cast<T>(0);
+				for (int u = DC_DU_COL_PTR[col]; u < DC_DU_COL_PTR[col+1]; u++){
+					const int k = DC_DU_ROW_IDX[u];
+					val += s_Minv_packed[row < k ? upper_index<true>(row, k, NUM_JOINTS) : upper_index<true>(k, row, NUM_JOINTS)] * dc[u];
+				}
+				df[v] = -val;
+			}
+		}
+	}
+}
+
+// CSC values -> dense column-major N x N block (structural zeros are written out)
+template <typename T>
+inline void expand_gradient_block(T *s_dense, const T *s_sparse, const int *col_ptr, const int *row_idx){
+	for (int i = 0; i < NUM_JOINTS*NUM_JOINTS; i++){s_dense[i] = static_cast<T>(0);}
+	for (int col = 0; col < NUM_JOINTS; col++){
+		for (int v = col_ptr[col]; v < col_ptr[col+1]; v++){s_dense[row_idx[v] + NUM_JOINTS*col] = s_sparse[v];}
+	}
+}
+
+// expand num_timesteps of sparse [dq | dqd] gradients back into the dense 2*N*N per timestep layout
+template <typename T>
+__host__
+void expand_dc_du_sparse(T *h_dc_du, const T *h_dc_du_sparse, const int num_timesteps){
+	for (int b = 0; b < 2*num_timesteps; b++){
+		expand_gradient_block<T>(&h_dc_du[b*NUM_JOINTS*NUM_JOINTS], &h_dc_du_sparse[b*DC_DU_NNZ], DC_DU_COL_PTR, DC_DU_ROW_IDX);
+	}
+}
+
+template <typename T>
+__host__
+void expand_df_du_sparse(T *h_df_du, const T *h_df_du_sparse, const int num_timesteps){
+	for (int b = 0; b < 2*num_timesteps; b++){
+		expand_gradient_block<T>(&h_df_du[b*NUM_JOINTS*NUM_JOINTS], &h_df_du_sparse[b*DF_DU_NNZ], DF_DU_COL_PTR, DF_DU_ROW_IDX);
+	}
+}
+
+template <typename T, bool USE_QDD_FLAG, bool USE_COMPRESSED_MEM>
+inline void inverse_dynamics_gradient_sparse_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,USE_COMPRESSED_MEM ? PACKING_Q_QD : PACKING_Q_QD_U>(hd_data,k);
+	const T *s_qdd = USE_QDD_FLAG ? in.u : nullptr;
+	T s_X_buf[36*NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_c[NUM_VEL];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	inverse_dynamics_inner<T>(s_c, s_vaf, in.qd, s_qdd, s_X, d_robotModel->d_XImats, gravity, &contacts);
+	inverse_dynamics_gradient_inner<T,true>(&hd_data->h_dc_du_sparse[k*2*DC_DU_NNZ], s_vaf, in.qd, s_X, d_robotModel->d_XImats, gravity, 0, 0, &contacts);
+}
+
+template <typename T, bool USE_QDD_FLAG>
+inline void forward_dynamics_gradient_sparse_timestep(gridData<T> *hd_data, const robotModel<T> *d_robotModel, const T gravity, const int k){
+	const timestepInputs<T> in = timestep_inputs<T,PACKING_Q_QD_U>(hd_data,k);
+	T s_X_buf[36*NUM_JOINTS]; T s_c[NUM_JOINTS]; T s_vaf[18*NUM_JOINTS]; T s_Minv[SYM_PACKED_SIZE]; T s_dc_du[2*DC_DU_NNZ];
+	const T *s_X = load_update_XImats_cached<T>(s_X_buf, in.q, hd_data, d_robotModel, k);
+	T *s_qdd = &hd_data->h_qdd[k*NUM_VEL];
+	const timestepContacts<T> contacts = timestep_contacts<T>(hd_data,k);
+	direct_minv_inner<T,true>(s_Minv, s_X, d_robotModel->d_XImats);
+	if (USE_QDD_FLAG){for (int i = 0; i < NUM_VEL; i++){s_qdd[i] = in.u[i];}}
+	else {
+		inverse_dynamics_inner<T>(s_c, s_vaf, in.qd, nullptr, s_X, d_robotModel->d_XImats, gravity, &contacts);
+		packed_minv_solve<T>(s_qdd, s_Minv, in.u, s_c);
+	}
+	inverse_dynamics_inner<T>(s_c, s_vaf, in.qd, s_qdd, s_X, d_robotModel->d_XImats, gravity, &contacts);
+	inverse_dynamics_gradient_inner<T,true>(s_dc_du, s_vaf, in.qd, s_X, d_robotModel->d_XImats, gravity, 0, 0, &contacts);
+	sparse_minv_gradient_product<T>(&hd_data->h_df_du_sparse[k*2*DF_DU_NNZ], s_Minv, s_dc_du);
+}
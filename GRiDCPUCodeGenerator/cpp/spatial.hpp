@@ -0,0 +1,160 @@
+/**************************************************************************
+ *  Spatial algebra helpers
+ *
+ *  Motion and force vectors are [angular; linear]. 6x6 matrices are stored
+ *  column-major (A[row + 6*col]) to match the layout used by grid.cuh.
+ **************************************************************************/
+#ifndef GRID_CPU_SPATIAL_HPP
+#define GRID_CPU_SPATIAL_HPP
+
+namespace grid_cpu {
+
+// out = X * v
+template <typename T>
+inline void matVMult6(T *out, const T *X, const T *v){
+	for (int r = 0; r < 6; r++){
+		T val = static_cast<T>(0);
+		for (int c = 0; c < 6; c++){val += X[r + 6*c] * v[c];}
+		out[r] = val;
+	}
+}
+
+// out += X * v
+template <typename T>
+inline void matVMult6Peq(T *out, const T *X, const T *v){
+	for (int r = 0; r < 6; r++){
+		T val = static_cast<T>(0);
+		for (int c = 0; c < 6; c++){val += X[r + 6*c] * v[c];}
+		out[r] += val;
+	}
+}
+
+// out = X^T * f
+template <typename T>
+inline void matTVMult6(T *out, const T *X, const T *f){
+	for (int c = 0; c < 6; c++){
+		T val = static_cast<T>(0);
+		for (int r = 0; r < 6; r++){val += X[r + 6*c] * f[r];}
+		out[c] = val;
+	}
+}
+
+// out += X^T * f
+template <typename T>
+inline void matTVMult6Peq(T *out, const T *X, const T *f){
+	for (int c = 0; c < 6; c++){
+		T val = static_cast<T>(0);
+		for (int r = 0; r < 6; r++){val += X[r + 6*c] * f[r];}
+		out[c] += val;
+	}
+}
+
+// out = X^-T * f (a Plucker motion transform X = [E 0; -E rx E] applied to a force, [E -E rx; 0 E] * f)
+template <typename T>
+inline void forceXMult6(T *out, const T *X, const T *f){
+	for (int r = 0; r < 3; r++){
+		T ang = static_cast<T>(0); T lin = static_cast<T>(0);
+		for (int c = 0; c < 3; c++){
+			ang += X[r + 6*c] * f[c] + X[3 + r + 6*c] * f[3 + c];
+			lin += X[3 + r + 6*(3 + c)] * f[3 + c];
+		}
+		out[r] = ang; out[3 + r] = lin;
+	}
+}
+
+template <typename T>
+inline T dot6(const T *a, const T *b){
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3] + a[4]*b[4] + a[5]*b[5];
+}
+
+// out = v x m (motion cross product, crm(v) * m)
+template <typename T>
+inline void mx(T *out, const T *v, const T *m){
+	out[0] = v[1]*m[2] - v[2]*m[1];
+	out[1] = v[2]*m[0] - v[0]*m[2];
+	out[2] = v[0]*m[1] - v[1]*m[0];
+	out[3] = v[1]*m[5] - v[2]*m[4] + v[4]*m[2] - v[5]*m[1];
+	out[4] = v[2]*m[3] - v[0]*m[5] + v[5]*m[0] - v[3]*m[2];
+	out[5] = v[0]*m[4] - v[1]*m[3] + v[3]*m[1] - v[4]*m[0];
+}
+
+// out += alpha * (v x m)
+template <typename T>
+inline void mxPeq(T *out, const T *v, const T *m, const T alpha){
+	T tmp[6]; mx(tmp,v,m);
+	for (int r = 0; r < 6; r++){out[r] += alpha * tmp[r];}
+}
+
+// out = v x* f (force cross product, crf(v) * f)
+template <typename T>
+inline void fx(T *out, const T *v, const T *f){
+	out[0] = v[1]*f[2] - v[2]*f[1] + v[4]*f[5] - v[5]*f[4];
+	out[1] = v[2]*f[0] - v[0]*f[2] + v[5]*f[3] - v[3]*f[5];
+	out[2] = v[0]*f[1] - v[1]*f[0] + v[3]*f[4] - v[4]*f[3];
+	out[3] = v[1]*f[5] - v[2]*f[4];
+	out[4] = v[2]*f[3] - v[0]*f[5];
+	out[5] = v[0]*f[4] - v[1]*f[3];
+}
+
+// out += v x* f
+template <typename T>
+inline void fxPeq(T *out, const T *v, const T *f){
+	T tmp[6]; fx(tmp,v,f);
+	for (int r = 0; r < 6; r++){out[r] += tmp[r];}
+}
+
+// out = X^T * A * X for symmetric 6x6 A (articulated / composite inertia to the parent frame)
+template <typename T>
+inline void congruence6Peq(T *out, const T *X, const T *A){
+	T AX[36];
+	for (int c = 0; c < 6; c++){matVMult6(&AX[6*c], A, &X[6*c]);}
+	for (int c = 0; c < 6; c++){
+		for (int r = c; r < 6; r++){
+			T val = dot6(&X[6*r], &AX[6*c]);
+			out[r + 6*c] += val;
+			if (r != c){out[c + 6*r] += val;}
+		}
+	}
+}
+
+// sin and cos of a scalar (simd.hpp overloads it for lanes)
+template <typename T>
+inline void sin_cos(const T a, T &s, T &c){using std::sin; using std::cos; s = sin(a); c = cos(a);}
+
+// Plucker transform of a 1-DoF joint (revolute about or prismatic along the unit axis in S)
+// applied to the fixed tree transform: X = X_J(q) * X_tree
+template <typename T>
+inline void jointXmat(T *X, const T q, const T *Xtree, const double *S, const bool revolute){
+	if (revolute){
+		const T ax = static_cast<T>(S[0]); const T ay = static_cast<T>(S[1]); const T az = static_cast<T>(S[2]);
+		T s, c; sin_cos(q, s, c); const T omc = static_cast<T>(1) - c;
+		// E = R(axis,q)^T
+		T E[9];
+		E[0] = c + omc*ax*ax;    E[3] = omc*ax*ay + s*az; E[6] = omc*ax*az - s*ay;
+		E[1] = omc*ay*ax - s*az; E[4] = c + omc*ay*ay;    E[7] = omc*ay*az + s*ax;
+		E[2] = omc*az*ax + s*ay; E[5] = omc*az*ay - s*ax; E[8] = c + omc*az*az;
+		for (int col = 0; col < 6; col++){
+			for (int blk = 0; blk < 2; blk++){
+				const T *in = &Xtree[6*col + 3*blk]; T *out = &X[6*col + 3*blk];
+				out[0] = E[0]*in[0] + E[3]*in[1] + E[6]*in[2];
+				out[1] = E[1]*in[0] + E[4]*in[1] + E[7]*in[2];
+				out[2] = E[2]*in[0] + E[5]*in[1] + E[8]*in[2];
+			}
+		}
+	}
+	else {
+		// X_J = [1 0; -(a q)x 1]
+		const T px = static_cast<T>(S[3])*q; const T py = static_cast<T>(S[4])*q; const T pz = static_cast<T>(S[5])*q;
+		for (int col = 0; col < 6; col++){
+			const T *in = &Xtree[6*col]; T *out = &X[6*col];
+			out[0] = in[0]; out[1] = in[1]; out[2] = in[2];
+			out[3] = in[3] - (py*in[2] - pz*in[1]);
+			out[4] = in[4] - (pz*in[0] - px*in[2]);
+			out[5] = in[5] - (px*in[1] - py*in[0]);
+		}
+	}
+}
+
+} // namespace grid_cpu
+
+#endif
@@ -0,0 +1,197 @@
+/**************************************************************************
+ *  Streaming trajectory driver
+ *
+ *  Runs one algorithm over every row of a memory-mapped trajectory file in
+ *  chunks of chunk_timesteps rows and writes the results to a memory-mapped
+ *  output file. Inputs are read in place through input views and outputs
+ *  are written in place, so no row is copied. A loader thread faults in
+ *  chunk k+1 while the workers compute chunk k, and each finished chunk is
+ *  dropped from both mappings, so resident memory is a few chunks however
+ *  long the log is.
+ *
+ *  Both files are headerless arrays of T in native byte order:
+ *      input   row k = [q (NUM_JOINTS), qd (NUM_VEL), u (NUM_VEL)]   (Q_QD_U_STRIDE values)
+ *      output  row k = the algorithm's gridData output for row k    (stream_output_stride values)
+ *  u is the applied torque for STREAM_FD / STREAM_FD_DU and the measured
+ *  qdd for STREAM_ID / STREAM_ID_DU (unused otherwise). Matrices are column
+ *  major as in gridData.
+ *
+ *      trajectoryStream<float> stream(9.81f, 8192);     // 8192 rows per chunk
+ *      stream.run("log.bin", "tau.bin", STREAM_ID);    // tau.bin is rows x NUM_VEL floats
+ **************************************************************************/
+
+enum streamAlgorithm {STREAM_ID = 0, STREAM_MINV, STREAM_FD, STREAM_ID_DU, STREAM_FD_DU, STREAM_CRBA,
+                      STREAM_EEPOS, STREAM_DEEPOS, STREAM_NUM_ALGORITHMS};
+
+// output written for each stream algorithm (one gridData buffer)
+inline unsigned stream_output_buffer(const int algorithm){
+	static const unsigned outputs[STREAM_NUM_ALGORITHMS] = {BUFFER_C, BUFFER_MINV, BUFFER_QDD, BUFFER_DC_DU, BUFFER_DF_DU,
+	                                                        BUFFER_M, BUFFER_EEPOS, BUFFER_DEEPOS};
+	return (algorithm >= 0 && algorithm < STREAM_NUM_ALGORITHMS) ? outputs[algorithm] : 0;
+}
+
+// T per output row
+template <typename T>
+inline int stream_output_stride(const int algorithm){
+	const unsigned output = stream_output_buffer(algorithm);
+	return output == 0 ? 0 : grid_buffer_info<T>(__builtin_ctz(output)).stride;
+}
+
+struct streamStats {
+	long long rows;
+	long long chunks;
+	double total_s;
+	double compute_s;   // inside the algorithm
+	double stall_s;     // waiting for the loader (non-zero means the pass was I/O bound)
+	double rows_per_s() const {return total_s > 0 ? rows/total_s : 0;}
+};
+
+template <typename T>
+class trajectoryStream {
+public:
+	explicit trajectoryStream(const T gravity_ = static_cast<T>(9.81), const int chunk_timesteps_ = 4096, const int num_threads = SUGGESTED_THREADS) :
+		gravity(gravity_), chunk_timesteps(chunk_timesteps_ > 0 ? chunk_timesteps_ : 1), threads(num_threads){
+		d_robotModel = init_robotModel<T>();
+		hd_data = init_gridData<T>(chunk_timesteps, 0);
+		shutdown = false; job_pending = false; job_offset = 0; job_bytes = 0;
+		loader = std::thread([this](){loader_loop();});
+	}
+
+	~trajectoryStream(){
+		{std::unique_lock<std::mutex> lock(mtx); shutdown = true;}
+		job_cv.notify_all();
+		loader.join();
+		free_gridData<T>(hd_data);
+		free_robotModel<T>(d_robotModel);
+	}
+
+	/**
+	 * Runs algorithm over every row of input_path and writes output_path (created or truncated).
+	 * Returns false, with a message on stdout, if a file cannot be mapped or the input is not whole rows.
+	 */
+	bool run(const char *input_path, const char *output_path, const int algorithm, streamStats *stats = nullptr){
+		const unsigned output = stream_output_buffer(algorithm);
+		if (output == 0){printf("[!Error] unknown stream algorithm %d\n", algorithm); return false;}
+		const size_t in_row = Q_QD_U_STRIDE*sizeof(T), out_row = stream_output_stride<T>(algorithm)*sizeof(T);
+		if (!input.open_read(input_path)){printf("[!Error] could not map %s\n", input_path); return false;}
+		if (input.size() % in_row != 0){
+			printf("[!Error] %s is not a whole number of %d value rows\n", input_path, Q_QD_U_STRIDE);
+			input.close(); return false;
+		}
+		const long long num_rows = static_cast<long long>(input.size() / in_row);
+		if (!output_file.create(output_path, num_rows*out_row)){printf("[!Error] could not create %s\n", output_path); input.close(); return false;}
+
+		// scratch for the other buffers the timestep writes (e.g., qdd for FD_DU), the output itself is redirected to the file
+		reserve_gridData<T>(hd_data, chunk_timesteps, algorithm_buffers(algorithm) & ~output);
+		const gridBufferInfo<T> &out_info = grid_buffer_info<T>(__builtin_ctz(output));
+		T *saved_h = hd_data->*out_info.h, *saved_d = hd_data->*out_info.d;
+
+		streamStats s; s.rows = num_rows; s.chunks = 0; s.compute_s = 0; s.stall_s = 0;
+		const unsigned long long start_ns = grid_cpu::monotonic_ns();
+		const long long num_chunks = (num_rows + chunk_timesteps - 1) / chunk_timesteps;
+		const size_t page = grid_cpu::mappedFile::page_bytes();
+		size_t in_released = 0, out_released = 0;
+		if (num_chunks > 0){post_prefetch(0, chunk_rows(0, num_rows)*in_row);}
+		for (long long c = 0; c < num_chunks; c++){
+			const long long first = c*chunk_timesteps;
+			const int rows = chunk_rows(first, num_rows);
+			unsigned long long t0 = grid_cpu::monotonic_ns();
+			wait_prefetch();
+			unsigned long long t1 = grid_cpu::monotonic_ns();
+			if (c + 1 < num_chunks){post_prefetch((first + rows)*in_row, chunk_rows(first + rows, num_rows)*in_row);}
+
+			// read the chunk in place and write its outputs straight into the output mapping
+			const T *in_rows = reinterpret_cast<const T *>(input.data() + first*in_row);
+			use_input_views<T>(hd_data, make_input_view(in_rows, Q_QD_U_STRIDE), make_input_view(in_rows, Q_QD_U_STRIDE, NUM_JOINTS),
+			                   make_input_view(in_rows, Q_QD_U_STRIDE, NUM_JOINTS + NUM_VEL));
+			T *out_rows = reinterpret_cast<T *>(output_file.data() + first*out_row);
+			hd_data->*out_info.h = out_rows; hd_data->*out_info.d = out_rows;
+			run_chunk(algorithm, rows);
+			unsigned long long t2 = grid_cpu::monotonic_ns();
+
+			// everything before this chunk's end is done with (a page it shares with the next chunk is dropped later)
+			const size_t in_end = (first + rows)*in_row, out_end = (first + rows)*out_row;
+			input.release(in_released, in_end - in_released); in_released = in_end / page * page;
+			output_file.release(out_released, out_end - out_released); out_released = out_end / page * page;
+			s.stall_s += (t1 - t0)*1e-9; s.compute_s += (t2 - t1)*1e-9; s.chunks++;
+		}
+		hd_data->*out_info.h = saved_h; hd_data->*out_info.d = saved_d;
+		use_grid_inputs<T>(hd_data);
+		input.close();
+		const bool ok = output_file.close();
+		if (!ok){printf("[!Error] could not flush %s\n", output_path);}
+		s.total_s = (grid_cpu::monotonic_ns() - start_ns)*1e-9;
+		if (stats != nullptr){*stats = s;}
+		return ok;
+	}
+
+	int chunk_size() const {return chunk_timesteps;}
+	const robotModel<T> *model() const {return d_robotModel;}
+
+private:
+	int chunk_rows(const long long first, const long long num_rows) const {
+		return static_cast<int>(num_rows - first < chunk_timesteps ? num_rows - first : chunk_timesteps);
+	}
+
+	static unsigned algorithm_buffers(const int algorithm){
+		return algorithm == STREAM_FD_DU ? (BUFFER_QDD | BUFFER_DF_DU) : stream_output_buffer(algorithm);
+	}
+
+	void run_chunk(const int algorithm, const int rows){
+		gridData<T> *data = hd_data; const robotModel<T> *model = d_robotModel; const T g = gravity;
+		switch (algorithm){
+			case STREAM_ID: {auto f = [&](int k){inverse_dynamics_timestep<T,true,false>(data,model,g,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_MINV: {auto f = [&](int k){direct_minv_timestep<T,false>(data,model,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_FD: {auto f = [&](int k){forward_dynamics_timestep<T>(data,model,g,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_ID_DU: {auto f = [&](int k){inverse_dynamics_gradient_timestep<T,true,false>(data,model,g,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_FD_DU: {auto f = [&](int k){forward_dynamics_gradient_timestep<T,false>(data,model,g,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_CRBA: {auto f = [&](int k){crba_timestep<T>(data,model,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_EEPOS: {auto f = [&](int k){end_effector_positions_timestep<T,false>(data,model,k);}; threads.parallel_for(rows, f); break;}
+			case STREAM_DEEPOS: {auto f = [&](int k){end_effector_positions_gradient_timestep<T,false>(data,model,k);}; threads.parallel_for(rows, f); break;}
+			default: break;
+		}
+	}
+
+	void post_prefetch(const size_t offset, const size_t bytes){
+		{std::unique_lock<std::mutex> lock(mtx); job_offset = offset; job_bytes = bytes; job_pending = true;}
+		job_cv.notify_one();
+	}
+
+	void wait_prefetch(){
+		std::unique_lock<std::mutex> lock(mtx);
+		done_cv.wait(lock, [&]{return !job_pending;});
+	}
+
+	void loader_loop(){
+		std::unique_lock<std::mutex> lock(mtx);
+		while (true){
+			job_cv.wait(lock, [&]{return shutdown || job_pending;});
+			if (shutdown){return;}
+			const size_t offset = job_offset, bytes = job_bytes;
+			lock.unlock();
+			input.prefetch(offset, bytes);
+			lock.lock();
+			job_pending = false;
+			done_cv.notify_all();
+		}
+	}
+
+	const T gravity;
+	const int chunk_timesteps;
+	hostThreads threads;
+	robotModel<T> *d_robotModel;
+	gridData<T> *hd_data;
+	grid_cpu::mappedFile input;
+	grid_cpu::mappedFile output_file;
+	std::thread loader;
+	std::mutex mtx;
+	std::condition_variable job_cv;
+	std::condition_variable done_cv;
+	bool job_pending;
+	bool shutdown;
+	size_t job_offset;
+	size_t job_bytes;
+
+	trajectoryStream(const trajectoryStream&) = delete;
+	trajectoryStream& operator=(const trajectoryStream&) = delete;
+};
@@ -0,0 +1,164 @@
+/**************************************************************************
+ *  Host worker threads
+ *
+ *  Persistent threads that run a batch of timesteps in parallel. The
+ *  calling thread takes part in the work and timesteps are handed out
+ *  through a shared atomic counter so no thread idles on a larger chunk.
+ *  A batch may hand out grain timesteps per claim and use only the first
+ *  max_threads threads (the knobs the autotuner sweeps, see tuning.hpp).
+ *  Idle workers spin for a while before parking so back to back batches
+ *  (e.g., one per control tick) never pay for a kernel wakeup. The pool
+ *  runs one batch at a time: a batch submitted from another thread while
+ *  one is in flight waits for it and then gets the whole pool, and only a
+ *  batch submitted from inside a job (of any pool) runs on its calling
+ *  thread, as waiting there could deadlock.
+ **************************************************************************/
+#ifndef GRID_CPU_THREADS_HPP
+#define GRID_CPU_THREADS_HPP
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#endif
+
+namespace grid_cpu {
+
+inline void cpu_relax(){
+	#if defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+	#else
+		std::this_thread::yield();
+	#endif
+}
+
+class hostThreads {
+public:
+	explicit hostThreads(int num_threads = 0, int spin_iters = 1 << 14) : spin_limit(spin_iters){
+		if (num_threads <= 0){num_threads = static_cast<int>(std::thread::hardware_concurrency());}
+		if (num_threads <= 0){num_threads = 1;}
+		shutdown = false; generation = 0; active = 0; sleepers = 0; job = nullptr; ctx = nullptr; num_items = 0; job_grain = 1; job_threads = 1;
+		for (int tid = 1; tid < num_threads; tid++){workers.emplace_back([this, tid](){worker_loop(tid);});}
+	}
+
+	~hostThreads(){
+		{std::unique_lock<std::mutex> lock(mtx); shutdown = true;}
+		start_cv.notify_all();
+		for (std::thread &worker : workers){worker.join();}
+	}
+
+	int size() const {return static_cast<int>(workers.size()) + 1;}
+
+	// Run f(k) for k in [0, n) across all threads (or the first max_threads) handing out grain
+	// timesteps at a time, and return once every call is done (safe to call from many threads)
+	template <typename Func>
+	void parallel_for(int n, Func &f, const int grain = 1, const int max_threads = 0){
+		if (n <= 0){return;}
+		const int nthreads = (max_threads <= 0 || max_threads > size()) ? size() : max_threads;
+		if (n == 1 || nthreads == 1 || in_job()){for (int k = 0; k < n; k++){f(k);} return;}
+		// the job state is shared, so batches from other threads queue here for the whole pool
+		std::unique_lock<std::mutex> lock(run_mtx);
+		in_job() = true;
+		run(&trampoline<Func>, static_cast<void *>(&f), n, grain < 1 ? 1 : grain, nthreads);
+		in_job() = false;
+	}
+
+private:
+	typedef void (*job_t)(void *, int);
+
+	// true on pool workers and on a caller while its batch runs, whose nested batches run serially
+	static bool &in_job(){static thread_local bool running = false; return running;}
+
+	template <typename Func>
+	static void trampoline(void *f, int k){(*static_cast<Func *>(f))(k);}
+
+	void run(job_t fn, void *fctx, int n, int grain, int nthreads){
+		job = fn; ctx = fctx; num_items = n; job_grain = grain; job_threads = nthreads; next.store(0);
+		active.store(static_cast<int>(workers.size()));
+		generation.fetch_add(1);
+		if (sleepers.load() > 0){
+			{std::unique_lock<std::mutex> lock(mtx);}
+			start_cv.notify_all();
+		}
+		drain(fn, fctx, n, grain);
+		while (active.load() > 0){cpu_relax();}
+	}
+
+	void drain(job_t fn, void *fctx, int n, int grain){
+		for (int k = next.fetch_add(grain); k < n; k = next.fetch_add(grain)){
+			const int end = k + grain < n ? k + grain : n;
+			for (int i = k; i < end; i++){fn(fctx,i);}
+		}
+	}
+
+	void worker_loop(const int tid){
+		in_job() = true;
+		unsigned long seen = 0;
+		while (true){
+			for (int spin = 0; spin < spin_limit && generation.load() == seen; spin++){cpu_relax();}
+			if (generation.load() == seen){
+				std::unique_lock<std::mutex> lock(mtx);
+				sleepers.fetch_add(1);
+				start_cv.wait(lock, [&]{return shutdown.load() || generation.load() != seen;});
+				sleepers.fetch_sub(1);
+			}
+			if (shutdown.load()){return;}
+			seen = generation.load();
+			if (tid < job_threads){drain(job, ctx, num_items, job_grain);}
+			active.fetch_sub(1);
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::mutex run_mtx; // held by the thread whose batch is in flight, the others wait on it
+	std::condition_variable start_cv;
+	std::atomic<int> next;
+	std::atomic<unsigned long> generation;
+	std::atomic<int> active;
+	std::atomic<int> sleepers;
+	std::atomic<bool> shutdown;
+	const int spin_limit;
+	job_t job;
+	void *ctx;
+	int num_items;
+	int job_grain;
+	int job_threads;
+
+	hostThreads(const hostThreads&) = delete;
+	hostThreads& operator=(const hostThreads&) = delete;
+};
+
+/**
+ * The process wide pool of num_threads threads (0 for one per core), shared by every generated model.
+ * Pools are made on first use and never freed, so a pool handed out once stays valid for the whole process.
+ */
+inline hostThreads *shared_threads(int num_threads = 0){
+	static std::mutex pools_mtx;
+	static std::vector<hostThreads *> pools;
+	if (num_threads <= 0){num_threads = static_cast<int>(std::thread::hardware_concurrency());}
+	if (num_threads <= 0){num_threads = 1;}
+	std::lock_guard<std::mutex> lock(pools_mtx);
+	for (hostThreads *pool : pools){if (pool->size() == num_threads){return pool;}}
+	pools.push_back(new hostThreads(num_threads));
+	return pools.back();
+}
+
+// the pool of the wrappers called without one (set by the latest init_grid of any model)
+inline std::atomic<hostThreads *> &default_threads_ptr(){static std::atomic<hostThreads *> threads(nullptr); return threads;}
+inline hostThreads *default_threads(int num_threads = 0){
+	hostThreads *threads = default_threads_ptr().load();
+	if (threads == nullptr){
+		hostThreads *expected = nullptr;
+		threads = shared_threads(num_threads);
+		if (!default_threads_ptr().compare_exchange_strong(expected, threads)){threads = expected;}
+	}
+	return threads;
+}
+
+} // namespace grid_cpu
+
+#ifndef __CUDACC__
+	// init_grid returns the worker pool in place of the CUDA stream array
+	typedef grid_cpu::hostThreads cudaStream_t;
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+/**************************************************************************
+ *  Tuning cache of the batch execution parameters
+ *
+ *  Holds the thread count and grain (timesteps per claim) that won the
+ *  autotuner's sweep (see autotune.hpp) for each robot, algorithm,
+ *  precision and batch size on this CPU. Every generated batch call looks
+ *  its configuration up here and falls back to all threads with a grain of
+ *  one when nothing was tuned. A batch size that was not tuned uses the
+ *  closest tuned one (in ratio).
+ *
+ *  The cache file is plain text, one tab separated entry per line:
+ *      cpu  robot  label  sizeof(T)  batch  threads  grain  us_per_batch
+ *  Entries of other CPUs are kept when the file is rewritten but never
+ *  used. The process wide cache loads $GRID_CPU_TUNING_CACHE on first use;
+ *  load before dispatching batches, lookups are not synchronized with it.
+ **************************************************************************/
+#ifndef GRID_CPU_TUNING_HPP
+#define GRID_CPU_TUNING_HPP
+
+#include <string>
+#include <unordered_map>
+
+namespace grid_cpu {
+
+struct tuningConfig {
+	int threads;  // first threads of the pool that take part (0 for all)
+	int grain;    // timesteps handed out per claim
+};
+
+struct tuningEntry {
+	std::string cpu;
+	std::string robot;
+	std::string label;
+	int precision;  // sizeof(T)
+	int batch;
+	tuningConfig config;
+	double us;      // per batch when it was tuned
+};
+
+// CPU model and hardware thread count of this machine, the part of every cache key that is not the call
+inline const std::string &cpu_model(){
+	static const std::string model = [](){
+		std::string name = "unknown";
+		FILE *f = fopen("/proc/cpuinfo", "r");
+		if (f != nullptr){
+			char line[512];
+			while (fgets(line, sizeof(line), f) != nullptr){
+				if (strncmp(line, "model name", 10) != 0){continue;}
+				const char *val = strchr(line, ':');
+				if (val == nullptr){continue;}
+				for (val++; *val == ' ' || *val == '\t'; val++){}
+				name = val;
+				while (!name.empty() && (name.back() == '\n' || name.back() == ' ')){name.pop_back();}
+				break;
+			}
+			fclose(f);
+		}
+		return name + " (" + std::to_string(std::thread::hardware_concurrency()) + " threads)";
+	}();
+	return model;
+}
+
+class tuningCache {
+public:
+	// process wide cache (loads $GRID_CPU_TUNING_CACHE the first time it is used)
+	static tuningCache &instance(){
+		static tuningCache cache(getenv("GRID_CPU_TUNING_CACHE"));
+		return cache;
+	}
+
+	/**
+	 * Adds the entries of path to the cache (an entry replaces one with the same key)
+	 * Returns false, with a message on stdout, if the file cannot be read.
+	 */
+	bool load(const char *path){
+		FILE *f = fopen(path, "r");
+		if (f == nullptr){printf("[!Error] could not read tuning cache %s\n", path); return false;}
+		char line[1024];
+		while (fgets(line, sizeof(line), f) != nullptr){
+			if (line[0] == '#' || line[0] == '\n'){continue;}
+			std::vector<std::string> fields; std::string field;
+			for (const char *c = line; *c != '\0' && *c != '\n'; c++){
+				if (*c == '\t'){fields.push_back(field); field.clear();} else {field += *c;}
+			}
+			fields.push_back(field);
+			if (fields.size() != 8){continue;}
+			tuningEntry entry;
+			entry.cpu = fields[0]; entry.robot = fields[1]; entry.label = fields[2];
+			entry.precision = atoi(fields[3].c_str()); entry.batch = atoi(fields[4].c_str());
+			entry.config.threads = atoi(fields[5].c_str()); entry.config.grain = atoi(fields[6].c_str());
+			entry.us = atof(fields[7].c_str());
+			if (entry.batch > 0 && entry.config.grain > 0){insert(entry);}
+		}
+		fclose(f);
+		return true;
+	}
+
+	// Writes every entry (of any CPU) to path, returns false if it cannot be written
+	bool save(const char *path) const {
+		FILE *f = fopen(path, "w");
+		if (f == nullptr){printf("[!Error] could not write tuning cache %s\n", path); return false;}
+		fprintf(f, "# grid_cpu tuning cache: cpu robot label sizeof(T) batch threads grain us_per_batch\n");
+		for (const tuningEntry &e : entries){
+			fprintf(f, "%s\t%s\t%s\t%d\t%d\t%d\t%d\t%.3f\n", e.cpu.c_str(), e.robot.c_str(), e.label.c_str(), e.precision, e.batch,
+			        e.config.threads, e.config.grain, e.us);
+		}
+		return fclose(f) == 0;
+	}
+
+	// Stores the winner for one call on this CPU
+	void record(const char *robot, const char *label, const int precision, const int batch, const tuningConfig config, const double us){
+		tuningEntry entry;
+		entry.cpu = cpu_model(); entry.robot = robot; entry.label = label;
+		entry.precision = precision; entry.batch = batch; entry.config = config; entry.us = us;
+		insert(entry);
+	}
+
+	// Configuration of a batch call, false if none was tuned (or forced) for it
+	bool lookup(tuningConfig &config, const char *robot, const char *label, const int precision, const int batch) const {
+		if (forced_active){config = forced; return true;}
+		if (index.empty()){return false;}
+		const auto it = index.find(key(robot, label, precision));
+		if (it == index.end()){return false;}
+		double best = 0; int best_id = -1;
+		for (const int id : it->second){
+			const int tuned = entries[id].batch;
+			const double ratio = tuned > batch ? static_cast<double>(tuned)/batch : static_cast<double>(batch)/tuned;
+			if (best_id < 0 || ratio < best){best = ratio; best_id = id;}
+		}
+		config = entries[best_id].config;
+		return true;
+	}
+
+	// Makes every lookup return config until cleared with nullptr (used while sweeping)
+	void force(const tuningConfig *config){
+		forced_active = config != nullptr;
+		if (config != nullptr){forced = *config;}
+	}
+
+	void clear(){entries.clear(); index.clear();}
+	int size() const {return static_cast<int>(entries.size());}
+	const std::vector<tuningEntry> &all() const {return entries;}
+
+private:
+	explicit tuningCache(const char *path) : forced_active(false){
+		forced.threads = 0; forced.grain = 1;
+		if (path != nullptr && path[0] != '\0'){load(path);}
+	}
+
+	// FNV-1a over robot, label and precision
+	static unsigned long long key(const char *robot, const char *label, const int precision){
+		unsigned long long h = 1469598103934665603ull;
+		for (const char *c = robot; *c != '\0'; c++){h = (h ^ static_cast<unsigned char>(*c)) * 1099511628211ull;}
+		h = (h ^ 0xffu) * 1099511628211ull;
+		for (const char *c = label; *c != '\0'; c++){h = (h ^ static_cast<unsigned char>(*c)) * 1099511628211ull;}
+		return (h ^ static_cast<unsigned>(precision)) * 1099511628211ull;
+	}
+
+	void insert(const tuningEntry &entry){
+		for (tuningEntry &e : entries){
+			if (e.cpu == entry.cpu && e.robot == entry.robot && e.label == entry.label && e.precision == entry.precision && e.batch == entry.batch){
+				e = entry; return;
+			}
+		}
+		entries.push_back(entry);
+		if (entry.cpu == cpu_model()){index[key(entry.robot.c_str(), entry.label.c_str(), entry.precision)].push_back(static_cast<int>(entries.size()) - 1);}
+	}
+
+	std::vector<tuningEntry> entries;
+	std::unordered_map<unsigned long long, std::vector<int>> index;  // entries of this CPU per robot, label and precision
+	tuningConfig forced;
+	bool forced_active;
+
+	tuningCache(const tuningCache&) = delete;
+	tuningCache& operator=(const tuningCache&) = delete;
+};
+
+inline tuningCache &tuning_cache(){return tuningCache::instance();}
+
+} // namespace grid_cpu
+
+#endif
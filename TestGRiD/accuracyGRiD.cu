@@ -0,0 +1,113 @@
+/***
+g++ -std=c++11 -O3 -march=native -pthread -x c++ -DGRID_CPU -o accuracyGRiD.exe accuracyGRiD.cu
+usage: ./accuracyGRiD.exe [--samples=N] [--batch=N] [--reps=N]
+Prints Minv, FD and FD_DU for N random states in float, mixed (float with double
+accumulation) and double precision, followed by the time per timestep of each.
+accuracyGRiD.py compares them against RBDReference.
+***/
+
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cstring>
+#include "../grid_cpu.hpp"
+
+const char *PRECISIONS[3] = {"float", "mixed", "double"};
+
+template <typename T>
+void print_row(const char *alg, const char *precision, const T *vals, const int n){
+	printf("%s %s", alg, precision);
+	for (int i = 0; i < n; i++){printf(" %.17g", static_cast<double>(vals[i]));}
+	printf("\n");
+}
+
+template <typename T>
+void load_state(grid::gridData<T> *hd_data, const std::vector<double> &state, const int k){
+	for (int i = 0; i < grid::Q_QD_U_STRIDE; i++){hd_data->h_q_qd_u[k*grid::Q_QD_U_STRIDE + i] = static_cast<T>(state[i]);}
+}
+
+// precision: 0 float, 1 mixed, 2 double
+template <typename T>
+void run_algorithm(const int alg, const int precision, grid::gridData<T> *hd_data, const grid::robotModel<T> *d_robotModel, const int num_timesteps){
+	const T gravity = static_cast<T>(9.81); dim3 blocks(1,1,1), dimms(1,1,1);
+	if (alg == 0){
+		if (precision == 1){grid::direct_minv_mixed_compute_only<T>(hd_data,d_robotModel,num_timesteps,blocks,dimms);}
+		else {grid::direct_minv_compute_only<T>(hd_data,d_robotModel,num_timesteps,blocks,dimms);}
+	}
+	else if (alg == 1){
+		if (precision == 1){grid::forward_dynamics_mixed_compute_only<T>(hd_data,d_robotModel,gravity,num_timesteps,blocks,dimms);}
+		else {grid::forward_dynamics_compute_only<T>(hd_data,d_robotModel,gravity,num_timesteps,blocks,dimms);}
+	}
+	else {
+		if (precision == 1){grid::forward_dynamics_gradient_mixed_compute_only<T>(hd_data,d_robotModel,gravity,num_timesteps,blocks,dimms);}
+		else {grid::forward_dynamics_gradient_compute_only<T>(hd_data,d_robotModel,gravity,num_timesteps,blocks,dimms);}
+	}
+}
+
+template <typename T>
+void print_outputs(const int precision, grid::gridData<T> *hd_data, const grid::robotModel<T> *d_robotModel){
+	const int N = grid::NUM_VEL;
+	run_algorithm<T>(0, precision, hd_data, d_robotModel, 1); print_row<T>("Minv", PRECISIONS[precision], hd_data->h_Minv, N*N);
+	run_algorithm<T>(1, precision, hd_data, d_robotModel, 1); print_row<T>("FD", PRECISIONS[precision], hd_data->h_qdd, N);
+	run_algorithm<T>(2, precision, hd_data, d_robotModel, 1); print_row<T>("FD_DU", PRECISIONS[precision], hd_data->h_df_du, 2*N*N);
+}
+
+// median single thread time per timestep over a batch of random states
+template <typename T>
+void print_timings(const int precision, grid::gridData<T> *hd_data, const grid::robotModel<T> *d_robotModel, const int batch, const int reps){
+	const char *ALGS[3] = {"Minv", "FD", "FD_DU"};
+	for (int alg = 0; alg < 3; alg++){
+		std::vector<double> times;
+		run_algorithm<T>(alg, precision, hd_data, d_robotModel, batch); // warm up (allocates the outputs)
+		for (int rep = 0; rep < reps; rep++){
+			struct timespec start, end;
+			clock_gettime(CLOCK_MONOTONIC,&start);
+			run_algorithm<T>(alg, precision, hd_data, d_robotModel, batch);
+			clock_gettime(CLOCK_MONOTONIC,&end);
+			times.push_back(time_delta_us_timespec(start,end)/batch);
+		}
+		std::sort(times.begin(), times.end());
+		printf("TIME %s %s %.6g\n", ALGS[alg], PRECISIONS[precision], times[times.size()/2]);
+	}
+}
+
+int main(int argc, char **argv){
+	int num_samples = 100, batch = 1024, reps = 20;
+	for (int i = 1; i < argc; i++){
+		if (!strncmp(argv[i], "--samples=", 10)){num_samples = atoi(argv[i] + 10);}
+		else if (!strncmp(argv[i], "--batch=", 8)){batch = atoi(argv[i] + 8);}
+		else if (!strncmp(argv[i], "--reps=", 7)){reps = atoi(argv[i] + 7);}
+	}
+	grid::robotModel<float> *model_f = grid::init_robotModel<float>();
+	grid::robotModel<double> *model_d = grid::init_robotModel<double>();
+	grid::gridData<float> *data_f = grid::init_gridData<float>(batch);
+	grid::gridData<double> *data_d = grid::init_gridData<double>(batch);
+
+	// states are rounded to float so every precision (and the reference) sees the same inputs
+	std::mt19937 rng(0); std::uniform_real_distribution<double> dist(-1.0, 1.0);
+	std::vector<double> state(grid::Q_QD_U_STRIDE);
+	for (int s = 0; s < num_samples; s++){
+		for (double &val : state){val = static_cast<double>(static_cast<float>(dist(rng)));}
+		printf("SAMPLE %d\n", s);
+		print_row<double>("q", "input", &state[0], grid::NUM_JOINTS);
+		print_row<double>("qd", "input", &state[grid::NUM_JOINTS], grid::NUM_VEL);
+		print_row<double>("u", "input", &state[grid::NUM_JOINTS + grid::NUM_VEL], grid::NUM_VEL);
+		load_state<float>(data_f, state, 0); load_state<double>(data_d, state, 0);
+		print_outputs<float>(0, data_f, model_f);
+		print_outputs<float>(1, data_f, model_f);
+		print_outputs<double>(2, data_d, model_d);
+	}
+
+	for (int k = 0; k < batch; k++){
+		for (double &val : state){val = dist(rng);}
+		load_state<float>(data_f, state, k); load_state<double>(data_d, state, k);
+	}
+	print_timings<float>(0, data_f, model_f, batch, reps);
+	print_timings<float>(1, data_f, model_f, batch, reps);
+	print_timings<double>(2, data_d, model_d, batch, reps);
+
+	grid::free_gridData<float>(data_f); grid::free_gridData<double>(data_d);
+	grid::free_robotModel<float>(model_f); grid::free_robotModel<double>(model_d);
+	return 0;
+}
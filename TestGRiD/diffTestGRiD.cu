@@ -0,0 +1,973 @@
+/***
+g++ -std=c++11 -O3 -march=native -pthread -x c++ -DGRID_CPU -o diffTestGRiD.exe diffTestGRiD.cu
+usage: ./diffTestGRiD.exe [--samples=N] [--so-samples=N] [--threads=N] [--tol=X] [--seed=N]
+Runs every grid_cpu.hpp algorithm in double precision on N random states
+(the second order ones, dense, PACKED and contracted with a random lambda,
+on the first --so-samples states; the sparse gradients expanded to dense)
+and compares each output with reference_dynamics.hpp (FD and FD_DU also through
+the LTL factorization paths, FD_LTL and FD_DU_LTL, and Minv, also from h_q, and M
+in packed storage unpacked with sym_packed_index, Minv_PACKED and CRBA_PACKED). Reports the worst absolute
+error, the worst error relative to the largest reference entry of that output,
+and the sample it occurred at. Exits with 1 if any relative error is above --tol.
+After the workers, autotune writes a tuning cache for a few calls, which is
+loaded back and the calls are checked under it and under an uneven grain (TUNING).
+Two threads submitting to one pool at once must each get more than one thread, and a
+batch submitted from inside a job must still complete (POOL).
+The AoSoA kernels run at default_lanes<double> through to_aosoa and from_aosoa on a batch that
+leaves the last block partial, with lanes on both sides of SIN_COS_MAX_ARG (AOSOA).
+ID, FD and FD_DU also read their inputs through use_input_views over caller arrays with
+padded strides and offsets, and the compressed ID, Minv and ID_DU through use_packed_inputs (VIEWS).
+A gridData that lazily carved its outputs is grown with resize_gridData and the outputs kept from
+before, and the calls after the growth and after a request to shrink it, are compared (RESIZE).
+The mixed precision Minv, FD and FD_DU at T_ACC = double are compared with the reference and must
+match the plain double calls bitwise (MIXED).
+A rolloutEngine rolls out random controls from a random state with both
+integrators, checked against the same integration of the reference ABA (ROLLOUT).
+The end effector poses, Jacobians and Jdot*qd (EE) are compared with poses read
+off the reference world to link transforms and their derivatives.
+A gridData with enable_contacts gives up to MAX_CONTACTS random external
+wrenches to each timestep, and ID, FD, ABA and both gradients under them are
+compared with the reference given the same wrenches (CONTACTS).
+The worker threads submit their batches to the shared pools, the fleet
+scheduler and the dynamics server at the same time, so a build with -fsanitize=thread
+(diffTestGRiD.py --sanitize=thread) also checks them for data races.
+A floating base grid_cpu.hpp is built with -DGRID_FLOATING_BASE and checks
+the algorithms floating base models have (no ABA, sparse, second order, bundle, AoSoA, mixed precision, fleet, server, stream or rollout).
+With -DGRID_SPLIT it includes grid_cpu/grid_cpu.hpp instead and links grid_cpu/libgrid_cpu.a
+(diffTestGRiD.py -s), so the explicitly instantiated split backend is checked the same way.
+***/
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <unistd.h>
+#ifdef GRID_SPLIT
+#include "../grid_cpu/grid_cpu.hpp"
+#else
+#include "../grid_cpu.hpp"
+#endif
+#include "reference_dynamics.hpp"
+
+const int BATCH = 64;
+const double GRAVITY = 9.81;
+const int MAX_CONTACTS = 2;
+
+enum diffOutput {OUT_ID = 0, OUT_ID_DU, OUT_MINV, OUT_CRBA, OUT_MINV_P, OUT_CRBA_P, OUT_FD, OUT_ABA, OUT_FD_DU, OUT_FD_LTL, OUT_FD_DU_LTL,
+                 OUT_ID_DU_SP, OUT_FD_DU_SP, OUT_ID_SO, OUT_FD_SO, OUT_ID_SO_P, OUT_FD_SO_P, OUT_ID_SO_C, OUT_FD_SO_C, OUT_BUNDLE, OUT_KIN_CACHE,
+                 OUT_CONTACTS, OUT_EE, OUT_AOSOA, OUT_VIEWS, OUT_RESIZE, OUT_MIXED, OUT_FLEET, OUT_SERVER, OUT_STREAM, OUT_ROLLOUT, OUT_TUNING,
+                 OUT_POOL, NUM_OUTPUTS};
+const char *OUTPUT_NAMES[NUM_OUTPUTS] = {"ID", "ID_DU", "Minv", "CRBA", "Minv_PACKED", "CRBA_PACKED", "FD", "ABA", "FD_DU", "FD_LTL", "FD_DU_LTL",
+                                         "ID_DU_SP", "FD_DU_SP", "ID_SO", "FD_SO", "ID_SO_P", "FD_SO_P", "ID_SO_C", "FD_SO_C", "BUNDLE", "KIN_CACHE",
+                                         "CONTACTS", "EE", "AOSOA", "VIEWS", "RESIZE", "MIXED", "FLEET", "SERVER", "STREAM", "ROLLOUT", "TUNING",
+                                         "POOL"};
+
+// Drivers shared by every worker thread
+struct diffTargets {
+	grid_cpu::hostThreads *earlier_pool;  // returned by an init_grid before the latest one
+#ifndef GRID_FLOATING_BASE
+	grid_cpu::fleetScheduler<double> *fleet;
+	int fleet_model;
+	grid::dynamicsServer<double,BATCH> *server;
+#endif
+};
+
+struct errorStats {
+	double max_abs;
+	double max_rel;
+	long long worst_sample;
+	long long count;
+	errorStats() : max_abs(0), max_rel(0), worst_sample(-1), count(0) {}
+	void record(const double *grid_out, const double *ref, const int n, const long long sample){
+		double err = 0, scale = 0;
+		for (int i = 0; i < n; i++){
+			// a NaN on either side is an infinite error (std::max would drop it)
+			const double diff = std::abs(grid_out[i] - ref[i]);
+			err = std::max(err, diff == diff ? diff : std::numeric_limits<double>::infinity());
+			scale = std::max(scale, std::abs(ref[i]));
+		}
+		const double rel = scale > 0 ? err/scale : err;
+		max_abs = std::max(max_abs, err);
+		if (rel > max_rel || worst_sample < 0){max_rel = rel; worst_sample = sample;}
+		count++;
+	}
+	void merge(const errorStats &other){
+		max_abs = std::max(max_abs, other.max_abs);
+		if (other.count > 0 && (other.max_rel > max_rel || worst_sample < 0)){max_rel = other.max_rel; worst_sample = other.worst_sample;}
+		count += other.count;
+	}
+};
+
+// the reference model is read from the same URDFParser data the generated constants were emitted from
+grid_reference::referenceModel model_from_grid(){
+	grid_reference::referenceModel model;
+	model.n = grid::NUM_JOINTS;
+	for (int jid = 0; jid < grid::NUM_JOINTS; jid++){
+		model.parent.push_back(grid::PARENT_IDS[jid]);
+		model.revolute.push_back(grid::JOINT_REVOLUTE[jid]);
+		for (int r = 0; r < 6; r++){model.S.push_back(grid::S_VECTORS[6*jid + r]);}
+		for (int i = 0; i < 36; i++){model.Xtree.push_back(grid::XIMATS[36*jid + i]); model.I.push_back(grid::XIMATS[36*(grid::NUM_JOINTS + jid) + i]);}
+	}
+#ifdef GRID_FLOATING_BASE
+	model.base_I.assign(grid::BASE_INERTIA, grid::BASE_INERTIA + 36);
+#endif
+	model.ee.assign(grid::EE_JOINT_IDS, grid::EE_JOINT_IDS + grid::NUM_EES);
+	return model;
+}
+
+// sample k is reproducible from (seed, k) alone: q, qd and u uniform in [-1,1) (a floating base quaternion of any scale)
+void random_state(double *state, const unsigned long long seed, const long long sample){
+	unsigned long long x = seed*0x9E3779B97F4A7C15ull + static_cast<unsigned long long>(sample);
+	for (int i = 0; i < grid::Q_QD_U_STRIDE; i++){
+		// splitmix64
+		unsigned long long z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull; z = (z ^ (z >> 27)) * 0x94D049BB133111EBull; z ^= z >> 31;
+		state[i] = 2.0*static_cast<double>(z >> 11)/9007199254740992.0 - 1.0;
+	}
+}
+
+// ID (u as qdd), both gradients, Minv, M and FD of the reference at one state, for the rows that check a few calls each
+struct referenceOutputs {
+	std::vector<double> c, dc_du, minv, M, qdd, df_du;
+	referenceOutputs() : c(grid::NUM_VEL), dc_du(2*grid::NUM_VEL*grid::NUM_VEL), minv(grid::NUM_VEL*grid::NUM_VEL),
+	                     M(grid::NUM_VEL*grid::NUM_VEL), qdd(grid::NUM_VEL), df_du(2*grid::NUM_VEL*grid::NUM_VEL) {}
+	void compute(const grid_reference::referenceModel &model, const double *q, const double *qd, const double *u){
+#ifdef GRID_FLOATING_BASE
+		grid_reference::fb_rnea<double>(c.data(), model, q, qd, u, GRAVITY);
+		grid_reference::fb_rnea_grad(dc_du.data(), model, q, qd, u, GRAVITY);
+		grid_reference::fb_minv<double>(minv.data(), model, q);
+		grid_reference::fb_crba<double>(M.data(), model, q);
+		grid_reference::fb_forward_dynamics<double>(qdd.data(), model, q, qd, u, GRAVITY);
+		grid_reference::fb_forward_dynamics_grad(df_du.data(), model, q, qd, u, GRAVITY);
+#else
+		grid_reference::rnea<double>(c.data(), model, q, qd, u, GRAVITY);
+		grid_reference::rnea_grad(dc_du.data(), model, q, qd, u, GRAVITY);
+		grid_reference::minv<double>(minv.data(), model, q);
+		grid_reference::crba<double>(M.data(), model, q);
+		grid_reference::aba<double>(qdd.data(), model, q, qd, u, GRAVITY);
+		grid_reference::forward_dynamics_grad(df_du.data(), model, q, qd, u, GRAVITY);
+#endif
+	}
+};
+
+/**
+ * Timestep k of hd_data gets sample % (MAX_CONTACTS + 1) random wrenches, each on a random body (or the
+ * floating base) with entries in [-1,1), which are also returned for the reference
+ */
+void random_contacts(std::vector<grid_reference::referenceWrenches> &wrenches, grid::gridData<double> *hd_data,
+                     const unsigned long long seed, const long long first, const int rows){
+#ifdef GRID_FLOATING_BASE
+	const int first_body = -1;
+#else
+	const int first_body = 0;
+#endif
+	std::vector<double> state(grid::Q_QD_U_STRIDE);
+	grid::clear_contacts<double>(hd_data);
+	for (int k = 0; k < rows; k++){
+		wrenches[k].clear();
+		for (int c = 0; c < (first + k) % (MAX_CONTACTS + 1); c++){
+			random_state(state.data(), seed + 2 + c, first + k);
+			grid_reference::referenceWrench ext;
+			ext.body = std::min(grid::NUM_JOINTS - 1, first_body + static_cast<int>((state[0] + 1.0)/2.0*(grid::NUM_JOINTS - first_body)));
+			std::copy(&state[1], &state[7], ext.w);
+			grid::add_contact<double>(hd_data, k, ext.body, ext.w);
+			wrenches[k].push_back(ext);
+		}
+	}
+}
+
+// One timestep of a packed symmetric NUM_VEL x NUM_VEL output (Minv_packed, M_packed) expanded to the dense layout
+void sym_unpack(double *dense, const double *packed){
+	const int N = grid::NUM_VEL;
+	for (int col = 0; col < N; col++){for (int row = 0; row < N; row++){dense[row + N*col] = packed[grid::sym_packed_index(row, col)];}}
+}
+
+#ifndef GRID_FLOATING_BASE
+// One timestep of a PACKED second order output expanded to the dense layout
+void so_unpack(double *dense, const double *packed){
+	const int N = grid::NUM_VEL;
+	for (int tensor = 0; tensor < 4; tensor++){
+		for (int slice = 0; slice < N; slice++){grid::so_packed_slice<double>(&dense[(tensor*N + slice)*N*N], packed, tensor, slice);}
+	}
+}
+
+// The second order reference contracted with lambda over the output index, in the idsva_so_contracted layout
+void so_contract(double *contracted, const double *so, const double *lambda){
+	const int N = grid::NUM_VEL; const int NN = N*N; const int NNN = N*N*N;
+	for (int i = 0; i < 4*NN; i++){contracted[i] = 0;}
+	for (int tensor = 0; tensor < 3; tensor++){
+		for (int i = 0; i < N; i++){for (int jk = 0; jk < NN; jk++){contracted[tensor*NN + jk] += lambda[i]*so[tensor*NNN + i*NN + jk];}}
+	}
+	// slice k of the last block is dM/dq_k, so (M lambda)_j differentiates to sum_i dM(j,i)/dq_k lambda_i
+	for (int k = 0; k < N; k++){
+		for (int j = 0; j < N; j++){for (int i = 0; i < N; i++){contracted[3*NN + j + N*k] += so[3*NNN + k*NN + j + N*i]*lambda[i];}}
+	}
+}
+
+// Runs the batch of hd_data as one fleet request of algorithm and returns its output
+std::vector<double> fleet_batch(const diffTargets &targets, const grid::gridData<double> *hd_data, const int algorithm, const int rows){
+	grid_cpu::fleetScheduler<double> &fleet = *targets.fleet;
+	grid_cpu::fleetScheduler<double>::request *req = fleet.acquire(targets.fleet_model);
+	for (; req == nullptr; req = fleet.acquire(targets.fleet_model)){std::this_thread::yield();}
+	std::copy(hd_data->h_q_qd_u, hd_data->h_q_qd_u + rows*grid::Q_QD_U_STRIDE, fleet.inputs(req));
+	fleet.submit(req, algorithm, rows);
+	fleet.wait(req);
+	const double *out = fleet.output(req);
+	std::vector<double> result(out, out + rows*fleet.descriptor(targets.fleet_model)->output_stride[algorithm]);
+	fleet.release(req);
+	return result;
+}
+
+// Runs the batch of hd_data as one server request of algorithm and returns the output buffer it fills
+std::vector<double> server_batch(const diffTargets &targets, const grid::gridData<double> *hd_data, const int algorithm,
+                                 double *grid::gridData<double>::*output, const int stride, const int rows){
+	grid::dynamicsServer<double,BATCH> &server = *targets.server;
+	grid::dynamicsServer<double,BATCH>::request *req = server.acquire();
+	for (; req == nullptr; req = server.acquire()){std::this_thread::yield();}
+	std::copy(hd_data->h_q_qd_u, hd_data->h_q_qd_u + rows*grid::Q_QD_U_STRIDE, req->hd_data->h_q_qd_u);
+	server.submit(req, algorithm, rows);
+	server.wait(req);
+	const double *out = req->hd_data->*output;
+	std::vector<double> result(out, out + rows*stride);
+	server.release(req);
+	return result;
+}
+#endif
+
+void check_batch(std::vector<errorStats> &stats, grid::gridData<double> *hd_data, grid::gridData<double> *hd_cached,
+                 grid::gridData<double> *hd_contacts, const grid::robotModel<double> *d_robotModel,
+                 const grid_reference::referenceModel &model, const diffTargets &targets, const unsigned long long seed,
+                 const long long first, const int rows, const int so_rows){
+	const int N = grid::NUM_VEL; const int NNN = N*N*N; const int S = grid::Q_QD_U_STRIDE;
+	for (int k = 0; k < rows; k++){random_state(&hd_data->h_q_qd_u[k*S], seed, first + k);}
+#ifndef GRID_FLOATING_BASE
+	// the costate of the contracted second order outputs is the leading entries of a second random state
+	for (int k = 0; k < so_rows; k++){
+		std::vector<double> state(S); random_state(state.data(), seed + 1, first + k);
+		std::copy(state.begin(), state.begin() + N, &hd_data->h_lambda[k*N]);
+	}
+#endif
+	dim3 blocks(1,1,1), dimms(1,1,1);
+#ifndef GRID_FLOATING_BASE
+	// the bundle writes the buffers of the separate calls below, so its outputs are copied out first
+	grid::dynamics_bundle_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> bundle_c(hd_data->h_c, hd_data->h_c + N*rows), bundle_qdd(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	const std::vector<double> bundle_minv(hd_data->h_Minv, hd_data->h_Minv + N*N*rows);
+	const std::vector<double> bundle_dc_du(hd_data->h_dc_du, hd_data->h_dc_du + 2*N*N*rows);
+	const std::vector<double> bundle_df_du(hd_data->h_df_du, hd_data->h_df_du + 2*N*N*rows);
+#endif
+	// the fused end effector pass, alone and with its RNEA pass (whose velocities then feed Jdot*qd)
+	const int EE = grid::NUM_EES;
+	grid::end_effector_kinematics_compute_only<double,grid::EE_KINEMATICS>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> ee_pos(hd_data->h_eePos, hd_data->h_eePos + 6*EE*rows);
+	const std::vector<double> ee_J(hd_data->h_eeJacobian, hd_data->h_eeJacobian + 6*EE*N*rows);
+	const std::vector<double> ee_Jdqd(hd_data->h_eeJdqd, hd_data->h_eeJdqd + 6*EE*rows);
+	grid::end_effector_kinematics_compute_only<double,grid::EE_ALL,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> ee_all_pos(hd_data->h_eePos, hd_data->h_eePos + 6*EE*rows);
+	const std::vector<double> ee_all_c(hd_data->h_c, hd_data->h_c + N*rows);
+	// u is the applied torque for the forward algorithms and qdd for the inverse ones
+	grid::inverse_dynamics_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::inverse_dynamics_gradient_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::direct_minv_compute_only<double>(hd_data,d_robotModel,rows,blocks,dimms);
+	grid::crba_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	// the packed upper triangles, Minv from h_q_qd_u and then (USE_COMPRESSED_MEM) from h_q
+	const int P = grid::SYM_PACKED_SIZE;
+	grid::direct_minv_packed_compute_only<double>(hd_data,d_robotModel,rows,blocks,dimms);
+	const std::vector<double> minv_packed(hd_data->h_Minv_packed, hd_data->h_Minv_packed + P*rows);
+	for (int k = 0; k < rows; k++){std::copy(&hd_data->h_q_qd_u[k*S], &hd_data->h_q_qd_u[k*S + grid::NUM_POS], &hd_data->h_q[k*grid::Q_STRIDE]);}
+	grid::direct_minv_packed_compute_only<double,true>(hd_data,d_robotModel,rows,blocks,dimms);
+	grid::crba_packed_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	// the LTL factorization paths write the qdd and df_du buffers of the Minv ones, so they run first
+	grid::forward_dynamics_ltl_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> ltl_fd(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	grid::forward_dynamics_gradient_ltl_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> ltl_df_du(hd_data->h_df_du, hd_data->h_df_du + 2*N*N*rows);
+	std::vector<double> fd(N*rows);
+	grid::forward_dynamics<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms,targets.earlier_pool);
+	std::copy(hd_data->h_qdd, hd_data->h_qdd + N*rows, fd.begin());
+	grid::forward_dynamics_gradient_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	// again on a gridData with the kinematics cache: the new q of the batch misses in direct_minv and
+	// both gradients reuse its transforms, which the hit / miss counters must show
+	std::copy(hd_data->h_q_qd_u, hd_data->h_q_qd_u + rows*S, hd_cached->h_q_qd_u);
+	grid::direct_minv_compute_only<double>(hd_cached,d_robotModel,rows,blocks,dimms);
+	grid::inverse_dynamics_gradient_compute_only<double,true>(hd_cached,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::forward_dynamics_gradient_compute_only<double>(hd_cached,d_robotModel,GRAVITY,rows,blocks,dimms);
+	unsigned long long hits, misses; grid::kinematics_cache_stats<double>(hd_cached, &hits, &misses, true);
+	const double cache_counts[2] = {static_cast<double>(hits), static_cast<double>(misses)}, expected_counts[2] = {2.0*rows, 1.0*rows};
+	stats[OUT_KIN_CACHE].record(cache_counts, expected_counts, 2, first);
+	// again with external wrenches on a gridData with contacts enabled
+	std::vector<grid_reference::referenceWrenches> wrenches(rows);
+	random_contacts(wrenches, hd_contacts, seed, first, rows);
+	std::copy(hd_data->h_q_qd_u, hd_data->h_q_qd_u + rows*S, hd_contacts->h_q_qd_u);
+	grid::inverse_dynamics_compute_only<double,true>(hd_contacts,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::inverse_dynamics_gradient_compute_only<double,true>(hd_contacts,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::forward_dynamics_compute_only<double>(hd_contacts,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> contact_fd(hd_contacts->h_qdd, hd_contacts->h_qdd + N*rows);
+	grid::forward_dynamics_gradient_compute_only<double>(hd_contacts,d_robotModel,GRAVITY,rows,blocks,dimms);
+	std::vector<double> ref(4*NNN), ref_qdd(N), ref_ee(6*EE*N), sym(N*N);
+#ifdef GRID_FLOATING_BASE
+	(void)so_rows; // floating base models have no second order outputs
+	for (int k = 0; k < rows; k++){
+		const long long sample = first + k;
+		const double *q = &hd_data->h_q_qd_u[k*S]; const double *qd = &q[grid::NUM_POS]; const double *u = &qd[N];
+		grid_reference::fb_rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_ID].record(&hd_data->h_c[k*N], ref.data(), N, sample);
+		grid_reference::fb_rnea_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_ID_DU].record(&hd_data->h_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_KIN_CACHE].record(&hd_cached->h_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::fb_minv<double>(ref.data(), model, q);
+		stats[OUT_MINV].record(&hd_data->h_Minv[k*N*N], ref.data(), N*N, sample);
+		sym_unpack(sym.data(), &minv_packed[k*P]);
+		stats[OUT_MINV_P].record(sym.data(), ref.data(), N*N, sample);
+		sym_unpack(sym.data(), &hd_data->h_Minv_packed[k*P]);
+		stats[OUT_MINV_P].record(sym.data(), ref.data(), N*N, sample);
+		stats[OUT_KIN_CACHE].record(&hd_cached->h_Minv[k*N*N], ref.data(), N*N, sample);
+		grid_reference::fb_crba<double>(ref.data(), model, q);
+		stats[OUT_CRBA].record(&hd_data->h_M[k*N*N], ref.data(), N*N, sample);
+		sym_unpack(sym.data(), &hd_data->h_M_packed[k*P]);
+		stats[OUT_CRBA_P].record(sym.data(), ref.data(), N*N, sample);
+		grid_reference::fb_forward_dynamics<double>(ref_qdd.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_FD].record(&fd[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_FD_LTL].record(&ltl_fd[k*N], ref_qdd.data(), N, sample);
+		grid_reference::fb_forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_FD_DU].record(&hd_data->h_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_FD_DU_LTL].record(&ltl_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_KIN_CACHE].record(&hd_cached->h_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::fb_rnea<double>(ref.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&hd_contacts->h_c[k*N], ref.data(), N, sample);
+		grid_reference::fb_rnea_grad(ref.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&hd_contacts->h_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::fb_forward_dynamics<double>(ref_qdd.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&contact_fd[k*N], ref_qdd.data(), N, sample);
+		grid_reference::fb_forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&hd_contacts->h_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::fb_rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_EE].record(&ee_all_c[k*N], ref.data(), N, sample);
+		grid_reference::ee_poses<double>(ref_ee.data(), model, q);
+		stats[OUT_EE].record(&ee_pos[k*6*EE], ref_ee.data(), 6*EE, sample);
+		stats[OUT_EE].record(&ee_all_pos[k*6*EE], ref_ee.data(), 6*EE, sample);
+		grid_reference::ee_jacobians(ref_ee.data(), model, q);
+		stats[OUT_EE].record(&ee_J[k*6*EE*N], ref_ee.data(), 6*EE*N, sample);
+		stats[OUT_EE].record(&hd_data->h_eeJacobian[k*6*EE*N], ref_ee.data(), 6*EE*N, sample);
+		grid_reference::ee_jdot_qd(ref_ee.data(), model, q, qd);
+		stats[OUT_EE].record(&ee_Jdqd[k*6*EE], ref_ee.data(), 6*EE, sample);
+		stats[OUT_EE].record(&hd_data->h_eeJdqd[k*6*EE], ref_ee.data(), 6*EE, sample);
+	}
+#else
+	grid::aba_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	std::vector<double> aba(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	grid::aba_compute_only<double>(hd_contacts,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> contact_aba(hd_contacts->h_qdd, hd_contacts->h_qdd + N*rows);
+	// and the separate (fixed base only) end effector pose and pose gradient calls
+	grid::end_effector_positions_compute_only<double>(hd_data,d_robotModel,rows,blocks,dimms);
+	grid::end_effector_positions_gradient_compute_only<double>(hd_data,d_robotModel,rows,blocks,dimms);
+	// the CSC gradients are expanded back to the dense layout
+	std::vector<double> dc_du_sp(2*N*N*rows), df_du_sp(2*N*N*rows);
+	grid::inverse_dynamics_gradient_sparse_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::expand_dc_du_sparse<double>(dc_du_sp.data(), hd_data->h_dc_du_sparse, rows);
+	grid::forward_dynamics_gradient_sparse_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::expand_df_du_sparse<double>(df_du_sp.data(), hd_data->h_df_du_sparse, rows);
+	if (so_rows > 0){
+		grid::idsva_so_host_compute_only<double>(hd_data,d_robotModel,GRAVITY,so_rows,blocks,dimms);
+		grid::fdsva_so_compute_only<double>(hd_data,d_robotModel,GRAVITY,so_rows,blocks,dimms);
+		grid::idsva_so_host_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,so_rows,blocks,dimms);
+		grid::fdsva_so_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,so_rows,blocks,dimms);
+		grid::idsva_so_contracted_compute_only<double>(hd_data,d_robotModel,GRAVITY,so_rows,blocks,dimms);
+		grid::fdsva_so_contracted_compute_only<double>(hd_data,d_robotModel,GRAVITY,so_rows,blocks,dimms);
+	}
+	const std::vector<double> fleet_fd = fleet_batch(targets, hd_data, grid_cpu::FLEET_FD, rows);
+	const std::vector<double> fleet_minv = fleet_batch(targets, hd_data, grid_cpu::FLEET_MINV, rows);
+	const std::vector<double> server_fd = server_batch(targets, hd_data, grid::SERVER_FD, &grid::gridData<double>::h_qdd, N, rows);
+	const std::vector<double> server_df_du = server_batch(targets, hd_data, grid::SERVER_FD_DU, &grid::gridData<double>::h_df_du, 2*N*N, rows);
+	std::vector<double> unpacked(4*NNN), contracted(4*N*N), zeros(N, 0.0);
+
+	for (int k = 0; k < rows; k++){
+		const long long sample = first + k;
+		const double *q = &hd_data->h_q_qd_u[k*S]; const double *qd = &q[grid::NUM_POS]; const double *u = &qd[N];
+		grid_reference::rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_ID].record(&hd_data->h_c[k*N], ref.data(), N, sample);
+		grid_reference::rnea_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_ID_DU].record(&hd_data->h_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_ID_DU_SP].record(&dc_du_sp[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_KIN_CACHE].record(&hd_cached->h_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::minv<double>(ref.data(), model, q);
+		stats[OUT_MINV].record(&hd_data->h_Minv[k*N*N], ref.data(), N*N, sample);
+		sym_unpack(sym.data(), &minv_packed[k*P]);
+		stats[OUT_MINV_P].record(sym.data(), ref.data(), N*N, sample);
+		sym_unpack(sym.data(), &hd_data->h_Minv_packed[k*P]);
+		stats[OUT_MINV_P].record(sym.data(), ref.data(), N*N, sample);
+		stats[OUT_BUNDLE].record(&bundle_minv[k*N*N], ref.data(), N*N, sample);
+		stats[OUT_KIN_CACHE].record(&hd_cached->h_Minv[k*N*N], ref.data(), N*N, sample);
+		stats[OUT_FLEET].record(&fleet_minv[k*N*N], ref.data(), N*N, sample);
+		grid_reference::crba<double>(ref.data(), model, q);
+		stats[OUT_CRBA].record(&hd_data->h_M[k*N*N], ref.data(), N*N, sample);
+		sym_unpack(sym.data(), &hd_data->h_M_packed[k*P]);
+		stats[OUT_CRBA_P].record(sym.data(), ref.data(), N*N, sample);
+		grid_reference::aba<double>(ref_qdd.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_FD].record(&fd[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_ABA].record(&aba[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_FD_LTL].record(&ltl_fd[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_BUNDLE].record(&bundle_qdd[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_FLEET].record(&fleet_fd[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_SERVER].record(&server_fd[k*N], ref_qdd.data(), N, sample);
+		grid_reference::forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_FD_DU].record(&hd_data->h_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_FD_DU_LTL].record(&ltl_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_FD_DU_SP].record(&df_du_sp[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_SERVER].record(&server_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_BUNDLE].record(&bundle_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		stats[OUT_KIN_CACHE].record(&hd_cached->h_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		// the bundle's c is ID(q,qd,0) and its dc_du is taken at the forward dynamics qdd
+		grid_reference::rnea<double>(ref.data(), model, q, qd, zeros.data(), GRAVITY);
+		stats[OUT_BUNDLE].record(&bundle_c[k*N], ref.data(), N, sample);
+		grid_reference::rnea_grad(ref.data(), model, q, qd, ref_qdd.data(), GRAVITY);
+		stats[OUT_BUNDLE].record(&bundle_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::rnea<double>(ref.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&hd_contacts->h_c[k*N], ref.data(), N, sample);
+		grid_reference::rnea_grad(ref.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&hd_contacts->h_dc_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::aba<double>(ref_qdd.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&contact_fd[k*N], ref_qdd.data(), N, sample);
+		stats[OUT_CONTACTS].record(&contact_aba[k*N], ref_qdd.data(), N, sample);
+		grid_reference::forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY, &wrenches[k]);
+		stats[OUT_CONTACTS].record(&hd_contacts->h_df_du[k*2*N*N], ref.data(), 2*N*N, sample);
+		grid_reference::rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats[OUT_EE].record(&ee_all_c[k*N], ref.data(), N, sample);
+		grid_reference::ee_poses<double>(ref_ee.data(), model, q);
+		stats[OUT_EE].record(&ee_pos[k*6*EE], ref_ee.data(), 6*EE, sample);
+		stats[OUT_EE].record(&ee_all_pos[k*6*EE], ref_ee.data(), 6*EE, sample);
+		stats[OUT_EE].record(&hd_data->h_eePos[k*6*EE], ref_ee.data(), 6*EE, sample);
+		grid_reference::ee_poses_grad(ref_ee.data(), model, q);
+		stats[OUT_EE].record(&hd_data->h_deePos[k*6*EE*N], ref_ee.data(), 6*EE*N, sample);
+		grid_reference::ee_jacobians(ref_ee.data(), model, q);
+		stats[OUT_EE].record(&ee_J[k*6*EE*N], ref_ee.data(), 6*EE*N, sample);
+		stats[OUT_EE].record(&hd_data->h_eeJacobian[k*6*EE*N], ref_ee.data(), 6*EE*N, sample);
+		grid_reference::ee_jdot_qd(ref_ee.data(), model, q, qd);
+		stats[OUT_EE].record(&ee_Jdqd[k*6*EE], ref_ee.data(), 6*EE, sample);
+		stats[OUT_EE].record(&hd_data->h_eeJdqd[k*6*EE], ref_ee.data(), 6*EE, sample);
+		if (k < so_rows){
+			grid_reference::second_order<false>(ref.data(), model, q, qd, u, GRAVITY);
+			stats[OUT_ID_SO].record(&hd_data->h_idsva_so[k*4*NNN], ref.data(), 4*NNN, sample);
+			so_unpack(unpacked.data(), &hd_data->h_idsva_so_packed[k*grid::SO_PACKED_SIZE]);
+			stats[OUT_ID_SO_P].record(unpacked.data(), ref.data(), 4*NNN, sample);
+			so_contract(contracted.data(), ref.data(), &hd_data->h_lambda[k*N]);
+			stats[OUT_ID_SO_C].record(&hd_data->h_idsva_so_contracted[k*4*N*N], contracted.data(), 4*N*N, sample);
+			grid_reference::second_order<true>(ref.data(), model, q, qd, u, GRAVITY);
+			stats[OUT_FD_SO].record(&hd_data->h_df2[k*4*NNN], ref.data(), 4*NNN, sample);
+			so_unpack(unpacked.data(), &hd_data->h_df2_packed[k*grid::SO_PACKED_SIZE]);
+			stats[OUT_FD_SO_P].record(unpacked.data(), ref.data(), 4*NNN, sample);
+			so_contract(contracted.data(), ref.data(), &hd_data->h_lambda[k*N]);
+			stats[OUT_FD_SO_C].record(&hd_data->h_df2_contracted[k*4*N*N], contracted.data(), 4*N*N, sample);
+		}
+	}
+#endif
+}
+
+#ifndef GRID_FLOATING_BASE
+const int STREAM_CHUNK = 96;
+
+/**
+ * Writes the first num_rows samples to a trajectory file and streams it through STREAM_ID (u as qdd) and
+ * STREAM_FD_DU in chunks of STREAM_CHUNK rows (the last one partial), comparing every output row
+ */
+void check_stream(errorStats &stats, const grid_reference::referenceModel &model, const unsigned long long seed, const long long num_rows,
+                  const int num_threads){
+	const int N = grid::NUM_VEL; const int S = grid::Q_QD_U_STRIDE;
+	char in_path[] = "/tmp/diffTestGRiD_in_XXXXXX", out_path[] = "/tmp/diffTestGRiD_out_XXXXXX";
+	const int in_fd = mkstemp(in_path), out_fd = mkstemp(out_path);
+	if (in_fd < 0 || out_fd < 0){printf("[!Error] could not create the stream files\n"); return;}
+	close(out_fd);
+	std::vector<double> states(num_rows*S);
+	for (long long k = 0; k < num_rows; k++){random_state(&states[k*S], seed, k);}
+	FILE *in_file = fdopen(in_fd, "wb");
+	fwrite(states.data(), sizeof(double), states.size(), in_file);
+	fclose(in_file);
+	grid::trajectoryStream<double> stream(GRAVITY, STREAM_CHUNK, num_threads);
+	std::vector<double> ref(2*N*N);
+	const int algorithms[2] = {grid::STREAM_ID, grid::STREAM_FD_DU};
+	for (int algorithm : algorithms){
+		const int stride = grid::stream_output_stride<double>(algorithm);
+		std::vector<double> out(num_rows*stride);
+		if (!stream.run(in_path, out_path, algorithm)){continue;}
+		FILE *out_file = fopen(out_path, "rb");
+		const size_t read = fread(out.data(), sizeof(double), out.size(), out_file);
+		fclose(out_file);
+		if (read != out.size()){printf("[!Error] %s holds %zu of %zu values\n", out_path, read, out.size()); continue;}
+		for (long long k = 0; k < num_rows; k++){
+			const double *q = &states[k*S]; const double *qd = &q[grid::NUM_POS]; const double *u = &qd[N];
+			if (algorithm == grid::STREAM_ID){grid_reference::rnea<double>(ref.data(), model, q, qd, u, GRAVITY);}
+			else {grid_reference::forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY);}
+			stats.record(&out[k*stride], ref.data(), stride, k);
+		}
+	}
+	remove(in_path); remove(out_path);
+}
+
+const int ROLLOUT_K = 64;
+const int ROLLOUT_H = 16;
+const double ROLLOUT_DT = 0.01;
+
+// cost of the rollout check: |x|^2 + 0.1 |u|^2 per step and |x_H|^2 at the end
+struct rolloutCheckCost {
+	double operator()(const double *x, const double *u, int) const {
+		double cost = 0;
+		for (int i = 0; i < 2*grid::NUM_JOINTS; i++){cost += x[i]*x[i];}
+		if (u != nullptr){for (int i = 0; i < grid::NUM_JOINTS; i++){cost += 0.1*u[i]*u[i];}}
+		return cost;
+	}
+};
+
+// dx = [qd; qdd] of x = [q; qd] under u with the reference ABA
+void reference_rollout_derivative(double *dx, const double *x, const double *u, const grid_reference::referenceModel &model){
+	const int N = grid::NUM_JOINTS;
+	grid_reference::aba<double>(&dx[N], model, x, &x[N], u, GRAVITY);
+	std::copy(&x[N], &x[2*N], dx);
+}
+
+/**
+ * Rolls out ROLLOUT_K random control sequences of ROLLOUT_H steps from a random state with both integrators
+ * and compares every trajectory state and cost with the same integration of the reference ABA
+ */
+void check_rollout(errorStats &stats, const grid_reference::referenceModel &model, const unsigned long long seed, const int num_threads){
+	const int N = grid::NUM_JOINTS; const int NS = 2*N; const int H = ROLLOUT_H;
+	std::vector<double> state(grid::Q_QD_U_STRIDE), x0(NS), u(ROLLOUT_K*H*N);
+	random_state(state.data(), seed + 4, 0);
+	std::copy(state.begin(), state.begin() + NS, x0.begin());
+	for (int k = 0; k < ROLLOUT_K*H; k++){random_state(state.data(), seed + 5, k); std::copy(state.begin(), state.begin() + N, &u[k*N]);}
+	grid::rolloutEngine<double> engine(GRAVITY, num_threads);
+	rolloutCheckCost cost;
+	std::vector<double> ref((H + 1)*NS), k1(NS), k2(NS), k3(NS), k4(NS), xs(NS);
+	const int integrators[2] = {grid::ROLLOUT_SEMI_IMPLICIT_EULER, grid::ROLLOUT_RK4};
+	for (int integrator : integrators){
+		if (!engine.run(x0.data(), u.data(), ROLLOUT_K, H, ROLLOUT_DT, integrator, cost)){continue;}
+		for (int r = 0; r < ROLLOUT_K; r++){
+			double *x = ref.data(); double ref_cost = 0;
+			std::copy(x0.begin(), x0.end(), x);
+			for (int t = 0; t < H; t++){
+				const double *ut = &u[(r*H + t)*N]; double *next = &x[NS];
+				ref_cost += cost(x, ut, t);
+				if (integrator == grid::ROLLOUT_SEMI_IMPLICIT_EULER){
+					reference_rollout_derivative(k1.data(), x, ut, model);
+					for (int i = 0; i < N; i++){next[N + i] = x[N + i] + ROLLOUT_DT*k1[N + i]; next[i] = x[i] + ROLLOUT_DT*next[N + i];}
+				}
+				else {
+					reference_rollout_derivative(k1.data(), x, ut, model);
+					for (int i = 0; i < NS; i++){xs[i] = x[i] + 0.5*ROLLOUT_DT*k1[i];}
+					reference_rollout_derivative(k2.data(), xs.data(), ut, model);
+					for (int i = 0; i < NS; i++){xs[i] = x[i] + 0.5*ROLLOUT_DT*k2[i];}
+					reference_rollout_derivative(k3.data(), xs.data(), ut, model);
+					for (int i = 0; i < NS; i++){xs[i] = x[i] + ROLLOUT_DT*k3[i];}
+					reference_rollout_derivative(k4.data(), xs.data(), ut, model);
+					for (int i = 0; i < NS; i++){next[i] = x[i] + ROLLOUT_DT/6.0*(k1[i] + 2.0*(k2[i] + k3[i]) + k4[i]);}
+				}
+				x = next;
+			}
+			ref_cost += cost(x, nullptr, H);
+			stats.record(engine.trajectory(r), ref.data(), (H + 1)*NS, r);
+			stats.record(engine.terminal_state(r), x, NS, r);
+			stats.record(&engine.costs()[r], &ref_cost, 1, r);
+		}
+	}
+}
+
+const int AOSOA_BATCH = 203;
+
+/**
+ * Runs ID (u as qdd), Minv, FD and both gradients through the AoSoA kernels at default_lanes<double> on
+ * AOSOA_BATCH samples, which is not a multiple of the lanes. The revolute joints of every third sample are moved
+ * past SIN_COS_MAX_ARG (the libm fallback lanes) and those of the samples after them to just inside it.
+ */
+void check_aosoa(errorStats &stats, const grid::robotModel<double> *d_robotModel, const grid_reference::referenceModel &model,
+                 const unsigned long long seed){
+	const int W = grid_cpu::default_lanes<double>::value;
+	const int N = grid::NUM_VEL; const int S = grid::Q_QD_U_STRIDE; const int rows = AOSOA_BATCH;
+	std::vector<double> states(rows*S);
+	for (int k = 0; k < rows; k++){
+		double *q = &states[k*S];
+		random_state(q, seed + 6, k);
+		const double shift = k % 3 == 1 ? grid_cpu::SIN_COS_MAX_ARG + 1000.0 : (k % 3 == 2 ? grid_cpu::SIN_COS_MAX_ARG - 1.0 : 0.0);
+		for (int jid = 0; jid < grid::NUM_JOINTS; jid++){if (grid::JOINT_REVOLUTE[jid]){q[jid] += q[jid] < 0 ? -shift : shift;}}
+	}
+	std::vector<double> in(grid::aosoa_size<W>(S, rows)), out(grid::aosoa_size<W>(2*N*N, rows));
+	std::vector<double> c(rows*N), minv(rows*N*N), qdd(rows*N), dc_du(rows*2*N*N), df_du(rows*2*N*N);
+	grid::to_aosoa<double,W>(in.data(), states.data(), S, rows);
+	grid::inverse_dynamics_aosoa<double,W,true>(out.data(), in.data(), d_robotModel, GRAVITY, rows);
+	grid::from_aosoa<double,W>(c.data(), out.data(), N, rows);
+	grid::direct_minv_aosoa<double,W>(out.data(), in.data(), d_robotModel, rows);
+	grid::from_aosoa<double,W>(minv.data(), out.data(), N*N, rows);
+	grid::forward_dynamics_aosoa<double,W>(out.data(), in.data(), d_robotModel, GRAVITY, rows);
+	grid::from_aosoa<double,W>(qdd.data(), out.data(), N, rows);
+	grid::inverse_dynamics_gradient_aosoa<double,W,true>(out.data(), in.data(), d_robotModel, GRAVITY, rows);
+	grid::from_aosoa<double,W>(dc_du.data(), out.data(), 2*N*N, rows);
+	grid::forward_dynamics_gradient_aosoa<double,W>(out.data(), in.data(), d_robotModel, GRAVITY, rows);
+	grid::from_aosoa<double,W>(df_du.data(), out.data(), 2*N*N, rows);
+	std::vector<double> ref(2*N*N);
+	for (int k = 0; k < rows; k++){
+		const double *q = &states[k*S]; const double *qd = &q[grid::NUM_POS]; const double *u = &qd[N];
+		grid_reference::rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&c[k*N], ref.data(), N, k);
+		grid_reference::minv<double>(ref.data(), model, q);
+		stats.record(&minv[k*N*N], ref.data(), N*N, k);
+		grid_reference::aba<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&qdd[k*N], ref.data(), N, k);
+		grid_reference::rnea_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&dc_du[k*2*N*N], ref.data(), 2*N*N, k);
+		grid_reference::forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&df_du[k*2*N*N], ref.data(), 2*N*N, k);
+	}
+}
+
+const int MIXED_BATCH = 100;
+
+/**
+ * Runs the mixed precision Minv, FD and FD_DU at T_ACC = double on MIXED_BATCH samples and compares them with the
+ * reference and, as the count of entries that differ bitwise (which must be 0), with the plain double calls
+ */
+void check_mixed(errorStats &stats, const grid::robotModel<double> *d_robotModel, const grid_reference::referenceModel &model,
+                 const unsigned long long seed){
+	const int N = grid::NUM_VEL; const int S = grid::Q_QD_U_STRIDE; const int rows = MIXED_BATCH;
+	grid::gridData<double> *hd_data = grid::init_gridData<double>(rows);
+	for (int k = 0; k < rows; k++){random_state(&hd_data->h_q_qd_u[k*S], seed + 9, k);}
+	dim3 blocks(1,1,1), dimms(1,1,1);
+	grid::direct_minv_compute_only<double>(hd_data,d_robotModel,rows,blocks,dimms);
+	const std::vector<double> minv(hd_data->h_Minv, hd_data->h_Minv + N*N*rows);
+	grid::forward_dynamics_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> qdd(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	grid::forward_dynamics_gradient_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> df_du(hd_data->h_df_du, hd_data->h_df_du + 2*N*N*rows);
+	grid::direct_minv_mixed_compute_only<double,double>(hd_data,d_robotModel,rows,blocks,dimms);
+	const std::vector<double> mixed_minv(hd_data->h_Minv, hd_data->h_Minv + N*N*rows);
+	grid::forward_dynamics_mixed_compute_only<double,double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> mixed_qdd(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	grid::forward_dynamics_gradient_mixed_compute_only<double,double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	referenceOutputs ref;
+	for (int k = 0; k < rows; k++){
+		const double *q = &hd_data->h_q_qd_u[k*S];
+		ref.compute(model, q, &q[grid::NUM_POS], &q[grid::NUM_POS + N]);
+		stats.record(&mixed_minv[k*N*N], ref.minv.data(), N*N, k);
+		stats.record(&mixed_qdd[k*N], ref.qdd.data(), N, k);
+		stats.record(&hd_data->h_df_du[k*2*N*N], ref.df_du.data(), 2*N*N, k);
+		double differ = 0; const double none = 0;
+		for (int i = 0; i < N*N; i++){differ += std::memcmp(&mixed_minv[k*N*N + i], &minv[k*N*N + i], sizeof(double)) != 0;}
+		for (int i = 0; i < N; i++){differ += std::memcmp(&mixed_qdd[k*N + i], &qdd[k*N + i], sizeof(double)) != 0;}
+		for (int i = 0; i < 2*N*N; i++){differ += std::memcmp(&hd_data->h_df_du[k*2*N*N + i], &df_du[k*2*N*N + i], sizeof(double)) != 0;}
+		stats.record(&differ, &none, 1, k);
+	}
+	grid::free_gridData<double>(hd_data);
+}
+#endif
+
+const int VIEWS_BATCH = 37;
+
+/**
+ * Runs ID (u as qdd), FD and FD_DU on VIEWS_BATCH samples read through use_input_views from caller arrays with
+ * padded strides and offsets (q alone, qd and u interleaved), then the USE_COMPRESSED_MEM ID, Minv and ID_DU after
+ * use_packed_inputs. Everything around the inputs, and the grid.cuh buffers not meant to be read, is NaN.
+ */
+void check_views(errorStats &stats, const grid::robotModel<double> *d_robotModel, const grid_reference::referenceModel &model,
+                 const unsigned long long seed){
+	const int N = grid::NUM_VEL; const int S = grid::Q_QD_U_STRIDE; const int rows = VIEWS_BATCH;
+	const int Q_STRIDE = grid::NUM_POS + 3, Q_OFFSET = 1, X_STRIDE = 2*N + 5, QD_OFFSET = 2, U_OFFSET = N + 4;
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::vector<double> states(rows*S), q(rows*Q_STRIDE + Q_OFFSET, nan), x(rows*X_STRIDE, nan);
+	for (int k = 0; k < rows; k++){
+		random_state(&states[k*S], seed + 7, k);
+		std::copy(&states[k*S], &states[k*S + grid::NUM_POS], &q[Q_OFFSET + k*Q_STRIDE]);
+		std::copy(&states[k*S + grid::NUM_POS], &states[k*S + grid::NUM_POS + N], &x[QD_OFFSET + k*X_STRIDE]);
+		std::copy(&states[k*S + grid::NUM_POS + N], &states[(k + 1)*S], &x[U_OFFSET + k*X_STRIDE]);
+	}
+	grid::gridData<double> *hd_data = grid::init_gridData<double>(rows);
+	std::fill(hd_data->h_q_qd_u, hd_data->h_q_qd_u + rows*S, nan);
+	std::fill(hd_data->h_q_qd, hd_data->h_q_qd + rows*grid::Q_QD_STRIDE, nan);
+	std::fill(hd_data->h_q, hd_data->h_q + rows*grid::Q_STRIDE, nan);
+	dim3 blocks(1,1,1), dimms(1,1,1);
+	grid::use_input_views<double>(hd_data, grid::make_input_view<double>(q.data(), Q_STRIDE, Q_OFFSET),
+	                              grid::make_input_view<double>(x.data(), X_STRIDE, QD_OFFSET), grid::make_input_view<double>(x.data(), X_STRIDE, U_OFFSET));
+	grid::inverse_dynamics_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> view_c(hd_data->h_c, hd_data->h_c + N*rows);
+	grid::inverse_dynamics_compute_only<double,true,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> view_c_compressed(hd_data->h_c, hd_data->h_c + N*rows);
+	grid::forward_dynamics_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> view_qdd(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	grid::forward_dynamics_gradient_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> view_df_du(hd_data->h_df_du, hd_data->h_df_du + 2*N*N*rows);
+	// the compressed variants read h_q_qd_u after use_packed_inputs, so h_q_qd and h_q stay NaN
+	grid::use_packed_inputs<double>(hd_data);
+	std::copy(states.begin(), states.end(), hd_data->h_q_qd_u);
+	grid::inverse_dynamics_compute_only<double,true,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::direct_minv_compute_only<double,true>(hd_data,d_robotModel,rows,blocks,dimms);
+	grid::inverse_dynamics_gradient_compute_only<double,true,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	referenceOutputs ref;
+	for (int k = 0; k < rows; k++){
+		const double *sq = &states[k*S]; const double *sqd = &sq[grid::NUM_POS]; const double *su = &sqd[N];
+		ref.compute(model, sq, sqd, su);
+		stats.record(&view_c[k*N], ref.c.data(), N, k);
+		stats.record(&view_c_compressed[k*N], ref.c.data(), N, k);
+		stats.record(&view_qdd[k*N], ref.qdd.data(), N, k);
+		stats.record(&view_df_du[k*2*N*N], ref.df_du.data(), 2*N*N, k);
+		stats.record(&hd_data->h_c[k*N], ref.c.data(), N, k);
+		stats.record(&hd_data->h_Minv[k*N*N], ref.minv.data(), N*N, k);
+		stats.record(&hd_data->h_dc_du[k*2*N*N], ref.dc_du.data(), 2*N*N, k);
+	}
+	grid::use_grid_inputs<double>(hd_data);
+	grid::free_gridData<double>(hd_data);
+}
+
+const int RESIZE_SMALL = 5;
+const int RESIZE_LARGE = 70;
+
+/**
+ * Starts a gridData at RESIZE_SMALL timesteps with only its inputs, so ID (u as qdd) and FD_DU carve their outputs
+ * lazily, then grows it to RESIZE_LARGE with resize_gridData: the kept outputs must still hold the first timesteps,
+ * and ID, Minv (carved after the growth), FD and FD_DU must match on every timestep. Asking for RESIZE_SMALL again
+ * must keep the capacity, and the calls are compared once more.
+ */
+void check_resize(errorStats &stats, const grid::robotModel<double> *d_robotModel, const grid_reference::referenceModel &model,
+                  const unsigned long long seed){
+	const int N = grid::NUM_VEL; const int S = grid::Q_QD_U_STRIDE;
+	std::vector<double> states(RESIZE_LARGE*S);
+	for (int k = 0; k < RESIZE_LARGE; k++){random_state(&states[k*S], seed + 8, k);}
+	std::vector<referenceOutputs> ref(RESIZE_LARGE);
+	for (int k = 0; k < RESIZE_LARGE; k++){const double *q = &states[k*S]; ref[k].compute(model, q, &q[grid::NUM_POS], &q[grid::NUM_POS + N]);}
+	grid::gridData<double> *hd_data = grid::init_gridData<double>(RESIZE_SMALL);
+	dim3 blocks(1,1,1), dimms(1,1,1);
+	std::copy(states.begin(), states.begin() + RESIZE_SMALL*S, hd_data->h_q_qd_u);
+	grid::inverse_dynamics_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,RESIZE_SMALL,blocks,dimms);
+	grid::forward_dynamics_gradient_compute_only<double>(hd_data,d_robotModel,GRAVITY,RESIZE_SMALL,blocks,dimms);
+	for (int k = 0; k < RESIZE_SMALL; k++){
+		stats.record(&hd_data->h_c[k*N], ref[k].c.data(), N, k);
+		stats.record(&hd_data->h_df_du[k*2*N*N], ref[k].df_du.data(), 2*N*N, k);
+	}
+	grid::resize_gridData<double>(hd_data, RESIZE_LARGE);
+	for (int k = 0; k < RESIZE_SMALL; k++){
+		stats.record(&hd_data->h_c[k*N], ref[k].c.data(), N, k);
+		stats.record(&hd_data->h_qdd[k*N], ref[k].qdd.data(), N, k);
+		stats.record(&hd_data->h_df_du[k*2*N*N], ref[k].df_du.data(), 2*N*N, k);
+	}
+	for (int pass = 0; pass < 2; pass++){
+		std::copy(states.begin(), states.end(), hd_data->h_q_qd_u);
+		grid::inverse_dynamics_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,RESIZE_LARGE,blocks,dimms);
+		grid::direct_minv_compute_only<double>(hd_data,d_robotModel,RESIZE_LARGE,blocks,dimms);
+		grid::forward_dynamics_compute_only<double>(hd_data,d_robotModel,GRAVITY,RESIZE_LARGE,blocks,dimms);
+		const std::vector<double> qdd(hd_data->h_qdd, hd_data->h_qdd + N*RESIZE_LARGE);
+		grid::forward_dynamics_gradient_compute_only<double>(hd_data,d_robotModel,GRAVITY,RESIZE_LARGE,blocks,dimms);
+		for (int k = 0; k < RESIZE_LARGE; k++){
+			stats.record(&hd_data->h_c[k*N], ref[k].c.data(), N, k);
+			stats.record(&hd_data->h_Minv[k*N*N], ref[k].minv.data(), N*N, k);
+			stats.record(&qdd[k*N], ref[k].qdd.data(), N, k);
+			stats.record(&hd_data->h_df_du[k*2*N*N], ref[k].df_du.data(), 2*N*N, k);
+		}
+		// resize_gridData never shrinks, so the capacity and the arena are unchanged for the second pass
+		const double expected[2] = {static_cast<double>(RESIZE_LARGE), static_cast<double>(grid::gridData_bytes<double>(hd_data))};
+		grid::resize_gridData<double>(hd_data, RESIZE_SMALL);
+		const double capacity[2] = {static_cast<double>(hd_data->max_timesteps), static_cast<double>(grid::gridData_bytes<double>(hd_data))};
+		stats.record(capacity, expected, 2, pass);
+	}
+	grid::free_gridData<double>(hd_data);
+}
+
+const int POOL_THREADS = 4;
+const int POOL_ITEMS = 64;
+
+/**
+ * Two threads submit a batch of POOL_ITEMS sleeping items to one pool of POOL_THREADS at the same time. Each batch
+ * must run on more than one thread (the later one waits for the pool rather than running on its caller), and the
+ * batch that the first item of each job submits to the same pool from inside the job must run to completion.
+ */
+void check_pool(errorStats &stats){
+	grid_cpu::hostThreads pool(POOL_THREADS);
+	std::atomic<int> ready(0);
+	double threads_seen[2], nested_done[2];
+	auto submit = [&](const int b){
+		std::mutex ids_mtx; std::vector<std::thread::id> ids; std::atomic<int> nested(0);
+		auto inner = [&](int){nested++;};
+		auto f = [&](int k){
+			{
+				std::lock_guard<std::mutex> lock(ids_mtx);
+				if (std::find(ids.begin(), ids.end(), std::this_thread::get_id()) == ids.end()){ids.push_back(std::this_thread::get_id());}
+			}
+			if (k == 0){pool.parallel_for(POOL_THREADS, inner);}
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		};
+		ready++;
+		while (ready.load() < 2){std::this_thread::yield();}
+		pool.parallel_for(POOL_ITEMS, f);
+		threads_seen[b] = std::min<double>(static_cast<double>(ids.size()), 2.0); nested_done[b] = nested.load();
+	};
+	std::thread other(submit, 1);
+	submit(0);
+	other.join();
+	const double expected[2] = {2.0, static_cast<double>(POOL_THREADS)};
+	for (int b = 0; b < 2; b++){
+		const double seen[2] = {threads_seen[b], nested_done[b]};
+		stats.record(seen, expected, 2, b);
+	}
+}
+
+const int TUNING_BATCH = 100;
+const char TUNING_LABELS[] = "ID,Minv,FD,ID_DU,FD_DU";
+const int TUNING_NUM_LABELS = 5;
+
+/**
+ * Runs the TUNING_LABELS calls on TUNING_BATCH samples under the current tuning cache and compares them
+ */
+void check_tuned_batch(errorStats &stats, grid::gridData<double> *hd_data, const grid::robotModel<double> *d_robotModel,
+                       const grid_reference::referenceModel &model){
+	const int N = grid::NUM_VEL; const int S = grid::Q_QD_U_STRIDE; const int rows = TUNING_BATCH;
+	dim3 blocks(1,1,1), dimms(1,1,1);
+	grid::inverse_dynamics_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::inverse_dynamics_gradient_compute_only<double,true>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	grid::direct_minv_compute_only<double>(hd_data,d_robotModel,rows,blocks,dimms);
+	grid::forward_dynamics_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	const std::vector<double> fd(hd_data->h_qdd, hd_data->h_qdd + N*rows);
+	grid::forward_dynamics_gradient_compute_only<double>(hd_data,d_robotModel,GRAVITY,rows,blocks,dimms);
+	std::vector<double> ref(2*N*N);
+	for (int k = 0; k < rows; k++){
+		const double *q = &hd_data->h_q_qd_u[k*S]; const double *qd = &q[grid::NUM_POS]; const double *u = &qd[N];
+#ifdef GRID_FLOATING_BASE
+		grid_reference::fb_rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&hd_data->h_c[k*N], ref.data(), N, k);
+		grid_reference::fb_rnea_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&hd_data->h_dc_du[k*2*N*N], ref.data(), 2*N*N, k);
+		grid_reference::fb_minv<double>(ref.data(), model, q);
+		stats.record(&hd_data->h_Minv[k*N*N], ref.data(), N*N, k);
+		grid_reference::fb_forward_dynamics<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&fd[k*N], ref.data(), N, k);
+		grid_reference::fb_forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&hd_data->h_df_du[k*2*N*N], ref.data(), 2*N*N, k);
+#else
+		grid_reference::rnea<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&hd_data->h_c[k*N], ref.data(), N, k);
+		grid_reference::rnea_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&hd_data->h_dc_du[k*2*N*N], ref.data(), 2*N*N, k);
+		grid_reference::minv<double>(ref.data(), model, q);
+		stats.record(&hd_data->h_Minv[k*N*N], ref.data(), N*N, k);
+		grid_reference::aba<double>(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&fd[k*N], ref.data(), N, k);
+		grid_reference::forward_dynamics_grad(ref.data(), model, q, qd, u, GRAVITY);
+		stats.record(&hd_data->h_df_du[k*2*N*N], ref.data(), 2*N*N, k);
+#endif
+	}
+}
+
+/**
+ * Autotunes the TUNING_LABELS calls at TUNING_BATCH into a temporary cache file, loads it back into the
+ * emptied process wide cache (which must then hold one entry per label) and compares the calls under it,
+ * then again with a grain of 7 on every thread, which does not divide the batch. The cache is emptied after.
+ */
+void check_tuning(errorStats &stats, const grid::robotModel<double> *d_robotModel, const grid_reference::referenceModel &model,
+                  const unsigned long long seed){
+	char path[] = "/tmp/diffTestGRiD_tuning_XXXXXX";
+	const int fd = mkstemp(path);
+	if (fd < 0){printf("[!Error] could not create the tuning cache file\n"); return;}
+	close(fd);
+	grid_cpu::tuningCache &cache = grid_cpu::tuning_cache();
+	const int batch_sizes[1] = {TUNING_BATCH};
+	if (grid::autotune<double>(path, batch_sizes, 1, GRAVITY, TUNING_LABELS, 1)){
+		cache.clear();
+		cache.load(path);
+		const double entries = static_cast<double>(cache.size()), expected_entries = TUNING_NUM_LABELS;
+		stats.record(&entries, &expected_entries, 1, 0);
+		grid::gridData<double> *hd_data = grid::init_gridData<double>(TUNING_BATCH);
+		for (int k = 0; k < TUNING_BATCH; k++){random_state(&hd_data->h_q_qd_u[k*grid::Q_QD_U_STRIDE], seed, k);}
+		check_tuned_batch(stats, hd_data, d_robotModel, model);
+		grid_cpu::tuningConfig uneven; uneven.threads = 0; uneven.grain = 7;
+		const char *labels[TUNING_NUM_LABELS] = {"ID", "Minv", "FD", "ID_DU", "FD_DU"};
+		for (const char *label : labels){cache.record(grid::ROBOT_NAME, label, sizeof(double), TUNING_BATCH, uneven, 0);}
+		check_tuned_batch(stats, hd_data, d_robotModel, model);
+		grid::free_gridData<double>(hd_data);
+	}
+	cache.clear();
+	remove(path);
+}
+
+int main(int argc, char **argv){
+	long long num_samples = 100000, so_samples = 1000; unsigned long long seed = 0;
+	int num_threads = grid::SUGGESTED_THREADS; double tol = 1e-8;
+	for (int i = 1; i < argc; i++){
+		if (!strncmp(argv[i], "--samples=", 10)){num_samples = atoll(argv[i] + 10);}
+		else if (!strncmp(argv[i], "--so-samples=", 13)){so_samples = atoll(argv[i] + 13);}
+		else if (!strncmp(argv[i], "--threads=", 10)){num_threads = std::max(1, atoi(argv[i] + 10));}
+		else if (!strncmp(argv[i], "--tol=", 6)){tol = atof(argv[i] + 6);}
+		else if (!strncmp(argv[i], "--seed=", 7)){seed = strtoull(argv[i] + 7, nullptr, 10);}
+		else {printf("[!Error] unknown option %s\n", argv[i]); return 2;}
+	}
+	so_samples = std::min(so_samples, num_samples);
+#ifdef GRID_FLOATING_BASE
+	so_samples = 0;
+#endif
+	const grid_reference::referenceModel model = model_from_grid();
+	grid::robotModel<double> *d_robotModel = grid::init_robotModel<double>();
+	diffTargets targets;
+	// a later init_grid (e.g., of another model) asking for another size must leave this pool running
+	targets.earlier_pool = grid::init_grid<double>(2);
+	grid::init_grid<double>(3);
+#ifndef GRID_FLOATING_BASE
+	grid_cpu::fleetScheduler<double> fleet(2);
+	targets.fleet = &fleet;
+	targets.fleet_model = fleet.add_model(grid::register_model<double>(), GRAVITY, BATCH, num_threads);
+	grid::dynamicsServer<double,BATCH> server(GRAVITY, 2);
+	targets.server = &server;
+#endif
+
+	// each worker takes the next BATCH samples until none are left
+	const long long num_batches = (num_samples + BATCH - 1) / BATCH;
+	std::atomic<long long> next_batch(0);
+	std::vector<std::vector<errorStats> > worker_stats(num_threads, std::vector<errorStats>(NUM_OUTPUTS));
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC,&start);
+	std::vector<std::thread> workers;
+	for (int tid = 0; tid < num_threads; tid++){
+		workers.emplace_back([&, tid](){
+			grid::gridData<double> *hd_data = grid::init_gridData<double>(BATCH);
+			grid::gridData<double> *hd_cached = grid::init_gridData<double>(BATCH);
+			grid::enable_kinematics_cache<double>(hd_cached, BATCH);
+			grid::gridData<double> *hd_contacts = grid::init_gridData<double>(BATCH);
+			grid::enable_contacts<double>(hd_contacts, MAX_CONTACTS);
+			for (long long batch = next_batch++; batch < num_batches; batch = next_batch++){
+				const long long first = batch*BATCH;
+				const int rows = static_cast<int>(std::min<long long>(BATCH, num_samples - first));
+				const int so_rows = static_cast<int>(std::max<long long>(0, std::min<long long>(rows, so_samples - first)));
+				check_batch(worker_stats[tid], hd_data, hd_cached, hd_contacts, d_robotModel, model, targets, seed, first, rows, so_rows);
+			}
+			grid::free_gridData<double>(hd_data);
+			grid::free_gridData<double>(hd_cached);
+			grid::free_gridData<double>(hd_contacts);
+		});
+	}
+	for (std::thread &worker : workers){worker.join();}
+#ifndef GRID_FLOATING_BASE
+	check_stream(worker_stats[0][OUT_STREAM], model, seed, std::min<long long>(num_samples, 1000), num_threads);
+	check_rollout(worker_stats[0][OUT_ROLLOUT], model, seed, num_threads);
+	check_aosoa(worker_stats[0][OUT_AOSOA], d_robotModel, model, seed);
+	check_mixed(worker_stats[0][OUT_MIXED], d_robotModel, model, seed);
+#endif
+	check_views(worker_stats[0][OUT_VIEWS], d_robotModel, model, seed);
+	check_resize(worker_stats[0][OUT_RESIZE], d_robotModel, model, seed);
+	check_tuning(worker_stats[0][OUT_TUNING], d_robotModel, model, seed);
+	check_pool(worker_stats[0][OUT_POOL]);
+	clock_gettime(CLOCK_MONOTONIC,&end);
+
+	std::vector<errorStats> stats(NUM_OUTPUTS);
+	for (int tid = 0; tid < num_threads; tid++){for (int i = 0; i < NUM_OUTPUTS; i++){stats[i].merge(worker_stats[tid][i]);}}
+	printf("%lld samples (%lld second order) on %d threads in %.2fs, seed %llu\n\n", num_samples, so_samples, num_threads,
+	       time_delta_us_timespec(start,end)*1e-6, seed);
+	printf("%-12s%12s%14s%14s%14s\n", "output", "samples", "max abs err", "max rel err", "worst sample");
+	bool passed = true;
+	for (int i = 0; i < NUM_OUTPUTS; i++){
+		// outputs the model does not have (or --so-samples=0) are left out
+		if (stats[i].count == 0){continue;}
+		const bool ok = stats[i].max_rel <= tol;
+		passed = passed && ok;
+		printf("%-12s%12lld%14.3e%14.3e%14lld  %s\n", OUTPUT_NAMES[i], stats[i].count, stats[i].max_abs, stats[i].max_rel, stats[i].worst_sample,
+		       ok ? "\033[92mPassed\033[0m" : "\033[91mFailed\033[0m");
+	}
+	grid::free_robotModel<double>(d_robotModel);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,740 @@
+/**************************************************************************
+ *  Reference rigid body dynamics in C++
+ *
+ *  A direct transcription of the RBDReference algorithms (Featherstone's
+ *  RNEA, CRBA and ABA on dense 6x6 spatial matrices) over the same
+ *  URDFParser model that grid_cpu.hpp is generated from. It shares no code
+ *  with the generated kernels: transforms are rebuilt from each joint's
+ *  axis, Minv comes from an LDL^T factorization of the CRBA mass matrix,
+ *  and every gradient is taken by forward mode differentiation of the
+ *  plain algorithms (nested for the second order terms) rather than by the
+ *  analytical recursions the kernels use. It is written to be obviously
+ *  correct, not fast, and every function is safe to call from many
+ *  threads at once.
+ *
+ *  A floating base model (base_I set) has a free-flyer root body that every
+ *  parent -1 joint hangs off, with q = [base position, base quaternion
+ *  (x,y,z,w), limb q] and qd = [base spatial velocity in the base frame,
+ *  limb qd]. Its q derivatives move the base along [rotation, translation]
+ *  in its own frame, as the generated kernels define them.
+ *
+ *  External wrenches (see enable_contacts) are [moment about the world
+ *  origin; force] in the world frame. Each one is carried to the link it
+ *  acts on by the force transform of the world to link motion transform
+ *  and subtracted from that link's body force, so their dependence on q
+ *  (and on the base pose) is differentiated with everything else.
+ *
+ *  End effector poses come from the world to link transforms, and their
+ *  Jacobians and Jdot*qd from differentiating those poses along each
+ *  velocity direction and along the qdd = 0 path of (q,qd).
+ *
+ *  All matrices are column major and every output matches the layout of
+ *  the corresponding gridData field.
+ **************************************************************************/
+#ifndef GRID_REFERENCE_DYNAMICS_HPP
+#define GRID_REFERENCE_DYNAMICS_HPP
+
+#include <cmath>
+#include <vector>
+
+namespace grid_reference {
+
+// Forward mode derivative (nest it for second derivatives)
+template <typename S>
+struct fwdDiff {
+	S val;
+	S der;
+	fwdDiff() : val(0.0), der(0.0) {}
+	fwdDiff(const double v) : val(v), der(0.0) {}
+	fwdDiff(const S &v, const S &d) : val(v), der(d) {}
+	friend fwdDiff operator+(const fwdDiff &a, const fwdDiff &b){return fwdDiff(a.val + b.val, a.der + b.der);}
+	friend fwdDiff operator-(const fwdDiff &a, const fwdDiff &b){return fwdDiff(a.val - b.val, a.der - b.der);}
+	friend fwdDiff operator-(const fwdDiff &a){return fwdDiff(-a.val, -a.der);}
+	friend fwdDiff operator*(const fwdDiff &a, const fwdDiff &b){return fwdDiff(a.val*b.val, a.der*b.val + a.val*b.der);}
+	friend fwdDiff operator/(const fwdDiff &a, const fwdDiff &b){return fwdDiff(a.val/b.val, (a.der*b.val - a.val*b.der)/(b.val*b.val));}
+	fwdDiff &operator+=(const fwdDiff &b){val = val + b.val; der = der + b.der; return *this;}
+	fwdDiff &operator-=(const fwdDiff &b){val = val - b.val; der = der - b.der; return *this;}
+	friend fwdDiff sin(const fwdDiff &a){using std::sin; using std::cos; return fwdDiff(sin(a.val), cos(a.val)*a.der);}
+	friend fwdDiff cos(const fwdDiff &a){using std::sin; using std::cos; return fwdDiff(cos(a.val), -(sin(a.val)*a.der));}
+	friend fwdDiff sqrt(const fwdDiff &a){using std::sqrt; const S root = sqrt(a.val); return fwdDiff(root, a.der/(S(2.0)*root));}
+	friend fwdDiff atan2(const fwdDiff &y, const fwdDiff &x){
+		using std::atan2; return fwdDiff(atan2(y.val, x.val), (x.val*y.der - y.val*x.der)/(x.val*x.val + y.val*y.val));
+	}
+};
+
+typedef fwdDiff<double> dual1;
+typedef fwdDiff<dual1> dual2;
+
+/**
+ * Robot description: per joint parent index (-1 for the base), motion subspace S,
+ * revolute (else prismatic) flag, fixed tree transform and spatial inertia, and
+ * the spatial inertia of a floating base (empty for a fixed base)
+ */
+struct referenceModel {
+	int n;
+	std::vector<int> parent;
+	std::vector<double> S;       // 6 per joint
+	std::vector<bool> revolute;
+	std::vector<double> Xtree;   // 36 per joint
+	std::vector<double> I;       // 36 per joint
+	std::vector<double> base_I;  // 36 for a floating base
+	std::vector<int> ee;         // joints whose link frames are the end effectors
+};
+
+// An external wrench on the link of joint body (-1 for a floating base), [moment about the origin; force] in the world frame
+struct referenceWrench {
+	int body;
+	double w[6];
+};
+typedef std::vector<referenceWrench> referenceWrenches;
+
+template <typename S>
+struct spatialVec {S v[6];};
+
+template <typename S>
+struct spatialMat {S m[36];};
+
+template <typename S>
+inline spatialVec<S> zero_vec(){spatialVec<S> out; for (int r = 0; r < 6; r++){out.v[r] = S(0.0);} return out;}
+
+template <typename S>
+inline spatialVec<S> operator+(const spatialVec<S> &a, const spatialVec<S> &b){spatialVec<S> out; for (int r = 0; r < 6; r++){out.v[r] = a.v[r] + b.v[r];} return out;}
+
+template <typename S>
+inline spatialVec<S> operator-(const spatialVec<S> &a, const spatialVec<S> &b){spatialVec<S> out; for (int r = 0; r < 6; r++){out.v[r] = a.v[r] - b.v[r];} return out;}
+
+template <typename S>
+inline spatialVec<S> scale(const spatialVec<S> &a, const S &s){spatialVec<S> out; for (int r = 0; r < 6; r++){out.v[r] = a.v[r]*s;} return out;}
+
+template <typename S>
+inline S dot(const spatialVec<S> &a, const spatialVec<S> &b){S out(0.0); for (int r = 0; r < 6; r++){out += a.v[r]*b.v[r];} return out;}
+
+// A*x and A^T*x
+template <typename S>
+inline spatialVec<S> mul(const spatialMat<S> &A, const spatialVec<S> &x){
+	spatialVec<S> out = zero_vec<S>();
+	for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){out.v[r] += A.m[r + 6*c]*x.v[c];}}
+	return out;
+}
+
+template <typename S>
+inline spatialVec<S> mul_T(const spatialMat<S> &A, const spatialVec<S> &x){
+	spatialVec<S> out = zero_vec<S>();
+	for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){out.v[c] += A.m[r + 6*c]*x.v[r];}}
+	return out;
+}
+
+template <typename S>
+inline spatialMat<S> mul(const spatialMat<S> &A, const spatialMat<S> &B){
+	spatialMat<S> out;
+	for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){
+		S val(0.0); for (int k = 0; k < 6; k++){val += A.m[r + 6*k]*B.m[k + 6*c];}
+		out.m[r + 6*c] = val;
+	}}
+	return out;
+}
+
+// X^T A X
+template <typename S>
+inline spatialMat<S> congruence(const spatialMat<S> &X, const spatialMat<S> &A){
+	spatialMat<S> XT;
+	for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){XT.m[r + 6*c] = X.m[c + 6*r];}}
+	return mul(XT, mul(A, X));
+}
+
+template <typename S>
+inline spatialMat<S> outer(const spatialVec<S> &a, const spatialVec<S> &b){
+	spatialMat<S> out;
+	for (int c = 0; c < 6; c++){for (int r = 0; r < 6; r++){out.m[r + 6*c] = a.v[r]*b.v[c];}}
+	return out;
+}
+
+// X^-T f, the force transform of a motion transform X = [E 0; C E]: [E f1 - E C^T E f2; E f2]
+template <typename S>
+inline spatialVec<S> force_mul(const spatialMat<S> &X, const spatialVec<S> &f){
+	S Ef2[3], CtEf2[3]; spatialVec<S> out;
+	for (int r = 0; r < 3; r++){Ef2[r] = S(0.0); for (int c = 0; c < 3; c++){Ef2[r] += X.m[r + 6*c]*f.v[3 + c];}}
+	for (int r = 0; r < 3; r++){CtEf2[r] = S(0.0); for (int c = 0; c < 3; c++){CtEf2[r] += X.m[3 + c + 6*r]*Ef2[c];}}
+	for (int r = 0; r < 3; r++){
+		S top(0.0); for (int c = 0; c < 3; c++){top += X.m[r + 6*c]*(f.v[c] - CtEf2[c]);}
+		out.v[r] = top; out.v[3 + r] = Ef2[r];
+	}
+	return out;
+}
+
+template <typename S>
+inline spatialVec<S> wrench_vec(const referenceWrench &ext){spatialVec<S> out; for (int r = 0; r < 6; r++){out.v[r] = S(ext.w[r]);} return out;}
+
+// Hamilton product of quaternions stored (x,y,z,w)
+template <typename S>
+inline void quat_mul(S *out, const S *a, const S *b){
+	out[0] = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1];
+	out[1] = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0];
+	out[2] = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3];
+	out[3] = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+}
+
+// R x for the rotation R of a quaternion of any scale: quat x conj(quat) / |quat|^2
+template <typename S>
+inline void quat_rotate(S *out, const S *quat, const S *x){
+	const S conj[4] = {-quat[0], -quat[1], -quat[2], quat[3]}; const S xq[4] = {x[0], x[1], x[2], S(0.0)};
+	const S norm2 = quat[0]*quat[0] + quat[1]*quat[1] + quat[2]*quat[2] + quat[3]*quat[3];
+	S tmp[4], rx[4]; quat_mul(tmp, xq, conj); quat_mul(rx, quat, tmp);
+	for (int r = 0; r < 3; r++){out[r] = rx[r] / norm2;}
+}
+
+// motion cross product v x m and force cross product v x* f
+template <typename S>
+inline spatialVec<S> crm(const spatialVec<S> &v, const spatialVec<S> &m){
+	const S *w = v.v; const S *vo = &v.v[3]; const S *mw = m.v; const S *mo = &m.v[3];
+	spatialVec<S> out;
+	out.v[0] = w[1]*mw[2] - w[2]*mw[1]; out.v[1] = w[2]*mw[0] - w[0]*mw[2]; out.v[2] = w[0]*mw[1] - w[1]*mw[0];
+	out.v[3] = w[1]*mo[2] - w[2]*mo[1] + vo[1]*mw[2] - vo[2]*mw[1];
+	out.v[4] = w[2]*mo[0] - w[0]*mo[2] + vo[2]*mw[0] - vo[0]*mw[2];
+	out.v[5] = w[0]*mo[1] - w[1]*mo[0] + vo[0]*mw[1] - vo[1]*mw[0];
+	return out;
+}
+
+template <typename S>
+inline spatialVec<S> crf(const spatialVec<S> &v, const spatialVec<S> &f){
+	const S *w = v.v; const S *vo = &v.v[3]; const S *fn = f.v; const S *ff = &f.v[3];
+	spatialVec<S> out;
+	out.v[0] = w[1]*fn[2] - w[2]*fn[1] + vo[1]*ff[2] - vo[2]*ff[1];
+	out.v[1] = w[2]*fn[0] - w[0]*fn[2] + vo[2]*ff[0] - vo[0]*ff[2];
+	out.v[2] = w[0]*fn[1] - w[1]*fn[0] + vo[0]*ff[1] - vo[1]*ff[0];
+	out.v[3] = w[1]*ff[2] - w[2]*ff[1]; out.v[4] = w[2]*ff[0] - w[0]*ff[2]; out.v[5] = w[0]*ff[1] - w[1]*ff[0];
+	return out;
+}
+
+template <typename S>
+inline spatialVec<S> joint_S(const referenceModel &model, const int jid){
+	spatialVec<S> out; for (int r = 0; r < 6; r++){out.v[r] = S(model.S[6*jid + r]);} return out;
+}
+
+template <typename S>
+inline spatialMat<S> joint_I(const referenceModel &model, const int jid){
+	spatialMat<S> out; for (int i = 0; i < 36; i++){out.m[i] = S(model.I[36*jid + i]);} return out;
+}
+
+// Parent to child transform X_J(q) * X_tree
+template <typename S>
+spatialMat<S> jcalc(const referenceModel &model, const int jid, const S &q){
+	using std::sin; using std::cos;
+	const double *axis = &model.S[6*jid];
+	spatialMat<S> XJ; for (int i = 0; i < 36; i++){XJ.m[i] = S(i % 7 == 0 ? 1.0 : 0.0);}
+	if (model.revolute[jid]){
+		// E = R(axis,q)^T = c*1 + (1-c)*a*a^T - s*[a]x, applied to both 3x3 diagonal blocks
+		const S c = cos(q), s = sin(q), omc = S(1.0) - c;
+		const double *a = axis;
+		S E[9];
+		for (int col = 0; col < 3; col++){for (int row = 0; row < 3; row++){E[row + 3*col] = omc*S(a[row]*a[col]) + (row == col ? c : S(0.0));}}
+		E[1 + 3*0] -= s*S(a[2]); E[2 + 3*0] += s*S(a[1]);
+		E[0 + 3*1] += s*S(a[2]); E[2 + 3*1] -= s*S(a[0]);
+		E[0 + 3*2] -= s*S(a[1]); E[1 + 3*2] += s*S(a[0]);
+		for (int col = 0; col < 3; col++){for (int row = 0; row < 3; row++){
+			XJ.m[row + 6*col] = E[row + 3*col]; XJ.m[3 + row + 6*(3 + col)] = E[row + 3*col];
+		}}
+	}
+	else {
+		// X_J = [1 0; -[p]x 1] with p = axis*q
+		const S p[3] = {S(axis[3])*q, S(axis[4])*q, S(axis[5])*q};
+		XJ.m[4 + 6*0] = -p[2]; XJ.m[5 + 6*0] = p[1];
+		XJ.m[3 + 6*1] = p[2]; XJ.m[5 + 6*1] = -p[0];
+		XJ.m[3 + 6*2] = -p[1]; XJ.m[4 + 6*2] = p[0];
+	}
+	spatialMat<S> Xtree; for (int i = 0; i < 36; i++){Xtree.m[i] = S(model.Xtree[36*jid + i]);}
+	return mul(XJ, Xtree);
+}
+
+/**
+ * The root (fixed base or floating base body) to link motion transforms of every link
+ */
+template <typename S>
+std::vector<spatialMat<S> > root_transforms(const referenceModel &model, const std::vector<spatialMat<S> > &X){
+	std::vector<spatialMat<S> > X0(model.n);
+	for (int i = 0; i < model.n; i++){X0[i] = model.parent[i] < 0 ? X[i] : mul(X[i], X0[model.parent[i]]);}
+	return X0;
+}
+
+/**
+ * Subtracts the external wrenches given in the root frame (w_root of each) from the body forces of their links
+ */
+template <typename S>
+void subtract_wrenches(std::vector<spatialVec<S> > &f, const std::vector<spatialMat<S> > &X0, const referenceWrenches &ext,
+                       const std::vector<spatialVec<S> > &w_root){
+	for (size_t c = 0; c < ext.size(); c++){
+		if (ext[c].body >= 0){f[ext[c].body] = f[ext[c].body] - force_mul(X0[ext[c].body], w_root[c]);}
+	}
+}
+
+/**
+ * RNEA: tau = ID(q,qd,qdd) with the base accelerating upwards at gravity, minus the external wrenches ext
+ * (nullptr for none)
+ */
+template <typename S>
+void rnea(S *tau, const referenceModel &model, const S *q, const S *qd, const S *qdd, const double gravity,
+          const referenceWrenches *ext = nullptr){
+	const int n = model.n;
+	std::vector<spatialMat<S> > X(n); std::vector<spatialVec<S> > v(n), a(n), f(n);
+	spatialVec<S> a_base = zero_vec<S>(); a_base.v[5] = S(gravity);
+	for (int i = 0; i < n; i++){
+		const int p = model.parent[i];
+		X[i] = jcalc<S>(model, i, q[i]);
+		const spatialVec<S> Si = joint_S<S>(model, i), vJ = scale(Si, qd[i]);
+		v[i] = (p < 0) ? vJ : mul(X[i], v[p]) + vJ;
+		a[i] = mul(X[i], p < 0 ? a_base : a[p]) + scale(Si, qdd[i]) + crm(v[i], vJ);
+		const spatialMat<S> I = joint_I<S>(model, i);
+		f[i] = mul(I, a[i]) + crf(v[i], mul(I, v[i]));
+	}
+	if (ext != nullptr){
+		// the fixed base frame is the world frame
+		std::vector<spatialVec<S> > w(ext->size()); for (size_t c = 0; c < ext->size(); c++){w[c] = wrench_vec<S>((*ext)[c]);}
+		subtract_wrenches<S>(f, root_transforms<S>(model, X), *ext, w);
+	}
+	for (int i = n - 1; i >= 0; i--){
+		tau[i] = dot(joint_S<S>(model, i), f[i]);
+		if (model.parent[i] >= 0){f[model.parent[i]] = f[model.parent[i]] + mul_T(X[i], f[i]);}
+	}
+}
+
+/**
+ * CRBA: joint space mass matrix M(q) (both triangles)
+ */
+template <typename S>
+void crba(S *M, const referenceModel &model, const S *q){
+	const int n = model.n;
+	std::vector<spatialMat<S> > X(n), IC(n);
+	for (int i = 0; i < n; i++){X[i] = jcalc<S>(model, i, q[i]); IC[i] = joint_I<S>(model, i);}
+	for (int i = n - 1; i >= 0; i--){
+		const int p = model.parent[i];
+		if (p >= 0){const spatialMat<S> Ic = congruence(X[i], IC[i]); for (int k = 0; k < 36; k++){IC[p].m[k] += Ic.m[k];}}
+	}
+	for (int k = 0; k < n*n; k++){M[k] = S(0.0);}
+	for (int i = 0; i < n; i++){
+		spatialVec<S> F = mul(IC[i], joint_S<S>(model, i));
+		M[i + n*i] = dot(joint_S<S>(model, i), F);
+		int j = i;
+		while (model.parent[j] >= 0){
+			F = mul_T(X[j], F); j = model.parent[j];
+			M[i + n*j] = dot(joint_S<S>(model, j), F); M[j + n*i] = M[i + n*j];
+		}
+	}
+}
+
+/**
+ * Minv = M^-1 of an n x n symmetric positive definite M from its LDL^T factorization
+ */
+template <typename S>
+void ldl_inverse(S *Minv, const S *M, const int n){
+	std::vector<S> L(n*n, S(0.0)), D(n);
+	for (int j = 0; j < n; j++){
+		S d = M[j + n*j];
+		for (int k = 0; k < j; k++){d -= L[j + n*k]*L[j + n*k]*D[k];}
+		D[j] = d; L[j + n*j] = S(1.0);
+		for (int i = j + 1; i < n; i++){
+			S val = M[i + n*j];
+			for (int k = 0; k < j; k++){val -= L[i + n*k]*L[j + n*k]*D[k];}
+			L[i + n*j] = val / d;
+		}
+	}
+	// solve L D L^T x = e_col for every column
+	std::vector<S> y(n);
+	for (int col = 0; col < n; col++){
+		for (int i = 0; i < n; i++){S val(i == col ? 1.0 : 0.0); for (int k = 0; k < i; k++){val -= L[i + n*k]*y[k];} y[i] = val;}
+		for (int i = 0; i < n; i++){y[i] = y[i] / D[i];}
+		for (int i = n - 1; i >= 0; i--){S val = y[i]; for (int k = i + 1; k < n; k++){val -= L[k + n*i]*Minv[k + n*col];} Minv[i + n*col] = val;}
+	}
+}
+
+/**
+ * Minv = M(q)^-1 of the CRBA mass matrix
+ */
+template <typename S>
+void minv(S *Minv, const referenceModel &model, const S *q){
+	std::vector<S> M(model.n*model.n);
+	crba<S>(M.data(), model, q);
+	ldl_inverse<S>(Minv, M.data(), model.n);
+}
+
+/**
+ * ABA: qdd = FD(q,qd,tau) with the external wrenches ext (nullptr for none)
+ */
+template <typename S>
+void aba(S *qdd, const referenceModel &model, const S *q, const S *qd, const S *tau, const double gravity,
+         const referenceWrenches *ext = nullptr){
+	const int n = model.n;
+	std::vector<spatialMat<S> > X(n), IA(n); std::vector<spatialVec<S> > v(n), c(n), pA(n), U(n), a(n);
+	std::vector<S> d(n), u(n);
+	for (int i = 0; i < n; i++){
+		const int p = model.parent[i];
+		X[i] = jcalc<S>(model, i, q[i]);
+		const spatialVec<S> vJ = scale(joint_S<S>(model, i), qd[i]);
+		v[i] = (p < 0) ? vJ : mul(X[i], v[p]) + vJ;
+		c[i] = crm(v[i], vJ);
+		IA[i] = joint_I<S>(model, i);
+		pA[i] = crf(v[i], mul(IA[i], v[i]));
+	}
+	if (ext != nullptr){
+		std::vector<spatialVec<S> > w(ext->size()); for (size_t c = 0; c < ext->size(); c++){w[c] = wrench_vec<S>((*ext)[c]);}
+		subtract_wrenches<S>(pA, root_transforms<S>(model, X), *ext, w);
+	}
+	for (int i = n - 1; i >= 0; i--){
+		const int p = model.parent[i]; const spatialVec<S> Si = joint_S<S>(model, i);
+		U[i] = mul(IA[i], Si); d[i] = dot(Si, U[i]); u[i] = tau[i] - dot(Si, pA[i]);
+		if (p >= 0){
+			spatialMat<S> Ia = IA[i]; const spatialMat<S> UU = outer(U[i], U[i]);
+			for (int k = 0; k < 36; k++){Ia.m[k] -= UU.m[k] / d[i];}
+			const spatialVec<S> pa = pA[i] + mul(Ia, c[i]) + scale(U[i], u[i] / d[i]);
+			const spatialMat<S> IaX = congruence(X[i], Ia);
+			for (int k = 0; k < 36; k++){IA[p].m[k] += IaX.m[k];}
+			pA[p] = pA[p] + mul_T(X[i], pa);
+		}
+	}
+	spatialVec<S> a_base = zero_vec<S>(); a_base.v[5] = S(gravity);
+	for (int i = 0; i < n; i++){
+		const int p = model.parent[i];
+		a[i] = mul(X[i], p < 0 ? a_base : a[p]) + c[i];
+		qdd[i] = (u[i] - dot(U[i], a[i])) / d[i];
+		a[i] = a[i] + scale(joint_S<S>(model, i), qdd[i]);
+	}
+}
+
+/**
+ * Floating base RNEA: tau = [base wrench; limb torques] = ID(q,qd,qdd) with the world accelerating
+ * upwards at gravity, which the base sees as R^T (0,0,gravity) for its rotation R, minus the external
+ * wrenches ext (nullptr for none), which the base sees as [R^T (n - p x f); R^T f] for its position p
+ */
+template <typename S>
+void fb_rnea(S *tau, const referenceModel &model, const S *q, const S *qd, const S *qdd, const double gravity,
+             const referenceWrenches *ext = nullptr){
+	const int n = model.n;
+	std::vector<spatialMat<S> > X(n); std::vector<spatialVec<S> > v(n), a(n), f(n);
+	spatialMat<S> I0; for (int i = 0; i < 36; i++){I0.m[i] = S(model.base_I[i]);}
+	// R^T g = conj(quat) g quat / |quat|^2 for any scale of the quaternion
+	const S *quat = &q[3]; const S g[4] = {S(0.0), S(0.0), S(gravity), S(0.0)};
+	S gq[4], rg[4]; const S conj[4] = {-quat[0], -quat[1], -quat[2], quat[3]};
+	quat_mul(gq, g, quat); quat_mul(rg, conj, gq);
+	const S norm2 = quat[0]*quat[0] + quat[1]*quat[1] + quat[2]*quat[2] + quat[3]*quat[3];
+	spatialVec<S> v0, a0;
+	for (int r = 0; r < 6; r++){v0.v[r] = qd[r]; a0.v[r] = (r < 3 ? S(0.0) : rg[r - 3] / norm2) + qdd[r];}
+	spatialVec<S> f0 = mul(I0, a0) + crf(v0, mul(I0, v0));
+	for (int i = 0; i < n; i++){
+		const int p = model.parent[i];
+		X[i] = jcalc<S>(model, i, q[7 + i]);
+		const spatialVec<S> Si = joint_S<S>(model, i), vJ = scale(Si, qd[6 + i]);
+		v[i] = mul(X[i], p < 0 ? v0 : v[p]) + vJ;
+		a[i] = mul(X[i], p < 0 ? a0 : a[p]) + scale(Si, qdd[6 + i]) + crm(v[i], vJ);
+		const spatialMat<S> I = joint_I<S>(model, i);
+		f[i] = mul(I, a[i]) + crf(v[i], mul(I, v[i]));
+	}
+	if (ext != nullptr){
+		std::vector<spatialVec<S> > w(ext->size());
+		for (size_t c = 0; c < ext->size(); c++){
+			const double *nf = (*ext)[c].w;
+			// moment about the base position, then both halves rotated into the base frame as R^T x = conj(quat) x quat / |quat|^2
+			const S m[4] = {S(nf[0]) - (q[1]*S(nf[5]) - q[2]*S(nf[4])), S(nf[1]) - (q[2]*S(nf[3]) - q[0]*S(nf[5])),
+			                S(nf[2]) - (q[0]*S(nf[4]) - q[1]*S(nf[3])), S(0.0)};
+			const S force[4] = {S(nf[3]), S(nf[4]), S(nf[5]), S(0.0)};
+			S tmp[4], rm[4], rf[4];
+			quat_mul(tmp, m, quat); quat_mul(rm, conj, tmp);
+			quat_mul(tmp, force, quat); quat_mul(rf, conj, tmp);
+			for (int r = 0; r < 3; r++){w[c].v[r] = rm[r] / norm2; w[c].v[3 + r] = rf[r] / norm2;}
+			if ((*ext)[c].body < 0){f0 = f0 - w[c];}
+		}
+		subtract_wrenches<S>(f, root_transforms<S>(model, X), *ext, w);
+	}
+	for (int i = n - 1; i >= 0; i--){
+		tau[6 + i] = dot(joint_S<S>(model, i), f[i]);
+		if (model.parent[i] >= 0){f[model.parent[i]] = f[model.parent[i]] + mul_T(X[i], f[i]);}
+		else {f0 = f0 + mul_T(X[i], f[i]);}
+	}
+	for (int r = 0; r < 6; r++){tau[r] = f0.v[r];}
+}
+
+/**
+ * Floating base mass matrix: column j is fb_rnea at rest without gravity and qdd = e_j
+ */
+template <typename S>
+void fb_crba(S *M, const referenceModel &model, const S *q){
+	const int nv = model.n + 6;
+	std::vector<S> zero(nv, S(0.0)), qdd(nv, S(0.0));
+	for (int j = 0; j < nv; j++){
+		qdd[j] = S(1.0);
+		fb_rnea<S>(&M[nv*j], model, q, zero.data(), qdd.data(), 0.0);
+		qdd[j] = S(0.0);
+	}
+}
+
+template <typename S>
+void fb_minv(S *Minv, const referenceModel &model, const S *q){
+	const int nv = model.n + 6;
+	std::vector<S> M(nv*nv);
+	fb_crba<S>(M.data(), model, q);
+	ldl_inverse<S>(Minv, M.data(), nv);
+}
+
+/**
+ * Floating base forward dynamics: qdd = Minv(q) (tau - ID(q,qd,0)) with the external wrenches ext (nullptr for none)
+ */
+template <typename S>
+void fb_forward_dynamics(S *qdd, const referenceModel &model, const S *q, const S *qd, const S *tau, const double gravity,
+                         const referenceWrenches *ext = nullptr){
+	const int nv = model.n + 6;
+	std::vector<S> zero(nv, S(0.0)), c(nv), Minv(nv*nv);
+	fb_rnea<S>(c.data(), model, q, qd, zero.data(), gravity, ext);
+	fb_minv<S>(Minv.data(), model, q);
+	for (int i = 0; i < nv; i++){
+		S val(0.0); for (int k = 0; k < nv; k++){val += Minv[i + nv*k]*(tau[k] - c[k]);}
+		qdd[i] = val;
+	}
+}
+
+// x as dual1 with unit derivative in entry seed (-1 for none)
+inline void seed1(dual1 *out, const double *x, const int n, const int seed){
+	for (int i = 0; i < n; i++){out[i] = dual1(x[i], i == seed ? 1.0 : 0.0);}
+}
+
+// x as dual2 with unit inner derivative in entry seed_inner and unit outer derivative in entry seed_outer
+inline void seed2(dual2 *out, const double *x, const int n, const int seed_inner, const int seed_outer){
+	for (int i = 0; i < n; i++){out[i] = dual2(dual1(x[i], i == seed_inner ? 1.0 : 0.0), dual1(i == seed_outer ? 1.0 : 0.0, 0.0));}
+}
+
+/**
+ * dc_du = [dtau/dq, dtau/dqd] at (q,qd,qdd), (2*n*n)
+ */
+inline void rnea_grad(double *dc_du, const referenceModel &model, const double *q, const double *qd, const double *qdd, const double gravity,
+                      const referenceWrenches *ext = nullptr){
+	const int n = model.n;
+	std::vector<dual1> q_d(n), qd_d(n), qdd_d(n), tau(n);
+	seed1(qdd_d.data(), qdd, n, -1);
+	for (int col = 0; col < 2*n; col++){
+		seed1(q_d.data(), q, n, col < n ? col : -1); seed1(qd_d.data(), qd, n, col < n ? -1 : col - n);
+		rnea<dual1>(tau.data(), model, q_d.data(), qd_d.data(), qdd_d.data(), gravity, ext);
+		for (int row = 0; row < n; row++){dc_du[row + n*col] = tau[row].der;}
+	}
+}
+
+/**
+ * df_du = [dqdd/dq, dqdd/dqd] of qdd = FD(q,qd,tau), (2*n*n)
+ */
+inline void forward_dynamics_grad(double *df_du, const referenceModel &model, const double *q, const double *qd, const double *tau, const double gravity,
+                                  const referenceWrenches *ext = nullptr){
+	const int n = model.n;
+	std::vector<dual1> q_d(n), qd_d(n), tau_d(n), qdd(n);
+	seed1(tau_d.data(), tau, n, -1);
+	for (int col = 0; col < 2*n; col++){
+		seed1(q_d.data(), q, n, col < n ? col : -1); seed1(qd_d.data(), qd, n, col < n ? -1 : col - n);
+		aba<dual1>(qdd.data(), model, q_d.data(), qd_d.data(), tau_d.data(), gravity, ext);
+		for (int row = 0; row < n; row++){df_du[row + n*col] = qdd[row].der;}
+	}
+}
+
+/**
+ * The floating base q as dual1 moved along tangent direction col of [base rotation, base translation, limb q]
+ * (-1 for none): the rotation columns take quat (e_col/2 eps, 1) and the translation ones move the base
+ * position along its own axis col - 3, R e_(col-3) in the world (the base position only enters through
+ * external wrenches and the end effector poses)
+ */
+inline void fb_seed1(dual1 *out, const double *q, const int n, const int col){
+	for (int i = 0; i < n + 7; i++){out[i] = dual1(q[i]);}
+	if (col >= 0 && col < 3){
+		dual1 quat[4]; dual1 turn[4] = {dual1(0.0), dual1(0.0), dual1(0.0), dual1(1.0)}; turn[col] = dual1(0.0, 0.5);
+		for (int i = 0; i < 4; i++){quat[i] = out[3 + i];}
+		quat_mul(&out[3], quat, turn);
+	}
+	else if (col >= 3 && col < 6){
+		double axis[3] = {0.0, 0.0, 0.0}, world[3]; axis[col - 3] = 1.0;
+		quat_rotate(world, &q[3], axis);
+		for (int i = 0; i < 3; i++){out[i] = dual1(q[i], world[i]);}
+	}
+	else if (col >= 6){out[7 + col - 6] = dual1(q[7 + col - 6], 1.0);}
+}
+
+/**
+ * Floating base dc_du = [dtau/dq, dtau/dqd] at (q,qd,qdd), (2*nv*nv) with nv = n + 6
+ */
+inline void fb_rnea_grad(double *dc_du, const referenceModel &model, const double *q, const double *qd, const double *qdd, const double gravity,
+                         const referenceWrenches *ext = nullptr){
+	const int nv = model.n + 6;
+	std::vector<dual1> q_d(nv + 1), qd_d(nv), qdd_d(nv), tau(nv);
+	seed1(qdd_d.data(), qdd, nv, -1);
+	for (int col = 0; col < 2*nv; col++){
+		fb_seed1(q_d.data(), q, model.n, col < nv ? col : -1); seed1(qd_d.data(), qd, nv, col < nv ? -1 : col - nv);
+		fb_rnea<dual1>(tau.data(), model, q_d.data(), qd_d.data(), qdd_d.data(), gravity, ext);
+		for (int row = 0; row < nv; row++){dc_du[row + nv*col] = tau[row].der;}
+	}
+}
+
+/**
+ * Floating base df_du = [dqdd/dq, dqdd/dqd] of qdd = FD(q,qd,tau), (2*nv*nv)
+ */
+inline void fb_forward_dynamics_grad(double *df_du, const referenceModel &model, const double *q, const double *qd, const double *tau, const double gravity,
+                                     const referenceWrenches *ext = nullptr){
+	const int nv = model.n + 6;
+	std::vector<dual1> q_d(nv + 1), qd_d(nv), tau_d(nv), qdd(nv);
+	seed1(tau_d.data(), tau, nv, -1);
+	for (int col = 0; col < 2*nv; col++){
+		fb_seed1(q_d.data(), q, model.n, col < nv ? col : -1); seed1(qd_d.data(), qd, nv, col < nv ? -1 : col - nv);
+		fb_forward_dynamics<dual1>(qdd.data(), model, q_d.data(), qd_d.data(), tau_d.data(), gravity, ext);
+		for (int row = 0; row < nv; row++){df_du[row + nv*col] = qdd[row].der;}
+	}
+}
+
+/**
+ * World frame rotation R (link to world, 9 per link) and origin p (3 per link) of every link, read off the
+ * world to link transforms X0 = [E 0; -E rx E] as R = E^T and rx = -E^T (-E rx). A floating base q places
+ * the base at position q[0..2] with quaternion q[3..6] first.
+ */
+template <typename S>
+void link_frames(std::vector<S> &R, std::vector<S> &p, const referenceModel &model, const S *q){
+	const int n = model.n; const bool fb = !model.base_I.empty(); const int off = fb ? 7 : 0;
+	spatialMat<S> Xb; for (int i = 0; i < 36; i++){Xb.m[i] = S(i % 7 == 0 ? 1.0 : 0.0);}
+	if (fb){
+		// column c of E0 = R0^T is R0^T e_c, and the lower left block is -E0 [p0]x
+		const S conj[4] = {-q[3], -q[4], -q[5], q[6]};
+		for (int c = 0; c < 3; c++){
+			S axis[3] = {S(0.0), S(0.0), S(0.0)}; axis[c] = S(1.0); S col[3]; quat_rotate(col, conj, axis);
+			for (int r = 0; r < 3; r++){Xb.m[r + 6*c] = col[r]; Xb.m[3 + r + 6*(3 + c)] = col[r];}
+		}
+		const S px[9] = {S(0.0), q[2], -q[1], -q[2], S(0.0), q[0], q[1], -q[0], S(0.0)};
+		for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){
+			S val(0.0); for (int k = 0; k < 3; k++){val -= Xb.m[r + 6*k]*px[k + 3*c];}
+			Xb.m[3 + r + 6*c] = val;
+		}}
+	}
+	std::vector<spatialMat<S> > X0(n);
+	R.resize(9*n); p.resize(3*n);
+	for (int i = 0; i < n; i++){
+		const int parent = model.parent[i];
+		X0[i] = mul(jcalc<S>(model, i, q[off + i]), parent < 0 ? Xb : X0[parent]);
+		S rx[9];
+		for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){
+			R[9*i + r + 3*c] = X0[i].m[c + 6*r];
+			S val(0.0); for (int k = 0; k < 3; k++){val -= X0[i].m[k + 6*r]*X0[i].m[3 + k + 6*c];}
+			rx[r + 3*c] = val;
+		}}
+		p[3*i] = rx[2 + 3*1]; p[3*i + 1] = rx[0 + 3*2]; p[3*i + 2] = rx[1 + 3*0];
+	}
+}
+
+/**
+ * End effector poses [x, y, z, roll, pitch, yaw] (6 per end effector) of the link frames of model.ee
+ */
+template <typename S>
+void ee_poses(S *pose, const referenceModel &model, const S *q){
+	using std::atan2; using std::sqrt;
+	std::vector<S> R, p; link_frames<S>(R, p, model, q);
+	for (size_t e = 0; e < model.ee.size(); e++){
+		const S *Re = &R[9*model.ee[e]]; S *out = &pose[6*e];
+		for (int r = 0; r < 3; r++){out[r] = p[3*model.ee[e] + r];}
+		out[3] = atan2(Re[2 + 3*1], Re[2 + 3*2]);
+		out[4] = atan2(-Re[2 + 3*0], sqrt(Re[2 + 3*1]*Re[2 + 3*1] + Re[2 + 3*2]*Re[2 + 3*2]));
+		out[5] = atan2(Re[1 + 3*0], Re[0 + 3*0]);
+	}
+}
+
+/**
+ * d(ee_poses)/dq of a fixed base model, (6 x num_ee*n column-major)
+ */
+inline void ee_poses_grad(double *dpose, const referenceModel &model, const double *q){
+	const int n = model.n; const int num_ee = static_cast<int>(model.ee.size());
+	std::vector<dual1> q_d(n), pose(6*num_ee);
+	for (int col = 0; col < n; col++){
+		seed1(q_d.data(), q, n, col);
+		ee_poses<dual1>(pose.data(), model, q_d.data());
+		for (int e = 0; e < num_ee; e++){for (int r = 0; r < 6; r++){dpose[r + 6*(e*n + col)] = pose[6*e + r].der;}}
+	}
+}
+
+// vee of the skew symmetric part of a 3x3 M, for M = dR R^T the angular velocity
+inline void skew_vee(double *w, const double *M){w[0] = 0.5*(M[2 + 3*1] - M[1 + 3*2]); w[1] = 0.5*(M[0 + 3*2] - M[2 + 3*0]); w[2] = 0.5*(M[1 + 3*0] - M[0 + 3*1]);}
+
+/**
+ * End effector Jacobians (6 x nv column-major per end effector) mapping qd to the [angular; linear] velocity
+ * of the end effector frame origin in the world frame: column col is [vee(dR R^T); dp] along tangent
+ * direction col of q (fb_seed1 for a floating base)
+ */
+inline void ee_jacobians(double *J, const referenceModel &model, const double *q){
+	const bool fb = !model.base_I.empty(); const int nv = model.n + (fb ? 6 : 0); const int np = model.n + (fb ? 7 : 0);
+	std::vector<dual1> q_d(np), R, p;
+	for (int col = 0; col < nv; col++){
+		if (fb){fb_seed1(q_d.data(), q, model.n, col);} else {seed1(q_d.data(), q, np, col);}
+		link_frames<dual1>(R, p, model, q_d.data());
+		for (size_t e = 0; e < model.ee.size(); e++){
+			const dual1 *Re = &R[9*model.ee[e]]; double *out = &J[6*(e*nv + col)]; double dRRt[9];
+			for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){
+				dRRt[r + 3*c] = 0.0; for (int k = 0; k < 3; k++){dRRt[r + 3*c] += Re[r + 3*k].der*Re[c + 3*k].val;}
+			}}
+			skew_vee(out, dRRt);
+			for (int r = 0; r < 3; r++){out[3 + r] = p[3*model.ee[e] + r].der;}
+		}
+	}
+}
+
+/**
+ * Jdot*qd of every end effector (6 per end effector): the [angular; linear] acceleration [vee(d2R/dt2 R^T);
+ * d2p/dt2] of its frame along the qdd = 0 path, q + qd t for the limbs and a floating base moving with its
+ * constant body velocity [w; v] = qd[0..5], to second order quat (w t/2, 1 - |w|^2 t^2/8) and p + R (v t + w x v t^2/2)
+ */
+inline void ee_jdot_qd(double *Jdqd, const referenceModel &model, const double *q, const double *qd){
+	const bool fb = !model.base_I.empty(); const int np = model.n + (fb ? 7 : 0);
+	const dual2 t(dual1(0.0, 1.0), dual1(1.0, 0.0));
+	std::vector<dual2> q_t(np), R, p;
+	for (int i = 0; i < np; i++){q_t[i] = dual2(q[i]);}
+	if (fb){
+		const double *w = qd; const double *v = &qd[3];
+		const dual2 half_t = t*dual2(0.5);
+		const dual2 turn[4] = {dual2(w[0])*half_t, dual2(w[1])*half_t, dual2(w[2])*half_t,
+		                       dual2(1.0) - dual2((w[0]*w[0] + w[1]*w[1] + w[2]*w[2])/8.0)*t*t};
+		dual2 quat[4]; for (int i = 0; i < 4; i++){quat[i] = q_t[3 + i];}
+		quat_mul(&q_t[3], quat, turn);
+		const double wxv[3] = {w[1]*v[2] - w[2]*v[1], w[2]*v[0] - w[0]*v[2], w[0]*v[1] - w[1]*v[0]};
+		double Rv[3], Rwxv[3]; quat_rotate(Rv, &q[3], v); quat_rotate(Rwxv, &q[3], wxv);
+		for (int r = 0; r < 3; r++){q_t[r] = q_t[r] + dual2(Rv[r])*t + dual2(0.5*Rwxv[r])*t*t;}
+	}
+	const int off = fb ? 7 : 0; const int nb = fb ? 6 : 0;
+	for (int i = 0; i < model.n; i++){q_t[off + i] = q_t[off + i] + dual2(qd[nb + i])*t;}
+	link_frames<dual2>(R, p, model, q_t.data());
+	for (size_t e = 0; e < model.ee.size(); e++){
+		const dual2 *Re = &R[9*model.ee[e]]; double *out = &Jdqd[6*e]; double ddRRt[9];
+		for (int c = 0; c < 3; c++){for (int r = 0; r < 3; r++){
+			ddRRt[r + 3*c] = 0.0; for (int k = 0; k < 3; k++){ddRRt[r + 3*c] += Re[r + 3*k].der.der*Re[c + 3*k].val.val;}
+		}}
+		skew_vee(out, ddRRt);
+		for (int r = 0; r < 3; r++){out[3 + r] = p[3*model.ee[e] + r].der.der;}
+	}
+}
+
+/**
+ * Second order terms of f(q,qd) = rnea(q,qd,qdd) (or aba(q,qd,tau)) and the q derivative of M (or Minv)
+ * in the idsva_so / fdsva_so layout: [d2f_dq2 | d2f_dqd2 | d2f_dqdqd | dM_dq], each n^3, where
+ * element (j,k) of slice i is d2f_i/dx_j dy_k and slice k of the last block is dM/dq_k
+ */
+template <bool FORWARD>
+void second_order(double *out, const referenceModel &model, const double *q, const double *qd, const double *qdd_or_tau, const double gravity){
+	const int n = model.n; const int nnn = n*n*n;
+	std::vector<dual2> q_d(n), qd_d(n), x_d(n), f(n);
+	for (int i = 0; i < n; i++){x_d[i] = dual2(qdd_or_tau[i]);}
+	// (inner, outer) seeds for the q q, qd qd and q qd blocks
+	for (int block = 0; block < 3; block++){
+		for (int j = 0; j < n; j++){
+			for (int k = 0; k < n; k++){
+				seed2(q_d.data(), q, n, block != 1 ? j : -1, block == 0 ? k : -1);
+				seed2(qd_d.data(), qd, n, block == 1 ? j : -1, block != 0 ? k : -1);
+				if (FORWARD){aba<dual2>(f.data(), model, q_d.data(), qd_d.data(), x_d.data(), gravity);}
+				else {rnea<dual2>(f.data(), model, q_d.data(), qd_d.data(), x_d.data(), gravity);}
+				for (int i = 0; i < n; i++){out[block*nnn + i*n*n + j + n*k] = f[i].der.der;}
+			}
+		}
+	}
+	std::vector<dual1> q1(n), M(n*n);
+	for (int k = 0; k < n; k++){
+		seed1(q1.data(), q, n, k);
+		if (FORWARD){minv<dual1>(M.data(), model, q1.data());} else {crba<dual1>(M.data(), model, q1.data());}
+		for (int i = 0; i < n*n; i++){out[3*nnn + k*n*n + i] = M[i].der;}
+	}
+}
+
+} // namespace grid_reference
+
+#endif
@@ -0,0 +1,80 @@
+#!/usr/bin/python3
+"""
+python3 TestGRiD/testBindings.py [--threads=N] [--seed=N]
+Checks the grid_cpu module built by diffTestGRiD.py -p. Every Workspace
+method must give the same outputs through its _async twin and from
+strided inputs, and Workspaces that share the default pool (num_threads
+0) or own one must keep giving exactly those outputs while --threads
+Python threads call them at once, ITERS times each. Exits with 1 on any
+mismatch.
+"""
+import sys
+import threading
+import numpy as np
+import grid_cpu
+
+BATCH = 64
+ITERS = 100
+
+def option(name, default):
+    for arg in sys.argv[1:]:
+        if arg.startswith("--" + name + "="): return int(arg.split("=", 1)[1])
+    return default
+
+def method_inputs(ws, name, q, qd, u, lam):
+    """The inputs a method reads, taken from the ValueError it raises when given more"""
+    try:
+        getattr(ws, name)(q, qd, u, lam)
+        return (q, qd, u, lam)
+    except ValueError as err:
+        if "reads only" not in str(err): raise
+        names = str(err).split("reads only ")[1]
+    return (q, qd if "qd" in names else None, u if ", u" in names else None, lam if "lam" in names else None)
+
+def outputs_of(result):
+    return [np.array(out) for out in (result if isinstance(result, tuple) else (result,))]
+
+def same(a, b):
+    return len(a) == len(b) and all(np.array_equal(x, y) for (x, y) in zip(a, b))
+
+def main():
+    num_threads = max(2, option("threads", 4)); iters = ITERS
+    rng = np.random.default_rng(option("seed", 0))
+    NP = grid_cpu.NUM_POS; NV = grid_cpu.NUM_VEL
+    # [q, qd, u, pad] rows, so the inputs are strided column slices
+    x = rng.uniform(-1, 1, (BATCH, NP + 2*NV + 3))
+    q, qd, u = x[:, :NP], x[:, NP:NP + NV], x[:, NP + NV:NP + 2*NV]
+    lam = rng.uniform(-1, 1, (BATCH, NV))
+    ws = grid_cpu.Workspace(BATCH)
+    names = [name for name in dir(ws) if not name.startswith("_") and callable(getattr(ws, name)) and
+             hasattr(ws, name + "_async")]
+    calls = {}; expected = {}; failures = []
+    for name in names:
+        calls[name] = method_inputs(ws, name, q, qd, u, lam)
+        expected[name] = outputs_of(getattr(ws, name)(*calls[name]))
+        if not same(outputs_of(getattr(ws, name + "_async")(*calls[name]).wait()), expected[name]):
+            failures.append(name + "_async")
+        contiguous = [None if arr is None else np.ascontiguousarray(arr) for arr in calls[name]]
+        if not same(outputs_of(getattr(ws, name)(*contiguous)), expected[name]):
+            failures.append(name + " (contiguous inputs)")
+
+    # one Workspace per Python thread, every other one on its own pool
+    mismatches = [0]*num_threads
+    def worker(tid):
+        mine = grid_cpu.Workspace(BATCH, 9.81, 0 if tid % 2 == 0 else 2)
+        for it in range(iters):
+            for name in names:
+                if not same(outputs_of(getattr(mine, name)(*calls[name])), expected[name]): mismatches[tid] += 1
+    threads = [threading.Thread(target=worker, args=(tid,)) for tid in range(num_threads)]
+    for thread in threads: thread.start()
+    for thread in threads: thread.join()
+    if sum(mismatches) > 0:
+        failures.append(str(sum(mismatches)) + " of " + str(num_threads*iters*len(names)) + " concurrent calls")
+
+    print(str(len(names)) + " methods, " + str(num_threads) + " threads x " + str(iters) + " iterations")
+    for failure in failures: print("\033[91mFailed\033[0m " + failure)
+    if not failures: print("\033[92mPassed\033[0m")
+    return 0 if not failures else 1
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,11 +1,16 @@
 /***
 nvcc -std=c++11 -o testGRiD.exe testGRiD.cu -gencode arch=compute_86,code=sm_86
+g++ -std=c++11 -O3 -pthread -x c++ -DGRID_CPU -o testGRiD.exe testGRiD.cu
 ***/
 
 #include <iostream>
 #include <algorithm>
 #include <type_traits>
-#include "../grid.cuh"
+#ifdef GRID_CPU
+	#include "../grid_cpu.hpp"
+#else
+	#include "../grid.cuh"
+#endif
 
 template <typename T>
 __host__
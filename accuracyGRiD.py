@@ -0,0 +1,115 @@
+#!/usr/bin/python3
+from URDFParser import URDFParser
+from GRiDCPUCodeGenerator import GRiDCPUCodeGenerator
+from RBDReference import RBDReference
+from util import parseInputs, printUsage, validateRobot, benchmarkArgs
+import subprocess
+import numpy as np
+
+PRECISIONS = ["float", "mixed", "double"]
+ALGORITHMS = ["Minv", "FD", "FD_DU"]
+TOLERANCE = 1e-4 # default relative error used to suggest a precision (override with --tol=)
+
+def accuracyGRiD(URDF_PATH, DRIVER_ARGS, TOL):
+    """
+    Reports the error of the float, mixed (float with double
+    accumulation) and double precision Minv, FD and FD_DU of
+    grid_cpu.hpp against RBDReference, together with their
+    time per timestep, and suggests the cheapest precision
+    whose worst relative error is below TOL.
+    """
+    parser = URDFParser()
+    robot = parser.parse(URDF_PATH)
+    validateRobot(robot)
+
+    codegen = GRiDCPUCodeGenerator(robot, False, FILE_NAMESPACE = 'grid')
+    print("-----------------")
+    print("Generating grid_cpu.hpp")
+    print("-----------------")
+    if not codegen.gen_all_code(): exit()
+
+    print("-----------------")
+    print("Compiling accuracyGRiD")
+    print("-----------------")
+    result = subprocess.run( \
+        ["g++", "-std=c++11", "-O3", "-march=native", "-pthread", "-x", "c++", "-DGRID_CPU", "-o", "accuracyGRiD.exe", "TestGRiD/accuracyGRiD.cu"], \
+        capture_output=True, text=True \
+    )
+    if result.stderr:
+        print("Compilation errors follow:")
+        print(result.stderr)
+        exit()
+
+    print("-----------------")
+    print("Running accuracyGRiD")
+    print("-----------------")
+    result = subprocess.run(["./accuracyGRiD.exe"] + DRIVER_ARGS, capture_output=True, text=True)
+    if result.stderr:
+        print("Runtime errors follow:")
+        print(result.stderr)
+        exit()
+
+    samples, timings = parse_output(result.stdout)
+    r = RBDReference(robot)
+    # worst absolute and relative (to the largest reference entry) error over every sample
+    abs_err = {(alg, p): 0.0 for alg in ALGORITHMS for p in PRECISIONS}
+    rel_err = {(alg, p): 0.0 for alg in ALGORITHMS for p in PRECISIONS}
+    for sample in samples:
+        q, qd, u = sample["q"], sample["qd"], sample["u"]
+        qdd = np.array(r.forward_dynamics(q,qd,u)).flatten()
+        (dfdq, dfdqd) = r.forward_dynamics_grad(q,qd,u)
+        refs = {
+            "Minv": np.array(r.minv(q)).flatten(order='F'),
+            "FD": qdd,
+            "FD_DU": np.concatenate([np.array(dfdq).flatten(order='F'), np.array(dfdqd).flatten(order='F')]),
+        }
+        for alg in ALGORITHMS:
+            ref = refs[alg]
+            scale = max(np.max(np.abs(ref)), 1e-12)
+            for p in PRECISIONS:
+                err = np.max(np.abs(sample[alg][p] - ref))
+                abs_err[(alg, p)] = max(abs_err[(alg, p)], err)
+                rel_err[(alg, p)] = max(rel_err[(alg, p)], err / scale)
+
+    print(f'{len(samples)} random states, errors against RBDReference, time per timestep on one thread\n')
+    print(f'{"algorithm":<10}{"precision":<10}{"max abs err":>14}{"max rel err":>14}{"time [us]":>12}')
+    for alg in ALGORITHMS:
+        for p in PRECISIONS:
+            print(f'{alg:<10}{p:<10}{abs_err[(alg, p)]:>14.3e}{rel_err[(alg, p)]:>14.3e}{timings[(alg, p)]:>12.3f}')
+        # suggest the fastest precision that meets TOL
+        ok = [p for p in PRECISIONS if rel_err[(alg, p)] < TOL]
+        if ok:
+            best = min(ok, key = lambda p: timings[(alg, p)])
+            print(f'  -> {best} meets the {TOL:.0e} relative error tolerance fastest\n')
+        else:
+            print(f'  -> no precision meets the {TOL:.0e} relative error tolerance\n')
+
+def parse_output(output):
+    samples = []
+    timings = {}
+    for line in output.split('\n'):
+        fields = line.strip().split(' ')
+        if not fields[0]: continue
+        if fields[0] == "SAMPLE":
+            samples.append({alg: {} for alg in ALGORITHMS})
+        elif fields[0] == "TIME":
+            timings[(fields[1], fields[2])] = float(fields[3])
+        elif fields[1] == "input":
+            samples[-1][fields[0]] = np.array([float(i) for i in fields[2:]])
+        else:
+            samples[-1][fields[0]][fields[1]] = np.array([float(i) for i in fields[2:]])
+    return samples, timings
+
+if __name__ == "__main__":
+    inputs = parseInputs()
+    URDF_PATH, DEBUG_MODE, FILE_NAMESPACE_NAME, FLOATING_BASE = inputs
+    if FLOATING_BASE:
+        print("[!Error] accuracyGRiD.py compares against reference dynamics that only model fixed base robots")
+        printUsage()
+        exit()
+    TOL = TOLERANCE
+    DRIVER_ARGS = []
+    for arg in benchmarkArgs():
+        if arg.startswith('--tol='): TOL = float(arg[6:])
+        else: DRIVER_ARGS.append(arg)
+    accuracyGRiD(URDF_PATH, DRIVER_ARGS, TOL)
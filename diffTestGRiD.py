@@ -0,0 +1,108 @@
+#!/usr/bin/python3
+from URDFParser import URDFParser
+from GRiDCPUCodeGenerator import GRiDCPUCodeGenerator
+from util import parseInputs, validateRobot, benchmarkArgs, useSplitBackend, usePythonBindings
+import subprocess
+import sysconfig
+import sys
+import os
+
+def diffTestGRiD(URDF_PATH, FLOATING_BASE, SPLIT, DRIVER_ARGS):
+    """
+    Generates grid_cpu.hpp (or with SPLIT the grid_cpu/
+    split backend and its libgrid_cpu.a) and compares every
+    algorithm against the C++ reference dynamics on many
+    random states in parallel (see TestGRiD/diffTestGRiD.cu).
+    Returns a boolean that signifies whether every
+    output is within tolerance.
+    """
+    parser = URDFParser()
+    robot = parser.parse(URDF_PATH, floating_base=FLOATING_BASE)
+    validateRobot(robot)
+
+    # --sanitize=thread (or address, undefined) builds the driver (and a split archive) with that sanitizer
+    sanitizers = [arg[len("--sanitize="):] for arg in DRIVER_ARGS if arg.startswith("--sanitize=")]
+    flags = ["-O1", "-g"] + ["-fsanitize=" + name for name in sanitizers] if sanitizers else ["-O3", "-march=native"]
+    DRIVER_ARGS = [arg for arg in DRIVER_ARGS if not arg.startswith("--sanitize=")]
+
+    codegen = GRiDCPUCodeGenerator(robot, False, FILE_NAMESPACE = 'grid')
+    print("-----------------")
+    print("Generating " + ("grid_cpu/ and libgrid_cpu.a" if SPLIT else "grid_cpu.hpp"))
+    print("-----------------")
+    if SPLIT:
+        # -fPIC so the python module of -p can link the same archive
+        sources = codegen.gen_split_code("grid_cpu")
+        if sources is None or not codegen.build_split_code(sources, "grid_cpu", ["-std=c++11"] + flags + ["-pthread", "-fPIC"]): exit()
+    elif not codegen.gen_all_code(): exit()
+
+    print("-----------------")
+    print("Compiling diffTestGRiD")
+    print("-----------------")
+    # floating base models have no ABA, second order or fleet entries to compare
+    if FLOATING_BASE: flags = flags + ["-DGRID_FLOATING_BASE"]
+    link = ["-DGRID_SPLIT", "-x", "none", "grid_cpu/libgrid_cpu.a"] if SPLIT else []
+    result = subprocess.run( \
+        ["g++", "-std=c++11"] + flags + ["-pthread", "-x", "c++", "-DGRID_CPU", "-o", "diffTestGRiD.exe", "TestGRiD/diffTestGRiD.cu"] + link, \
+        capture_output=True, text=True \
+    )
+    if result.stderr:
+        print("Compilation errors follow:")
+        print(result.stderr)
+        exit()
+
+    print("-----------------")
+    print("Running diffTestGRiD")
+    print("-----------------")
+    result = subprocess.run(["./diffTestGRiD.exe"] + DRIVER_ARGS, capture_output=True, text=True)
+    if result.stderr:
+        print("Runtime errors follow:")
+        print(result.stderr)
+        exit()
+    print(result.stdout)
+    if result.returncode != 0: return False
+    return testBindings(codegen, SPLIT, DRIVER_ARGS) if usePythonBindings() else True
+
+def testBindings(codegen, SPLIT, DRIVER_ARGS):
+    """
+    Builds the grid_cpu python module over the generated
+    grid_cpu.hpp (or grid_cpu/ and libgrid_cpu.a with SPLIT)
+    and runs TestGRiD/testBindings.py on it (sync, async,
+    strided and concurrent Workspace calls).
+    Returns a boolean that signifies whether it passed.
+    """
+    print("-----------------")
+    print("Compiling the grid_cpu python module")
+    print("-----------------")
+    source = "grid_cpu/grid_cpu_py.cpp" if SPLIT else "grid_cpu_py.cpp"
+    if not codegen.gen_python_bindings(source): exit()
+    includes = subprocess.run([sys.executable, "-m", "pybind11", "--includes"], capture_output=True, text=True)
+    if includes.returncode != 0:
+        print("[!Error] testing the python bindings needs pybind11")
+        exit()
+    result = subprocess.run( \
+        ["g++", "-std=c++14", "-O3", "-march=native", "-pthread", "-shared", "-fPIC"] + includes.stdout.split() + \
+        [source] + (["grid_cpu/libgrid_cpu.a"] if SPLIT else []) + ["-o", "grid_cpu" + sysconfig.get_config_var("EXT_SUFFIX")], \
+        capture_output=True, text=True \
+    )
+    if result.stderr:
+        print("Compilation errors follow:")
+        print(result.stderr)
+        exit()
+
+    print("-----------------")
+    print("Running testBindings")
+    print("-----------------")
+    # the module is built in the working directory
+    env = dict(os.environ, PYTHONPATH = os.getcwd())
+    result = subprocess.run([sys.executable, "TestGRiD/testBindings.py"] + DRIVER_ARGS, capture_output=True, text=True, env=env)
+    if result.stderr:
+        print("Runtime errors follow:")
+        print(result.stderr)
+        exit()
+    print(result.stdout)
+    return result.returncode == 0
+
+if __name__ == "__main__":
+    inputs = parseInputs()
+    URDF_PATH, DEBUG_MODE, FILE_NAMESPACE_NAME, FLOATING_BASE = inputs
+    sys.exit(0 if diffTestGRiD(URDF_PATH, FLOATING_BASE, useSplitBackend(), benchmarkArgs()) else 1)
@@ -1,8 +1,11 @@
 #!/usr/bin/python3
 from URDFParser import URDFParser
 from GRiDCodeGenerator import GRiDCodeGenerator
-from util import parseInputs, printUsage, validateRobot
+from GRiDCPUCodeGenerator import GRiDCPUCodeGenerator
+from util import parseInputs, printUsage, validateRobot, useCPUBackend, useSplitBackend, usePythonBindings, contentHash, cacheIsCurrent, writeCacheStamp
 from numpy import identity, zeros
+import inspect
+import os
 import sys
 
 J_TYPE = ["'Rx'", "'Ry'", "'Rz'", "'Px'", "'Py'", "Pz'"]
@@ -77,8 +80,30 @@ def generate_matlab_model(robot, floating_base):
     sys.stdout = original_stdout
     f.close()
 
+def generator_dirs(*classes):
+    # source directories of the generator (and parser) packages, hashed as the generator version
+    return [os.path.dirname(os.path.abspath(inspect.getfile(cls))) for cls in classes]
+
 def main():
     URDF_PATH, DEBUG_MODE, FILE_NAMESPACE_NAME, FLOATING_BASE = parseInputs()
+
+    # regenerating an unchanged robot (same URDF, options and generator sources) is a no-op
+    if useSplitBackend():
+        OUTPUT, OUTPUTS, GENERATOR = "grid_cpu/", ["grid_cpu/grid_cpu.hpp", "grid_cpu/libgrid_cpu.a"], GRiDCPUCodeGenerator
+    elif useCPUBackend():
+        OUTPUT, OUTPUTS, GENERATOR = "grid_cpu.hpp", ["grid_cpu.hpp"], GRiDCPUCodeGenerator
+    else:
+        OUTPUT, OUTPUTS, GENERATOR = "grid.cuh", ["grid.cuh"], GRiDCodeGenerator
+    BINDINGS = None
+    if usePythonBindings() and GENERATOR == GRiDCPUCodeGenerator:
+        BINDINGS = os.path.join(os.path.dirname(OUTPUTS[0]), "grid_cpu_py.cpp")
+        OUTPUTS = OUTPUTS + [BINDINGS]
+    STAMP_PATH = os.path.join(OUTPUT, "grid.hash") if OUTPUT.endswith("/") else OUTPUT + ".hash"
+    KEY = contentHash([URDF_PATH] + generator_dirs(GENERATOR, URDFParser), [OUTPUT, DEBUG_MODE, FILE_NAMESPACE_NAME, FLOATING_BASE, BINDINGS])
+    if cacheIsCurrent(STAMP_PATH, KEY, OUTPUTS):
+        print(OUTPUT + " is up to date with " + URDF_PATH + "!")
+        return
+
     parser = URDFParser()
     robot = parser.parse(URDF_PATH, floating_base=FLOATING_BASE)
 
@@ -88,10 +113,30 @@ def main():
     # generate_matlab_model(robot, FLOATINGBASE)
     # print(f"m file genereated and saved to {robot.name}.m!")
 
+    if useSplitBackend():
+        codegen = GRiDCPUCodeGenerator(robot, DEBUG_MODE, FILE_NAMESPACE = FILE_NAMESPACE_NAME)
+        sources = codegen.gen_split_code("grid_cpu")
+        if sources is not None and codegen.build_split_code(sources, "grid_cpu"):
+            if BINDINGS is not None:
+                codegen.gen_python_bindings(BINDINGS)
+            writeCacheStamp(STAMP_PATH, KEY)
+            print("New code generated and saved to grid_cpu/ (grid_cpu.hpp and libgrid_cpu.a" + (" and grid_cpu_py.cpp" if BINDINGS else "") + ")!")
+        return
+
+    if useCPUBackend():
+        codegen = GRiDCPUCodeGenerator(robot, DEBUG_MODE, FILE_NAMESPACE = FILE_NAMESPACE_NAME)
+        if codegen.gen_all_code():
+            if BINDINGS is not None:
+                codegen.gen_python_bindings(BINDINGS)
+            writeCacheStamp(STAMP_PATH, KEY)
+            print("New code generated and saved to grid_cpu.hpp" + (" and grid_cpu_py.cpp" if BINDINGS else "") + "!")
+        return
+
     codegen = GRiDCodeGenerator(robot, DEBUG_MODE, True, FILE_NAMESPACE = FILE_NAMESPACE_NAME)
     if FLOATING_BASE: include_homogenous_transforms = False
     else: include_homogenous_transforms = True
     codegen.gen_all_code(include_homogenous_transforms = include_homogenous_transforms)
+    writeCacheStamp(STAMP_PATH, KEY)
     print("New code generated and saved to grid.cuh!")
 
 if __name__ == "__main__":
@@ -1,15 +1,16 @@
 #!/usr/bin/python3
 from URDFParser import URDFParser
 from GRiDCodeGenerator import GRiDCodeGenerator
+from GRiDCPUCodeGenerator import GRiDCPUCodeGenerator
 from RBDReference import RBDReference
-from util import parseInputs, printUsage, validateRobot, initializeValues
+from util import parseInputs, printUsage, validateRobot, initializeValues, useCPUBackend
 import subprocess
 import numpy as np
 import re
 
 DIFF = 1e-2 # maximum allowable difference per value in outputs
 
-def testGRiD(URDF_PATH, FLOATING_BASE):
+def testGRiD(URDF_PATH, FLOATING_BASE, USE_CPU = False):
     """
     Tests all implemented algorithms in GRiD, and
     compares them with RBDReference. Returns a
@@ -24,22 +25,32 @@ def testGRiD(URDF_PATH, FLOATING_BASE):
 
     validateRobot(robot, NO_ARG_OPTION = True)
 
-    codegen = GRiDCodeGenerator(robot, False, True, FILE_NAMESPACE = 'grid')
-    print("-----------------")
-    print("Generating GRiD.cuh")
-    print("-----------------")
-    if FLOATING_BASE: include_homogenous_transforms = False
-    else: include_homogenous_transforms = True
-    codegen.gen_all_code(include_homogenous_transforms = include_homogenous_transforms)
-    print("New code generated and saved to grid.cuh!")
+    if USE_CPU:
+        codegen = GRiDCPUCodeGenerator(robot, False, FILE_NAMESPACE = 'grid')
+        print("-----------------")
+        print("Generating grid_cpu.hpp")
+        print("-----------------")
+        if not codegen.gen_all_code(): exit()
+        print("New code generated and saved to grid_cpu.hpp!")
+    else:
+        codegen = GRiDCodeGenerator(robot, False, True, FILE_NAMESPACE = 'grid')
+        print("-----------------")
+        print("Generating GRiD.cuh")
+        print("-----------------")
+        if FLOATING_BASE: include_homogenous_transforms = False
+        else: include_homogenous_transforms = True
+        codegen.gen_all_code(include_homogenous_transforms = include_homogenous_transforms)
+        print("New code generated and saved to grid.cuh!")
 
     if FLOATING_BASE: filename = 'TestGRiD/testGRiDFB.cu'
     else: filename = 'TestGRiD/testGRiD.cu'
     print("-----------------")
     print("Compiling testGRiD")
     print("-----------------")
+    if USE_CPU: compile_cmd = ["g++", "-std=c++11", "-O3", "-pthread", "-x", "c++", "-DGRID_CPU", "-o", "testGRiD.exe", filename]
+    else: compile_cmd = ["nvcc", "-o", "testGRiD.exe", filename]
     result = subprocess.run( \
-        ["nvcc", "-o", "testGRiD.exe", filename], \
+        compile_cmd, \
         capture_output=True, text=True \
     )
     if result.stderr:
@@ -223,4 +234,4 @@ if __name__ == "__main__":
     else: 
         print(f'Usage: printGRiD.py URDF_PATH FILE_NAMESPACE_NAME (-f) (-d)')
         exit()
-    testGRiD(URDF_PATH, FLOATING_BASE)
\ No newline at end of file
+    testGRiD(URDF_PATH, FLOATING_BASE, useCPUBackend())
\ No newline at end of file
@@ -1,13 +1,19 @@
 import sys
+import os
 import pathlib
+import hashlib
 import random
 import numpy as np
 np.set_printoptions(precision=4, suppress=True, linewidth = 100)
 
 def printUsage(NO_ARG_OPTION = False):
-    print("Usage is: script.py PATH_TO_URDF (FILE_NAMESPACE_NAME) (-d) (-f)")
+    print("Usage is: script.py PATH_TO_URDF (FILE_NAMESPACE_NAME) (-d) (-f) (-c) (-s) (-p)")
     print("                    where -D indicates full debug mode")
     print("                    where -f indicates floating base")
+    print("                    where -c indicates the host CPU backend (grid_cpu.hpp)")
+    print("                    where -s indicates the split host CPU backend (grid_cpu/, one translation unit per algorithm)")
+    print("                    where -p (with -c or -s) also emits grid_cpu_py.cpp, pybind11 bindings of the host CPU backend")
+    print("                    and --option=value arguments are passed to the benchmark drivers (see GRiDBenchmarks/util/benchmark_harness.h)")
     if NO_ARG_OPTION:
         print("Alternative usage assuming grid.cuh is already generated: script.py")
 
@@ -44,6 +50,10 @@ def parseInputs(NO_ARG_OPTION = False):
     for arg in args:
         if arg.lower() == '-d': DEBUG_MODE = True
         elif arg.lower() == '-f': FLOATING_BASE = True
+        elif arg.lower() == '-c': continue # see useCPUBackend
+        elif arg.lower() == '-s': continue # see useSplitBackend
+        elif arg.lower() == '-p': continue # see usePythonBindings
+        elif arg.startswith('--'): continue # see benchmarkArgs
         else: FILE_NAMESPACE_NAME = arg
     
     if FLOATING_BASE: DEBUG_MODE = False
@@ -55,6 +65,43 @@ def parseInputs(NO_ARG_OPTION = False):
 
     return (URDF_PATH, DEBUG_MODE, FILE_NAMESPACE_NAME, FLOATING_BASE)
 
+def useCPUBackend():
+    return '-c' in [arg.lower() for arg in sys.argv[1:]]
+
+def useSplitBackend():
+    return '-s' in [arg.lower() for arg in sys.argv[1:]]
+
+def usePythonBindings():
+    return '-p' in [arg.lower() for arg in sys.argv[1:]]
+
+def contentHash(PATHS, OPTIONS = []):
+    # sha256 of every source file in PATHS (directories are walked in sorted order) and every OPTIONS string
+    SOURCE_SUFFIXES = ('.py', '.hpp', '.h', '.cuh', '.cu', '.cpp', '.urdf', '.xml')
+    h = hashlib.sha256()
+    for PATH in PATHS:
+        files = [PATH]
+        if os.path.isdir(PATH):
+            files = sorted(os.path.join(root, name) for (root, dirs, names) in os.walk(PATH) \
+                           for name in names if name.endswith(SOURCE_SUFFIXES) and '__pycache__' not in root)
+        for FILE_PATH in files:
+            h.update(os.path.basename(FILE_PATH).encode())
+            h.update(pathlib.Path(FILE_PATH).read_bytes())
+    for OPTION in OPTIONS:
+        h.update(str(OPTION).encode())
+    return h.hexdigest()
+
+def cacheIsCurrent(STAMP_PATH, KEY, OUTPUTS):
+    # true if OUTPUTS exist and were generated from KEY (see writeCacheStamp)
+    if not fileExists(STAMP_PATH) or not all(os.path.exists(OUTPUT) for OUTPUT in OUTPUTS):
+        return False
+    return pathlib.Path(STAMP_PATH).read_text().strip() == KEY
+
+def writeCacheStamp(STAMP_PATH, KEY):
+    pathlib.Path(STAMP_PATH).write_text(KEY + "\n")
+
+def benchmarkArgs():
+    return [arg for arg in sys.argv[1:] if arg.startswith('--')]
+
 def validateRobot(robot, NO_ARG_OPTION = False):
     if robot == None:
         print("[!Error] URDF parsing failed. Please make sure you input a valid URDF file.")